@@ -0,0 +1,732 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "Body.h"
+#include "BodySystem.h"
+#include "BHTree.h"
+#include "BHTreeNode.h"
+#include "Diagnostics.h"
+#include "FMM.h"
+#include "GroupWalk.h"
+#include "Simulation.h"
+
+// Porównania wydajności wariantów symulacji. Wyniki wypisywane są w formacie CSV (separator ';'),
+// tak jak w barnes_hut_results.csv.
+
+static std::vector<Body> random_bodies(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(-1000.0, 1000.0);
+    std::uniform_real_distribution<double> mass(1.0e20, 1.0e21);
+    std::vector<Body> bodies;
+    bodies.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        bodies.emplace_back(mass(rng), pos(rng), pos(rng), pos(rng), 0.0, 0.0, 0.0);
+    }
+    return bodies;
+}
+
+// skupiska po 1000 ciał o rozkładzie normalnym - odpowiednik naszych rozkładów zgęszczonych
+static std::vector<Body> clustered_bodies(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> spread(0.0, 10.0);
+    std::uniform_real_distribution<double> centre(-1000.0, 1000.0);
+    std::uniform_real_distribution<double> mass(1.0e20, 1.0e21);
+    std::vector<Body> bodies;
+    bodies.reserve(n);
+    double cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int i = 0; i < n; ++i) {
+        if (i % 1000 == 0) {
+            cx = centre(rng);
+            cy = centre(rng);
+            cz = centre(rng);
+        }
+        bodies.emplace_back(mass(rng), cx + spread(rng), cy + spread(rng), cz + spread(rng), 0.0, 0.0, 0.0);
+    }
+    return bodies;
+}
+
+template <typename F>
+static double time_ms(F&& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// pamięć drzewa wskaźnikowego: węzły, kopie ciał w liściach i narzut alokatora na każdy obiekt
+static size_t legacy_memory(const BHTreeNode& node) {
+    const size_t allocatorOverhead = 16;
+    size_t bytes = sizeof(BHTreeNode) + allocatorOverhead;
+    if (!node.bodies.empty()) bytes += node.bodies.capacity() * sizeof(Body) + allocatorOverhead;
+    for (const auto& child : node.children) {
+        if (child) bytes += legacy_memory(*child);
+    }
+    return bytes;
+}
+
+// drzewo wskaźnikowe (BHTreeNode) kontra pula węzłów (BHTree): czas budowy, czas sił i pamięć
+static void bench_tree(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;LegacyBuild(ms);PoolBuild(ms);LegacyForce(ms);PoolForce(ms);LegacyMemory(B);PoolMemory(B)\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = random_bodies(n, 42);
+        BHTree tree;
+        build_bhtree(bodies, tree);     // rozgrzewka - pula osiąga docelowy rozmiar
+
+        double legacyBuild = 0.0, poolBuild = 0.0, legacyForce = 0.0, poolForce = 0.0;
+        size_t legacyBytes = 0;
+        for (int r = 0; r < repeats; ++r) {
+            legacyBuild += time_ms([&] {
+                BHTreeNode root = build_bhtree_legacy(bodies);
+                legacyForce += time_ms([&] {
+                    for (const auto& body : bodies) {
+                        double fx = 0.0, fy = 0.0, fz = 0.0;
+                        root.calculateForce(body, fx, fy, fz);
+                    }
+                });
+                legacyBytes = legacy_memory(root);
+            });
+            poolBuild += time_ms([&] { build_bhtree(bodies, tree); });
+            poolForce += time_ms([&] {
+                for (uint32_t i = 0; i < bodies.size(); ++i) {
+                    double fx = 0.0, fy = 0.0, fz = 0.0;
+                    tree.calculateForce(bodies, i, fx, fy, fz);
+                }
+            });
+        }
+        // czas budowy drzewa wskaźnikowego obejmuje też jego zwolnienie, ale nie pętlę sił
+        legacyBuild -= legacyForce;
+
+        std::cout << n << ";" << legacyBuild / repeats << ";" << poolBuild / repeats << ";"
+                  << legacyForce / repeats << ";" << poolForce / repeats << ";"
+                  << legacyBytes << ";" << tree.memoryUsage() << "\n";
+    }
+}
+
+// liczby wątków do pomiarów skalowania: 1, 2, 4, ..., maksimum
+static std::vector<int> thread_counts() {
+    const int maxThreads = omp_get_max_threads();
+    std::vector<int> counts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+// budowa przez wstawianie kontra równoległa budowa Mortona dla 1..N wątków
+static void bench_build(const std::vector<int>& sizes, int repeats) {
+    const int maxThreads = omp_get_max_threads();
+    std::cout << "N;Threads;InsertionBuild(ms);MortonBuild(ms);Speedup\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = random_bodies(n, 42);
+        Octant root = bounding_octant(bodies);
+        BHTree inserted, sorted;
+        inserted.buildByInsertion(bodies, root);
+
+        double insertion = 0.0;
+        for (int r = 0; r < repeats; ++r) {
+            insertion += time_ms([&] { inserted.buildByInsertion(bodies, root); });
+        }
+        insertion /= repeats;
+
+        for (int threads : thread_counts()) {
+            omp_set_num_threads(threads);
+            sorted.buildMorton(bodies, root);
+            double morton = 0.0;
+            for (int r = 0; r < repeats; ++r) {
+                morton += time_ms([&] { sorted.buildMorton(bodies, root); });
+            }
+            morton /= repeats;
+            std::cout << n << ";" << threads << ";" << insertion << ";" << morton << ";" << insertion / morton << "\n";
+        }
+        omp_set_num_threads(maxThreads);
+    }
+}
+
+// przejście rekurencyjne kontra pętla po spłaszczonym drzewie (jednowątkowo, sama pętla sił)
+static void bench_traversal(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;Flatten(ms);Recursive(ms);Stackless(ms);Speedup\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = random_bodies(n, 42);
+        BHTree tree;
+        build_bhtree(bodies, tree);
+
+        double flatten = 0.0, recursive = 0.0, stackless = 0.0;
+        for (int r = 0; r < repeats; ++r) {
+            flatten += time_ms([&] { tree.flatten(); });
+            recursive += time_ms([&] {
+                for (uint32_t i : tree.order) {
+                    double fx = 0.0, fy = 0.0, fz = 0.0;
+                    tree.calculateForce(bodies, i, fx, fy, fz);
+                }
+            });
+            stackless += time_ms([&] {
+                for (uint32_t i : tree.order) {
+                    double fx = 0.0, fy = 0.0, fz = 0.0;
+                    tree.calculateForceStackless(bodies, i, fx, fy, fz);
+                }
+            });
+        }
+        std::cout << n << ";" << flatten / repeats << ";" << recursive / repeats << ";" << stackless / repeats << ";"
+                  << recursive / stackless << "\n";
+    }
+}
+
+// przejście pojedyncze (bez stosu) kontra przejście grupowe; błąd względem theta = 0.1
+static void bench_group(const std::vector<int>& sizes, int repeats, double theta) {
+    std::cout << "Distribution;N;GroupSize;PerBody(ms);Grouped(ms);Speedup;PairsPerBody;MaxRelError\n";
+    for (int clustered = 0; clustered < 2; ++clustered) {
+        for (int n : sizes) {
+            std::vector<Body> bodies = clustered ? clustered_bodies(n, 42) : random_bodies(n, 42);
+            BHTree tree;
+            build_bhtree(bodies, tree);
+            tree.flatten();
+
+            std::vector<double> fx(n), fy(n), fz(n);
+            double perBody = 0.0;
+            for (int r = 0; r < repeats; ++r) {
+                perBody += time_ms([&] {
+                    #pragma omp parallel for
+                    for (int k = 0; k < n; ++k) {
+                        uint32_t i = tree.order[k];
+                        double x = 0.0, y = 0.0, z = 0.0;
+                        tree.calculateForceStackless(bodies, i, x, y, z, theta);
+                        fx[i] = x;
+                        fy[i] = y;
+                        fz[i] = z;
+                    }
+                });
+            }
+
+            // wartości odniesienia dla próbki ciał
+            std::vector<uint32_t> sample;
+            std::vector<double> rx, ry, rz;
+            for (uint32_t i = 0; i < static_cast<uint32_t>(n); i += std::max(1, n / 200)) {
+                double x = 0.0, y = 0.0, z = 0.0;
+                tree.calculateForceStackless(bodies, i, x, y, z, 0.1);
+                sample.push_back(i);
+                rx.push_back(x);
+                ry.push_back(y);
+                rz.push_back(z);
+            }
+
+            for (int groupSize : {8, 32, 128}) {
+                GroupWalkStats stats;
+                double grouped = 0.0;
+                for (int r = 0; r < repeats; ++r) {
+                    grouped += time_ms([&] { stats = compute_forces_grouped(tree, bodies, theta, groupSize, fx, fy, fz); });
+                }
+                double maxError = 0.0;
+                for (size_t s = 0; s < sample.size(); ++s) {
+                    uint32_t i = sample[s];
+                    double ex = fx[i] - rx[s], ey = fy[i] - ry[s], ez = fz[i] - rz[s];
+                    double norm = std::sqrt(rx[s] * rx[s] + ry[s] * ry[s] + rz[s] * rz[s]);
+                    maxError = std::max(maxError, std::sqrt(ex * ex + ey * ey + ez * ez) / norm);
+                }
+                std::cout << (clustered ? "clustered" : "uniform") << ";" << n << ";" << groupSize << ";"
+                          << perBody / repeats << ";" << grouped / repeats << ";" << perBody / grouped << ";"
+                          << static_cast<double>(stats.interactions) / n << ";" << maxError << "\n";
+            }
+        }
+    }
+}
+
+// suma bezpośrednia dla jednego ciała (wartość odniesienia błędu)
+static void direct_force(const std::vector<Body>& bodies, uint32_t i, double& fx, double& fy, double& fz) {
+    const double G = 6.67430e-11;
+    fx = fy = fz = 0.0;
+    for (uint32_t j = 0; j < bodies.size(); ++j) {
+        if (j == i) continue;
+        double dx = bodies[j].x - bodies[i].x, dy = bodies[j].y - bodies[i].y, dz = bodies[j].z - bodies[i].z;
+        double dist_sq = dx * dx + dy * dy + dz * dz;
+        double s = G * bodies[i].mass * bodies[j].mass / (dist_sq * std::sqrt(dist_sq));
+        fx += s * dx;
+        fy += s * dy;
+        fz += s * dz;
+    }
+}
+
+// monopol kontra kwadrupol: czas pętli sił i błąd względny (średni i 99. percentyl) dla kilku theta
+static void bench_multipole(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;Order;Theta;Build(ms);Force(ms);MeanRelError;P99RelError\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = clustered_bodies(n, 42);
+        std::vector<uint32_t> sample;
+        std::vector<double> rx, ry, rz;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(n); i += std::max(1, n / 100)) {
+            double x, y, z;
+            direct_force(bodies, i, x, y, z);
+            sample.push_back(i);
+            rx.push_back(x);
+            ry.push_back(y);
+            rz.push_back(z);
+        }
+
+        for (int order : {BHTree::MONOPOLE, BHTree::QUADRUPOLE}) {
+            for (double theta : {0.4, 0.6, 0.8, 1.0, 1.2}) {
+                BHTree tree;
+                tree.multipoleOrder = order;
+                double build = 0.0, force = 0.0;
+                for (int r = 0; r < repeats; ++r) {
+                    build += time_ms([&] { build_bhtree(bodies, tree); tree.flatten(); });
+                    force += time_ms([&] {
+                        #pragma omp parallel for
+                        for (int k = 0; k < n; ++k) {
+                            double x = 0.0, y = 0.0, z = 0.0;
+                            tree.calculateForceStackless(bodies, tree.order[k], x, y, z, theta);
+                        }
+                    });
+                }
+
+                std::vector<double> errors;
+                for (size_t s = 0; s < sample.size(); ++s) {
+                    double x = 0.0, y = 0.0, z = 0.0;
+                    tree.calculateForceStackless(bodies, sample[s], x, y, z, theta);
+                    double ex = x - rx[s], ey = y - ry[s], ez = z - rz[s];
+                    errors.push_back(std::sqrt((ex * ex + ey * ey + ez * ez) / (rx[s] * rx[s] + ry[s] * ry[s] + rz[s] * rz[s])));
+                }
+                std::sort(errors.begin(), errors.end());
+                double mean = 0.0;
+                for (double e : errors) mean += e;
+                mean /= errors.size();
+
+                std::cout << n << ";" << order << ";" << theta << ";" << build / repeats << ";" << force / repeats << ";"
+                          << mean << ";" << errors[errors.size() * 99 / 100] << "\n";
+            }
+        }
+    }
+}
+
+// błąd względny (średni i 99. percentyl) sił `fx, fy, fz` dla próbki ciał
+static void sample_errors(const std::vector<uint32_t>& sample, const std::vector<double>& rx,
+                          const std::vector<double>& ry, const std::vector<double>& rz, const std::vector<double>& fx,
+                          const std::vector<double>& fy, const std::vector<double>& fz, double& mean, double& p99) {
+    std::vector<double> errors;
+    for (size_t s = 0; s < sample.size(); ++s) {
+        uint32_t i = sample[s];
+        double ex = fx[i] - rx[s], ey = fy[i] - ry[s], ez = fz[i] - rz[s];
+        errors.push_back(std::sqrt((ex * ex + ey * ey + ez * ez) / (rx[s] * rx[s] + ry[s] * ry[s] + rz[s] * rz[s])));
+    }
+    std::sort(errors.begin(), errors.end());
+    mean = 0.0;
+    for (double e : errors) mean += e;
+    mean /= errors.size();
+    p99 = errors[errors.size() * 99 / 100];
+}
+
+// FMM (rzędy 2, 4, 6) kontra Barnes-Hut i suma bezpośrednia (jak w cpu-proj) dla 1..N wątków. Czas sumy
+// bezpośredniej dla dużych N jest ekstrapolowany z pomiaru dla próbki ciał (koszt rośnie liniowo z liczbą celów).
+static void bench_fmm(const std::vector<int>& sizes, int repeats) {
+    const int maxThreads = omp_get_max_threads();
+    std::cout << "N;Threads;Method;Order;Build(ms);Force(ms);MeanRelError;P99RelError\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = clustered_bodies(n, 42);
+        std::vector<uint32_t> sample;
+        std::vector<double> rx, ry, rz;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(n); i += std::max(1, n / 100)) {
+            sample.push_back(i);
+            rx.push_back(0.0);
+            ry.push_back(0.0);
+            rz.push_back(0.0);
+        }
+        const int samples = static_cast<int>(sample.size());
+        double direct = time_ms([&] {
+            #pragma omp parallel for
+            for (int s = 0; s < samples; ++s) direct_force(bodies, sample[s], rx[s], ry[s], rz[s]);
+        });
+        std::cout << n << ";" << maxThreads << ";direct;0;0;" << direct * n / samples << ";0;0\n";
+
+        std::vector<double> fx(n), fy(n), fz(n);
+        for (int threads : thread_counts()) {
+            omp_set_num_threads(threads);
+            BHTree tree;
+            double build = 0.0, force = 0.0, mean = 0.0, p99 = 0.0;
+            for (int r = 0; r < repeats; ++r) {
+                build += time_ms([&] { build_bhtree(bodies, tree); tree.flatten(); });
+                force += time_ms([&] {
+                    #pragma omp parallel for
+                    for (int k = 0; k < n; ++k) {
+                        uint32_t i = tree.order[k];
+                        double x = 0.0, y = 0.0, z = 0.0;
+                        tree.calculateForceStackless(bodies, i, x, y, z);
+                        fx[i] = x;
+                        fy[i] = y;
+                        fz[i] = z;
+                    }
+                });
+            }
+            sample_errors(sample, rx, ry, rz, fx, fy, fz, mean, p99);
+            std::cout << n << ";" << threads << ";bh;1;" << build / repeats << ";" << force / repeats << ";"
+                      << mean << ";" << p99 << "\n";
+
+            for (int order : {2, 4, 6}) {
+                FMMSolver solver(order);
+                force = 0.0;
+                for (int r = 0; r < repeats; ++r) {
+                    force += time_ms([&] { solver.computeForces(tree, bodies, fx, fy, fz); });
+                }
+                sample_errors(sample, rx, ry, rz, fx, fy, fz, mean, p99);
+                std::cout << n << ";" << threads << ";fmm;" << order << ";" << build / repeats << ";"
+                          << force / repeats << ";" << mean << ";" << p99 << "\n";
+            }
+        }
+        omp_set_num_threads(maxThreads);
+    }
+}
+
+// pełna budowa drzewa w każdym kroku kontra refit: ciała przesuwają się o v * dt, jak w symulacji
+static void bench_refit(const std::vector<int>& sizes, int steps) {
+    std::cout << "N;Steps;Rebuild(ms/step);Refit(ms/step);Rebuilds;Migrated\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = clustered_bodies(n, 42);
+        std::mt19937 rng(7);
+        std::normal_distribution<double> velocity(0.0, 1.0);
+        for (auto& b : bodies) {
+            b.vx = velocity(rng);
+            b.vy = velocity(rng);
+            b.vz = velocity(rng);
+        }
+
+        BHTree rebuilt, refitted;
+        build_bhtree(bodies, rebuilt);
+        build_bhtree(bodies, refitted);
+        double rebuild = 0.0, refit = 0.0;
+        size_t rebuilds = 0, migrated = 0;
+        for (int step = 0; step < steps; ++step) {
+            for (auto& b : bodies) {
+                b.x += b.vx * 0.01;
+                b.y += b.vy * 0.01;
+                b.z += b.vz * 0.01;
+            }
+            rebuild += time_ms([&] { build_bhtree(bodies, rebuilt); });
+            refit += time_ms([&] {
+                if (!refitted.refit(bodies)) {
+                    migrated += refitted.migratedSinceBuild();
+                    build_bhtree(bodies, refitted);
+                    ++rebuilds;
+                }
+            });
+        }
+        migrated += refitted.migratedSinceBuild();
+        std::cout << n << ";" << steps << ";" << rebuild / steps << ";" << refit / steps << ";" << rebuilds << ";"
+                  << migrated << "\n";
+    }
+}
+
+// pojemność liścia K: czas budowy, czas sił (przejście bezstosowe), liczba węzłów, pamięć i błąd sił
+static void bench_leaf(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;LeafSize;Build(ms);Force(ms);Nodes;Memory(B);MeanRelError;P99RelError\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = clustered_bodies(n, 42);
+        std::vector<uint32_t> sample;
+        std::vector<double> rx, ry, rz;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(n); i += std::max(1, n / 100)) {
+            sample.push_back(i);
+            rx.push_back(0.0);
+            ry.push_back(0.0);
+            rz.push_back(0.0);
+        }
+        const int samples = static_cast<int>(sample.size());
+        #pragma omp parallel for
+        for (int s = 0; s < samples; ++s) direct_force(bodies, sample[s], rx[s], ry[s], rz[s]);
+
+        std::vector<double> fx(n), fy(n), fz(n);
+        for (int leafSize : {1, 2, 4, 8, 16, 32, 64}) {
+            BHTree tree;
+            tree.leafSize = leafSize;
+            build_bhtree(bodies, tree);     // rozgrzewka - pula osiąga docelowy rozmiar
+            double build = 0.0, force = 0.0, mean = 0.0, p99 = 0.0;
+            for (int r = 0; r < repeats; ++r) {
+                build += time_ms([&] { build_bhtree(bodies, tree); tree.flatten(); });
+                force += time_ms([&] {
+                    #pragma omp parallel for
+                    for (int k = 0; k < n; ++k) {
+                        uint32_t i = tree.order[k];
+                        double x = 0.0, y = 0.0, z = 0.0;
+                        tree.calculateForceStackless(bodies, i, x, y, z);
+                        fx[i] = x;
+                        fy[i] = y;
+                        fz[i] = z;
+                    }
+                });
+            }
+            sample_errors(sample, rx, ry, rz, fx, fy, fz, mean, p99);
+            std::cout << n << ";" << leafSize << ";" << build / repeats << ";" << force / repeats << ";"
+                      << tree.nodes.size() << ";" << tree.memoryUsage() << ";" << mean << ";" << p99 << "\n";
+        }
+    }
+}
+
+// wspólny krok dt i wspólny najkrótszy krok dt / 2^L kontra hierarchiczne kroki czasowe: czas kroku, liczba
+// obliczeń sił i średnia odległość od pozycji z najkrótszym krokiem (punkt odniesienia)
+static void bench_block(const std::vector<int>& sizes, int steps) {
+    const int levels = 4;
+    std::cout << "N;Levels;Method;Time(ms/step);ForceEvaluations;MeanPositionError\n";
+    for (int n : sizes) {
+        std::vector<Body> initial = clustered_bodies(n, 42);
+        for (auto& b : initial) b.mass *= 1e-10;    // skupiska związane, ale bez rozbiegania w kilku krokach
+
+        std::vector<Body> reference;
+        for (const char* method : {"fine", "shared", "block"}) {
+            std::vector<Body> bodies = initial;
+            SimulationContext context;
+            if (std::strcmp(method, "shared") != 0) context.options.timestepLevels = levels;
+            if (std::strcmp(method, "fine") == 0) context.options.timestepEta = 1e-12;
+            double time = time_ms([&] {
+                for (int step = 0; step < steps; ++step) simulate_step(bodies, context);
+            });
+            if (reference.empty()) reference = bodies;
+
+            double error = 0.0;
+            for (int i = 0; i < n; ++i) {
+                double dx = bodies[i].x - reference[i].x, dy = bodies[i].y - reference[i].y;
+                double dz = bodies[i].z - reference[i].z;
+                error += std::sqrt(dx * dx + dy * dy + dz * dz);
+            }
+            std::cout << n << ";" << levels << ";" << method << ";" << time / steps << ";" << context.forceEvaluations << ";"
+                      << error / n << "\n";
+        }
+    }
+}
+
+// energia całkowita: podwójna pętla O(N^2) (dawne calculate_total_energy) kontra diagnostyka z drzewem;
+// suma bezpośrednia dla dużych N jest ekstrapolowana z pierwszych wierszy (koszt rośnie liniowo z liczbą wierszy)
+static void bench_energy(const std::vector<int>& sizes, int repeats) {
+    const double G = 6.67430e-11;
+    std::cout << "N;Direct(ms);Diagnostics(ms);RelEnergyError\n";
+    for (int n : sizes) {
+        std::vector<Body> bodies = clustered_bodies(n, 42);
+        const int rows = std::min(n, 2000);
+        double exact = 0.0;
+        double direct = time_ms([&] {
+            for (int i = 0; i < rows; ++i) {
+                for (int j = i + 1; j < n; ++j) {
+                    double dx = bodies[i].x - bodies[j].x;
+                    double dy = bodies[i].y - bodies[j].y;
+                    double dz = bodies[i].z - bodies[j].z;
+                    exact -= G * bodies[i].mass * bodies[j].mass / std::sqrt(dx * dx + dy * dy + dz * dz);
+                }
+            }
+        });
+        // wiersze i < rows zawierają część par; pełna suma liczy (n - 1) / 2 par na wiersz
+        direct *= static_cast<double>(n) * (n - 1) / 2.0 / (static_cast<double>(rows) * (2.0 * n - rows - 1) / 2.0);
+
+        BHTree tree;
+        Diagnostics d;
+        double diagnostics = 0.0;
+        for (int r = 0; r < repeats; ++r) {
+            diagnostics += time_ms([&] { d = compute_diagnostics(bodies, tree, DiagnosticsMonitor::DEFAULT_THETA); });
+        }
+        double error = 0.0;
+        if (rows == n) {                    // odniesienie: pełna podwójna pętla
+            error = std::abs(d.total() - (d.kinetic + exact)) / std::abs(d.kinetic + exact);
+        }
+        else if (n <= 10000) {              // odniesienie: drzewo z theta = 0, czyli suma dokładna
+            Diagnostics reference = compute_diagnostics(bodies, tree, 0.0);
+            error = std::abs(d.total() - reference.total()) / std::abs(reference.total());
+        }
+        std::cout << n << ";" << direct << ";" << diagnostics / repeats << ";" << error << "\n";
+    }
+}
+
+// std::vector<Body> (AoS) kontra BodySystem (SoA, tablice wyrównane do 64 B): całkowanie, prostopadłościan
+// otaczający i budowa drzewa
+static void bench_layout(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;AoSIntegrate(ms);SoAIntegrate(ms);AoSBounds(ms);SoABounds(ms);AoSBuild(ms);SoABuild(ms)\n";
+    for (int n : sizes) {
+        std::vector<Body> aos = random_bodies(n, 42);
+        BodySystem soa(aos);
+        std::vector<double> fx(n, 1.0e15), fy(n, -1.0e15), fz(n, 0.5e15);
+        BHTree aosTree, soaTree;
+        build_bhtree(aos, aosTree);
+        build_bhtree(soa, soaTree);
+
+        double aosIntegrate = 0.0, soaIntegrate = 0.0, aosBounds = 0.0, soaBounds = 0.0, aosBuild = 0.0, soaBuild = 0.0;
+        for (int r = 0; r < repeats; ++r) {
+            aosIntegrate += time_ms([&] {
+                #pragma omp parallel for
+                for (int i = 0; i < n; ++i) update_body_leapfrog(aos[i], fx[i], fy[i], fz[i]);
+            });
+            soaIntegrate += time_ms([&] { update_bodies_leapfrog(soa, fx, fy, fz); });
+            aosBounds += time_ms([&] { bounding_octant(aos); });
+            soaBounds += time_ms([&] { bounding_octant(soa); });
+            aosBuild += time_ms([&] { build_bhtree(aos, aosTree); });
+            soaBuild += time_ms([&] { build_bhtree(soa, soaTree); });
+        }
+        std::cout << n << ";" << aosIntegrate / repeats << ";" << soaIntegrate / repeats << ";"
+                  << aosBounds / repeats << ";" << soaBounds / repeats << ";" << aosBuild / repeats << ";"
+                  << soaBuild / repeats << "\n";
+    }
+}
+
+// tryb mieszanej precyzji (BodySystemF, BHTreeF) kontra double: czas kroku, pamięć ciał i drzewa oraz błędy
+// względem ścieżki double - względny błąd siły (mediana i maksimum) i największe przesunięcie pozycji po
+// `steps` krokach odniesione do rozmiaru układu; osobno dla przejścia bez stosu i grupowego
+static void bench_precision(const std::vector<int>& sizes, int steps) {
+    std::cout << "N;Traversal;DoubleStep(ms);MixedStep(ms);DoubleMemory(MB);MixedMemory(MB);MedianForceError;"
+                 "MaxForceError;PositionError\n";
+    for (int n : sizes)
+    for (TraversalMode traversal : {TraversalMode::Stackless, TraversalMode::Grouped}) {
+        std::vector<Body> initial = clustered_bodies(n, 42);
+        BodySystem full(initial);
+        BodySystemF mixed(initial);
+        SimulationContext fullContext;
+        SimulationContextF mixedContext;
+        fullContext.options.traversal = mixedContext.options.traversal = traversal;
+
+        double fullTime = 0.0, mixedTime = 0.0;
+        std::vector<double> errors(n);
+        for (int step = 0; step < steps; ++step) {
+            fullTime += time_ms([&] { simulate_step(full, fullContext); });
+            mixedTime += time_ms([&] { simulate_step(mixed, mixedContext); });
+            if (step > 0) continue;
+            for (int i = 0; i < n; ++i) {
+                double dx = mixedContext.fx[i] - fullContext.fx[i];
+                double dy = mixedContext.fy[i] - fullContext.fy[i];
+                double dz = mixedContext.fz[i] - fullContext.fz[i];
+                double norm = std::sqrt(fullContext.fx[i] * fullContext.fx[i] + fullContext.fy[i] * fullContext.fy[i]
+                                        + fullContext.fz[i] * fullContext.fz[i]);
+                errors[i] = std::sqrt(dx * dx + dy * dy + dz * dz) / norm;
+            }
+        }
+
+        double position = 0.0;
+        for (int i = 0; i < n; ++i) {
+            position = std::max(position, std::abs(static_cast<double>(mixed.x[i]) - full.x[i]));
+            position = std::max(position, std::abs(static_cast<double>(mixed.y[i]) - full.y[i]));
+            position = std::max(position, std::abs(static_cast<double>(mixed.z[i]) - full.z[i]));
+        }
+        const double extent = bounding_octant(full).size;
+        std::sort(errors.begin(), errors.end());
+        const double mb = 1024.0 * 1024.0;
+        std::cout << n << ";" << (traversal == TraversalMode::Grouped ? "grouped" : "stackless") << ";"
+                  << fullTime / steps << ";" << mixedTime / steps << ";"
+                  << (full.memoryUsage() + fullContext.tree.memoryUsage()) / mb << ";"
+                  << (mixed.memoryUsage() + mixedContext.tree.memoryUsage()) / mb << ";" << errors[n / 2] << ";"
+                  << errors.back() << ";" << position / extent << "\n";
+    }
+}
+
+// płaski dysk o gęstości malejącej wykładniczo z promieniem, w płaszczyźnie z = 0
+static std::vector<Body> disk_bodies(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::exponential_distribution<double> radius(1.0 / 300.0);
+    std::uniform_real_distribution<double> angle(0.0, 2.0 * M_PI);
+    std::uniform_real_distribution<double> mass(1.0e20, 1.0e21);
+    std::vector<Body> bodies;
+    bodies.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        double r = radius(rng), phi = angle(rng);
+        bodies.emplace_back(mass(rng), r * std::cos(phi), r * std::sin(phi), 0.0, 0.0, 0.0, 0.0);
+    }
+    return bodies;
+}
+
+// czas budowy i przejścia (bez stosu), liczba węzłów i pamięć drzewa o wymiarze `Dim` dla płaskiego dysku;
+// siły zapisywane są w `fx`, `fy`
+template <int Dim>
+static void time_dimension(const BodySystem& bodies, int repeats, double& build, double& forces, size_t& nodes,
+                           size_t& memory, std::vector<double>& fx, std::vector<double>& fy) {
+    const int n = static_cast<int>(bodies.size());
+    BHTreeT<double, Dim> tree;
+    build = forces = 0.0;
+    for (int r = 0; r < repeats; ++r) {
+        build += time_ms([&] { build_bhtree(bodies, tree); tree.flatten(); });
+        forces += time_ms([&] {
+            #pragma omp parallel for
+            for (int k = 0; k < n; ++k) {
+                const uint32_t i = tree.order[k];
+                double x = 0.0, y = 0.0, z = 0.0;
+                tree.calculateForceStackless(bodies, i, x, y, z);
+                fx[i] = x;
+                fy[i] = y;
+            }
+        });
+    }
+    build /= repeats;
+    forces /= repeats;
+    nodes = tree.nodes.size();
+    memory = tree.memoryUsage();
+}
+
+// drzewo ósemkowe kontra czwórkowe (--dimensions 2) dla płaskiego dysku: budowa, siły, rozmiar drzewa i mediana
+// względnej różnicy sił między drzewami
+static void bench_dimensions(const std::vector<int>& sizes, int repeats) {
+    std::cout << "N;OctreeBuild(ms);QuadtreeBuild(ms);OctreeForces(ms);QuadtreeForces(ms);OctreeNodes;QuadtreeNodes;"
+                 "OctreeMemory(MB);QuadtreeMemory(MB);MedianForceDifference\n";
+    for (int n : sizes) {
+        BodySystem bodies(disk_bodies(n, 42));
+        std::vector<double> ox(n), oy(n), qx(n), qy(n);
+        double octreeBuild, octreeForces, quadtreeBuild, quadtreeForces;
+        size_t octreeNodes, quadtreeNodes, octreeMemory, quadtreeMemory;
+        time_dimension<3>(bodies, repeats, octreeBuild, octreeForces, octreeNodes, octreeMemory, ox, oy);
+        time_dimension<2>(bodies, repeats, quadtreeBuild, quadtreeForces, quadtreeNodes, quadtreeMemory, qx, qy);
+
+        std::vector<double> differences(n);
+        for (int i = 0; i < n; ++i) {
+            differences[i] = std::hypot(qx[i] - ox[i], qy[i] - oy[i]) / std::hypot(ox[i], oy[i]);
+        }
+        std::nth_element(differences.begin(), differences.begin() + n / 2, differences.end());
+        const double mb = 1024.0 * 1024.0;
+        std::cout << n << ";" << octreeBuild << ";" << quadtreeBuild << ";" << octreeForces << ";" << quadtreeForces
+                  << ";" << octreeNodes << ";" << quadtreeNodes << ";" << octreeMemory / mb << ";"
+                  << quadtreeMemory / mb << ";" << differences[n / 2] << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "tree";
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+    std::vector<int> sizes = {1000, 10000, 100000, 1000000};
+
+    if (mode == "tree") {
+        bench_tree(sizes, repeats);
+    }
+    else if (mode == "build") {
+        bench_build(sizes, repeats);
+    }
+    else if (mode == "traversal") {
+        bench_traversal(sizes, repeats);
+    }
+    else if (mode == "group") {
+        bench_group(sizes, repeats, BHTree::DEFAULT_THETA);
+    }
+    else if (mode == "multipole") {
+        bench_multipole({10000, 100000}, repeats);
+    }
+    else if (mode == "refit") {
+        bench_refit(sizes, 20);
+    }
+    else if (mode == "leaf") {
+        bench_leaf(sizes, repeats);
+    }
+    else if (mode == "block") {
+        bench_block({10000, 100000}, 5);
+    }
+    else if (mode == "energy") {
+        bench_energy(sizes, repeats);
+    }
+    else if (mode == "layout") {
+        std::vector<int> large = sizes;
+        large.push_back(10000000);
+        bench_layout(large, repeats);
+    }
+    else if (mode == "precision") {
+        bench_precision(sizes, repeats);
+    }
+    else if (mode == "dimensions") {
+        bench_dimensions(sizes, repeats);
+    }
+    else if (mode == "fmm") {
+        bench_fmm({10000, 100000, 500000}, repeats);
+    }
+    else {
+        std::cerr << "Uzycie: " << argv[0] << " [tree|build|traversal|group|multipole|fmm|refit|leaf|block|energy|layout|precision|dimensions] [powtorzenia]\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,755 @@
+#include "BHTree.h"
+#include "Gravity.h"
+#include <algorithm>
+#include <cmath>
+
+template <typename Real, int Dim>
+BHNodeT<Real, Dim>::BHNodeT(const Orthant<Dim>& region_)
+    : region(region_), mass(0), first(NONE), count(0), leaf(true) {
+    center.fill(0);
+    quad.fill(0);
+    children.fill(NONE);
+}
+
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::reset() {
+    nodes.clear();
+    order.clear();
+    next.clear();
+    levels.clear();
+    flat.clear();
+    migrated = 0;
+}
+
+template <typename Real, int Dim>
+uint32_t BHTreeT<Real, Dim>::allocate(const Region& region) {
+    nodes.emplace_back(region);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+// klucze Mortona ciał względem regionu korzenia (2^21 komórek na oś w 3D, 2^31 w 2D)
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::computeKeys(const Bodies& bodies, const Region& rootRegion) {
+    const int n = static_cast<int>(bodies.size());
+    const double cells = static_cast<double>(1u << MAX_DEPTH);
+    const double maxCell = cells - 1.0;
+    const double scale = rootRegion.size > 0.0 ? cells / rootRegion.size : 0.0;
+    Vector lower;
+    for (int d = 0; d < Dim; ++d) lower[d] = rootRegion.center[d] - rootRegion.size / 2;
+
+    keys.resize(n);
+    order.resize(n);
+
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        const Vector p = position_of<Dim>(bodies[i]);
+        std::array<uint32_t, Dim> cell;
+        for (int d = 0; d < Dim; ++d) {
+            cell[d] = static_cast<uint32_t>(std::min(std::max((p[d] - lower[d]) * scale, 0.0), maxCell));
+        }
+        keys[i] = morton_key<Dim>(cell);
+        order[i] = static_cast<uint32_t>(i);
+    }
+}
+
+// budowanie drzewa przez wstawianie kolejnych ciał; węzły trafiają do puli `nodes`
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::buildByInsertion(const Bodies& bodies, const Region& rootRegion) {
+    reset();
+    if (bodies.empty()) return;
+
+    // dziecko wybierane jest z klucza Mortona, dzięki czemu oba sposoby budowy dają to samo drzewo
+    computeKeys(bodies, rootRegion);
+    next.resize(bodies.size());
+    allocate(rootRegion);
+    for (uint32_t i = 0; i < bodies.size(); ++i) {
+        insert(i);
+    }
+
+    order.clear();
+    finalize(0);
+    gatherBodies(bodies);
+
+    // momenty od dołu - dzieci mają w puli większe indeksy niż rodzic
+    for (int k = static_cast<int>(nodes.size()) - 1; k >= 0; --k) computeMoments(k);
+}
+
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::insert(uint32_t index) {
+    const int depthLimit = std::min(maxDepth, MAX_DEPTH);
+    uint32_t current = 0;
+    int depth = 0;
+
+    // uwaga: allocate() może przenieść pulę, dlatego węzły są adresowane indeksami, a nie referencjami
+    while (true) {
+        if (!nodes[current].leaf) {                         // węzeł wewnętrzny - schodzimy do dziecka
+            int octant = morton_child<Dim>(keys[index], depth);
+            uint32_t child = nodes[current].children[octant];
+            if (child == Node::NONE) {                    // dzieci tworzone są tylko dla zajętych oktantów
+                child = allocate(nodes[current].region.getSubOctant(octant));
+                nodes[current].children[octant] = child;
+            }
+            current = child;
+            ++depth;
+            continue;
+        }
+
+        if (nodes[current].count < static_cast<uint32_t>(std::max(leafSize, 1)) || depth >= depthLimit) {
+            // miejsce w kubełku albo maksymalna głębokość (ciała prawie pokrywające się) - lista w liściu
+            next[index] = nodes[current].first;
+            nodes[current].first = index;
+            ++nodes[current].count;
+            return;
+        }
+
+        // podział pełnego liścia: jego ciała przechodzą do dzieci, a pętla wstawia nowe ciało dalej
+        uint32_t resident = nodes[current].first;
+        nodes[current].leaf = false;
+        nodes[current].first = Node::NONE;
+        nodes[current].count = 0;
+        while (resident != Node::NONE) {
+            uint32_t following = next[resident];
+            int octant = morton_child<Dim>(keys[resident], depth);
+            uint32_t child = nodes[current].children[octant];
+            if (child == Node::NONE) {
+                child = allocate(nodes[current].region.getSubOctant(octant));
+                nodes[current].children[octant] = child;
+            }
+            next[resident] = nodes[child].first;
+            nodes[child].first = resident;
+            ++nodes[child].count;
+            resident = following;
+        }
+    }
+}
+
+// przejście w głąb: układa ciała liści w `order` i wyznacza zakresy węzłów
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::finalize(uint32_t index) {
+    uint32_t begin = static_cast<uint32_t>(order.size());
+
+    if (nodes[index].leaf) {
+        for (uint32_t i = nodes[index].first; i != Node::NONE; i = next[i]) {
+            order.push_back(i);
+        }
+        // kolejność jak po sortowaniu Mortona (klucz, potem indeks) - oba sposoby budowy dają to samo drzewo
+        std::sort(order.begin() + begin, order.end(), [&](uint32_t a, uint32_t b) {
+            return keys[a] != keys[b] ? keys[a] < keys[b] : a < b;
+        });
+    }
+    else {
+        for (uint32_t child : nodes[index].children) {
+            if (child != Node::NONE) finalize(child);
+        }
+    }
+
+    nodes[index].first = begin;
+    nodes[index].count = static_cast<uint32_t>(order.size()) - begin;
+}
+
+// masa i środek masy węzła z jego ciał (liść, kopie SoA z gatherBodies()) lub z już policzonych dzieci
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::computeMoments(uint32_t index) {
+    Node& node = nodes[index];
+    double mass = 0.0;
+    Vector moment{};
+
+    if (node.leaf) {
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            mass += bodyMass[k];
+            for (int d = 0; d < Dim; ++d) moment[d] += static_cast<double>(bodyPosition[d][k]) * bodyMass[k];
+        }
+    }
+    else {
+        for (uint32_t child : node.children) {
+            if (child == Node::NONE) continue;
+            const Node& c = nodes[child];
+            mass += c.mass;
+            for (int d = 0; d < Dim; ++d) moment[d] += static_cast<double>(c.center[d]) * c.mass;
+        }
+    }
+
+    node.mass = static_cast<Real>(mass);
+    for (int d = 0; d < Dim; ++d) {
+        node.center[d] = static_cast<Real>(mass > 0.0 ? moment[d] / mass : node.region.center[d]);
+    }
+
+    if (multipoleOrder < QUADRUPOLE) return;
+
+    // moment kwadrupolowy względem środka masy; dla dzieci przesunięty twierdzeniem Steinera
+    double quad[Node::QUAD] = {};
+    Vector offset;
+    if (node.leaf) {
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            for (int d = 0; d < Dim; ++d) offset[d] = bodyPosition[d][k] - node.center[d];
+            add_quadrupole_term<Dim>(quad, bodyMass[k], offset);
+        }
+    }
+    else {
+        for (uint32_t child : node.children) {
+            if (child == Node::NONE) continue;
+            const Node& c = nodes[child];
+            for (int q = 0; q < Node::QUAD; ++q) quad[q] += c.quad[q];
+            for (int d = 0; d < Dim; ++d) offset[d] = c.center[d] - node.center[d];
+            add_quadrupole_term<Dim>(quad, c.mass, offset);
+        }
+    }
+    for (int q = 0; q < Node::QUAD; ++q) node.quad[q] = static_cast<Real>(quad[q]);
+}
+
+// Budowa równoległa. Ciała są sortowane według kluczy Mortona, więc każdy węzeł obejmuje ciągły zakres
+// posortowanych ciał, a jego dzieci to kolejne podzakresy o tej samej grupie `Dim` bitów klucza. Poziomy drzewa
+// tworzone są kolejno (węzły jednego poziomu równolegle, układ wszerz niezależny od liczby wątków),
+// a masy i środki mas liczone są od najgłębszego poziomu do korzenia.
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::buildMorton(const Bodies& bodies, const Region& rootRegion) {
+    reset();
+    if (bodies.empty()) return;
+
+    computeKeys(bodies, rootRegion);
+    radix_sort(keys, order, keysScratch, orderScratch);
+
+    const uint32_t leafCapacity = static_cast<uint32_t>(std::max(leafSize, 1));
+    const int depthLimit = std::min(maxDepth, MAX_DEPTH);
+    const Node blank(Region(Vector{}, 0));
+    allocate(rootRegion);
+    nodes[0].first = 0;
+    nodes[0].count = static_cast<uint32_t>(bodies.size());
+
+    levels.assign(1, 0);
+    uint32_t levelBegin = 0, levelEnd = 1;
+    for (int depth = 0; levelBegin < levelEnd; ++depth) {
+        const int levelSize = static_cast<int>(levelEnd - levelBegin);
+        childCounts.resize(levelSize);
+
+        // liczba niepustych dzieci każdego węzła wewnętrznego na tym poziomie
+        #pragma omp parallel for
+        for (int k = 0; k < levelSize; ++k) {
+            const Node& node = nodes[levelBegin + k];
+            uint32_t children = 0;
+            if (node.count > leafCapacity && depth < depthLimit) {
+                const uint32_t end = node.first + node.count;
+                for (uint32_t i = node.first; i < end; ++children) {
+                    int octant = morton_child<Dim>(keys[i], depth);
+                    i = static_cast<uint32_t>(std::partition_point(keys.begin() + i, keys.begin() + end,
+                        [&](uint64_t key) { return morton_child<Dim>(key, depth) == octant; }) - keys.begin());
+                }
+            }
+            childCounts[k] = children;
+        }
+
+        const uint32_t total = static_cast<uint32_t>(exclusive_scan(childCounts, levelSize));
+        nodes.resize(levelEnd + total, blank);
+
+        // tworzenie dzieci w przydzielonych miejscach puli
+        #pragma omp parallel for
+        for (int k = 0; k < levelSize; ++k) {
+            Node& node = nodes[levelBegin + k];
+            if (node.count <= leafCapacity || depth >= depthLimit) continue;
+
+            node.leaf = false;
+            uint32_t slot = levelEnd + childCounts[k];
+            const uint32_t end = node.first + node.count;
+            for (uint32_t i = node.first; i < end; ++slot) {
+                int octant = morton_child<Dim>(keys[i], depth);
+                uint32_t runEnd = static_cast<uint32_t>(std::partition_point(keys.begin() + i, keys.begin() + end,
+                    [&](uint64_t key) { return morton_child<Dim>(key, depth) == octant; }) - keys.begin());
+                Node& child = nodes[slot];
+                child.region = node.region.getSubOctant(octant);
+                child.first = i;
+                child.count = runEnd - i;
+                node.children[octant] = slot;
+                i = runEnd;
+            }
+        }
+
+        levels.push_back(levelEnd);
+        levelBegin = levelEnd;
+        levelEnd += total;
+    }
+
+    // momenty od najgłębszego poziomu do korzenia; liście czytają ciała z ciągłych kopii SoA
+    gatherBodies(bodies);
+    for (size_t level = levels.size() - 1; level-- > 0;) {
+        const int begin = static_cast<int>(levels[level]);
+        const int end = static_cast<int>(levels[level + 1]);
+        #pragma omp parallel for
+        for (int k = begin; k < end; ++k) {
+            computeMoments(k);
+        }
+    }
+}
+
+// Refit. Ciała pozostające w swoich liściach zachowują kolejność; ciała przeniesione schodzą od korzenia po
+// środkach regionów do istniejącego liścia (który staje się kubełkiem) albo do nowego liścia w pustym oktancie.
+// Zakresy `order` są wyznaczane od nowa od korzenia w dół, a momenty - od liści w górę.
+// Węzły nie są usuwane ani dzielone - opróżnione liście zostają z zerową masą, a kubełki rosną, dopóki
+// kryteria jakości nie wymuszą pełnej budowy.
+template <typename Real, int Dim>
+template <typename Bodies>
+bool BHTreeT<Real, Dim>::refit(const Bodies& bodies, double maxMigrated) {
+    const int n = static_cast<int>(bodies.size());
+    if (nodes.empty() || order.size() != bodies.size()) return false;
+
+    // jakość korzenia: wszystkie ciała w środku i rozmiar nie większy niż MAX_INFLATION razy potrzebny
+    const Region root = nodes[0].region;
+    const Vector origin = position_of<Dim>(bodies[0]);
+    double minX = origin[0], maxX = origin[0];
+    double minY = origin[1], maxY = origin[1];
+    double minZ = origin[Dim - 1], maxZ = origin[Dim - 1];  // w 2D powtarza oś y
+    #pragma omp parallel for reduction(min: minX, minY, minZ) reduction(max: maxX, maxY, maxZ)
+    for (int i = 0; i < n; ++i) {
+        const Vector p = position_of<Dim>(bodies[i]);
+        minX = std::min(minX, p[0]); maxX = std::max(maxX, p[0]);
+        minY = std::min(minY, p[1]); maxY = std::max(maxY, p[1]);
+        minZ = std::min(minZ, p[Dim - 1]); maxZ = std::max(maxZ, p[Dim - 1]);
+    }
+    const double low[3] = {minX, minY, minZ}, high[3] = {maxX, maxY, maxZ};
+    Vector lower, upper;
+    for (int d = 0; d < Dim; ++d) {
+        lower[d] = low[d];
+        upper[d] = high[d];
+    }
+    if (!root.contains(lower) || !root.contains(upper)) return false;
+    const double extent = std::max(std::max(maxX - minX, maxY - minY), maxZ - minZ) * 1.5;
+    if (extent > 0.0 && root.size > MAX_INFLATION * extent) return false;
+
+    // Przebiegi po węzłach wewnętrznych. Po budowie Mortona idą poziomami (węzły poziomu równolegle); liście
+    // dopisane przez locate() leżą za ostatnim poziomem, ale ich rodzice należą do poziomów. Po budowie przez
+    // wstawianie dzieci mają zawsze większe indeksy niż rodzic, więc wystarcza przebieg po kolejnych indeksach.
+    const bool byLevels = levels.size() > 1;
+    auto bottomUp = [&](auto&& visit) {
+        if (byLevels) {
+            for (size_t level = levels.size() - 1; level-- > 0;) {
+                #pragma omp parallel for
+                for (int k = static_cast<int>(levels[level]); k < static_cast<int>(levels[level + 1]); ++k) {
+                    if (!nodes[k].leaf) visit(k);
+                }
+            }
+        }
+        else {
+            for (int k = static_cast<int>(nodes.size()) - 1; k >= 0; --k) {
+                if (!nodes[k].leaf) visit(k);
+            }
+        }
+    };
+    auto topDown = [&](auto&& visit) {
+        if (byLevels) {
+            for (size_t level = 0; level + 1 < levels.size(); ++level) {
+                #pragma omp parallel for
+                for (int k = static_cast<int>(levels[level]); k < static_cast<int>(levels[level + 1]); ++k) {
+                    if (!nodes[k].leaf) visit(k);
+                }
+            }
+        }
+        else {
+            for (int k = 0; k < static_cast<int>(nodes.size()); ++k) {
+                if (!nodes[k].leaf) visit(k);
+            }
+        }
+    };
+
+    // ciała, które opuściły swój liść; liście bez zmian od razu dostają nowe momenty. Nowe pozycje są najpierw
+    // kopiowane w dotychczasowej kolejności `order`, więc przegląd liści czyta ciągłe tablice.
+    gatherBodies(bodies);
+    const int count = static_cast<int>(nodes.size());
+    refitCounts.assign(count, 0);
+    dirty.assign(count, 0);
+    departures.assign(static_cast<size_t>(n) + 1, 0);
+    migrants.clear();
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> local;
+        #pragma omp for schedule(dynamic, 256)
+        for (int k = 0; k < count; ++k) {
+            const Node& node = nodes[k];
+            if (!node.leaf) continue;
+            for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+                Vector p;
+                for (int d = 0; d < Dim; ++d) p[d] = bodyPosition[d][j];
+                if (node.region.contains(p)) continue;
+                departures[j] = 1;
+                local.push_back(order[j]);
+                dirty[k] = 1;
+            }
+            if (!dirty[k]) computeMoments(k);
+        }
+        #pragma omp critical
+        migrants.insert(migrants.end(), local.begin(), local.end());
+    }
+
+    if (static_cast<double>(migrated + migrants.size()) > maxMigrated * n) return false;
+    migrated += migrants.size();
+
+    if (!migrants.empty()) {
+        std::sort(migrants.begin(), migrants.end());        // kolejność niezależna od liczby wątków
+        destinations.resize(migrants.size());
+        for (size_t m = 0; m < migrants.size(); ++m) {
+            destinations[m] = locate(position_of<Dim>(bodies[migrants[m]]));
+        }
+
+        // Nowa liczność poddrzewa = stara - ciała, które opuściły jego zakres (suma prefiksowa po pozycjach
+        // `order`) + ciała, które do niego trafiły (zliczone w refitCounts przez locate()). Początki zakresów
+        // wyznaczane są od góry, a liście od razu przepisują pozostające ciała.
+        exclusive_scan(departures, departures.size());
+        orderScratch.resize(n);
+        topDown([&](int k) {
+            uint32_t position = nodes[k].first;
+            for (uint32_t child : nodes[k].children) {
+                if (child == Node::NONE) continue;
+                Node& c = nodes[child];
+                const uint32_t left = c.count > 0 ? departures[c.first + c.count] - departures[c.first] : 0;
+                const uint32_t total = c.count + refitCounts[child] - left;
+                if (c.leaf) {
+                    uint32_t kept = position;
+                    for (uint32_t j = c.first; j < c.first + c.count; ++j) {
+                        if (departures[j + 1] == departures[j]) orderScratch[kept++] = order[j];
+                    }
+                    c.count = kept - position;              // przeniesione ciała dopisywane są niżej
+                }
+                else {
+                    c.count = total;
+                }
+                c.first = position;
+                position += total;
+            }
+        });
+        for (size_t m = 0; m < migrants.size(); ++m) {
+            Node& leaf = nodes[destinations[m]];
+            orderScratch[leaf.first + leaf.count++] = migrants[m];
+        }
+        order.swap(orderScratch);
+        gatherBodies(bodies);
+    }
+
+    // momenty od dołu; zmienione liście liczone są tuż przed rodzicem
+    bottomUp([&](int k) {
+        for (uint32_t child : nodes[k].children) {
+            if (child != Node::NONE && dirty[child]) computeMoments(child);
+        }
+        computeMoments(k);
+    });
+    return true;
+}
+
+// liść, do którego należy ciało (węzły na ścieżce zliczają przybyłe ciało); w pustym oktancie tworzony jest nowy liść
+template <typename Real, int Dim>
+uint32_t BHTreeT<Real, Dim>::locate(const Vector& position) {
+    uint32_t current = 0;
+    while (!nodes[current].leaf) {
+        ++refitCounts[current];
+        const Region& region = nodes[current].region;
+        int octant = 0;
+        for (int d = 0; d < Dim; ++d) {
+            if (position[d] >= region.center[d]) octant |= 1 << d;
+        }
+        uint32_t child = nodes[current].children[octant];
+        if (child == Node::NONE) {
+            child = allocate(nodes[current].region.getSubOctant(octant));
+            nodes[current].children[octant] = child;
+            refitCounts.push_back(1);
+            dirty.push_back(1);
+            return child;
+        }
+        current = child;
+    }
+    ++refitCounts[current];
+    dirty[current] = 1;
+    return current;
+}
+
+// kopiuje pozycje i masy ciał do tablic SoA w kolejności `order`
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::gatherBodies(const Bodies& bodies) {
+    const int n = static_cast<int>(order.size());
+    for (auto& axis : bodyPosition) axis.resize(n);
+    bodyMass.resize(n);
+
+    #pragma omp parallel for
+    for (int k = 0; k < n; ++k) {
+        const auto& b = bodies[order[k]];
+        const Vector p = position_of<Dim>(b);
+        for (int d = 0; d < Dim; ++d) bodyPosition[d][k] = static_cast<Real>(p[d]);
+        bodyMass[k] = static_cast<Real>(b.mass);
+    }
+}
+
+// oddziaływania bezpośrednie z całym kubełkiem liścia (razem z `target`, który daje zerową siłę)
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::accumulateLeaf(uint32_t first, uint32_t count, const Vector& position, double mass,
+                                        Vector& force) const {
+    std::array<const Real*, Dim> source;
+    for (int d = 0; d < Dim; ++d) source[d] = bodyPosition[d].data() + first;
+    add_gravity_bucket<Real, Dim>(source, bodyMass.data() + first, static_cast<int>(count), position, mass, force);
+}
+
+// siła w 3D albo jej składowe x i y w 2D (fz bez zmian)
+template <int Dim>
+static void store_force(const std::array<double, Dim>& force, double& fx, double& fy, double& fz) {
+    fx = force[0];
+    fy = force[1];
+    if constexpr (Dim == 3) fz = force[2];
+}
+
+template <int Dim>
+static std::array<double, Dim> load_force(double fx, double fy, double fz) {
+    if constexpr (Dim == 3) return {fx, fy, fz};
+    else return {fx, fy};
+}
+
+// oblicza siłę działającą na ciało `target`
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::calculateForce(const Bodies& bodies, uint32_t target, double& fx, double& fy, double& fz,
+                            double theta) const {
+    if (nodes.empty()) return;
+    Vector force = load_force<Dim>(fx, fy, fz);
+    accumulateForce(0, bodies, target, force, theta);
+    store_force<Dim>(force, fx, fy, fz);
+}
+
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::accumulateForce(uint32_t index, const Bodies& bodies, uint32_t target, Vector& force,
+                                         double theta) const {
+    const Node& node = nodes[index];
+    if (node.mass == 0.0) return;
+
+    const auto& t = bodies[target];
+
+    if (node.leaf) {                                        // liść - oddziaływania bezpośrednie z kubełkiem
+        accumulateLeaf(node.first, node.count, position_of<Dim>(t), t.mass, force);
+        return;
+    }
+
+    // różnice względem środka węzła liczone w typie środka i współrzędnych ciała (float w trybie mieszanym)
+    const auto p = position_of<Dim, coordinate_t<decltype(t)>>(t);
+
+    Vector d;
+    double dist_sq = 0.0;
+    for (int k = 0; k < Dim; ++k) {
+        d[k] = node.center[k] - p[k];
+        dist_sq += d[k] * d[k];
+    }
+    double dist = std::sqrt(dist_sq + SOFTENING);
+
+    // Warunek Barnes-Hut
+    if ((node.region.size / dist) < theta) {
+        add_gravity<Dim>(d, node.mass, t.mass, force);
+        if (multipoleOrder >= QUADRUPOLE) add_quadrupole<Dim>(d, node.quad.data(), t.mass, force);
+    }
+    else {
+        for (uint32_t child : node.children) {
+            if (child != Node::NONE) accumulateForce(child, bodies, target, force, theta);
+        }
+    }
+}
+
+// potencjał w miejscu ciała `target` - to samo kryterium otwarcia węzłów co przy siłach
+template <typename Real, int Dim>
+template <typename Bodies>
+double BHTreeT<Real, Dim>::calculatePotential(const Bodies& bodies, uint32_t target, double theta) const {
+    if (nodes.empty()) return 0.0;
+    return accumulatePotential(0, bodies, target, theta);
+}
+
+template <typename Real, int Dim>
+template <typename Bodies>
+double BHTreeT<Real, Dim>::accumulatePotential(uint32_t index, const Bodies& bodies, uint32_t target,
+                                   double theta) const {
+    const Node& node = nodes[index];
+    if (node.mass == 0.0) return 0.0;
+
+    const auto p = position_of<Dim, coordinate_t<decltype(bodies[target])>>(bodies[target]);
+    double potential = 0.0;
+
+    if (node.leaf) {                                        // liść - suma bezpośrednia z pominięciem `target`
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            if (order[k] == target) continue;
+            double r2 = 0.0;
+            for (int d = 0; d < Dim; ++d) {
+                double delta = bodyPosition[d][k] - p[d];
+                r2 += delta * delta;
+            }
+            potential -= G * bodyMass[k] / std::sqrt(r2 + SOFTENING);
+        }
+        return potential;
+    }
+
+    Vector delta;
+    double r2 = 0.0;
+    for (int d = 0; d < Dim; ++d) {
+        delta[d] = node.center[d] - p[d];
+        r2 += delta[d] * delta[d];
+    }
+    r2 += SOFTENING;
+    double dist = std::sqrt(r2);
+
+    if ((node.region.size / dist) < theta) {
+        potential = -G * node.mass / dist;
+        if (multipoleOrder >= QUADRUPOLE) {                 // -G/2 * (d^T Q d) / r^5
+            double diagonal = 0.0, offDiagonal = 0.0;
+            for (int i = 0; i < Dim; ++i) {
+                diagonal += node.quad[quadrupole_index<Dim>(i, i)] * delta[i] * delta[i];
+                for (int j = i + 1; j < Dim; ++j) {
+                    offDiagonal += node.quad[quadrupole_index<Dim>(i, j)] * delta[i] * delta[j];
+                }
+            }
+            potential -= 0.5 * G * (diagonal + 2.0 * offDiagonal) / (r2 * r2 * dist);
+        }
+    }
+    else {
+        for (uint32_t child : node.children) {
+            if (child != Node::NONE) potential += accumulatePotential(child, bodies, target, theta);
+        }
+    }
+    return potential;
+}
+
+// Spłaszczanie drzewa. Dzieci mają w puli zawsze większe indeksy niż rodzic, więc rozmiary poddrzew można
+// policzyć w kolejności malejących indeksów, a pozycje pre-order - w kolejności rosnącej. Po budowie Mortona
+// oba przebiegi idą poziomami, a węzły jednego poziomu przetwarzane są równolegle.
+template <typename Real, int Dim>
+void BHTreeT<Real, Dim>::flatten() {
+    const int count = static_cast<int>(nodes.size());
+    flat.resize(count);
+    subtreeSizes.resize(count);
+    preorder.resize(count);
+    if (count == 0) return;
+
+    auto computeSize = [&](int k) {
+        uint32_t size = 1;
+        for (uint32_t child : nodes[k].children) {
+            if (child != Node::NONE) size += subtreeSizes[child];
+        }
+        subtreeSizes[k] = size;
+    };
+    auto placeChildren = [&](int k) {
+        uint32_t position = preorder[k] + 1;
+        for (uint32_t child : nodes[k].children) {
+            if (child == Node::NONE) continue;
+            preorder[child] = position;
+            position += subtreeSizes[child];
+        }
+    };
+
+    const bool byLevels = levels.size() > 1 && levels.back() == nodes.size();
+    preorder[0] = 0;
+    if (byLevels) {
+        for (size_t level = levels.size() - 1; level-- > 0;) {
+            #pragma omp parallel for
+            for (int k = static_cast<int>(levels[level]); k < static_cast<int>(levels[level + 1]); ++k) computeSize(k);
+        }
+        for (size_t level = 0; level + 1 < levels.size(); ++level) {
+            #pragma omp parallel for
+            for (int k = static_cast<int>(levels[level]); k < static_cast<int>(levels[level + 1]); ++k) placeChildren(k);
+        }
+    }
+    else {
+        for (int k = count - 1; k >= 0; --k) computeSize(k);
+        for (int k = 0; k < count; ++k) placeChildren(k);
+    }
+
+    #pragma omp parallel for
+    for (int k = 0; k < count; ++k) {
+        const Node& node = nodes[k];
+        FlatNode& f = flat[preorder[k]];
+        f.center = node.center;
+        f.mass = node.mass;
+        f.size = static_cast<Real>(node.region.size);
+        f.quad = node.quad;
+        f.skip = preorder[k] + subtreeSizes[k];
+        f.first = node.first;
+        f.count = node.count;
+    }
+}
+
+template <typename Real, int Dim>
+template <typename Bodies>
+void BHTreeT<Real, Dim>::calculateForceStackless(const Bodies& bodies, uint32_t target, double& fx, double& fy,
+                                     double& fz, double theta) const {
+    const auto& t = bodies[target];
+    const Vector position = position_of<Dim>(t);
+    const auto p = position_of<Dim, coordinate_t<decltype(t)>>(t);
+    Vector force = load_force<Dim>(fx, fy, fz);
+    const uint32_t end = static_cast<uint32_t>(flat.size());
+
+    // kolejność odwiedzin jest taka sama jak w wersji rekurencyjnej, więc wyniki są identyczne
+    uint32_t i = 0;
+    while (i < end) {
+        const FlatNode& node = flat[i];
+        if (node.mass == 0.0) {
+            i = node.skip;
+            continue;
+        }
+
+        if (node.skip == i + 1) {                           // liść - oddziaływania bezpośrednie z kubełkiem
+            accumulateLeaf(node.first, node.count, position, t.mass, force);
+            i = node.skip;
+            continue;
+        }
+
+        Vector d;
+        double dist_sq = 0.0;
+        for (int k = 0; k < Dim; ++k) {
+            d[k] = node.center[k] - p[k];
+            dist_sq += d[k] * d[k];
+        }
+        double dist = std::sqrt(dist_sq + SOFTENING);
+
+        if ((node.size / dist) < theta) {                   // cały węzeł jako punkt - pomijamy poddrzewo
+            add_gravity<Dim>(d, node.mass, t.mass, force);
+            if (multipoleOrder >= QUADRUPOLE) add_quadrupole<Dim>(d, node.quad.data(), t.mass, force);
+            i = node.skip;
+        }
+        else {                                              // otwarcie węzła - pierwsze dziecko leży tuż za nim
+            ++i;
+        }
+    }
+    store_force<Dim>(force, fx, fy, fz);
+}
+
+template <typename Real, int Dim>
+size_t BHTreeT<Real, Dim>::memoryUsage() const {
+    return nodes.capacity() * sizeof(Node)
+        + (keys.capacity() + keysScratch.capacity()) * sizeof(uint64_t)
+        + (order.capacity() + orderScratch.capacity() + next.capacity() + childCounts.capacity()
+           + levels.capacity() + subtreeSizes.capacity() + preorder.capacity() + refitCounts.capacity()
+           + migrants.capacity() + destinations.capacity() + departures.capacity()) * sizeof(uint32_t)
+        + dirty.capacity()
+        + (bodyMass.capacity() + bodyPosition[0].capacity() * Dim) * sizeof(Real)
+        + flat.capacity() * sizeof(FlatNode);
+}
+
+// jawne konkretyzacje: drzewo double dla obu układów pamięci ciał (i dla BodySystemF - diagnostyka trybu
+// mieszanego liczy energię w double), drzewo float dla BodySystemF; to samo dla drzew czwórkowych
+#define BHTREE_INSTANTIATE(Real, Dim, Bodies) \
+    template void BHTreeT<Real, Dim>::buildByInsertion(const Bodies&, const Orthant<Dim>&); \
+    template void BHTreeT<Real, Dim>::buildMorton(const Bodies&, const Orthant<Dim>&); \
+    template bool BHTreeT<Real, Dim>::refit(const Bodies&, double); \
+    template void BHTreeT<Real, Dim>::calculateForce(const Bodies&, uint32_t, double&, double&, double&, \
+                                                     double) const; \
+    template void BHTreeT<Real, Dim>::calculateForceStackless(const Bodies&, uint32_t, double&, double&, \
+                                                              double&, double) const; \
+    template double BHTreeT<Real, Dim>::calculatePotential(const Bodies&, uint32_t, double) const;
+
+template struct BHNodeT<double, 3>;
+template struct BHNodeT<float, 3>;
+template struct BHNodeT<double, 2>;
+template struct BHNodeT<float, 2>;
+template class BHTreeT<double, 3>;
+template class BHTreeT<float, 3>;
+template class BHTreeT<double, 2>;
+template class BHTreeT<float, 2>;
+BHTREE_INSTANTIATE(double, 3, std::vector<Body>)
+BHTREE_INSTANTIATE(double, 3, BodySystem)
+BHTREE_INSTANTIATE(double, 3, BodySystemF)
+BHTREE_INSTANTIATE(float, 3, BodySystemF)
+BHTREE_INSTANTIATE(double, 2, std::vector<Body>)
+BHTREE_INSTANTIATE(double, 2, BodySystem)
+BHTREE_INSTANTIATE(float, 2, BodySystemF)
+#undef BHTREE_INSTANTIATE
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef BHTREE_H
+#define BHTREE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Body.h"
+#include "BodySystem.h"
+#include "Morton.h"
+#include "Octant.h"
+
+// węzeł drzewa przechowywany w ciągłej puli; dzieci adresowane są 32-bitowymi indeksami. Momenty
+// przechowywane są w typie `Real` (double albo float), a liczone w double. `Dim` = 3 daje oktanty i 8 dzieci,
+// `Dim` = 2 - kwadranty i 4 dzieci.
+template <typename Real, int Dim = 3>
+struct BHNodeT {
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+    static constexpr int CHILDREN = Orthant<Dim>::CHILDREN;
+    static constexpr int QUAD = Dim * (Dim + 1) / 2;
+
+    Orthant<Dim> region;
+    Real mass;
+    std::array<Real, Dim> center;
+    // moment kwadrupolowy {xx, xy, xz, yy, yz, zz} albo {xx, xy, yy} (tylko przy multipoleOrder >= 2)
+    std::array<Real, QUAD> quad;
+    std::array<uint32_t, CHILDREN> children;
+    uint32_t first;     // początek zakresu ciał poddrzewa w BHTree::order
+    uint32_t count;     // liczba ciał poddrzewa (liść ma więcej niż leafSize na maksymalnej głębokości lub po refit())
+    bool leaf;
+
+    explicit BHNodeT(const Orthant<Dim>& region_);
+};
+using BHNode = BHNodeT<double>;
+
+// węzeł spłaszczonego drzewa ułożony w kolejności przejścia w głąb (pre-order); otwarcie węzła to przejście
+// do następnego elementu tablicy, a pominięcie poddrzewa to skok do `skip` (dla liścia skip == indeks + 1)
+template <typename Real, int Dim = 3>
+struct BHFlatNodeT {
+    std::array<Real, Dim> center;
+    Real mass;
+    Real size;
+    std::array<Real, BHNodeT<Real, Dim>::QUAD> quad;
+    uint32_t skip;      // indeks pierwszego węzła za poddrzewem
+    uint32_t first;     // początek zakresu ciał poddrzewa w BHTree::order
+    uint32_t count;     // liczba ciał poddrzewa
+};
+using BHFlatNode = BHFlatNodeT<double>;
+
+// Drzewo Barnes-Hut oparte na puli węzłów, wielokrotnie używane między krokami symulacji. `Real` to typ
+// przechowywania momentów węzłów i kopii ciał: BHTree (double) albo BHTreeF (float, tryb mieszanej precyzji).
+// `Dim` wybiera w czasie kompilacji drzewo ósemkowe (3) albo czwórkowe (2) dla układów płaskich - w 2D drzewo
+// dzieli tylko płaszczyznę xy, a współrzędna z ciał jest pomijana.
+template <typename Real, int Dim = 3>
+class BHTreeT {
+public:
+    using Node = BHNodeT<Real, Dim>;
+    using FlatNode = BHFlatNodeT<Real, Dim>;
+    using Region = Orthant<Dim>;
+    using Vector = std::array<double, Dim>;
+
+    static constexpr double DEFAULT_THETA = 0.8;
+    static constexpr int MAX_DEPTH = morton_bits<Dim>();
+    static constexpr int DEFAULT_LEAF_SIZE = 4;
+    static constexpr int MONOPOLE = 1;
+    static constexpr int QUADRUPOLE = 2;
+    // domyślny udział ciał przeniesionych do innych liści od ostatniej budowy, powyżej którego refit() odmawia
+    static constexpr double DEFAULT_MAX_MIGRATED = 0.05;
+    // dopuszczalny stosunek rozmiaru korzenia do rozmiaru, jaki dałaby nowa budowa (kurczący się układ)
+    static constexpr double MAX_INFLATION = 2.0;
+
+    // rząd rozwinięcia multipolowego węzłów: MONOPOLE (masa i środek masy) lub QUADRUPOLE; ustawiany przed budową
+    int multipoleOrder = MONOPOLE;
+    // pojemność liścia (kubełka) K; liść jest dzielony dopiero przy K + 1 ciałach
+    int leafSize = DEFAULT_LEAF_SIZE;
+    // maksymalna głębokość (co najwyżej MAX_DEPTH); głębiej ciała zostają w liściu bez względu na K
+    int maxDepth = MAX_DEPTH;
+
+    std::vector<Node> nodes;        // nodes[0] jest korzeniem
+    std::vector<uint32_t> order;    // indeksy ciał w kolejności Mortona (pogrupowane według liści)
+    std::vector<FlatNode> flat;     // spłaszczona kopia drzewa (po wywołaniu flatten())
+    // pozycje (bodyPosition[k] - oś k) i masy ciał w kolejności `order` (SoA) - zawartość kubełka leży
+    // w pamięci w jednym ciągu
+    std::array<std::vector<Real>, Dim> bodyPosition;
+    std::vector<Real> bodyMass;
+
+    // Metody przyjmujące ciała są szablonami dla std::vector<Body> i BodySystem (SoA) - a w BHTreeF dla
+    // BodySystemF - jawnie konkretyzowanymi w BHTree.cpp. W 2D siła fz pozostaje bez zmian.
+
+    // czyści drzewo, zachowując zaalokowaną pamięć
+    void reset();
+    // budowa szeregowa przez wstawianie kolejnych ciał
+    template <typename Bodies>
+    void buildByInsertion(const Bodies& bodies, const Region& rootRegion);
+    // budowa równoległa: klucze Mortona, sortowanie pozycyjne i tworzenie drzewa poziomami
+    template <typename Bodies>
+    void buildMorton(const Bodies& bodies, const Region& rootRegion);
+    // Aktualizacja drzewa po ruchu ciał bez ponownej budowy: topologia i regiony węzłów zostają, ciała, które
+    // opuściły swój liść, są wstawiane do właściwego liścia, a masy i środki mas liczone są od nowa od dołu.
+    // Zwraca false (drzewo do przebudowy), gdy ciało opuściło korzeń, korzeń jest zbyt duży względem układu
+    // albo udział przeniesionych ciał od ostatniej budowy przekracza `maxMigrated`.
+    template <typename Bodies>
+    bool refit(const Bodies& bodies, double maxMigrated = DEFAULT_MAX_MIGRATED);
+    // liczba ciał przeniesionych przez refit() od ostatniej pełnej budowy
+    size_t migratedSinceBuild() const { return migrated; }
+    // rekurencyjne przejście po węzłach puli
+    template <typename Bodies>
+    void calculateForce(const Bodies& bodies, uint32_t target, double& fx, double& fy, double& fz,
+                        double theta = DEFAULT_THETA) const;
+    // potencjał grawitacyjny w miejscu ciała `target` (na jednostkę masy, bez wkładu samego ciała); theta = 0
+    // daje dokładną sumę po wszystkich ciałach
+    template <typename Bodies>
+    double calculatePotential(const Bodies& bodies, uint32_t target, double theta = DEFAULT_THETA) const;
+    // układa węzły w kolejności pre-order z łączami `skip`
+    void flatten();
+    // przejście pętlą po spłaszczonym drzewie, bez rekurencji i bez stosu (wymaga flatten())
+    template <typename Bodies>
+    void calculateForceStackless(const Bodies& bodies, uint32_t target, double& fx, double& fy, double& fz,
+                                 double theta = DEFAULT_THETA) const;
+
+    bool empty() const { return nodes.empty(); }
+    // liczba bajtów zarezerwowanych przez drzewo
+    size_t memoryUsage() const;
+
+private:
+    std::vector<uint64_t> keys, keysScratch;
+    std::vector<uint32_t> orderScratch;
+    std::vector<uint32_t> next;         // listy ciał w liściach w trakcie wstawiania
+    std::vector<uint32_t> childCounts;  // liczby dzieci węzłów bieżącego poziomu (budowa Mortona)
+    std::vector<uint32_t> levels;       // początki kolejnych poziomów w `nodes` (budowa Mortona)
+    std::vector<uint32_t> subtreeSizes; // liczby węzłów poddrzew (spłaszczanie)
+    std::vector<uint32_t> preorder;     // pozycje węzłów w `flat` (spłaszczanie)
+    std::vector<uint32_t> refitCounts;  // liczby ciał, które trafiły do poddrzew węzłów (refit)
+    std::vector<uint32_t> migrants;     // ciała, które opuściły swój liść, i ich nowe liście (refit)
+    std::vector<uint32_t> destinations;
+    std::vector<uint32_t> departures;   // ciała, które opuściły liść, na pozycjach `order`, potem suma prefiksowa
+    std::vector<uint8_t> dirty;         // 1 dla liści, których zawartość zmienił refit
+    size_t migrated = 0;
+
+    uint32_t allocate(const Region& region);
+    template <typename Bodies>
+    void computeKeys(const Bodies& bodies, const Region& rootRegion);
+    void insert(uint32_t index);
+    void finalize(uint32_t node);
+    void computeMoments(uint32_t node);
+    template <typename Bodies>
+    void gatherBodies(const Bodies& bodies);
+    void accumulateLeaf(uint32_t first, uint32_t count, const Vector& position, double mass, Vector& force) const;
+    uint32_t locate(const Vector& position);
+    template <typename Bodies>
+    void accumulateForce(uint32_t node, const Bodies& bodies, uint32_t target, Vector& force, double theta) const;
+    template <typename Bodies>
+    double accumulatePotential(uint32_t node, const Bodies& bodies, uint32_t target, double theta) const;
+};
+
+using BHTree = BHTreeT<double>;
+using BHTreeF = BHTreeT<float>;
+// drzewa czwórkowe dla symulacji płaskich (--dimensions 2)
+using QuadTree = BHTreeT<double, 2>;
+using QuadTreeF = BHTreeT<float, 2>;
+
+#endif // BHTREE_H
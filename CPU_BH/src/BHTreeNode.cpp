@@ -1,42 +1,34 @@
 #include "BHTreeNode.h"
+#include "Gravity.h"
 #include <cmath>
 #include <algorithm>
 #include <iostream>
 
-const double G = 6.67430e-11;
 const double THETA = 0.8;
 
 // konstruktor klasy
-BHTreeNode::BHTreeNode(const Octant& region_)
-    : region(region_), mass(0), centerX(0), centerY(0), centerZ(0) {}
+BHTreeNode::BHTreeNode(const Octant& region_, int leafSize_, int depth_)
+    : region(region_), mass(0), centerX(0), centerY(0), centerZ(0), leafSize(std::max(leafSize_, 1)),
+      depth(depth_) {}
 
 // wstawianie ciaa do drzewa oktantowego
 void BHTreeNode::insert(const Body& newBody) {
-    
-    if (!body) {                                        // jeli wze nie zawiera adnego ciaa
-        if (mass == 0) {                                // jeli jest pusty
-            
-            body = std::make_unique<Body>(newBody);     // przypisuje nowe ciao do wza
-            
-            // ustawia mas i pozycj rodka masy
-            mass = newBody.mass;
-            centerX = newBody.x;
-            centerY = newBody.y;
-            centerZ = newBody.z;
-        }
-        else {                                          // jeli wze ma ju mas
-            if (!children[0])                           // ale nie posiada dzieci (jeszcze nie jest podzielony)
-                subdivide();                            // dzieli wze na 8 oktantw (podregiony)
-            placeInChild(newBody);                      // wstawia nowe ciao do odpowiedniego dziecka w podzielonym regionie
+
+    if (!children[0]) {                                 // li
+        // miejsce w kubeku albo maksymalna gboko - ciaa pokrywajce si zostaj w jednym liciu
+        if (static_cast<int>(bodies.size()) < leafSize || depth >= MAX_DEPTH) {
+            bodies.push_back(newBody);
+            updateMassAndCenter(newBody);
+            return;
         }
+
+        // peny kubeek: podzia i przeniesienie cia do podregionw
+        subdivide();
+        for (const Body& b : bodies) placeInChild(b);
+        bodies.clear();
+        bodies.shrink_to_fit();
     }
-    else {                                               // gdy wze zawiera ju ciao (kolizja)
-        // Przenoszenie istniejce ciaa do jednego z podregionw i dodanie nowe ciaa
-        Body tempBody = *body;
-        body.reset();
-        placeInChild(tempBody);
-        placeInChild(newBody);
-    }
+    placeInChild(newBody);                              // wstawia nowe ciao do odpowiedniego dziecka
 
     // aktualizuje mas i pozycj rodka masy po dodaniu nowego ciaa
     updateMassAndCenter(newBody);
@@ -44,26 +36,26 @@ void BHTreeNode::insert(const Body& newBody) {
 
 // oblicza si dziaajc na dane ciao
 void BHTreeNode::calculateForce(const Body& target, double& fx, double& fy, double& fz) const {
-    // pomija wzy bez masy lub wze bdcy identyczny z `target`
-    if (mass == 0.0 || (body && body.get() == &target)) return;
+    if (mass == 0.0) return;                            // pomija wzy bez masy
+
+    if (!children[0]) {                                 // li - oddziaywania bezporednie z kubekiem
+        // ciao `target` moe by w kubeku - przy zerowej odlegoci wygadzenie daje zerow si
+        for (const Body& b : bodies) {
+            add_gravity(b.x - target.x, b.y - target.y, b.z - target.z, b.mass, target.mass, fx, fy, fz);
+        }
+        return;
+    }
 
     // oblicza wektor rnicy midzy rodkiem masy regionu a ciaem
     double dx = centerX - target.x;
     double dy = centerY - target.y;
     double dz = centerZ - target.z;
     double dist_sq = dx * dx + dy * dy + dz * dz;           // Odlego kwadratowa midzy rodkiem masy a celem
-    double dist = sqrt(dist_sq + 1e-10);                    // Odlego z maym przesuniciem, aby unikn dzielenia przez zero
+    double dist = sqrt(dist_sq + SOFTENING);                // Odlego z maym przesuniciem, aby unikn dzielenia przez zero
 
     // Warunek Barnes-Hut
     if ((region.size / dist) < THETA) {                     // traktuje cay region jako punkt
-        
-        double force = G * mass * target.mass / dist_sq;    // oblicza warto siy grawitacyjnej
-        // skadowe siy
-        fx += force * dx / dist;
-        fy += force * dy / dist;
-        fz += force * dz / dist;
-
-        // std::cout << "Obliczono sile dla ciala: fx=" << fx << " fy=" << fy << " fz=" << fz << "\n";
+        add_gravity(dx, dy, dz, mass, target.mass, fx, fy, fz);
     }
     else {
         // jeli region jest zbyt blisko (przyblienie Barnes-Hut nie jest moliwe)
@@ -85,18 +77,15 @@ void BHTreeNode::updateMassAndCenter(const Body& newBody) {
 
 // dzieli wze na 8 podregionw
 void BHTreeNode::subdivide() {
-    for (int i = 0; i < 8; ++i) {
-        children[i] = std::make_unique<BHTreeNode>(region.getSubOctant(i));
+    for (int i = 0; i < Octant::CHILDREN; ++i) {
+        children[i] = std::make_unique<BHTreeNode>(region.getSubOctant(i), leafSize, depth + 1);
     }
 }
 
-// przypisuje ciao do odpowiedniego potomka (dziecka) w drzewie oktantowym
+// przypisuje ciao do potomka wedug pooenia wzgldem rodka regionu; w przeciwiestwie do testu
+// Octant::contains() kade ciao trafia do dokadnie jednego dziecka, take na granicy lub poza regionem
 void BHTreeNode::placeInChild(const Body& b) {
-    for (int i = 0; i < 8; ++i) {
-        if (children[i] && children[i]->region.contains(b)) {
-            children[i]->insert(b);
-            return;
-        }
-    }
+    int octant = (b.x >= region.center[0] ? 1 : 0) | (b.y >= region.center[1] ? 2 : 0)
+        | (b.z >= region.center[2] ? 4 : 0);
+    children[octant]->insert(b);
 }
-
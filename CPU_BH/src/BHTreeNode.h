@@ -2,18 +2,25 @@
 #define BHTREENODE_H
 
 #include <memory>
+#include <vector>
 #include "Body.h"
 #include "Octant.h"
 
 class BHTreeNode {
 public:
+    static constexpr int DEFAULT_LEAF_SIZE = 4;
+    // głębiej liście nie są dzielone - chroni przed nieskończoną rekurencją dla pokrywających się ciał
+    static constexpr int MAX_DEPTH = 32;
+
     Octant region;
-    std::unique_ptr<Body> body;
+    std::vector<Body> bodies;   // kubełek liścia (pusty w węzłach wewnętrznych)
     double mass;
     double centerX, centerY, centerZ;
-    std::unique_ptr<BHTreeNode> children[8];
+    std::unique_ptr<BHTreeNode> children[Octant::CHILDREN];
+    int leafSize;               // pojemność kubełka K
+    int depth;
 
-    BHTreeNode(const Octant& region_);
+    BHTreeNode(const Octant& region_, int leafSize_ = DEFAULT_LEAF_SIZE, int depth_ = 0);
     void insert(const Body& newBody);
     void calculateForce(const Body& target, double& fx, double& fy, double& fz) const;
 
@@ -24,4 +31,4 @@ private:
     void placeInChild(const Body& b);
 };
 
-#endif // BHTREENODE_H
\ No newline at end of file
+#endif // BHTREENODE_H
@@ -0,0 +1,38 @@
+#include "BodySystem.h"
+
+template <typename Real>
+BodySystemT<Real>::BodySystemT(const std::vector<Body>& bodies) {
+    resize(bodies.size());
+    for (std::size_t i = 0; i < bodies.size(); ++i) (*this)[i] = bodies[i];
+}
+
+// pojemność zaokrąglona w górę do wielokrotności LANE
+template <typename Real>
+void BodySystemT<Real>::reserve(std::size_t n) {
+    const std::size_t padded = (n + LANE - 1) / LANE * LANE;
+    for (Array* array : {&mass, &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az}) array->reserve(padded);
+}
+
+template <typename Real>
+void BodySystemT<Real>::resize(std::size_t n) {
+    reserve(n);
+    for (Array* array : {&mass, &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az}) array->resize(n, Real(0));
+}
+
+template <typename Real>
+void BodySystemT<Real>::push_back(const Body& body) {
+    if (size() == mass.capacity()) reserve(2 * size() + 1);
+    resize(size() + 1);
+    (*this)[size() - 1] = body;
+}
+
+template <typename Real>
+std::vector<Body> BodySystemT<Real>::toBodies() const {
+    std::vector<Body> bodies;
+    bodies.reserve(size());
+    for (std::size_t i = 0; i < size(); ++i) bodies.push_back((*this)[i]);
+    return bodies;
+}
+
+template class BodySystemT<double>;
+template class BodySystemT<float>;
@@ -0,0 +1,100 @@
+#ifndef BODYSYSTEM_H
+#define BODYSYSTEM_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "Body.h"
+
+// alokator zwracający pamięć wyrównaną do `Alignment` bajtów (linia pamięci podręcznej, rejestry AVX-512)
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Widok jednego ciała w BodySystem - referencje do elementów tablic, więc kod napisany dla Body
+// (bodies[i].x, bodies[i].vx += ...) działa bez zmian dla obu układów pamięci.
+template <typename T>
+struct BodyRefT {
+    T& mass;
+    T& x; T& y; T& z;
+    T& vx; T& vy; T& vz;
+    T& ax; T& ay; T& az;
+
+    operator Body() const {
+        Body body(mass, x, y, z, vx, vy, vz);
+        body.ax = ax;
+        body.ay = ay;
+        body.az = az;
+        return body;
+    }
+    // przy przechowywaniu w float wartości są zaokrąglane
+    const BodyRefT& operator=(const Body& body) const {
+        using Value = typename std::remove_const<T>::type;
+        mass = static_cast<Value>(body.mass);
+        x = static_cast<Value>(body.x); y = static_cast<Value>(body.y); z = static_cast<Value>(body.z);
+        vx = static_cast<Value>(body.vx); vy = static_cast<Value>(body.vy); vz = static_cast<Value>(body.vz);
+        ax = static_cast<Value>(body.ax); ay = static_cast<Value>(body.ay); az = static_cast<Value>(body.az);
+        return *this;
+    }
+};
+using BodyRef = BodyRefT<double>;
+using ConstBodyRef = BodyRefT<const double>;
+
+// Ciała w układzie SoA: każda składowa w osobnej tablicy wyrównanej do 64 bajtów, z pojemnością
+// zaokrągloną do pełnych linii pamięci podręcznej, dzięki czemu pętle po jednej składowej są wektoryzowane,
+// a ostatnia linia tablicy nie jest dzielona z sąsiednią alokacją. operator[] daje widok AoS (BodyRefT).
+// `Real` to typ przechowywania: double albo float (tryb mieszanej precyzji - połowa pamięci i dwa razy
+// więcej elementów w rejestrze SIMD; obliczenia korzystające z widoku i tak sumują w double).
+template <typename Real>
+class BodySystemT {
+public:
+    using Scalar = Real;
+    using Array = std::vector<Real, AlignedAllocator<Real>>;
+    static constexpr std::size_t LANE = 64 / sizeof(Real);  // liczba elementów w linii 64 bajtów
+
+    Array mass;
+    Array x, y, z;
+    Array vx, vy, vz;
+    Array ax, ay, az;
+
+    BodySystemT() = default;
+    explicit BodySystemT(const std::vector<Body>& bodies);
+
+    std::size_t size() const { return mass.size(); }
+    bool empty() const { return mass.empty(); }
+    void resize(std::size_t n);
+    void push_back(const Body& body);
+    // kopia w układzie AoS
+    std::vector<Body> toBodies() const;
+    // liczba bajtów zarezerwowanych przez tablice składowych
+    std::size_t memoryUsage() const { return 10 * mass.capacity() * sizeof(Real); }
+
+    BodyRefT<Real> operator[](std::size_t i) {
+        return {mass[i], x[i], y[i], z[i], vx[i], vy[i], vz[i], ax[i], ay[i], az[i]};
+    }
+    BodyRefT<const Real> operator[](std::size_t i) const {
+        return {mass[i], x[i], y[i], z[i], vx[i], vy[i], vz[i], ax[i], ay[i], az[i]};
+    }
+
+private:
+    void reserve(std::size_t n);
+};
+
+using BodySystem = BodySystemT<double>;
+using BodySystemF = BodySystemT<float>;     // przechowywanie w float (tryb --precision mixed)
+
+#endif // BODYSYSTEM_H
@@ -0,0 +1,79 @@
+#include "Diagnostics.h"
+#include "Simulation.h"
+#include <cmath>
+
+template <typename Bodies>
+Diagnostics compute_diagnostics(const Bodies& bodies, BHTree& tree, double theta) {
+    Diagnostics d;
+    const int n = static_cast<int>(bodies.size());
+    if (n == 0) return d;
+
+    double kinetic = 0.0, mass = 0.0;
+    double px = 0.0, py = 0.0, pz = 0.0;
+    double lx = 0.0, ly = 0.0, lz = 0.0;
+    double cx = 0.0, cy = 0.0, cz = 0.0;
+
+    #pragma omp parallel for reduction(+: kinetic, mass, px, py, pz, lx, ly, lz, cx, cy, cz)
+    for (int i = 0; i < n; ++i) {
+        // składowe odczytywane jako double także przy przechowywaniu w float (BodySystemF)
+        const auto& b = bodies[i];
+        const double m = b.mass, x = b.x, y = b.y, z = b.z, vx = b.vx, vy = b.vy, vz = b.vz;
+        kinetic += 0.5 * m * (vx * vx + vy * vy + vz * vz);
+        mass += m;
+        px += m * vx;
+        py += m * vy;
+        pz += m * vz;
+        // L = m * (r x v)
+        lx += m * (y * vz - z * vy);
+        ly += m * (z * vx - x * vz);
+        lz += m * (x * vy - y * vx);
+        cx += m * x;
+        cy += m * y;
+        cz += m * z;
+    }
+
+    // energia potencjalna U = 1/2 * suma m_i * phi_i; ciała w kolejności Mortona jak przy siłach
+    build_bhtree(bodies, tree);
+    double potential = 0.0;
+    #pragma omp parallel for reduction(+: potential) schedule(dynamic, 256)
+    for (int k = 0; k < n; ++k) {
+        const uint32_t i = tree.order[k];
+        potential += 0.5 * static_cast<double>(bodies[i].mass) * tree.calculatePotential(bodies, i, theta);
+    }
+
+    d.kinetic = kinetic;
+    d.potential = potential;
+    d.momentum[0] = px;
+    d.momentum[1] = py;
+    d.momentum[2] = pz;
+    d.angularMomentum[0] = lx;
+    d.angularMomentum[1] = ly;
+    d.angularMomentum[2] = lz;
+    if (mass > 0.0) {
+        d.centerOfMass[0] = cx / mass;
+        d.centerOfMass[1] = cy / mass;
+        d.centerOfMass[2] = cz / mass;
+    }
+    return d;
+}
+
+template <typename Bodies>
+bool DiagnosticsMonitor::sample(const Bodies& bodies, int step) {
+    if (interval < 1 || step % interval != 0) return false;
+
+    Diagnostics d = compute_diagnostics(bodies, tree, theta);
+    d.step = step;
+    if (!samples.empty()) {
+        const double initial = samples.front().total();
+        d.energyDrift = initial != 0.0 ? (d.total() - initial) / std::abs(initial) : 0.0;
+    }
+    samples.push_back(d);
+    return true;
+}
+
+template Diagnostics compute_diagnostics(const std::vector<Body>&, BHTree&, double);
+template Diagnostics compute_diagnostics(const BodySystem&, BHTree&, double);
+template bool DiagnosticsMonitor::sample(const std::vector<Body>&, int);
+template bool DiagnosticsMonitor::sample(const BodySystem&, int);
+template Diagnostics compute_diagnostics(const BodySystemF&, BHTree&, double);
+template bool DiagnosticsMonitor::sample(const BodySystemF&, int);
@@ -0,0 +1,50 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <vector>
+#include "BHTree.h"
+#include "Body.h"
+
+// wielkości zachowywane przez układ w jednej chwili symulacji
+struct Diagnostics {
+    int step = 0;
+    double kinetic = 0.0;
+    double potential = 0.0;             // z drzewa Barnes-Hut o dokładności `theta`
+    double momentum[3] = {0.0, 0.0, 0.0};
+    double angularMomentum[3] = {0.0, 0.0, 0.0};   // względem początku układu współrzędnych
+    double centerOfMass[3] = {0.0, 0.0, 0.0};
+    double energyDrift = 0.0;           // (E - E0) / |E0| względem pierwszej próbki
+
+    double total() const { return kinetic + potential; }
+};
+
+// Energia kinetyczna i potencjalna, pęd, moment pędu i środek masy, liczone równolegle. Potencjał pochodzi
+// z drzewa `tree` budowanego tu dla bieżących pozycji (theta = 0 - suma dokładna). `bodies` to
+// std::vector<Body>, BodySystem lub BodySystemF (drzewo i sumy zawsze w double).
+template <typename Bodies>
+Diagnostics compute_diagnostics(const Bodies& bodies, BHTree& tree, double theta);
+
+// Diagnostyka co `interval` kroków z historią próbek i dryfem energii względem pierwszej próbki. Ma własne
+// drzewo, więc nie narusza drzewa symulacji (np. refitu z poprzedniego kroku).
+class DiagnosticsMonitor {
+public:
+    static constexpr double DEFAULT_THETA = 0.5;
+
+    int interval = 10;
+    double theta = DEFAULT_THETA;
+
+    // liczy diagnostykę, gdy `step` jest wielokrotnością `interval`; zwraca true, gdy powstała nowa próbka
+    template <typename Bodies>
+    bool sample(const Bodies& bodies, int step);
+    const std::vector<Diagnostics>& history() const { return samples; }
+    const Diagnostics& latest() const { return samples.back(); }
+    bool empty() const { return samples.empty(); }
+    // dryf energii ostatniej próbki (0 przed dwiema próbkami)
+    double energyDrift() const { return samples.empty() ? 0.0 : samples.back().energyDrift; }
+
+private:
+    BHTree tree;
+    std::vector<Diagnostics> samples;
+};
+
+#endif // DIAGNOSTICS_H
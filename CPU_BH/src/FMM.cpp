@@ -0,0 +1,311 @@
+#include "FMM.h"
+#include "Gravity.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// poddrzewa z większą liczbą ciał przetwarzane są jako osobne zadania OpenMP
+static const uint32_t TASK_CUTOFF = 1024;
+// największa liczba współczynników rozwinięcia (rząd MAX_ORDER)
+static const int MAX_TERMS = (FMMSolver::MAX_ORDER + 1) * (FMMSolver::MAX_ORDER + 2) * (FMMSolver::MAX_ORDER + 3) / 6;
+
+static double binomial(int n, int k) {
+    double result = 1.0;
+    for (int i = 1; i <= k; ++i) result = result * (n - k + i) / i;
+    return result;
+}
+
+FMMSolver::FMMSolver(int order) {
+    setOrder(order);
+}
+
+int FMMSolver::index(int i, int j, int k) const {
+    if (i < 0 || j < 0 || k < 0 || i + j + k > p) return -1;
+    return indexTable[(i * (p + 1) + j) * (p + 1) + k];
+}
+
+// Tablice przekształceń. Multi-indeksy alfa = (i, j, k) stopnia |alfa| <= p są numerowane rosnąco według
+// stopnia; dla każdego przekształcenia zapamiętywane są tylko niezerowe iloczyny współczynników.
+void FMMSolver::setOrder(int order) {
+    if (order < 1 || order > MAX_ORDER) throw std::invalid_argument("FMM order must be between 1 and 10");
+    p = order;
+
+    exponents.clear();
+    indexTable.assign((p + 1) * (p + 1) * (p + 1), -1);
+    for (int n = 0; n <= p; ++n) {
+        for (int i = n; i >= 0; --i) {
+            for (int j = n - i; j >= 0; --j) {
+                int k = n - i - j;
+                indexTable[(i * (p + 1) + j) * (p + 1) + k] = static_cast<int>(exponents.size());
+                exponents.push_back({i, j, k});
+            }
+        }
+    }
+    terms = static_cast<int>(exponents.size());
+
+    powerBase.assign(terms, 0);
+    powerAxis.assign(terms, 0);
+    minusOne.assign(terms, {-1, -1, -1});
+    minusTwo.assign(terms, {-1, -1, -1});
+    for (int a = 1; a < terms; ++a) {
+        const auto& e = exponents[a];
+        int axis = e[0] > 0 ? 0 : (e[1] > 0 ? 1 : 2);
+        std::array<int, 3> lower = e;
+        --lower[axis];
+        powerBase[a] = index(lower[0], lower[1], lower[2]);
+        powerAxis[a] = axis;
+        for (int d = 0; d < 3; ++d) {
+            std::array<int, 3> one = e, two = e;
+            one[d] -= 1;
+            two[d] -= 2;
+            minusOne[a][d] = index(one[0], one[1], one[2]);
+            minusTwo[a][d] = index(two[0], two[1], two[2]);
+        }
+    }
+
+    m2m.clear();
+    m2l.clear();
+    l2l.clear();
+    gradient.clear();
+    for (int a = 0; a < terms; ++a) {
+        const auto& alpha = exponents[a];
+        const int degreeA = alpha[0] + alpha[1] + alpha[2];
+        for (int b = 0; b < terms; ++b) {
+            const auto& beta = exponents[b];
+            const int degreeB = beta[0] + beta[1] + beta[2];
+
+            // M2M: M'_alfa += C(alfa, beta) * M_beta * d^(alfa - beta)
+            if (beta[0] <= alpha[0] && beta[1] <= alpha[1] && beta[2] <= alpha[2]) {
+                double c = binomial(alpha[0], beta[0]) * binomial(alpha[1], beta[1]) * binomial(alpha[2], beta[2]);
+                m2m.push_back({a, b, index(alpha[0] - beta[0], alpha[1] - beta[1], alpha[2] - beta[2]), c});
+                // L2L: L'_beta += C(alfa, beta) * L_alfa * e^(alfa - beta)
+                l2l.push_back({b, a, index(alpha[0] - beta[0], alpha[1] - beta[1], alpha[2] - beta[2]), c});
+            }
+
+            // M2L: L_beta += (-1)^|beta| * C(alfa + beta, alfa) * M_alfa * a_(alfa + beta)
+            if (degreeA + degreeB <= p) {
+                double c = binomial(alpha[0] + beta[0], alpha[0]) * binomial(alpha[1] + beta[1], alpha[1]) *
+                           binomial(alpha[2] + beta[2], alpha[2]);
+                if (degreeB % 2 == 1) c = -c;
+                m2l.push_back({b, a, index(alpha[0] + beta[0], alpha[1] + beta[1], alpha[2] + beta[2]), c});
+            }
+        }
+
+        // L2P: d(phi)/dx_d += alfa_d * L_alfa * h^(alfa - e_d)
+        for (int d = 0; d < 3; ++d) {
+            if (alpha[d] > 0) gradient.push_back({d, a, minusOne[a][d], static_cast<double>(alpha[d])});
+        }
+    }
+}
+
+// jednomiany (dx, dy, dz)^alfa dla wszystkich multi-indeksów
+void FMMSolver::powers(double dx, double dy, double dz, double* out) const {
+    const double d[3] = {dx, dy, dz};
+    out[0] = 1.0;
+    for (int a = 1; a < terms; ++a) {
+        out[a] = out[powerBase[a]] * d[powerAxis[a]];
+    }
+}
+
+// Współczynniki a_alfa(R) = (-1)^|alfa| / alfa! * D^alfa (1 / |R|) z rekurencji
+// n r^2 a_alfa = (2n - 1) sum_d R_d a_(alfa - e_d) - (n - 1) sum_d a_(alfa - 2 e_d), gdzie n = |alfa|.
+void FMMSolver::derivatives(double dx, double dy, double dz, double* out) const {
+    const double d[3] = {dx, dy, dz};
+    const double r2 = dx * dx + dy * dy + dz * dz;
+    const double invR2 = 1.0 / r2;
+    out[0] = std::sqrt(invR2);
+    for (int a = 1; a < terms; ++a) {
+        const auto& e = exponents[a];
+        const int n = e[0] + e[1] + e[2];
+        double first = 0.0, second = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (minusOne[a][axis] >= 0) first += d[axis] * out[minusOne[a][axis]];
+            if (minusTwo[a][axis] >= 0) second += out[minusTwo[a][axis]];
+        }
+        out[a] = ((2 * n - 1) * first - (n - 1) * second) * invR2 / n;
+    }
+}
+
+// przejście w górę: P2M w liściach, M2M w węzłach wewnętrznych (po zakończeniu zadań dzieci)
+template <typename Real, typename Bodies>
+void FMMSolver::upward(const BHTreeT<Real>& tree, const Bodies& bodies, uint32_t index) {
+    const BHNodeT<Real>& node = tree.nodes[index];
+    double* M = &multipoles[static_cast<size_t>(index) * terms];
+    std::fill(M, M + terms, 0.0);
+    double pw[MAX_TERMS];
+    double r = 0.0;
+
+    if (terminal(node)) {
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            const auto& b = bodies[tree.order[k]];
+            double dx = b.x - node.region.center[0], dy = b.y - node.region.center[1], dz = b.z - node.region.center[2];
+            powers(dx, dy, dz, pw);
+            for (int a = 0; a < terms; ++a) M[a] += b.mass * pw[a];
+            r = std::max(r, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+    else {
+        for (uint32_t child : node.children) {
+            if (child == BHNode::NONE) continue;
+            if (tree.nodes[child].count > TASK_CUTOFF) {
+                #pragma omp task firstprivate(child) shared(tree, bodies)
+                upward(tree, bodies, child);
+            }
+            else {
+                upward(tree, bodies, child);
+            }
+        }
+        #pragma omp taskwait
+
+        for (uint32_t child : node.children) {
+            if (child == BHNode::NONE) continue;
+            const BHNodeT<Real>& c = tree.nodes[child];
+            const double* childM = &multipoles[static_cast<size_t>(child) * terms];
+            double dx = c.region.center[0] - node.region.center[0];
+            double dy = c.region.center[1] - node.region.center[1];
+            double dz = c.region.center[2] - node.region.center[2];
+            powers(dx, dy, dz, pw);
+            for (const Term& t : m2m) M[t.target] += t.coefficient * childM[t.first] * pw[t.second];
+            r = std::max(r, std::sqrt(dx * dx + dy * dy + dz * dz) + radius[child]);
+        }
+    }
+    radius[index] = r;
+}
+
+template <typename Real>
+bool FMMSolver::terminal(const BHNodeT<Real>& node) const {
+    return node.leaf || node.count <= static_cast<uint32_t>(leafSize);
+}
+
+template <typename Real>
+bool FMMSolver::separated(const BHTreeT<Real>& tree, uint32_t a, uint32_t b) const {
+    const Octant& A = tree.nodes[a].region;
+    const Octant& B = tree.nodes[b].region;
+    double dx = A.center[0] - B.center[0], dy = A.center[1] - B.center[1], dz = A.center[2] - B.center[2];
+    double reach = radius[a] + radius[b];
+    return reach * reach < theta * theta * (dx * dx + dy * dy + dz * dz);
+}
+
+// Podwójne przejście sterowane węzłem celu. Lista `sources` razem z rozwinięciem lokalnym rodzica pokrywa
+// wszystkie ciała dokładnie raz: źródło dopuszczalne trafia do rozwinięcia lokalnego (M2L), zbyt bliskie jest
+// zastępowane dziećmi albo przekazywane dzieciom celu, a para liści liczona jest bezpośrednio (P2P).
+template <typename Real, typename Bodies>
+void FMMSolver::interact(const BHTreeT<Real>& tree, const Bodies& bodies, uint32_t target, uint32_t parent,
+                         std::vector<uint32_t> sources, std::vector<double>& fx, std::vector<double>& fy,
+                         std::vector<double>& fz) {
+    const BHNodeT<Real>& node = tree.nodes[target];
+    double* L = &locals[static_cast<size_t>(target) * terms];
+    std::fill(L, L + terms, 0.0);
+    double buffer[MAX_TERMS];
+
+    if (parent != BHNode::NONE) {                           // L2L z rozwinięcia rodzica
+        const BHNodeT<Real>& up = tree.nodes[parent];
+        const double* parentL = &locals[static_cast<size_t>(parent) * terms];
+        powers(node.region.center[0] - up.region.center[0], node.region.center[1] - up.region.center[1],
+               node.region.center[2] - up.region.center[2], buffer);
+        for (const Term& t : l2l) L[t.target] += t.coefficient * parentL[t.first] * buffer[t.second];
+    }
+
+    const bool leaf = terminal(node);
+    if (leaf) {
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            uint32_t i = tree.order[k];
+            fx[i] = fy[i] = fz[i] = 0.0;
+        }
+    }
+
+    std::vector<uint32_t> deferred;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        const uint32_t source = sources[s];
+        const BHNodeT<Real>& src = tree.nodes[source];
+
+        const bool admissible = separated(tree, target, source);
+        // dla kilku par ciał bezpośrednie oddziaływanie jest tańsze niż M2L
+        const bool direct = leaf && (admissible ? node.count * src.count <= static_cast<uint32_t>(terms)
+                                                : terminal(src));
+        if (direct) {                                       // P2P
+            for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+                const uint32_t i = tree.order[k];
+                const auto& t = bodies[i];
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+                add_gravity_bucket(tree.bodyPosition[0].data() + src.first, tree.bodyPosition[1].data() + src.first,
+                                   tree.bodyPosition[2].data() + src.first, tree.bodyMass.data() + src.first,
+                                   static_cast<int>(src.count), t.x, t.y, t.z, t.mass, sx, sy, sz);
+                fx[i] += sx;
+                fy[i] += sy;
+                fz[i] += sz;
+            }
+        }
+        else if (admissible) {                              // M2L
+            const double* M = &multipoles[static_cast<size_t>(source) * terms];
+            derivatives(node.region.center[0] - src.region.center[0], node.region.center[1] - src.region.center[1],
+                        node.region.center[2] - src.region.center[2], buffer);
+            for (const Term& t : m2l) L[t.target] += t.coefficient * M[t.first] * buffer[t.second];
+        }
+        else if (leaf || (!terminal(src) && src.region.size > node.region.size)) {
+            for (uint32_t child : src.children) {           // otwieramy większe (lub jedyne otwieralne) źródło
+                if (child != BHNode::NONE) sources.push_back(child);
+            }
+        }
+        else {
+            deferred.push_back(source);                     // otwieramy cel
+        }
+    }
+
+    if (leaf) {                                             // L2P
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            const uint32_t i = tree.order[k];
+            const auto& b = bodies[i];
+            powers(b.x - node.region.center[0], b.y - node.region.center[1], b.z - node.region.center[2], buffer);
+            double grad[3] = {0.0, 0.0, 0.0};
+            for (const Term& t : gradient) grad[t.target] += t.coefficient * L[t.first] * buffer[t.second];
+            const double gm = G * b.mass;
+            fx[i] += gm * grad[0];
+            fy[i] += gm * grad[1];
+            fz[i] += gm * grad[2];
+        }
+        return;
+    }
+
+    for (uint32_t child : node.children) {
+        if (child == BHNode::NONE) continue;
+        if (tree.nodes[child].count > TASK_CUTOFF) {
+            #pragma omp task firstprivate(child) shared(tree, bodies, deferred, fx, fy, fz)
+            interact(tree, bodies, child, target, deferred, fx, fy, fz);
+        }
+        else {
+            interact(tree, bodies, child, target, deferred, fx, fy, fz);
+        }
+    }
+    #pragma omp taskwait
+}
+
+template <typename Real, typename Bodies>
+void FMMSolver::computeForces(const BHTreeT<Real>& tree, const Bodies& bodies,
+                              std::vector<double>& fx, std::vector<double>& fy, std::vector<double>& fz) {
+    const size_t n = bodies.size();
+    fx.assign(n, 0.0);
+    fy.assign(n, 0.0);
+    fz.assign(n, 0.0);
+    if (tree.empty()) return;
+
+    const size_t count = tree.nodes.size();
+    multipoles.resize(count * terms);
+    locals.resize(count * terms);
+    radius.resize(count);
+
+    #pragma omp parallel
+    #pragma omp single
+    upward(tree, bodies, 0);
+
+    #pragma omp parallel
+    #pragma omp single
+    interact(tree, bodies, 0, BHNode::NONE, std::vector<uint32_t>(1, 0), fx, fy, fz);
+}
+
+template void FMMSolver::computeForces(const BHTree&, const std::vector<Body>&, std::vector<double>&,
+                                       std::vector<double>&, std::vector<double>&);
+template void FMMSolver::computeForces(const BHTree&, const BodySystem&, std::vector<double>&,
+                                       std::vector<double>&, std::vector<double>&);
+template void FMMSolver::computeForces(const BHTreeF&, const BodySystemF&, std::vector<double>&,
+                                       std::vector<double>&, std::vector<double>&);
@@ -0,0 +1,70 @@
+#ifndef FMM_H
+#define FMM_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "BHTree.h"
+#include "Body.h"
+
+// Szybka metoda multipolowa (FMM) na drzewie BHTree z kartezjańskimi rozwinięciami Taylora rzędu `order`.
+// Przebieg: w górę (P2M, M2M), podwójne przejście drzewa z oddziaływaniami komórka-komórka (M2L) i bliskim
+// polem liczonym bezpośrednio (P2P), w dół (L2L, L2P). Zadania OpenMP dzielą drzewo celów na rozłączne poddrzewa.
+class FMMSolver {
+public:
+    static constexpr int DEFAULT_ORDER = 4;
+    static constexpr int MAX_ORDER = 10;
+    static constexpr double DEFAULT_THETA = 0.5;
+    static constexpr int DEFAULT_LEAF_SIZE = 16;
+
+    // kryterium dopuszczalności pary komórek: (r_A + r_B) < theta * |c_A - c_B|
+    double theta = DEFAULT_THETA;
+    // poddrzewa z co najwyżej tyloma ciałami są traktowane jak liście (P2M i P2P na całym zakresie ciał)
+    int leafSize = DEFAULT_LEAF_SIZE;
+
+    explicit FMMSolver(int order = DEFAULT_ORDER);
+    // zmienia rząd rozwinięć (1..MAX_ORDER) i przelicza tablice współczynników
+    void setOrder(int order);
+    int order() const { return p; }
+
+    // siły na wszystkie ciała; `tree` musi być zbudowane dla `bodies` (std::vector<Body> lub BodySystem, dla
+    // BHTreeF - BodySystemF). Rozwinięcia liczone są zawsze w double.
+    template <typename Real, typename Bodies>
+    void computeForces(const BHTreeT<Real>& tree, const Bodies& bodies,
+                       std::vector<double>& fx, std::vector<double>& fy, std::vector<double>& fz);
+
+private:
+    // wpis tablicy przekształcenia: out[target] += coefficient * a[first] * b[second]
+    struct Term {
+        int target, first, second;
+        double coefficient;
+    };
+
+    int p = 0;
+    int terms = 0;                              // liczba współczynników rozwinięcia
+    std::vector<std::array<int, 3>> exponents;  // multi-indeksy w kolejności rosnącego stopnia
+    std::vector<int> indexTable;                // (i, j, k) -> indeks lub -1
+    std::vector<int> powerBase, powerAxis;      // potęga jako potęga niższa razy jedna współrzędna
+    std::vector<std::array<int, 3>> minusOne, minusTwo;
+    std::vector<Term> m2m, m2l, l2l, gradient;
+
+    std::vector<double> multipoles, locals;     // `terms` współczynników na węzeł
+    std::vector<double> radius;                 // promień obejmujący ciała węzła (od środka geometrycznego)
+
+    int index(int i, int j, int k) const;
+    void powers(double dx, double dy, double dz, double* out) const;
+    void derivatives(double dx, double dy, double dz, double* out) const;
+
+    template <typename Real, typename Bodies>
+    void upward(const BHTreeT<Real>& tree, const Bodies& bodies, uint32_t node);
+    template <typename Real, typename Bodies>
+    void interact(const BHTreeT<Real>& tree, const Bodies& bodies, uint32_t target, uint32_t parent,
+                  std::vector<uint32_t> sources, std::vector<double>& fx, std::vector<double>& fy,
+                  std::vector<double>& fz);
+    template <typename Real>
+    bool terminal(const BHNodeT<Real>& node) const;
+    template <typename Real>
+    bool separated(const BHTreeT<Real>& tree, uint32_t a, uint32_t b) const;
+};
+
+#endif // FMM_H
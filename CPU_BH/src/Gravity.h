@@ -0,0 +1,136 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// stałe fizyczne współdzielone przez solvery (dołączane tylko w plikach .cpp)
+const double G = 6.67430e-11;
+const double SOFTENING = 1e-10; // wygładzenie odległości chroniące przed dzieleniem przez zero
+
+// Kernele są szablonami wymiaru `Dim` (3 - przestrzeń, 2 - płaszczyzna xy drzewa czwórkowego); wektory to
+// std::array<double, Dim>. Prawo siły jest zawsze newtonowskie (1/r^2) - w 2D ciała po prostu leżą w jednej
+// płaszczyźnie. Dla Dim = 3 działania wykonywane są w tej samej kolejności co we wzorach rozpisanych na osie.
+template <int Dim>
+using Vec = std::array<double, Dim>;
+
+// pozycja składowej (i, j), i <= j, w spakowanym momencie {xx, xy, xz, yy, yz, zz} albo {xx, xy, yy}
+template <int Dim>
+constexpr int quadrupole_index(int i, int j) { return i * Dim - i * (i - 1) / 2 + (j - i); }
+
+// dodaje siłę, z jaką masa `sourceMass` odległa o d przyciąga ciało o masie `targetMass`
+template <int Dim>
+inline void add_gravity(const Vec<Dim>& d, double sourceMass, double targetMass, Vec<Dim>& f) {
+    double dist_sq = 0.0;
+    for (int k = 0; k < Dim; ++k) dist_sq += d[k] * d[k];
+    dist_sq += SOFTENING;
+    double dist = std::sqrt(dist_sq);
+    double force = G * sourceMass * targetMass / dist_sq;
+    for (int k = 0; k < Dim; ++k) f[k] += force * d[k] / dist;
+}
+
+inline void add_gravity(double dx, double dy, double dz, double sourceMass, double targetMass,
+                        double& fx, double& fy, double& fz) {
+    Vec<3> f = {fx, fy, fz};
+    add_gravity<3>({dx, dy, dz}, sourceMass, targetMass, f);
+    fx = f[0];
+    fy = f[1];
+    fz = f[2];
+}
+
+// Dodaje siły od `count` mas punktowych zapisanych w tablicach SoA (`position[k]` - współrzędne osi k); pętla
+// bez rozgałęzień jest wektoryzowana, a ciało docelowe może być w tablicach - przy zerowej odległości
+// wygładzenie daje zerową siłę. Działania na parach wykonywane są w typie przechowywania `Real` (dla float dwa
+// razy więcej par na rejestr SIMD) i sumowane w nim w blokach po GRAVITY_BLOCK par, a sumy bloków - w double.
+// Czynnik m / r^3 liczony jest jako (m / r) * (d / r^2), żeby dla float nie przekroczyć zakresu.
+constexpr int GRAVITY_BLOCK = 64;
+
+template <typename Real, int Dim>
+inline void add_gravity_bucket(const std::array<const Real*, Dim>& position, const Real* mass, int count,
+                               const Vec<Dim>& target, double targetMass, Vec<Dim>& f) {
+    // osie w osobnych zmiennych - tablica d[Dim] w pętli wektoryzowanej trafia do pamięci
+    const Real* x = position[0];
+    const Real* y = position[1];
+    const Real* z = position[Dim - 1];
+    const Real px = static_cast<Real>(target[0]), py = static_cast<Real>(target[1]);
+    const Real pz = static_cast<Real>(target[Dim - 1]);
+    const Real softening = static_cast<Real>(SOFTENING);
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (int begin = 0; begin < count; begin += GRAVITY_BLOCK) {
+        const int end = std::min(count, begin + GRAVITY_BLOCK);
+        Real bx = 0, by = 0, bz = 0;
+        #pragma omp simd reduction(+: bx, by, bz)
+        for (int j = begin; j < end; ++j) {
+            Real dx = x[j] - px;
+            Real dy = y[j] - py;
+            Real r2 = dx * dx + dy * dy;
+            Real dz = 0;
+            if constexpr (Dim == 3) {
+                dz = z[j] - pz;
+                r2 += dz * dz;
+            }
+            Real inv = Real(1) / std::sqrt(r2 + softening);
+            Real s = mass[j] * inv;
+            Real inv2 = inv * inv;
+            bx += s * (dx * inv2);
+            by += s * (dy * inv2);
+            if constexpr (Dim == 3) bz += s * (dz * inv2);
+        }
+        sum[0] += bx;
+        sum[1] += by;
+        sum[2] += bz;
+    }
+    const double gm = G * targetMass;
+    for (int k = 0; k < Dim; ++k) f[k] += gm * sum[k];
+}
+
+template <typename Real>
+inline void add_gravity_bucket(const Real* x, const Real* y, const Real* z, const Real* mass, int count,
+                               double tx, double ty, double tz, double targetMass,
+                               double& fx, double& fy, double& fz) {
+    Vec<3> f = {fx, fy, fz};
+    add_gravity_bucket<Real, 3>({x, y, z}, mass, count, {tx, ty, tz}, targetMass, f);
+    fx = f[0];
+    fy = f[1];
+    fz = f[2];
+}
+
+// Dodaje siłę od bezśladowego momentu kwadrupolowego q (spakowanego jak w quadrupole_index()) liczonego
+// względem środka masy węzła; d to wektor od ciała do środka masy. Przyspieszenie to
+// a = G * (-Q d / r^5 + 5/2 * (d^T Q d) d / r^7). Moment może być przechowywany w float; wzór liczony jest w double.
+template <int Dim, typename Real>
+inline void add_quadrupole(const Vec<Dim>& d, const Real* q, double targetMass, Vec<Dim>& f) {
+    double r2 = 0.0;
+    for (int k = 0; k < Dim; ++k) r2 += d[k] * d[k];
+    r2 += SOFTENING;
+    double inv = 1.0 / std::sqrt(r2);
+    double inv2 = inv * inv;
+    double inv5 = inv2 * inv2 * inv;
+    Vec<Dim> qd;
+    for (int i = 0; i < Dim; ++i) {
+        qd[i] = 0.0;
+        for (int j = 0; j < Dim; ++j) {
+            qd[i] += q[i <= j ? quadrupole_index<Dim>(i, j) : quadrupole_index<Dim>(j, i)] * d[j];
+        }
+    }
+    double dqd = 0.0;
+    for (int k = 0; k < Dim; ++k) dqd += d[k] * qd[k];
+    double qrr = 2.5 * dqd * inv2;
+    double scale = G * targetMass * inv5;
+    for (int k = 0; k < Dim; ++k) f[k] += scale * (qrr * d[k] - qd[k]);
+}
+
+// dodaje do q wkład masy m przesuniętej o d względem środka rozwinięcia
+template <int Dim>
+inline void add_quadrupole_term(double* q, double m, const Vec<Dim>& d) {
+    double d2 = 0.0;
+    for (int k = 0; k < Dim; ++k) d2 += d[k] * d[k];
+    for (int i = 0; i < Dim; ++i) {
+        for (int j = i; j < Dim; ++j) {
+            q[quadrupole_index<Dim>(i, j)] += i == j ? m * (3.0 * d[i] * d[i] - d2) : m * 3.0 * d[i] * d[j];
+        }
+    }
+}
+
+#endif // GRAVITY_H
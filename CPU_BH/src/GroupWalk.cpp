@@ -0,0 +1,187 @@
+#include "GroupWalk.h"
+#include "Gravity.h"
+#include <algorithm>
+#include <cmath>
+
+template <typename Real>
+void InteractionListT<Real>::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    mass.clear();
+    cellX.clear();
+    cellY.clear();
+    cellZ.clear();
+    for (auto& component : quad) component.clear();
+}
+
+template <typename Real>
+void InteractionListT<Real>::add(Real x_, Real y_, Real z_, Real mass_) {
+    x.push_back(x_);
+    y.push_back(y_);
+    z.push_back(z_);
+    mass.push_back(mass_);
+}
+
+template <typename Real>
+void InteractionListT<Real>::addQuadrupole(Real x_, Real y_, Real z_, const Real* q) {
+    cellX.push_back(x_);
+    cellY.push_back(y_);
+    cellZ.push_back(z_);
+    for (int c = 0; c < 6; ++c) quad[c].push_back(q[c]);
+}
+
+// odległość punktu od prostopadłościanu (0 wewnątrz)
+static double distance_to_box(double px, double py, double pz, const double* boxMin, const double* boxMax) {
+    double dx = std::max(std::max(boxMin[0] - px, px - boxMax[0]), 0.0);
+    double dy = std::max(std::max(boxMin[1] - py, py - boxMax[1]), 0.0);
+    double dz = std::max(std::max(boxMin[2] - pz, pz - boxMax[2]), 0.0);
+    return std::sqrt(dx * dx + dy * dy + dz * dz + SOFTENING);
+}
+
+// jedno przejście spłaszczonego drzewa dla całej grupy; węzeł jest przybliżany tylko wtedy, gdy kryterium
+// Barnes-Hut jest spełnione dla najbliższego punktu grupy, a więc i dla każdego jej ciała
+template <typename Real>
+static void build_interaction_list(const BHTreeT<Real>& tree, const double* boxMin, const double* boxMax,
+                                   double theta, InteractionListT<Real>& list) {
+    list.clear();
+    const uint32_t end = static_cast<uint32_t>(tree.flat.size());
+    uint32_t i = 0;
+    while (i < end) {
+        const BHFlatNodeT<Real>& node = tree.flat[i];
+        if (node.mass == 0) {
+            i = node.skip;
+            continue;
+        }
+
+        if (node.skip == i + 1) {                           // liść - ciała trafiają na listę pojedynczo
+            for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+                list.add(tree.bodyPosition[0][k], tree.bodyPosition[1][k], tree.bodyPosition[2][k], tree.bodyMass[k]);
+            }
+            i = node.skip;
+            continue;
+        }
+
+        double dist = distance_to_box(node.center[0], node.center[1], node.center[2], boxMin, boxMax);
+        if ((node.size / dist) < theta) {
+            list.add(node.center[0], node.center[1], node.center[2], node.mass);
+            if (tree.multipoleOrder >= BHTree::QUADRUPOLE) {
+                list.addQuadrupole(node.center[0], node.center[1], node.center[2], node.quad.data());
+            }
+            i = node.skip;
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+template <typename Real, typename Bodies>
+GroupWalkStats compute_forces_grouped(const BHTreeT<Real>& tree, const Bodies& bodies, double theta,
+                                      int groupSize, std::vector<double>& fx, std::vector<double>& fy,
+                                      std::vector<double>& fz) {
+    GroupWalkStats stats;
+    if (tree.flat.empty()) return stats;
+
+    // grupy: największe poddrzewa z co najwyżej `groupSize` ciałami (ciągłe zakresy w kolejności Mortona)
+    std::vector<uint32_t> groups;
+    const uint32_t end = static_cast<uint32_t>(tree.flat.size());
+    for (uint32_t i = 0; i < end;) {
+        const BHFlatNodeT<Real>& node = tree.flat[i];
+        if (node.count <= static_cast<uint32_t>(groupSize) || node.skip == i + 1) {
+            groups.push_back(i);
+            i = node.skip;
+        }
+        else {
+            ++i;
+        }
+    }
+    stats.groups = groups.size();
+
+    size_t interactions = 0;
+    const int groupCount = static_cast<int>(groups.size());
+
+    #pragma omp parallel reduction(+: interactions)
+    {
+        InteractionListT<Real> list;
+
+        #pragma omp for schedule(dynamic, 4)
+        for (int g = 0; g < groupCount; ++g) {
+            const BHFlatNodeT<Real>& group = tree.flat[groups[g]];
+            if (group.count == 0) continue;                 // poddrzewo opróżnione przez BHTree::refit()
+            const uint32_t first = group.first, last = group.first + group.count;
+
+            double boxMin[3] = {bodies[tree.order[first]].x, bodies[tree.order[first]].y, bodies[tree.order[first]].z};
+            double boxMax[3] = {boxMin[0], boxMin[1], boxMin[2]};
+            for (uint32_t k = first + 1; k < last; ++k) {
+                const auto& b = bodies[tree.order[k]];
+                boxMin[0] = std::min<double>(boxMin[0], b.x); boxMax[0] = std::max<double>(boxMax[0], b.x);
+                boxMin[1] = std::min<double>(boxMin[1], b.y); boxMax[1] = std::max<double>(boxMax[1], b.y);
+                boxMin[2] = std::min<double>(boxMin[2], b.z); boxMax[2] = std::max<double>(boxMax[2], b.z);
+            }
+
+            build_interaction_list(tree, boxMin, boxMax, theta, list);
+
+            const int length = static_cast<int>(list.size());
+
+            for (uint32_t k = first; k < last; ++k) {
+                const uint32_t target = tree.order[k];
+                const double x = bodies[target].x, y = bodies[target].y, z = bodies[target].z;
+                const double gm = G * bodies[target].mass;
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+
+                // samo ciało też jest na liście, ale przy zerowej odległości i wygładzeniu daje zerową siłę;
+                // pary liczone są w typie drzewa `Real`, sumy w double
+                add_gravity_bucket(list.x.data(), list.y.data(), list.z.data(), list.mass.data(), length, x, y, z,
+                                   bodies[target].mass, sx, sy, sz);
+
+                // człony kwadrupolowe węzłów - ten sam wzór co add_quadrupole(), zawsze w double (iloczyny
+                // momentu i odległości wychodzą poza zakres float)
+                const Real* cx = list.cellX.data();
+                const Real* cy = list.cellY.data();
+                const Real* cz = list.cellZ.data();
+                const Real* qxx = list.quad[0].data();
+                const Real* qxy = list.quad[1].data();
+                const Real* qxz = list.quad[2].data();
+                const Real* qyy = list.quad[3].data();
+                const Real* qyz = list.quad[4].data();
+                const Real* qzz = list.quad[5].data();
+                const int cells = static_cast<int>(list.cellX.size());
+
+                #pragma omp simd reduction(+: sx, sy, sz)
+                for (int j = 0; j < cells; ++j) {
+                    double dx = cx[j] - x;
+                    double dy = cy[j] - y;
+                    double dz = cz[j] - z;
+                    double inv = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + SOFTENING);
+                    double inv2 = inv * inv;
+                    double qx = qxx[j] * dx + qxy[j] * dy + qxz[j] * dz;
+                    double qy = qxy[j] * dx + qyy[j] * dy + qyz[j] * dz;
+                    double qz = qxz[j] * dx + qyz[j] * dy + qzz[j] * dz;
+                    double qrr = 2.5 * (dx * qx + dy * qy + dz * qz) * inv2;
+                    double s = gm * inv2 * inv2 * inv;
+                    sx += s * (qrr * dx - qx);
+                    sy += s * (qrr * dy - qy);
+                    sz += s * (qrr * dz - qz);
+                }
+
+                fx[target] = sx;
+                fy[target] = sy;
+                fz[target] = sz;
+            }
+            interactions += static_cast<size_t>(length) * group.count;
+        }
+    }
+
+    stats.interactions = interactions;
+    return stats;
+}
+
+template struct InteractionListT<double>;
+template struct InteractionListT<float>;
+template GroupWalkStats compute_forces_grouped(const BHTree&, const std::vector<Body>&, double, int,
+                                               std::vector<double>&, std::vector<double>&, std::vector<double>&);
+template GroupWalkStats compute_forces_grouped(const BHTree&, const BodySystem&, double, int,
+                                               std::vector<double>&, std::vector<double>&, std::vector<double>&);
+template GroupWalkStats compute_forces_grouped(const BHTreeF&, const BodySystemF&, double, int,
+                                               std::vector<double>&, std::vector<double>&, std::vector<double>&);
@@ -0,0 +1,41 @@
+#ifndef GROUPWALK_H
+#define GROUPWALK_H
+
+#include <cstddef>
+#include <vector>
+#include "BHTree.h"
+#include "Body.h"
+
+// lista oddziaływań grupy w układzie SoA: przybliżone węzły i pojedyncze ciała jako masy punktowe;
+// `Real` to typ przechowywania drzewa, z którego lista jest budowana
+template <typename Real>
+struct InteractionListT {
+    std::vector<Real> x, y, z, mass;
+    // momenty kwadrupolowe przybliżonych węzłów (tylko przy BHTree::QUADRUPOLE)
+    std::vector<Real> cellX, cellY, cellZ;
+    std::vector<Real> quad[6];
+
+    void clear();
+    void add(Real x_, Real y_, Real z_, Real mass_);
+    void addQuadrupole(Real x_, Real y_, Real z_, const Real* q);
+    size_t size() const { return mass.size(); }
+};
+using InteractionList = InteractionListT<double>;
+
+// statystyki przejścia grupowego
+struct GroupWalkStats {
+    size_t groups = 0;
+    size_t interactions = 0;    // suma (rozmiar grupy * długość listy) - liczba obliczonych par
+};
+
+// Siły metodą przejścia grupowego. Ciała sąsiadujące w kolejności Mortona (poddrzewa z co najwyżej
+// `groupSize` ciałami) dzielą jedno przejście drzewa z zachowawczym kryterium otwarcia liczonym względem
+// prostopadłościanu grupy, a wspólna lista oddziaływań jest potem liczona dla każdego ciała grupy
+// zwektoryzowaną pętlą. Wymaga wcześniejszego tree.flatten(); siły trafiają do fx/fy/fz[indeks ciała].
+// `bodies` to std::vector<Body> lub BodySystem (dla BHTreeF - BodySystemF).
+template <typename Real, typename Bodies>
+GroupWalkStats compute_forces_grouped(const BHTreeT<Real>& tree, const Bodies& bodies, double theta,
+                                      int groupSize, std::vector<double>& fx, std::vector<double>& fy,
+                                      std::vector<double>& fz);
+
+#endif // GROUPWALK_H
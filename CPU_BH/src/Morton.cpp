@@ -0,0 +1,90 @@
+#include "Morton.h"
+#include <omp.h>
+
+void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+                std::vector<uint64_t>& keysScratch, std::vector<uint32_t>& valuesScratch) {
+    const size_t n = keys.size();
+    const int RADIX = 256;
+    keysScratch.resize(n);
+    valuesScratch.resize(n);
+
+    std::vector<size_t> histogram(static_cast<size_t>(omp_get_max_threads()) * RADIX);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        bool skip = false;
+
+        #pragma omp parallel
+        {
+            const int t = omp_get_thread_num();
+            const int threads = omp_get_num_threads();
+            const size_t begin = n * t / threads;
+            const size_t end = n * (t + 1) / threads;
+            size_t* local = &histogram[static_cast<size_t>(t) * RADIX];
+
+            for (int d = 0; d < RADIX; ++d) local[d] = 0;
+            for (size_t i = begin; i < end; ++i) {
+                ++local[(keys[i] >> shift) & 0xff];
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                // pozycje startowe: najpierw według cyfry, potem według wątku - zachowuje stabilność
+                size_t offset = 0;
+                for (int d = 0; d < RADIX; ++d) {
+                    for (int w = 0; w < threads; ++w) {
+                        size_t c = histogram[static_cast<size_t>(w) * RADIX + d];
+                        if (c == n) skip = true;            // wszystkie klucze mają tę samą cyfrę
+                        histogram[static_cast<size_t>(w) * RADIX + d] = offset;
+                        offset += c;
+                    }
+                }
+            }
+
+            if (!skip) {
+                for (size_t i = begin; i < end; ++i) {
+                    size_t pos = local[(keys[i] >> shift) & 0xff]++;
+                    keysScratch[pos] = keys[i];
+                    valuesScratch[pos] = values[i];
+                }
+            }
+        }
+
+        if (!skip) {
+            keys.swap(keysScratch);
+            values.swap(valuesScratch);
+        }
+    }
+}
+
+size_t exclusive_scan(std::vector<uint32_t>& values, size_t count) {
+    std::vector<size_t> partial(static_cast<size_t>(omp_get_max_threads()) + 1, 0);
+    size_t total = 0;
+
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int threads = omp_get_num_threads();
+        const size_t begin = count * t / threads;
+        const size_t end = count * (t + 1) / threads;
+
+        size_t sum = 0;
+        for (size_t i = begin; i < end; ++i) sum += values[i];
+        partial[t + 1] = sum;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int w = 0; w < threads; ++w) partial[w + 1] += partial[w];
+            total = partial[threads];
+        }
+
+        size_t offset = partial[t];
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t v = values[i];
+            values[i] = static_cast<uint32_t>(offset);
+            offset += v;
+        }
+    }
+    return total;
+}
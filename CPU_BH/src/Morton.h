@@ -0,0 +1,68 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// liczba bitów na oś w 63-bitowym kluczu Mortona (kolejność Z)
+const int MORTON_BITS = 21;
+
+// rozsuwa 21 bitów tak, aby między kolejnymi bitami były dwa zera
+inline uint64_t expand_bits(uint32_t v) {
+    uint64_t x = v & 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+// klucz Mortona; bity osi x, y, z są przeplatane w kolejności zgodnej z Octant::getSubOctant
+inline uint64_t morton_key(uint32_t ix, uint32_t iy, uint32_t iz) {
+    return expand_bits(ix) | (expand_bits(iy) << 1) | (expand_bits(iz) << 2);
+}
+
+// indeks dziecka (0-7) na głębokości `depth`, do którego należy klucz
+inline int morton_octant(uint64_t key, int depth) {
+    return static_cast<int>((key >> (3 * (MORTON_BITS - 1 - depth))) & 7);
+}
+
+// Klucze dla drzewa w `Dim` wymiarach: w 3D to morton_key() i morton_octant(), w 2D przeplatane są dwie osie
+// po 31 bitów (62-bitowy klucz, 2^31 komórek na oś - tak, żeby 1u << bits mieściło się w uint32_t).
+template <int Dim>
+constexpr int morton_bits() { return Dim == 3 ? MORTON_BITS : 31; }
+
+// rozsuwa 31 bitów tak, aby między kolejnymi bitami było jedno zero
+inline uint64_t expand_bits2(uint32_t v) {
+    uint64_t x = v & 0x7fffffff;
+    x = (x | x << 16) & 0x0000ffff0000ffffULL;
+    x = (x | x << 8) & 0x00ff00ff00ff00ffULL;
+    x = (x | x << 4) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | x << 2) & 0x3333333333333333ULL;
+    x = (x | x << 1) & 0x5555555555555555ULL;
+    return x;
+}
+
+template <int Dim>
+inline uint64_t morton_key(const std::array<uint32_t, Dim>& cell) {
+    if constexpr (Dim == 3) return morton_key(cell[0], cell[1], cell[2]);
+    else return expand_bits2(cell[0]) | (expand_bits2(cell[1]) << 1);
+}
+
+// indeks dziecka (0 - 2^Dim - 1) na głębokości `depth`, zgodny z Orthant::getSubOctant
+template <int Dim>
+inline int morton_child(uint64_t key, int depth) {
+    return static_cast<int>((key >> (Dim * (morton_bits<Dim>() - 1 - depth))) & ((1u << Dim) - 1));
+}
+
+// równoległe, stabilne sortowanie pozycyjne (LSD) par klucz-wartość; bufory `*Scratch` są używane ponownie
+void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+                std::vector<uint64_t>& keysScratch, std::vector<uint32_t>& valuesScratch);
+
+// równoległa suma prefiksowa (wykluczająca) w miejscu; zwraca sumę wszystkich elementów
+size_t exclusive_scan(std::vector<uint32_t>& values, size_t count);
+
+#endif // MORTON_H
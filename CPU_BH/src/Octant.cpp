@@ -1,18 +1,32 @@
 #include "Octant.h"
 
-Octant::Octant(double x_, double y_, double z_, double size_)
-    : x(x_), y(y_), z(z_), size(size_) {}
+template <int Dim>
+Orthant<Dim>::Orthant(const std::array<double, Dim>& center_, double size_)
+    : center(center_), size(size_) {}
 
-bool Octant::contains(const Body& body) const {
-    return (body.x >= x - size / 2 && body.x <= x + size / 2 &&
-        body.y >= y - size / 2 && body.y <= y + size / 2 &&
-        body.z >= z - size / 2 && body.z <= z + size / 2);
+template <int Dim>
+bool Orthant<Dim>::contains(const Body& body) const {
+    return contains(position_of<Dim>(body));
 }
 
-Octant Octant::getSubOctant(int index) const {
+template <int Dim>
+bool Orthant<Dim>::contains(const std::array<double, Dim>& point) const {
+    for (int k = 0; k < Dim; ++k) {
+        if (point[k] < center[k] - size / 2 || point[k] > center[k] + size / 2) return false;
+    }
+    return true;
+}
+
+template <int Dim>
+Orthant<Dim> Orthant<Dim>::getSubOctant(int index) const {
     double newSize = size / 2;
-    double offsetX = ((index & 1) ? newSize : -newSize) / 2;
-    double offsetY = ((index & 2) ? newSize : -newSize) / 2;
-    double offsetZ = ((index & 4) ? newSize : -newSize) / 2;
-    return Octant(x + offsetX, y + offsetY, z + offsetZ, newSize);
-}
\ No newline at end of file
+    std::array<double, Dim> childCenter;
+    for (int k = 0; k < Dim; ++k) {
+        double offset = ((index & (1 << k)) ? newSize : -newSize) / 2;
+        childCenter[k] = center[k] + offset;
+    }
+    return Orthant(childCenter, newSize);
+}
+
+template struct Orthant<2>;
+template struct Orthant<3>;
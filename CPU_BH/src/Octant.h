@@ -1,15 +1,41 @@
 #ifndef OCTANT_H
 #define OCTANT_H
 
+#include <array>
+#include <type_traits>
+#include <utility>
 #include "Body.h"
 
-struct Octant {
-    double x, y, z;
+// Region drzewa w `Dim` wymiarach: sześcian (Dim = 3, oktant) albo kwadrat na płaszczyźnie xy (Dim = 2,
+// kwadrant) o środku `center` i boku `size`. Dziecko o indeksie i leży w górnej połowie osi k, gdy ustawiony
+// jest bit k indeksu.
+template <int Dim>
+struct Orthant {
+    static_assert(Dim == 2 || Dim == 3, "obsługiwane są drzewa czwórkowe (2D) i ósemkowe (3D)");
+    static constexpr int CHILDREN = 1 << Dim;
+
+    std::array<double, Dim> center;
     double size;
 
-    Octant(double x_, double y_, double z_, double size_);
+    Orthant(const std::array<double, Dim>& center_, double size_);
+    // w 2D liczą się tylko współrzędne x i y ciała
     bool contains(const Body& body) const;
-    Octant getSubOctant(int index) const;
+    bool contains(const std::array<double, Dim>& point) const;
+    Orthant getSubOctant(int index) const;
 };
 
-#endif // OCTANT_H
\ No newline at end of file
+using Octant = Orthant<3>;
+using Quadrant = Orthant<2>;
+
+// pierwsze `Dim` współrzędne ciała (Body, BodyRef lub innego typu z polami x, y, z) w typie `T`
+template <int Dim, typename T = double, typename B>
+inline std::array<T, Dim> position_of(const B& body) {
+    if constexpr (Dim == 3) return {static_cast<T>(body.x), static_cast<T>(body.y), static_cast<T>(body.z)};
+    else return {static_cast<T>(body.x), static_cast<T>(body.y)};
+}
+
+// typ składowych ciała: double dla Body i BodySystem, float dla BodySystemF
+template <typename B>
+using coordinate_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<const B&>().x)>>;
+
+#endif // OCTANT_H
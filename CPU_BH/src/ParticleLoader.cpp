@@ -0,0 +1,537 @@
+#include "ParticleLoader.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <vector>
+#include <omp.h>
+#include "Trajectory.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PARTICLE_LOADER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// kolumny wczytywanego ciała, w kolejności plików .bin i CSV bez nagłówka
+enum ParticleColumn { COL_X, COL_Y, COL_Z, COL_VX, COL_VY, COL_VZ, COL_MASS, PARTICLE_COLUMNS };
+
+// plik zmapowany do pamięci tylko do odczytu; bez mmap (Windows) wczytywany w całości
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+#ifdef PARTICLE_LOADER_MMAP
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            length = static_cast<std::size_t>(info.st_size);
+            opened = true;
+            if (length > 0) {
+                void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) {
+                    opened = false;
+                    length = 0;
+                }
+                else {
+                    // każdy wątek czyta swój fragment po kolei - większy odczyt z wyprzedzeniem
+                    madvise(address, length, MADV_SEQUENTIAL);
+                    mapping = static_cast<const char*>(address);
+                }
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        if (!in) return;
+        buffer.resize(static_cast<std::size_t>(in.tellg()));
+        in.seekg(0);
+        opened = static_cast<bool>(in.read(buffer.data(), buffer.size()));
+        mapping = buffer.data();
+        length = buffer.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef PARTICLE_LOADER_MMAP
+        if (mapping) munmap(const_cast<char*>(mapping), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return mapping; }
+    std::size_t size() const { return length; }
+
+private:
+    const char* mapping = nullptr;
+    std::size_t length = 0;
+    bool opened = false;
+#ifndef PARTICLE_LOADER_MMAP
+    std::vector<char> buffer;
+#endif
+};
+
+ParticleFormat particle_format_for(const std::string& filename) {
+    auto endsWith = [&](const char* suffix) {
+        const std::size_t length = std::strlen(suffix);
+        return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+    };
+    if (endsWith(".bin")) return ParticleFormat::Binary;
+    if (endsWith(".nbt")) return ParticleFormat::Trajectory;
+    if (endsWith(".json") || endsWith(".ndjson") || endsWith(".jsonl")) return ParticleFormat::Json;
+    return ParticleFormat::Csv;
+}
+
+// liczba fragmentów parsowanych równolegle: po jednym na wątek, nie mniejszych niż 1 MB
+static int chunk_count(std::size_t bytes, int requested) {
+    if (requested > 0) return requested;
+    const std::size_t bySize = bytes / (std::size_t(1) << 20) + 1;
+    return static_cast<int>(std::min<std::size_t>(omp_get_max_threads(), bySize));
+}
+
+// granice fragmentów [begin, end); `find(p)` zwraca pierwszy początek rekordu nie wcześniejszy niż p
+template <typename Find>
+static std::vector<const char*> split_chunks(const char* begin, const char* end, int chunks, Find find) {
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = begin;
+    const std::size_t size = static_cast<std::size_t>(end - begin);
+    for (int c = 1; c < chunks; ++c) {
+        bounds[c] = std::max(bounds[c - 1], find(begin + size / chunks * c));
+    }
+    return bounds;
+}
+
+// pozycje kolejnych ciał we fragmentach - sumy prefiksowe liczników z pierwszego przebiegu
+static std::vector<std::size_t> chunk_offsets(const std::vector<std::size_t>& counts) {
+    std::vector<std::size_t> offsets(counts.size() + 1, 0);
+    for (std::size_t c = 0; c < counts.size(); ++c) offsets[c + 1] = offsets[c] + counts[c];
+    return offsets;
+}
+
+template <typename Real>
+static void store_body(BodySystemT<Real>& bodies, std::size_t i, const double values[PARTICLE_COLUMNS]) {
+    bodies.x[i] = static_cast<Real>(values[COL_X]);
+    bodies.y[i] = static_cast<Real>(values[COL_Y]);
+    bodies.z[i] = static_cast<Real>(values[COL_Z]);
+    bodies.vx[i] = static_cast<Real>(values[COL_VX]);
+    bodies.vy[i] = static_cast<Real>(values[COL_VY]);
+    bodies.vz[i] = static_cast<Real>(values[COL_VZ]);
+    bodies.mass[i] = static_cast<Real>(values[COL_MASS]);
+}
+
+// pierwszy błąd (najwcześniejszy fragment) z numerem linii liczonym dopiero teraz, szeregowo
+static bool report_error(const std::string& filename, const char* data, const std::vector<const char*>& errors,
+                         const char* what) {
+    for (const char* error : errors) {
+        if (!error) continue;
+        const std::size_t line = 1 + std::count(data, error, '\n');
+        std::cerr << "Blad: " << filename << ":" << line << ": " << what << "\n";
+        return false;
+    }
+    return true;
+}
+
+// liczba od p; from_chars nie przyjmuje '+' przed liczbą
+static bool parse_number(const char*& p, const char* end, double& value) {
+    if (p < end && *p == '+') ++p;
+    const std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+// --- CSV ---
+
+static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static bool is_separator(char c) { return c == ',' || c == ';' || is_blank(c); }
+
+static const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) ++p;
+    return p;
+}
+
+static const char* line_end(const char* p, const char* end) {
+    if (p >= end) return end;
+    const void* newline = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+    return newline ? static_cast<const char*>(newline) : end;
+}
+
+// linia z danymi: niepusta i nie komentarz
+static bool is_data_line(const char* p, const char* end) {
+    p = skip_blanks(p, end);
+    return p < end && *p != '#';
+}
+
+// pola pierwszej linii (nagłówka albo danych) rozdzielone separatorami
+static std::vector<std::string_view> split_fields(const char* p, const char* end) {
+    std::vector<std::string_view> fields;
+    while (true) {
+        while (p < end && is_separator(*p)) ++p;
+        if (p >= end) return fields;
+        const char* start = p;
+        while (p < end && !is_separator(*p)) ++p;
+        fields.emplace_back(start, static_cast<std::size_t>(p - start));
+    }
+}
+
+static int csv_column(std::string_view name) {
+    std::string key;
+    for (char c : name) {
+        if (c != '"' && c != '\'') key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    static const char* const names[] = {"x", "y", "z", "vx", "vy", "vz", "mass"};
+    for (int column = 0; column < PARTICLE_COLUMNS; ++column) {
+        if (key == names[column]) return column;
+    }
+    return key == "m" ? COL_MASS : -1;
+}
+
+// pola linii CSV do values według `layout` (pole -> kolumna, -1 - pomijane); kolumn spoza layoutu nie zmienia
+static bool parse_csv_line(const char* p, const char* end, const std::vector<int>& layout,
+                           double values[PARTICLE_COLUMNS]) {
+    for (std::size_t field = 0; field < layout.size(); ++field) {
+        p = skip_blanks(p, end);
+        if (field > 0 && p < end && (*p == ',' || *p == ';')) p = skip_blanks(p + 1, end);
+        if (layout[field] < 0) {
+            while (p < end && !is_separator(*p)) ++p;
+        }
+        else if (!parse_number(p, end, values[layout[field]])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Real>
+static bool load_csv(const std::string& filename, const char* data, std::size_t size, BodySystemT<Real>& bodies,
+                     int chunks) {
+    const char* end = data + size;
+
+    // nagłówek: pierwsza linia z danymi, której pierwsze pole nie jest liczbą
+    const char* first = data;
+    while (first < end && !is_data_line(first, line_end(first, end))) first = std::min(line_end(first, end) + 1, end);
+    const char* firstEnd = line_end(first, end);
+    const std::vector<std::string_view> fields = split_fields(first, firstEnd);
+    double probe;
+    const char* probeStart = fields.empty() ? end : fields[0].data();
+    const bool header = !fields.empty() && !(parse_number(probeStart, end, probe) &&
+                                             probeStart == fields[0].data() + fields[0].size());
+
+    std::vector<int> layout;
+    if (header) {
+        for (std::string_view name : fields) layout.push_back(csv_column(name));
+        auto has = [&](int column) { return std::find(layout.begin(), layout.end(), column) != layout.end(); };
+        if (!has(COL_X) || !has(COL_Y) || !has(COL_MASS)) {
+            std::cerr << "Blad: " << filename << ": naglowek CSV musi zawierac kolumny x, y i mass\n";
+            return false;
+        }
+    }
+    else if (fields.size() == 7) {
+        layout = {COL_X, COL_Y, COL_Z, COL_VX, COL_VY, COL_VZ, COL_MASS};
+    }
+    else if (fields.size() == 4) {
+        layout = {COL_X, COL_Y, COL_Z, COL_MASS};
+    }
+    else if (!fields.empty()) {
+        std::cerr << "Blad: " << filename << ": CSV bez naglowka musi miec 7 kolumn (x, y, z, vx, vy, vz, mass)"
+            << " albo 4 (x, y, z, mass), a ma " << fields.size() << "\n";
+        return false;
+    }
+    const char* begin = header ? std::min(firstEnd + 1, end) : data;
+
+    chunks = chunk_count(static_cast<std::size_t>(end - begin), chunks);
+    const std::vector<const char*> bounds = split_chunks(begin, end, chunks, [&](const char* p) {
+        return p == begin || p[-1] == '\n' ? p : std::min(line_end(p, end) + 1, end);
+    });
+
+    std::vector<std::size_t> counts(chunks, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; ++c) {
+        std::size_t count = 0;
+        for (const char* p = bounds[c]; p < bounds[c + 1];) {
+            const char* e = line_end(p, end);
+            if (is_data_line(p, e)) ++count;
+            p = e < end ? e + 1 : end;
+        }
+        counts[c] = count;
+    }
+    const std::vector<std::size_t> offsets = chunk_offsets(counts);
+    bodies.resize(offsets.back());
+
+    std::vector<const char*> errors(chunks, nullptr);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; ++c) {
+        std::size_t i = offsets[c];
+        for (const char* p = bounds[c]; p < bounds[c + 1];) {
+            const char* e = line_end(p, end);
+            if (is_data_line(p, e)) {
+                double values[PARTICLE_COLUMNS] = {};
+                if (!parse_csv_line(p, e, layout, values)) {
+                    errors[c] = p;
+                    break;
+                }
+                store_body(bodies, i++, values);
+            }
+            p = e < end ? e + 1 : end;
+        }
+    }
+    return report_error(filename, data, errors, "niepoprawna liczba albo za malo kolumn");
+}
+
+// --- JSON ---
+
+static bool is_json_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+static const char* skip_json_space(const char* p, const char* end) {
+    while (p < end && is_json_space(*p)) ++p;
+    return p;
+}
+
+// '{' otwiera obiekt ciała, gdy poprzedza go (z pominięciem białych znaków) przecinek albo początek tablicy -
+// wewnątrz ciała nawias klamrowy stoi zawsze po dwukropku
+static bool is_body_start(const char* p, const char* arrayBegin) {
+    while (p > arrayBegin && is_json_space(p[-1])) --p;
+    return p == arrayBegin || p[-1] == ',';
+}
+
+static const char* next_body(const char* p, const char* arrayBegin, const char* arrayEnd) {
+    while (p < arrayEnd) {
+        const void* brace = std::memchr(p, '{', static_cast<std::size_t>(arrayEnd - p));
+        if (!brace) return arrayEnd;
+        p = static_cast<const char*>(brace);
+        if (is_body_start(p, arrayBegin)) return p;
+        ++p;
+    }
+    return arrayEnd;
+}
+
+// klucz "nazwa" z dwukropkiem; p ustawiany na wartość
+static bool parse_json_key(const char*& p, const char* end, std::string_view& key) {
+    p = skip_json_space(p, end);
+    if (p >= end || *p != '"') return false;
+    const void* quote = std::memchr(p + 1, '"', static_cast<std::size_t>(end - p - 1));
+    if (!quote) return false;
+    key = std::string_view(p + 1, static_cast<std::size_t>(static_cast<const char*>(quote) - p - 1));
+    p = skip_json_space(static_cast<const char*>(quote) + 1, end);
+    if (p >= end || *p != ':') return false;
+    p = skip_json_space(p + 1, end);
+    return true;
+}
+
+// liczba albo null - tak zapisywane są wartości nieskończone i NaN
+static bool parse_json_number(const char*& p, const char* end, double& value) {
+    if (end - p >= 4 && std::memcmp(p, "null", 4) == 0) {
+        value = std::numeric_limits<double>::quiet_NaN();
+        p += 4;
+        return true;
+    }
+    return parse_number(p, end, value);
+}
+
+// pomija dowolną wartość (napis, liczbę, literał, obiekt albo tablicę)
+static bool skip_json_value(const char*& p, const char* end) {
+    int depth = 0;
+    do {
+        if (p >= end) return false;
+        if (*p == '"') {
+            for (++p; p < end && *p != '"'; ++p) {
+                if (*p == '\\') ++p;
+            }
+            if (p >= end) return false;
+            ++p;
+        }
+        else if (*p == '{' || *p == '[') {
+            ++depth;
+            ++p;
+        }
+        else if (*p == '}' || *p == ']') {
+            if (depth == 0) return false;
+            --depth;
+            ++p;
+        }
+        else if (depth == 0) {
+            while (p < end && *p != ',' && *p != '}' && *p != ']' && !is_json_space(*p)) ++p;
+        }
+        else {
+            ++p;
+        }
+    } while (depth > 0);
+    return true;
+}
+
+// obiekt {"klucz": wartość, ...}; `field(key, p)` wczytuje wartość klucza i zwraca false przy błędzie
+template <typename Field>
+static bool parse_json_object(const char*& p, const char* end, Field field) {
+    p = skip_json_space(p, end);
+    if (p >= end || *p != '{') return false;
+    p = skip_json_space(p + 1, end);
+    if (p < end && *p == '}') {
+        ++p;
+        return true;
+    }
+    while (true) {
+        std::string_view key;
+        if (!parse_json_key(p, end, key) || !field(key, p)) return false;
+        p = skip_json_space(p, end);
+        if (p >= end) return false;
+        if (*p == '}') {
+            ++p;
+            return true;
+        }
+        if (*p != ',') return false;
+        ++p;
+    }
+}
+
+static bool parse_json_vector(const char*& p, const char* end, double* values) {
+    return parse_json_object(p, end, [&](std::string_view key, const char*& value) {
+        if (key.size() == 1 && key[0] >= 'x' && key[0] <= 'z') return parse_json_number(value, end, values[key[0] - 'x']);
+        return skip_json_value(value, end);
+    });
+}
+
+// ciało w układzie cpu-proj ("position", "velocity", "mass") albo GPU ("p", "v", "m"); pozycja i masa są wymagane
+static bool parse_json_body(const char*& p, const char* end, double values[PARTICLE_COLUMNS]) {
+    bool position = false, mass = false;
+    const bool ok = parse_json_object(p, end, [&](std::string_view key, const char*& value) {
+        if (key == "position" || key == "p") return position = parse_json_vector(value, end, values + COL_X);
+        if (key == "velocity" || key == "v") return parse_json_vector(value, end, values + COL_VX);
+        if (key == "mass" || key == "m") return mass = parse_json_number(value, end, values[COL_MASS]);
+        return skip_json_value(value, end);
+    });
+    return ok && position && mass;
+}
+
+// początek ostatniego klucza "bodies" - szukany od końca blokami po 16 MB; w bloku find() przeskakuje memchr
+// do rzadkiej w zapisie liczb litery 'b' zamiast porównywać każdy bajt jak rfind()
+static const char* find_last_bodies_key(const char* data, std::size_t size) {
+    const std::string_view key = "bodies\"";
+    const std::size_t BLOCK = std::size_t(1) << 24;
+    for (std::size_t hi = size; hi > 0;) {
+        const std::size_t lo = hi > BLOCK ? hi - BLOCK : 0;
+        const std::string_view block(data + lo, std::min(size, hi + key.size()) - lo);
+        const char* found = nullptr;
+        for (std::size_t k = block.find(key); k != std::string_view::npos && k < hi - lo; k = block.find(key, k + 1)) {
+            if (lo + k > 0 && data[lo + k - 1] == '"') found = data + lo + k - 1;
+        }
+        if (found) return found;
+        hi = lo;
+    }
+    return nullptr;
+}
+
+template <typename Real>
+static bool load_json(const std::string& filename, const char* data, std::size_t size, BodySystemT<Real>& bodies,
+                      int chunks) {
+    const char* end = data + size;
+
+    // tablica "bodies" ostatniej klatki - tablica JSON klatek i NDJSON kończą się ostatnią klatką
+    const char* key = find_last_bodies_key(data, size);
+    const char* p = key ? skip_json_space(key + 8, end) : end;
+    if (p < end && *p == ':') p = skip_json_space(p + 1, end);
+    if (p >= end || *p != '[') {
+        std::cerr << "Blad: " << filename << ": brak tablicy \"bodies\"\n";
+        return false;
+    }
+    const char* arrayBegin = p + 1;
+    // ciała nie zawierają tablic, więc pierwszy ']' zamyka tablicę ciał
+    const void* close = std::memchr(arrayBegin, ']', static_cast<std::size_t>(end - arrayBegin));
+    if (!close) {
+        std::cerr << "Blad: " << filename << ": niekompletna ostatnia klatka\n";
+        return false;
+    }
+    const char* arrayEnd = static_cast<const char*>(close);
+
+    chunks = chunk_count(static_cast<std::size_t>(arrayEnd - arrayBegin), chunks);
+    const std::vector<const char*> bounds = split_chunks(arrayBegin, arrayEnd, chunks, [&](const char* q) {
+        return next_body(q, arrayBegin, arrayEnd);
+    });
+
+    std::vector<std::size_t> counts(chunks, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; ++c) {
+        std::size_t count = 0;
+        for (const char* q = next_body(bounds[c], arrayBegin, arrayEnd); q < bounds[c + 1];
+             q = next_body(q + 1, arrayBegin, arrayEnd)) {
+            ++count;
+        }
+        counts[c] = count;
+    }
+    const std::vector<std::size_t> offsets = chunk_offsets(counts);
+    bodies.resize(offsets.back());
+
+    std::vector<const char*> errors(chunks, nullptr);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; ++c) {
+        std::size_t i = offsets[c];
+        for (const char* q = next_body(bounds[c], arrayBegin, arrayEnd); q < bounds[c + 1];
+             q = next_body(q, arrayBegin, arrayEnd)) {
+            const char* body = q;
+            double values[PARTICLE_COLUMNS] = {};
+            if (!parse_json_body(q, arrayEnd, values)) {
+                errors[c] = body;
+                break;
+            }
+            store_body(bodies, i++, values);
+        }
+    }
+    return report_error(filename, data, errors, "niepoprawny obiekt ciala (wymagane position/p i mass/m)");
+}
+
+// --- binarne ---
+
+template <typename Real>
+static bool load_binary(const std::string& filename, const char* data, std::size_t size, BodySystemT<Real>& bodies) {
+    const std::size_t record = PARTICLE_COLUMNS * sizeof(double);
+    if (size % record != 0) {
+        std::cerr << "Blad: " << filename << ": rozmiar pliku nie jest wielokrotnoscia " << record << " B\n";
+        return false;
+    }
+    const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(size / record);
+    bodies.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (std::ptrdiff_t i = 0; i < n; ++i) {
+        double values[PARTICLE_COLUMNS];
+        std::memcpy(values, data + i * record, record);
+        store_body(bodies, i, values);
+    }
+    return true;
+}
+
+template <typename Real>
+bool load_particles(const std::string& filename, BodySystemT<Real>& bodies, int chunks) {
+    const ParticleFormat format = particle_format_for(filename);
+    bool ok;
+    if (format == ParticleFormat::Trajectory) {
+        ok = read_trajectory_frame(filename, TRAJ_LAST_FRAME, bodies);
+        if (!ok) std::cerr << "Blad: nie mozna odczytac ostatniej klatki trajektorii " << filename << "\n";
+        for (auto* array : {&bodies.ax, &bodies.ay, &bodies.az}) std::fill(array->begin(), array->end(), Real(0));
+    }
+    else {
+        MappedFile file(filename);
+        if (!file.isOpen()) {
+            std::cerr << "Blad: nie mozna otworzyc pliku " << filename << "\n";
+            return false;
+        }
+        if (format == ParticleFormat::Binary) ok = load_binary(filename, file.data(), file.size(), bodies);
+        else if (format == ParticleFormat::Json) ok = load_json(filename, file.data(), file.size(), bodies, chunks);
+        else ok = load_csv(filename, file.data(), file.size(), bodies, chunks);
+    }
+    if (ok && bodies.empty()) {
+        std::cerr << "Blad: plik " << filename << " nie zawiera cial\n";
+        ok = false;
+    }
+    return ok;
+}
+
+template bool load_particles(const std::string&, BodySystem&, int);
+template bool load_particles(const std::string&, BodySystemF&, int);
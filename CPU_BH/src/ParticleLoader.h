@@ -0,0 +1,30 @@
+#ifndef PARTICLELOADER_H
+#define PARTICLELOADER_H
+
+#include <string>
+#include "BodySystem.h"
+
+// Ciała początkowe z pliku, format wybierany po rozszerzeniu:
+//   .csv, .txt  - jedno ciało na linię, liczby oddzielone przecinkiem, średnikiem, spacją albo tabulatorem.
+//                 Pierwsza linia może być nagłówkiem z nazwami kolumn (x, y, z, vx, vy, vz, mass albo m; pozostałe
+//                 kolumny są pomijane, brakujące z i prędkości są zerami). Bez nagłówka 7 kolumn to
+//                 x, y, z, vx, vy, vz, mass, a 4 - x, y, z, mass. Linie zaczynające się od '#' to komentarze.
+//   .bin        - surowe rekordy po 7 liczb float64 little-endian w kolejności x, y, z, vx, vy, vz, mass
+//                 (np. tablica numpy o kształcie (N, 7) zapisana przez tofile())
+//   .json, .ndjson, .jsonl - ostatnia klatka zapisu symulacji {"bodies": [...]}; ciało to
+//                 {"position" | "p": {x, y, z}, "velocity" | "v": {...}, "mass" | "m": ...} - układ cpu-proj,
+//                 GPU_BH i GPU_2_pair, więc przebieg może zacząć się od klatki innego programu
+//   .nbt        - ostatnia klatka trajektorii binarnej (Trajectory.h)
+// Pliki tekstowe są mapowane do pamięci i dzielone na tyle fragmentów, ile jest wątków; granica fragmentu
+// przesuwana jest do początku linii (CSV) albo obiektu ciała (JSON). Pierwszy przebieg liczy ciała we
+// fragmentach, drugi parsuje je std::from_chars prosto na ich miejsca w tablicach SoA.
+enum class ParticleFormat { Csv, Binary, Json, Trajectory };
+
+ParticleFormat particle_format_for(const std::string& filename);
+
+// Zwraca false i wypisuje przyczynę (z numerem linii) na std::cerr. `chunks` - liczba fragmentów
+// parsowanych równolegle (0 - po jednym na wątek, ale nie mniejszych niż 1 MB).
+template <typename Real>
+bool load_particles(const std::string& filename, BodySystemT<Real>& bodies, int chunks = 0);
+
+#endif // PARTICLELOADER_H
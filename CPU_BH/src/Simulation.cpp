@@ -1,11 +1,19 @@
 ﻿#include "Simulation.h"
+#include "Gravity.h"
+#include "GroupWalk.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <cmath>
 #include <iomanip>
 #include <omp.h>
+#include <string>
 
-const double G = 6.67430e-11;
-const double dt = 0.01; // krok czasowy
+const double dt = TIME_STEP;
 
 // aktualizuje pozycję i prędkość ciała metodą Leapfrog, biorąc pod uwagę siły
 void update_body_leapfrog(Body& body, double fx, double fy, double fz) {
@@ -30,64 +38,345 @@ void update_body_leapfrog(Body& body, double fx, double fy, double fz) {
     body.vz += body.az * dt * 0.5;
 }
 
+// Wersja SoA update_body_leapfrog dla wszystkich ciał naraz - te same działania w tej samej kolejności, ale
+// na wyrównanych tablicach składowych, więc pętla jest wektoryzowana. Dla float wyrażenia liczone są w double
+// (siły są w double), a zaokrąglane dopiero przy zapisie.
+template <typename Real>
+void update_bodies_leapfrog(BodySystemT<Real>& bodies, const std::vector<double>& fx, const std::vector<double>& fy,
+                            const std::vector<double>& fz) {
+    const int n = static_cast<int>(bodies.size());
+    const Real* __restrict mass = bodies.mass.data();
+    Real* __restrict x = bodies.x.data();
+    Real* __restrict y = bodies.y.data();
+    Real* __restrict z = bodies.z.data();
+    Real* __restrict vx = bodies.vx.data();
+    Real* __restrict vy = bodies.vy.data();
+    Real* __restrict vz = bodies.vz.data();
+    Real* __restrict ax = bodies.ax.data();
+    Real* __restrict ay = bodies.ay.data();
+    Real* __restrict az = bodies.az.data();
+    const double* __restrict fxs = fx.data();
+    const double* __restrict fys = fy.data();
+    const double* __restrict fzs = fz.data();
+
+    #pragma omp parallel for simd aligned(mass, x, y, z, vx, vy, vz, ax, ay, az: 64)
+    for (int i = 0; i < n; ++i) {
+        ax[i] = fxs[i] / mass[i];
+        ay[i] = fys[i] / mass[i];
+        az[i] = fzs[i] / mass[i];
+        vx[i] += ax[i] * dt * 0.5;
+        vy[i] += ay[i] * dt * 0.5;
+        vz[i] += az[i] * dt * 0.5;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+        vx[i] += ax[i] * dt * 0.5;
+        vy[i] += ay[i] * dt * 0.5;
+        vz[i] += az[i] * dt * 0.5;
+    }
+}
+
 // pojedynyczy krok symulacyjny
 void simulate_step(std::vector<Body>& bodies) {
-    BHTreeNode root = build_bhtree(bodies);
+    static SimulationContext context;
+    simulate_step(bodies, context);
+}
 
-    // obliczanie siły na każde ciało równolegle
-    #pragma omp parallel for 
-    for (int i = 0; i < bodies.size(); ++i) {
-        double fx = 0.0, fy = 0.0, fz = 0.0;
-        root.calculateForce(bodies[i], fx, fy, fz);
-        update_body_leapfrog(bodies[i], fx, fy, fz);
+// drzewo dla bieżących pozycji: refit drzewa z poprzedniego wywołania albo pełna budowa
+template <typename Bodies, typename Real, int Dim>
+static void prepare_tree(const Bodies& bodies, SimulationContextT<Real, Dim>& context) {
+    const SimulationOptions& options = context.options;
+    BHTreeT<Real, Dim>& tree = context.tree;
+    // refit jest możliwy tylko dla drzewa z poprzedniego kroku o tym samym rzędzie momentów i pojemności liści
+    const bool reuse = options.refit && tree.multipoleOrder == options.multipoleOrder
+        && tree.leafSize == options.leafSize;
+    tree.multipoleOrder = options.multipoleOrder;
+    tree.leafSize = options.leafSize;
+    if (reuse && tree.refit(bodies, options.maxMigrated)) {
+        ++context.refits;
+    }
+    else {
+        build_bhtree(bodies, tree);
+        ++context.rebuilds;
+    }
+    if (options.solver == SolverType::BarnesHut && options.traversal != TraversalMode::Recursive) {
+        tree.flatten();
     }
 }
 
-void calculate_total_energy(const std::vector<Body>& bodies) {
-    double kinetic_total = 0.0;
-    double potential_total = 0.0;
+// siły na ciała z listy `active` albo na wszystkie ciała (active == nullptr). FMM i przejście grupowe liczą
+// zawsze siły na wszystkie ciała; dla podzbioru ciał każde ciało przechodzi drzewo osobno. Oba są tylko
+// trójwymiarowe - w 2D parse_simulation_options() ich nie dopuszcza.
+template <typename Bodies, typename Real, int Dim>
+static void compute_forces(const Bodies& bodies, SimulationContextT<Real, Dim>& context,
+                           const std::vector<uint32_t>* active) {
+    const SimulationOptions& options = context.options;
+    const BHTreeT<Real, Dim>& tree = context.tree;
+    int n = static_cast<int>(bodies.size());
+    context.fx.resize(n);
+    context.fy.resize(n);
+    context.fz.resize(n);
 
-    // Energia kinetyczna
-    for (const auto& body : bodies) {
-        double speed_sq = body.vx * body.vx + body.vy * body.vy + body.vz * body.vz;
-        kinetic_total += 0.5 * body.mass * speed_sq;
+    bool done = false;
+    if constexpr (Dim == 3) {
+        if (options.solver == SolverType::FMM) {
+            if (context.fmm.order() != options.fmmOrder) context.fmm.setOrder(options.fmmOrder);
+            context.fmm.theta = options.fmmTheta;
+            context.fmm.computeForces(tree, bodies, context.fx, context.fy, context.fz);
+            done = true;
+        }
+        else if (options.traversal == TraversalMode::Grouped && !active) {
+            compute_forces_grouped(tree, bodies, options.theta, options.groupSize, context.fx, context.fy,
+                                   context.fz);
+            done = true;
+        }
+    }
+    if (!done) {
+        // obliczanie siły na każde ciało równolegle; liście drzewa wskazują na `bodies`,
+        // więc pozycje są aktualizowane dopiero po obliczeniu wszystkich sił. Ciała odwiedzane są
+        // w kolejności Mortona - sąsiednie iteracje przechodzą te same gałęzie drzewa.
+        const uint32_t* targets = active ? active->data() : tree.order.data();
+        const int count = active ? static_cast<int>(active->size()) : n;
+        const bool stackless = options.traversal != TraversalMode::Recursive;
+
+        #pragma omp parallel for
+        for (int k = 0; k < count; ++k) {
+            const uint32_t i = targets[k];
+            double fx = 0.0, fy = 0.0, fz = 0.0;
+            if (stackless) {
+                tree.calculateForceStackless(bodies, i, fx, fy, fz, options.theta);
+            }
+            else {
+                tree.calculateForce(bodies, i, fx, fy, fz, options.theta);
+            }
+            context.fx[i] = fx;
+            context.fy[i] = fy;
+            context.fz[i] = fz;
+        }
+    }
+    const bool subset = active && options.solver != SolverType::FMM;
+    context.forceEvaluations += subset ? active->size() : bodies.size();
+}
+
+// poziom kroku czasowego: najmniejsze l, dla którego dt / 2^l nie przekracza eta * |a| / |da/dt|
+static int timestep_level(double acceleration, double jerk, double eta, int maxLevel) {
+    int level = 0;
+    if (jerk > 0.0) {
+        const double step = eta * acceleration / jerk;
+        while (level < maxLevel && dt / (1u << level) > step) ++level;
+    }
+    return level;
+}
+
+// Krok dt podzielony na 2^L podkroków (schemat KDK z hierarchicznymi krokami). Ciało na poziomie l dostaje
+// połowę kopnięcia na początku i na końcu swojego kroku dt / 2^l, a wszystkie ciała dryfują w każdym
+// podkroku - pozycje ciał nieaktywnych są więc przewidywane liniowo na potrzeby budowy drzewa. Siły liczone są
+// tylko dla ciał kończących krok; poziom wybierany jest ze zmiany przyspieszenia (|da/dt|) i może zmaleć tylko
+// wtedy, gdy bieżący podkrok jest wyrównany do dłuższego kroku.
+template <typename Bodies, typename Real, int Dim>
+static void simulate_block_step(Bodies& bodies, SimulationContextT<Real, Dim>& context) {
+    const SimulationOptions& options = context.options;
+    const int n = static_cast<int>(bodies.size());
+    const int maxLevel = std::min(options.timestepLevels, MAX_TIMESTEP_LEVELS);
+    const uint32_t ticks = 1u << maxLevel;
+    const double tick = dt / ticks;
+    std::vector<int>& levels = context.levels;
+
+    if (levels.size() != bodies.size()) {                   // pierwszy krok: przyspieszenia wszystkich ciał
+        prepare_tree(bodies, context);
+        compute_forces(bodies, context, nullptr);
+        levels.assign(n, maxLevel);
+        #pragma omp parallel for
+        for (int i = 0; i < n; ++i) {
+            bodies[i].ax = context.fx[i] / bodies[i].mass;
+            bodies[i].ay = context.fy[i] / bodies[i].mass;
+            bodies[i].az = context.fz[i] / bodies[i].mass;
+        }
     }
 
-    // Energia potencjalna
-    for (size_t i = 0; i < bodies.size(); ++i) {
-        for (size_t j = i + 1; j < bodies.size(); ++j) {
-            double dx = bodies[i].x - bodies[j].x;
-            double dy = bodies[i].y - bodies[j].y;
-            double dz = bodies[i].z - bodies[j].z;
-            double dist = std::sqrt(dx * dx + dy * dy + dz * dz);
-            potential_total -= G * bodies[i].mass * bodies[j].mass / dist;
+    for (uint32_t t = 0; t < ticks; ++t) {
+        // pierwsza połowa kopnięcia ciał zaczynających krok i dryf wszystkich ciał
+        int ending = 0;
+        #pragma omp parallel for reduction(+: ending)
+        for (int i = 0; i < n; ++i) {
+            auto&& body = bodies[i];
+            const uint32_t stride = 1u << (maxLevel - std::min(levels[i], maxLevel));
+            if (t % stride == 0) {
+                const double half = 0.5 * stride * tick;
+                body.vx += body.ax * half;
+                body.vy += body.ay * half;
+                body.vz += body.az * half;
+            }
+            body.x += body.vx * tick;
+            body.y += body.vy * tick;
+            body.z += body.vz * tick;
+            if ((t + 1) % stride == 0) ++ending;
+        }
+        if (ending == 0) continue;
+
+        prepare_tree(bodies, context);
+        context.active.clear();
+        for (uint32_t i : context.tree.order) {
+            const uint32_t stride = 1u << (maxLevel - std::min(levels[i], maxLevel));
+            if ((t + 1) % stride == 0) context.active.push_back(i);
+        }
+        compute_forces(bodies, context, &context.active);
+
+        // druga połowa kopnięcia nowym przyspieszeniem i wybór następnego poziomu
+        const int count = static_cast<int>(context.active.size());
+        #pragma omp parallel for
+        for (int k = 0; k < count; ++k) {
+            const uint32_t i = context.active[k];
+            auto&& body = bodies[i];
+            const uint32_t stride = 1u << (maxLevel - std::min(levels[i], maxLevel));
+            const double step = stride * tick;
+            const double ax = context.fx[i] / body.mass, ay = context.fy[i] / body.mass, az = context.fz[i] / body.mass;
+            const double jx = ax - body.ax, jy = ay - body.ay, jz = az - body.az;
+            body.vx += ax * step * 0.5;
+            body.vy += ay * step * 0.5;
+            body.vz += az * step * 0.5;
+            body.ax = ax;
+            body.ay = ay;
+            body.az = az;
+
+            int level = timestep_level(std::sqrt(ax * ax + ay * ay + az * az),
+                                       std::sqrt(jx * jx + jy * jy + jz * jz) / step, options.timestepEta, maxLevel);
+            while ((t + 1) % (1u << (maxLevel - level)) != 0) ++level;
+            levels[i] = level;
         }
     }
+}
+
+void simulate_step(std::vector<Body>& bodies, SimulationContext& context) {
+    if (context.options.timestepLevels > 0) {
+        simulate_block_step(bodies, context);
+        return;
+    }
+
+    prepare_tree(bodies, context);
+    compute_forces(bodies, context, nullptr);
+
+    int n = static_cast<int>(bodies.size());
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        update_body_leapfrog(bodies[i], context.fx[i], context.fy[i], context.fz[i]);
+    }
+}
+
+template <typename Real, int Dim>
+void simulate_step(BodySystemT<Real>& bodies, SimulationContextT<Real, Dim>& context) {
+    if (context.options.timestepLevels > 0) {
+        simulate_block_step(bodies, context);
+        return;
+    }
 
-    double total_energy = kinetic_total + potential_total;
-  //  std::cout << std::fixed << std::setprecision(10) << "Energia kinetyczna: " << kinetic_total << " J, Energia potencjalna: " << potential_total << " J, Calkowita energia: " << total_energy << " J\n";
+    prepare_tree(bodies, context);
+    compute_forces(bodies, context, nullptr);
+    update_bodies_leapfrog(bodies, context.fx, context.fy, context.fz);
 }
 
-// budowanie drzewa Barnes-Hut
-BHTreeNode build_bhtree(std::vector<Body>& bodies) {
+// region o środku w środku prostopadłościanu [low, high] i boku 1,5 razy dłuższym niż jego najdłuższa krawędź
+template <int Dim, typename Real>
+static Orthant<Dim> bounding_region(const Real* low, const Real* high) {
+    double world_size = 0.0;
+    std::array<double, Dim> center;
+    for (int d = 0; d < Dim; ++d) {
+        world_size = std::max<double>(world_size, high[d] - low[d]);
+        center[d] = (high[d] + low[d]) / 2.0;
+    }
+    return Orthant<Dim>(center, world_size * 1.5);
+}
+
+// wyznacza region obejmujący wszystkie ciała (w 2D współrzędna z jest pomijana)
+template <int Dim>
+Orthant<Dim> bounding_octant(const std::vector<Body>& bodies) {
     // znajdowanie minimalnych i maksymalnych wartości pozycji dla ograniczenia przestrzeni
     double minX = bodies[0].x, maxX = bodies[0].x;
     double minY = bodies[0].y, maxY = bodies[0].y;
     double minZ = bodies[0].z, maxZ = bodies[0].z;
+    const int n = static_cast<int>(bodies.size());
 
-    for (const auto& body : bodies) {
+    #pragma omp parallel for reduction(min: minX, minY, minZ) reduction(max: maxX, maxY, maxZ)
+    for (int i = 0; i < n; ++i) {
+        const Body& body = bodies[i];
         if (body.x < minX) minX = body.x;
         if (body.x > maxX) maxX = body.x;
         if (body.y < minY) minY = body.y;
         if (body.y > maxY) maxY = body.y;
-        if (body.z < minZ) minZ = body.z;
-        if (body.z > maxZ) maxZ = body.z;
+        if constexpr (Dim == 3) {
+            if (body.z < minZ) minZ = body.z;
+            if (body.z > maxZ) maxZ = body.z;
+        }
     }
 
-    // definiuje oktant o rozmiarze dostosowanym do przestrzeni
-    double world_size = std::max(std::max(maxX - minX, maxY - minY), maxZ - minZ);
-    Octant root_region((maxX + minX) / 2, (maxY + minY) / 2, (maxZ + minZ) / 2, world_size * 1.5);
-    BHTreeNode root(root_region);
+    // definiuje region o rozmiarze dostosowanym do przestrzeni
+    const double low[3] = {minX, minY, minZ}, high[3] = {maxX, maxY, maxZ};
+    return bounding_region<Dim>(low, high);
+}
+
+// wersja SoA: redukcja min/max po wyrównanych tablicach współrzędnych, wektoryzowana
+template <int Dim, typename Real>
+Orthant<Dim> bounding_octant(const BodySystemT<Real>& bodies) {
+    const int n = static_cast<int>(bodies.size());
+    const Real* __restrict x = bodies.x.data();
+    const Real* __restrict y = bodies.y.data();
+    const Real* __restrict z = bodies.z.data();
+    Real minX = x[0], maxX = x[0];
+    Real minY = y[0], maxY = y[0];
+    Real minZ = z[0], maxZ = z[0];
+
+    #pragma omp parallel for simd aligned(x, y, z: 64) reduction(min: minX, minY, minZ) reduction(max: maxX, maxY, maxZ)
+    for (int i = 0; i < n; ++i) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+        if constexpr (Dim == 3) {
+            minZ = std::min(minZ, z[i]);
+            maxZ = std::max(maxZ, z[i]);
+        }
+    }
+
+    const Real low[3] = {minX, minY, minZ}, high[3] = {maxX, maxY, maxZ};
+    return bounding_region<Dim>(low, high);
+}
+
+// budowanie drzewa Barnes-Hut w puli węzłów `tree` (pamięć z poprzedniego kroku jest używana ponownie);
+// drzewo powstaje równolegle z kluczy Mortona zamiast przez szeregowe wstawianie
+template <typename Bodies, typename Real, int Dim>
+void build_bhtree(const Bodies& bodies, BHTreeT<Real, Dim>& tree) {
+    if (bodies.empty()) {
+        tree.reset();
+        return;
+    }
+    tree.buildMorton(bodies, bounding_octant<Dim>(bodies));
+}
+
+template void update_bodies_leapfrog(BodySystem&, const std::vector<double>&, const std::vector<double>&,
+                                     const std::vector<double>&);
+template void update_bodies_leapfrog(BodySystemF&, const std::vector<double>&, const std::vector<double>&,
+                                     const std::vector<double>&);
+template Octant bounding_octant<3>(const std::vector<Body>&);
+template Quadrant bounding_octant<2>(const std::vector<Body>&);
+template Octant bounding_octant<3>(const BodySystem&);
+template Octant bounding_octant<3>(const BodySystemF&);
+template Quadrant bounding_octant<2>(const BodySystem&);
+template Quadrant bounding_octant<2>(const BodySystemF&);
+template void build_bhtree(const std::vector<Body>&, BHTree&);
+template void build_bhtree(const BodySystem&, BHTree&);
+template void build_bhtree(const BodySystemF&, BHTree&);
+template void build_bhtree(const BodySystemF&, BHTreeF&);
+template void build_bhtree(const std::vector<Body>&, QuadTree&);
+template void build_bhtree(const BodySystem&, QuadTree&);
+template void build_bhtree(const BodySystemF&, QuadTreeF&);
+template void simulate_step(BodySystem&, SimulationContextT<double, 3>&);
+template void simulate_step(BodySystemF&, SimulationContextT<float, 3>&);
+template void simulate_step(BodySystem&, SimulationContextT<double, 2>&);
+template void simulate_step(BodySystemF&, SimulationContextT<float, 2>&);
+
+// budowanie drzewa wskaźnikowego (BHTreeNode) - pozostawione do porównań z pulą węzłów
+BHTreeNode build_bhtree_legacy(const std::vector<Body>& bodies, int leafSize) {
+    BHTreeNode root(bounding_octant(bodies), leafSize);
 
     // wstawia każde ciało do drzewa
     for (const auto& body : bodies) {
@@ -96,3 +385,125 @@ BHTreeNode build_bhtree(std::vector<Body>& bodies) {
 
     return root;
 }
+
+// liczba całkowita z przedziału [min, max] zajmująca cały tekst; przy błędzie `value` się nie zmienia
+static bool parse_int_option(const std::string& text, int min, int max, int& value) {
+    int parsed = 0;
+    const char* end = text.data() + text.size();
+    auto [last, error] = std::from_chars(text.data(), end, parsed);
+    if (text.empty() || error != std::errc() || last != end || parsed < min || parsed > max) return false;
+    value = parsed;
+    return true;
+}
+
+// skończona liczba rzeczywista zajmująca cały tekst, nie mniejsza niż min (większa od min, gdy `exclusive`)
+static bool parse_double_option(const std::string& text, double min, bool exclusive, double& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    errno = 0;
+    const double parsed = std::strtod(text.c_str(), &end);
+    if (errno != 0 || end != text.c_str() + text.size() || !std::isfinite(parsed)) return false;
+    if (parsed < min || (exclusive && parsed == min)) return false;
+    value = parsed;
+    return true;
+}
+
+bool parse_simulation_options(int argc, char** argv, SimulationOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+
+        if (arg == "--traversal") {
+            if (value == "recursive") options.traversal = TraversalMode::Recursive;
+            else if (value == "stackless") options.traversal = TraversalMode::Stackless;
+            else if (value == "grouped") options.traversal = TraversalMode::Grouped;
+            else return false;
+            ++i;
+        }
+        else if (arg == "--group-size") {
+            if (!parse_int_option(value, 1, INT_MAX, options.groupSize)) return false;
+            ++i;
+        }
+        else if (arg == "--leaf-size") {
+            if (!parse_int_option(value, 1, INT_MAX, options.leafSize)) return false;
+            ++i;
+        }
+        else if (arg == "--multipole") {
+            if (value == "1") options.multipoleOrder = BHTree::MONOPOLE;
+            else if (value == "2") options.multipoleOrder = BHTree::QUADRUPOLE;
+            else return false;
+            ++i;
+        }
+        else if (arg == "--solver") {
+            if (value == "bh") options.solver = SolverType::BarnesHut;
+            else if (value == "fmm") options.solver = SolverType::FMM;
+            else return false;
+            ++i;
+        }
+        else if (arg == "--fmm-order") {
+            if (!parse_int_option(value, 1, FMMSolver::MAX_ORDER, options.fmmOrder)) return false;
+            ++i;
+        }
+        else if (arg == "--refit") {
+            options.refit = true;
+        }
+        else if (arg == "--max-migrated") {
+            if (!parse_double_option(value, 0.0, false, options.maxMigrated)) return false;
+            ++i;
+        }
+        else if (arg == "--block-levels") {
+            if (!parse_int_option(value, 0, MAX_TIMESTEP_LEVELS, options.timestepLevels)) return false;
+            ++i;
+        }
+        else if (arg == "--timestep-eta") {
+            if (!parse_double_option(value, 0.0, true, options.timestepEta)) return false;
+            ++i;
+        }
+        else if (arg == "--diagnostics-interval") {
+            if (!parse_int_option(value, 0, INT_MAX, options.diagnosticsInterval)) return false;
+            ++i;
+        }
+        else if (arg == "--diagnostics-theta") {
+            if (!parse_double_option(value, 0.0, false, options.diagnosticsTheta)) return false;
+            ++i;
+        }
+        else if (arg == "--precision") {
+            if (value == "double") options.precision = Precision::Double;
+            else if (value == "mixed") options.precision = Precision::Mixed;
+            else return false;
+            ++i;
+        }
+        else if (arg == "--dimensions") {
+            if (value == "2") options.dimensions = 2;
+            else if (value == "3") options.dimensions = 3;
+            else return false;
+            ++i;
+        }
+        else if (arg == "--output") {
+            if (value.empty()) return false;
+            options.trajectoryFile = value;
+            ++i;
+        }
+        else if (arg == "--input") {
+            if (value.empty()) return false;
+            options.inputFile = value;
+            ++i;
+        }
+        else if (arg == "--output-interval") {
+            if (!parse_int_option(value, 1, INT_MAX, options.trajectoryInterval)) return false;
+            ++i;
+        }
+        else if (arg == "--theta") {
+            if (!parse_double_option(value, 0.0, false, options.theta)) return false;
+            ++i;
+        }
+        else {
+            return false;
+        }
+    }
+    // FMM i przejście grupowe mają tylko wersje trójwymiarowe
+    if (options.dimensions == 2 && (options.solver == SolverType::FMM || options.traversal == TraversalMode::Grouped)) {
+        return false;
+    }
+    return true;
+}
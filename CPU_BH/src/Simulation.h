@@ -1,13 +1,101 @@
 ﻿#ifndef SIMULATION_H
 #define SIMULATION_H
 
+#include <string>
 #include <vector>
 #include "Body.h"
+#include "BodySystem.h"
+#include "BHTree.h"
 #include "BHTreeNode.h"
+#include "Diagnostics.h"
+#include "FMM.h"
+
+// sposób przechodzenia drzewa przy obliczaniu sił
+enum class TraversalMode {
+    Recursive,      // rekurencja po węzłach puli
+    Stackless,      // pętla po spłaszczonym drzewie z łączami `skip`
+    Grouped         // wspólna lista oddziaływań dla grup sąsiednich ciał (GroupWalk.h)
+};
+
+// metoda obliczania sił
+enum class SolverType {
+    BarnesHut,      // drzewo Barnes-Hut (sposób przejścia według TraversalMode)
+    FMM             // szybka metoda multipolowa (FMM.h)
+};
+
+// typ przechowywania ciał i drzewa
+enum class Precision {
+    Double,         // wszystko w double
+    Mixed           // ciała, momenty węzłów i pary w kernelach w float, sumy sił i energii w double
+};
+
+// parametry symulacji wybierane w czasie działania
+struct SimulationOptions {
+    TraversalMode traversal = TraversalMode::Stackless;
+    double theta = BHTree::DEFAULT_THETA;
+    int groupSize = 32;         // maksymalna liczba ciał w grupie (tryb Grouped)
+    int multipoleOrder = BHTree::MONOPOLE;
+    int leafSize = BHTree::DEFAULT_LEAF_SIZE;  // pojemność liścia drzewa K
+    SolverType solver = SolverType::BarnesHut;
+    int fmmOrder = FMMSolver::DEFAULT_ORDER;
+    double fmmTheta = FMMSolver::DEFAULT_THETA;
+    bool refit = false;         // aktualizacja drzewa z poprzedniego kroku zamiast budowy od zera
+    double maxMigrated = BHTree::DEFAULT_MAX_MIGRATED;
+    // liczba poziomów hierarchicznych kroków czasowych L (0 - wspólny krok dt); ciało na poziomie l ma krok dt / 2^l
+    int timestepLevels = 0;
+    double timestepEta = 0.05;  // krok ciała: eta * |a| / |da/dt|
+    int diagnosticsInterval = 10;   // co ile kroków liczona jest energia i pęd (0 - wcale)
+    double diagnosticsTheta = DiagnosticsMonitor::DEFAULT_THETA;
+    Precision precision = Precision::Double;    // wybór BodySystem / BodySystemF w main.cpp
+    // wymiar drzewa: 3 - drzewo ósemkowe, 2 - czwórkowe w płaszczyźnie xy dla układów płaskich (wybór w main.cpp;
+    // tylko solver Barnes-Hut z przejściem rekurencyjnym lub spłaszczonym)
+    int dimensions = 3;
+    std::string trajectoryFile;     // plik trajektorii binarnej .nbt (pusty - bez zapisu, Trajectory.h)
+    int trajectoryInterval = 1;     // co ile kroków zapisywana jest klatka trajektorii
+    std::string inputFile;          // plik z ciałami początkowymi (pusty - ciała z main.cpp, ParticleLoader.h)
+};
+
+static constexpr int MAX_TIMESTEP_LEVELS = 20;
+static constexpr double TIME_STEP = 0.01;   // krok czasowy dt
+
+// stan utrzymywany między krokami symulacji - pula drzewa i bufory sił nie są zwalniane; `Real` to typ
+// przechowywania drzewa (taki sam jak ciał), a `Dim` - jego wymiar
+template <typename Real, int Dim = 3>
+struct SimulationContextT {
+    SimulationOptions options;
+    BHTreeT<Real, Dim> tree;
+    FMMSolver fmm;
+    std::vector<double> fx, fy, fz;
+    size_t rebuilds = 0;        // liczba pełnych budów drzewa
+    size_t refits = 0;          // liczba kroków, w których wystarczył refit
+    size_t forceEvaluations = 0;    // liczba obliczeń siły na pojedyncze ciało
+    std::vector<int> levels;        // poziomy kroków czasowych ciał (tryb timestepLevels > 0)
+    std::vector<uint32_t> active;   // ciała kończące krok w bieżącym podkroku, w kolejności Mortona
+};
+using SimulationContext = SimulationContextT<double>;
+using SimulationContextF = SimulationContextT<float>;
 
 void simulate_step(std::vector<Body>& bodies);
+void simulate_step(std::vector<Body>& bodies, SimulationContext& context);
+// Krok dla ciał w układzie SoA - te same wyniki co dla std::vector<Body>, z wektoryzowanym całkowaniem. Dla
+// BodySystemF (mieszana precyzja) ciała i drzewo są w float, a siły w double; dla Dim = 2 siły liczone są
+// z drzewa czwórkowego w płaszczyźnie xy.
+template <typename Real, int Dim>
+void simulate_step(BodySystemT<Real>& bodies, SimulationContextT<Real, Dim>& context);
 void update_body_leapfrog(Body& body, double fx, double fy, double fz);
-void calculate_total_energy(const std::vector<Body>& bodies);
-BHTreeNode build_bhtree(std::vector<Body>& bodies);
+template <typename Real>
+void update_bodies_leapfrog(BodySystemT<Real>& bodies, const std::vector<double>& fx, const std::vector<double>& fy,
+                            const std::vector<double>& fz);
+// region obejmujący wszystkie ciała: oktant (Dim = 3) albo kwadrat w płaszczyźnie xy (Dim = 2)
+template <int Dim = 3>
+Orthant<Dim> bounding_octant(const std::vector<Body>& bodies);
+template <int Dim = 3, typename Real>
+Orthant<Dim> bounding_octant(const BodySystemT<Real>& bodies);
+// `bodies` to std::vector<Body>, BodySystem lub BodySystemF; drzewo float tylko dla BodySystemF
+template <typename Bodies, typename Real, int Dim>
+void build_bhtree(const Bodies& bodies, BHTreeT<Real, Dim>& tree);
+BHTreeNode build_bhtree_legacy(const std::vector<Body>& bodies, int leafSize = BHTreeNode::DEFAULT_LEAF_SIZE);
+// wczytuje opcje z argumentów wiersza poleceń (np. --traversal recursive); zwraca false przy błędzie
+bool parse_simulation_options(int argc, char** argv, SimulationOptions& options);
 
-#endif // SIMULATION_H
\ No newline at end of file
+#endif // SIMULATION_H
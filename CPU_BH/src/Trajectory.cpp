@@ -0,0 +1,181 @@
+#include "Trajectory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+static const char TRAJECTORY_MAGIC[8] = "NBTRAJ1";
+static const char TRAJECTORY_INDEX_MAGIC[8] = "NBTRIDX";
+static const int TRAJECTORY_COLUMNS = 10;
+
+// grupa pól, do której należy kolumna (kolejność x, y, z, vx, vy, vz, ax, ay, az, mass)
+static uint32_t column_field(int column) {
+    if (column < 3) return TRAJ_POSITIONS;
+    if (column < 6) return TRAJ_VELOCITIES;
+    if (column < 9) return TRAJ_ACCELERATIONS;
+    return TRAJ_MASSES;
+}
+
+// rozmiar klatki z nagłówkiem, dopełniony do 8 B
+static uint64_t frame_bytes(const TrajectoryFileHeader& header) {
+    uint64_t columns = 0;
+    for (int c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        if (header.fields & column_field(c)) ++columns;
+    }
+    const uint64_t data = columns * header.bodyCount * header.scalarBytes;
+    return sizeof(TrajectoryFrameHeader) + (data + 7) / 8 * 8;
+}
+
+// tablica BodySystemT (także const) odpowiadająca kolumnie pliku
+template <typename Bodies>
+static auto& column_array(Bodies& bodies, int column) {
+    switch (column) {
+    case 0: return bodies.x;
+    case 1: return bodies.y;
+    case 2: return bodies.z;
+    case 3: return bodies.vx;
+    case 4: return bodies.vy;
+    case 5: return bodies.vz;
+    case 6: return bodies.ax;
+    case 7: return bodies.ay;
+    case 8: return bodies.az;
+    default: return bodies.mass;
+    }
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+template <typename Real>
+bool TrajectoryWriter::open(const std::string& filename, std::size_t bodyCount, double dt, uint32_t fields) {
+    close();
+    offsets.clear();
+    header = TrajectoryFileHeader{};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.fields = fields & TRAJ_ALL_FIELDS;
+    header.scalarBytes = sizeof(Real);
+    header.headerBytes = sizeof(TrajectoryFileHeader);
+    header.bodyCount = bodyCount;
+    header.dt = dt;
+    std::strncpy(header.units, "m kg s", sizeof(header.units) - 1);
+
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file || std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::cerr << "Blad: nie mozna zapisac trajektorii do pliku " << filename << "\n";
+        if (file) std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+template <typename Real>
+bool TrajectoryWriter::sample(const BodySystemT<Real>& bodies, int step, double time) {
+    if (!file || interval <= 0 || step % interval != 0 || bodies.size() != header.bodyCount) return false;
+
+    TrajectoryFrameHeader frame{};
+    frame.step = step;
+    frame.time = time;
+    frame.timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+    offsets.push_back(sizeof(TrajectoryFileHeader) + offsets.size() * frame_bytes(header));
+    std::fwrite(&frame, sizeof(frame), 1, file);
+
+    // kolumny zapisywane są prosto z tablic SoA - bez kopiowania i konwersji
+    uint64_t written = 0;
+    for (int c = 0; c < TRAJECTORY_COLUMNS; ++c) {
+        if (!(header.fields & column_field(c))) continue;
+        std::fwrite(column_array(bodies, c).data(), sizeof(Real), bodies.size(), file);
+        written += sizeof(Real) * bodies.size();
+    }
+    static const char padding[8] = {};
+    std::fwrite(padding, 1, (8 - written % 8) % 8, file);
+    return true;
+}
+
+void TrajectoryWriter::close() {
+    if (!file) return;
+    TrajectoryTrailer trailer{};
+    trailer.frameCount = offsets.size();
+    trailer.indexOffset = sizeof(TrajectoryFileHeader) + offsets.size() * frame_bytes(header);
+    std::memcpy(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic));
+    std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file);
+    std::fwrite(&trailer, sizeof(trailer), 1, file);
+    std::fclose(file);
+    file = nullptr;
+}
+
+template <typename Real>
+bool read_trajectory_frame(const std::string& filename, std::size_t k, BodySystemT<Real>& bodies,
+                           TrajectoryFrameHeader* frame, TrajectoryFileHeader* header) {
+    std::FILE* in = std::fopen(filename.c_str(), "rb");
+    if (!in) return false;
+
+    TrajectoryFileHeader fileHeader;
+    bool ok = std::fread(&fileHeader, sizeof(fileHeader), 1, in) == 1 &&
+        std::memcmp(fileHeader.magic, TRAJECTORY_MAGIC, sizeof(fileHeader.magic)) == 0 &&
+        (fileHeader.scalarBytes == 4 || fileHeader.scalarBytes == 8);
+    const uint64_t frameSize = ok ? frame_bytes(fileHeader) : 0;
+
+    // offset klatki z indeksu, a bez stopki (przerwany zapis) - po stałym rozmiarze klatki
+    uint64_t offset = 0, frames = 0;
+    TrajectoryTrailer trailer;
+    std::fseek(in, 0, SEEK_END);
+    const uint64_t size = static_cast<uint64_t>(std::ftell(in));
+    if (ok && size >= sizeof(fileHeader) + sizeof(trailer) &&
+        std::fseek(in, static_cast<long>(size - sizeof(trailer)), SEEK_SET) == 0 &&
+        std::fread(&trailer, sizeof(trailer), 1, in) == 1 &&
+        std::memcmp(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic)) == 0) {
+        frames = trailer.frameCount;
+        if (k == TRAJ_LAST_FRAME) k = frames - 1;
+        ok = k < frames && std::fseek(in, static_cast<long>(trailer.indexOffset + k * sizeof(uint64_t)), SEEK_SET) == 0 &&
+            std::fread(&offset, sizeof(offset), 1, in) == 1;
+    }
+    else if (ok) {
+        frames = (size - sizeof(fileHeader)) / frameSize;
+        if (k == TRAJ_LAST_FRAME) k = frames - 1;
+        offset = sizeof(fileHeader) + k * frameSize;
+        ok = k < frames;
+    }
+
+    TrajectoryFrameHeader frameHeader;
+    ok = ok && std::fseek(in, static_cast<long>(offset), SEEK_SET) == 0 &&
+        std::fread(&frameHeader, sizeof(frameHeader), 1, in) == 1;
+    if (ok) {
+        const std::size_t n = static_cast<std::size_t>(fileHeader.bodyCount);
+        bodies.resize(n);
+        std::vector<double> doubles(n);
+        std::vector<float> floats(n);
+        for (int c = 0; c < TRAJECTORY_COLUMNS && ok; ++c) {
+            auto& column = column_array(bodies, c);
+            if (!(fileHeader.fields & column_field(c))) {
+                std::fill(column.begin(), column.end(), Real(0));
+            }
+            else if (fileHeader.scalarBytes == sizeof(Real)) {
+                ok = std::fread(column.data(), sizeof(Real), n, in) == n;
+            }
+            else if (fileHeader.scalarBytes == 8) {
+                ok = std::fread(doubles.data(), sizeof(double), n, in) == n;
+                for (std::size_t i = 0; i < n; ++i) column[i] = static_cast<Real>(doubles[i]);
+            }
+            else {
+                ok = std::fread(floats.data(), sizeof(float), n, in) == n;
+                for (std::size_t i = 0; i < n; ++i) column[i] = static_cast<Real>(floats[i]);
+            }
+        }
+    }
+    std::fclose(in);
+    if (ok && frame) *frame = frameHeader;
+    if (ok && header) *header = fileHeader;
+    return ok;
+}
+
+template bool TrajectoryWriter::open<double>(const std::string&, std::size_t, double, uint32_t);
+template bool TrajectoryWriter::open<float>(const std::string&, std::size_t, double, uint32_t);
+template bool TrajectoryWriter::sample(const BodySystem&, int, double);
+template bool TrajectoryWriter::sample(const BodySystemF&, int, double);
+template bool read_trajectory_frame(const std::string&, std::size_t, BodySystem&, TrajectoryFrameHeader*,
+                                    TrajectoryFileHeader*);
+template bool read_trajectory_frame(const std::string&, std::size_t, BodySystemF&, TrajectoryFrameHeader*,
+                                    TrajectoryFileHeader*);
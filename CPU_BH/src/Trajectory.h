@@ -0,0 +1,91 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "BodySystem.h"
+
+// Binarny format trajektorii (.nbt), ten sam co w cpu-proj (TrajectoryTool konwertuje go do i z JSON):
+//   nagłówek pliku (64 B) | klatka 0 | klatka 1 | ... | indeks: offsety klatek (uint64) | stopka (24 B)
+// Klatka to nagłówek (32 B) i kolumny po N wartości x, y, z, vx, vy, vz, ax, ay, az, mass (tylko grupy
+// zaznaczone w `fields`), dopełnione do 8 B. Wartości zapisywane są w typie przechowywania ciał - przy
+// --precision mixed we float, bez konwersji; cały plik jest little-endian.
+
+enum TrajectoryFields : uint32_t {
+    TRAJ_POSITIONS = 1,
+    TRAJ_VELOCITIES = 2,
+    TRAJ_ACCELERATIONS = 4,
+    TRAJ_MASSES = 8,
+    TRAJ_ALL_FIELDS = 15
+};
+
+struct TrajectoryFileHeader {
+    char magic[8];          // "NBTRAJ1"
+    uint32_t version;
+    uint32_t fields;        // maska TrajectoryFields
+    uint32_t scalarBytes;   // 8 - double, 4 - float
+    uint32_t headerBytes;   // sizeof(TrajectoryFileHeader)
+    uint64_t bodyCount;
+    double dt;
+    char units[24];         // jednostki długości, masy i czasu
+};
+
+struct TrajectoryFrameHeader {
+    int64_t step;
+    double time;
+    int64_t timestamp;
+    uint64_t reserved;
+};
+
+struct TrajectoryTrailer {
+    uint64_t frameCount;
+    uint64_t indexOffset;
+    char magic[8];          // "NBTRIDX"
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 64, "naglowek pliku trajektorii musi miec 64 bajty");
+static_assert(sizeof(TrajectoryFrameHeader) == 32, "naglowek klatki musi miec 32 bajty");
+static_assert(sizeof(TrajectoryTrailer) == 24, "stopka trajektorii musi miec 24 bajty");
+
+// Zapis klatek co `interval` kroków. Klatka to jeden fwrite na kolumnę prosto z tablic BodySystemT, indeks
+// i stopka dopisywane są przy zamknięciu - plik przerwanej symulacji da się odczytać po stałym rozmiarze klatki.
+class TrajectoryWriter {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    int interval = 1;
+
+    TrajectoryWriter() = default;
+    ~TrajectoryWriter();
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+    // otwiera plik i zapisuje nagłówek; typ wartości to `Real` z BodySystemT; zwraca false przy błędzie
+    template <typename Real>
+    bool open(const std::string& filename, std::size_t bodyCount, double dt, uint32_t fields = TRAJ_ALL_FIELDS);
+    bool isOpen() const { return file != nullptr; }
+    // zapisuje klatkę, gdy `step` jest wielokrotnością `interval`; zwraca true, gdy klatka powstała
+    template <typename Real>
+    bool sample(const BodySystemT<Real>& bodies, int step, double time);
+    std::size_t frameCount() const { return offsets.size(); }
+    // dopisuje indeks i stopkę
+    void close();
+
+private:
+    std::FILE* file = nullptr;
+    TrajectoryFileHeader header{};
+    std::vector<uint64_t> offsets;
+};
+
+// numer klatki oznaczający ostatnią klatkę pliku
+static constexpr std::size_t TRAJ_LAST_FRAME = static_cast<std::size_t>(-1);
+
+// Odczyt klatki `k` pliku .nbt do `bodies` (wartości w typie `Real`, kolumny spoza pliku zerowane). Klatka
+// wyszukiwana jest w indeksie ze stopki albo, bez stopki, po stałym rozmiarze klatki; zwraca false przy błędzie.
+template <typename Real>
+bool read_trajectory_frame(const std::string& filename, std::size_t k, BodySystemT<Real>& bodies,
+                           TrajectoryFrameHeader* frame = nullptr, TrajectoryFileHeader* header = nullptr);
+
+#endif // TRAJECTORY_H
@@ -1,31 +1,91 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include "Body.h"
+#include "BodySystem.h"
+#include "Diagnostics.h"
+#include "ParticleLoader.h"
 #include "Simulation.h"
+#include "Trajectory.h"
 
-int main() {
-    std::vector<Body> bodies = {
-    Body(1.0e24, 500.0, 500.0, 0.0, -1.0, -1.0, 0.0),  
-    Body(1.0e24, -500.0, 500.0, 0.0, 1.0, -1.0, 0.0),  
-    Body(1.0e24, -500.0, -500.0, 0.0, 1.0, 1.0, 0.0),  
-    Body(1.0e24, 500.0, -500.0, 0.0, -1.0, 1.0, 0.0),
-    };
+// Główna pętla symulacji dla ciał przechowywanych w typie `Real` (double albo float - tryb --precision mixed)
+// i drzewa o wymiarze `Dim` (3 albo 2 - tryb --dimensions 2); zwraca false, gdy nie udało się wczytać ciał
+template <typename Real, int Dim>
+static bool run_simulation(const SimulationOptions& options, const std::vector<Body>& initial) {
+    SimulationContextT<Real, Dim> context;
+    context.options = options;
+    // ciała w układzie SoA (BodySystemT) - z pliku --input wczytywane wprost do tablic, bez std::vector<Body>
+    BodySystemT<Real> bodies;
+    if (options.inputFile.empty()) {
+        bodies = BodySystemT<Real>(initial);
+    }
+    else {
+        const auto start = std::chrono::steady_clock::now();
+        if (!load_particles(options.inputFile, bodies)) return false;
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Wczytano " << bodies.size() << " cial z " << options.inputFile << " (" << elapsed.count()
+            << " ms)\n";
+    }
 
     int steps = 100;
+    DiagnosticsMonitor diagnostics;
+    diagnostics.interval = options.diagnosticsInterval;
+    diagnostics.theta = options.diagnosticsTheta;
+    TrajectoryWriter trajectory;
+    trajectory.interval = options.trajectoryInterval;
+    if (!options.trajectoryFile.empty()) {
+        trajectory.open<Real>(options.trajectoryFile, bodies.size(), TIME_STEP);
+    }
 
-    // G��wna p�tla symulacji
     for (int step = 0; step < steps; ++step) {
-        simulate_step(bodies);
-        calculate_total_energy(bodies);
+        simulate_step(bodies, context);
+        trajectory.sample(bodies, step, (step + 1) * TIME_STEP);
+        if (diagnostics.sample(bodies, step)) {
+            const Diagnostics& d = diagnostics.latest();
+            std::cout << "Krok " << step << ": energia=" << d.total() << " J (kinetyczna " << d.kinetic
+                << ", potencjalna " << d.potential << "), dryf energii=" << d.energyDrift
+                << ", ped=(" << d.momentum[0] << ", " << d.momentum[1] << ", " << d.momentum[2] << ")\n";
+        }
 
+        // przy dużych układach z pliku wypisywane są tylko pierwsze ciała
         if (step % 10 == 0) {
             std::cout << "Krok " << step << ":\n";
-            for (const auto& body : bodies) {
+            for (size_t i = 0; i < std::min<size_t>(bodies.size(), 16); ++i) {
+                const auto& body = bodies[i];
                 std::cout << "Cialo: x=" << body.x << " y=" << body.y << " z=" << body.z
                     << " vx=" << body.vx << " vy=" << body.vy << " vz=" << body.vz << "\n";
             }
         }
     }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    SimulationOptions options;
+    if (!parse_simulation_options(argc, argv, options)) {
+        std::cerr << "Uzycie: " << argv[0] << " [--traversal recursive|stackless|grouped] [--group-size n] [--leaf-size K] [--multipole 1|2] [--theta wartosc] [--solver bh|fmm] [--fmm-order p] [--refit] [--max-migrated udzial] [--block-levels L] [--timestep-eta eta] [--diagnostics-interval n] [--diagnostics-theta wartosc] [--precision double|mixed] [--dimensions 2|3] [--output plik.nbt] [--output-interval n] [--input plik.csv|.bin|.json|.nbt]\n";
+        return 1;
+    }
+
+    std::vector<Body> initial{
+    Body(1.0e24, 500.0, 500.0, 0.0, -1.0, -1.0, 0.0),  
+    Body(1.0e24, -500.0, 500.0, 0.0, 1.0, -1.0, 0.0),  
+    Body(1.0e24, -500.0, -500.0, 0.0, 1.0, 1.0, 0.0),  
+    Body(1.0e24, 500.0, -500.0, 0.0, -1.0, 1.0, 0.0),
+    };
+
+    const bool mixed = options.precision == Precision::Mixed;
+    bool ok;
+    if (options.dimensions == 2) {
+        if (mixed) ok = run_simulation<float, 2>(options, initial);
+        else ok = run_simulation<double, 2>(options, initial);
+    }
+    else {
+        if (mixed) ok = run_simulation<float, 3>(options, initial);
+        else ok = run_simulation<double, 3>(options, initial);
+    }
+    if (!ok) return 1;
 
     char x;
     std::cout << "Wcisnij dowolny klawisz, aby zamknac";
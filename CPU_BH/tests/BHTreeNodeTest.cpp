@@ -1,25 +1,28 @@
 #include "gtest/gtest.h"
 #include "../src/BHTreeNode.h"
+#include <algorithm>
+#include <cmath>
 
 // Test konstrukcji węzła
 TEST(BHTreeNodeTest, ConstructorTest) {
-    Octant region(0.0, 0.0, 0.0, 10.0);
+    Octant region({0.0, 0.0, 0.0}, 10.0);
     BHTreeNode node(region);
 
-    EXPECT_DOUBLE_EQ(node.region.x, 0.0);
-    EXPECT_DOUBLE_EQ(node.region.y, 0.0);
-    EXPECT_DOUBLE_EQ(node.region.z, 0.0);
+    EXPECT_DOUBLE_EQ(node.region.center[0], 0.0);
+    EXPECT_DOUBLE_EQ(node.region.center[1], 0.0);
+    EXPECT_DOUBLE_EQ(node.region.center[2], 0.0);
     EXPECT_DOUBLE_EQ(node.region.size, 10.0);
     EXPECT_EQ(node.mass, 0.0);
     EXPECT_EQ(node.centerX, 0.0);
     EXPECT_EQ(node.centerY, 0.0);
     EXPECT_EQ(node.centerZ, 0.0);
-    EXPECT_EQ(node.body, nullptr);
+    EXPECT_TRUE(node.bodies.empty());
+    EXPECT_EQ(node.leafSize, BHTreeNode::DEFAULT_LEAF_SIZE);
 }
 
 // Test podziału węzła
 TEST(BHTreeNodeTest, SubdivideTest) {
-    Octant region(0.0, 0.0, 0.0, 10.0);
+    Octant region({0.0, 0.0, 0.0}, 10.0);
     BHTreeNode node(region);
 
     node.subdivide();
@@ -29,3 +32,48 @@ TEST(BHTreeNodeTest, SubdivideTest) {
         EXPECT_DOUBLE_EQ(node.children[i]->region.size, 5.0); // Rozmiar każdego podregionu
     }
 }
+
+// Test kubełka - liść przyjmuje K ciał i dzieli się dopiero przy kolejnym
+TEST(BHTreeNodeTest, BucketSplitsWhenFull) {
+    BHTreeNode node(Octant({0.0, 0.0, 0.0}, 10.0), 4);
+    for (int i = 0; i < 4; ++i) node.insert(Body(1.0, -4.0 + i * 2.0, 1.0, 1.0, 0.0, 0.0, 0.0));
+
+    EXPECT_EQ(node.bodies.size(), 4u);
+    EXPECT_EQ(node.children[0], nullptr);
+
+    node.insert(Body(1.0, 3.0, -3.0, 1.0, 0.0, 0.0, 0.0));
+    EXPECT_TRUE(node.bodies.empty());
+    ASSERT_NE(node.children[0], nullptr);
+    EXPECT_DOUBLE_EQ(node.mass, 5.0);
+
+    double childMass = 0.0;
+    for (const auto& child : node.children) childMass += child->mass;
+    EXPECT_DOUBLE_EQ(childMass, 5.0);
+}
+
+// głębokość poddrzewa i największy kubełek
+static int max_depth(const BHTreeNode& node, size_t& largest) {
+    largest = std::max(largest, node.bodies.size());
+    int depth = 0;
+    for (const auto& child : node.children) {
+        if (child) depth = std::max(depth, 1 + max_depth(*child, largest));
+    }
+    return depth;
+}
+
+// Test pokrywających się ciał - wstawianie kończy się na maksymalnej głębokości bez utraty masy
+TEST(BHTreeNodeTest, CoincidentBodiesStopAtMaxDepth) {
+    BHTreeNode node(Octant({0.0, 0.0, 0.0}, 10.0), 1);
+    for (int i = 0; i < 50; ++i) node.insert(Body(2.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0));
+    node.insert(Body(2.0, 5.0, 5.0, 5.0, 0.0, 0.0, 0.0));  // na granicy regionu
+
+    EXPECT_DOUBLE_EQ(node.mass, 102.0);
+    size_t largest = 0;
+    EXPECT_EQ(max_depth(node, largest), BHTreeNode::MAX_DEPTH);
+    EXPECT_EQ(largest, 50u);
+
+    double fx = 0.0, fy = 0.0, fz = 0.0;
+    node.calculateForce(Body(1.0, -4.0, -4.0, -4.0, 0.0, 0.0, 0.0), fx, fy, fz);
+    EXPECT_TRUE(std::isfinite(fx));
+    EXPECT_GT(fx, 0.0);
+}
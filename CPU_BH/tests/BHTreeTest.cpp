@@ -0,0 +1,491 @@
+#include "gtest/gtest.h"
+#include "../src/BHTree.h"
+#include "../src/Simulation.h"
+#include "TestBodies.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+#include <vector>
+
+// bezpośrednia suma sił jako punkt odniesienia
+static void direct_force(const std::vector<Body>& bodies, size_t i, double& fx, double& fy, double& fz) {
+    const double G = 6.67430e-11;
+    fx = fy = fz = 0.0;
+    for (size_t j = 0; j < bodies.size(); ++j) {
+        if (j == i) continue;
+        double dx = bodies[j].x - bodies[i].x;
+        double dy = bodies[j].y - bodies[i].y;
+        double dz = bodies[j].z - bodies[i].z;
+        double dist_sq = dx * dx + dy * dy + dz * dz;
+        double dist = std::sqrt(dist_sq);
+        double force = G * bodies[i].mass * bodies[j].mass / dist_sq;
+        fx += force * dx / dist;
+        fy += force * dy / dist;
+        fz += force * dz / dist;
+    }
+}
+
+// Test masy całkowitej i środka masy korzenia
+TEST(BHTreeTest, RootHoldsTotalMassAndCenter) {
+    std::vector<Body> bodies = random_bodies(500, 1);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    double mass = 0.0, cx = 0.0;
+    for (const auto& b : bodies) {
+        mass += b.mass;
+        cx += b.x * b.mass;
+    }
+
+    EXPECT_NEAR(tree.nodes[0].mass, mass, mass * 1e-12);
+    EXPECT_NEAR(tree.nodes[0].center[0], cx / mass, 1e-9);
+}
+
+// Test, czy każde ciało trafia do dokładnie jednego liścia
+TEST(BHTreeTest, EveryBodyIsInOneLeaf) {
+    std::vector<Body> bodies = random_bodies(1000, 2);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    ASSERT_EQ(tree.order.size(), bodies.size());
+    std::vector<int> seen(bodies.size(), 0);
+    for (const auto& node : tree.nodes) {
+        if (!node.leaf) continue;
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            seen[tree.order[k]]++;
+        }
+    }
+    for (int s : seen) EXPECT_EQ(s, 1);
+}
+
+// Test ponownego użycia puli - druga budowa nie powinna alokować nowej pamięci
+TEST(BHTreeTest, PoolIsReusedBetweenBuilds) {
+    std::vector<Body> bodies = random_bodies(1000, 3);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    size_t memory = tree.memoryUsage();
+    const BHNode* pool = tree.nodes.data();
+
+    build_bhtree(bodies, tree);
+
+    EXPECT_EQ(tree.memoryUsage(), memory);
+    EXPECT_EQ(tree.nodes.data(), pool);
+}
+
+// Test ciał w tym samym miejscu - trafiają do wspólnego liścia na maksymalnej głębokości
+TEST(BHTreeTest, CoincidentBodiesShareLeaf) {
+    std::vector<Body> bodies = {
+        Body(1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0),
+        Body(1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0),
+        Body(1.0, -1.0, -1.0, -1.0, 0.0, 0.0, 0.0)
+    };
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    EXPECT_DOUBLE_EQ(tree.nodes[0].mass, 3.0);
+    EXPECT_EQ(tree.order.size(), 3u);
+
+    double fx = 0.0, fy = 0.0, fz = 0.0;
+    tree.calculateForce(bodies, 0, fx, fy, fz);
+    EXPECT_TRUE(std::isfinite(fx));
+    EXPECT_LT(fx, 0.0);
+}
+
+// Test dokładności siły względem sumy bezpośredniej
+TEST(BHTreeTest, ForceMatchesDirectSum) {
+    std::vector<Body> bodies = random_bodies(300, 4);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    for (uint32_t i = 0; i < bodies.size(); i += 37) {
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        double ex, ey, ez;
+        tree.calculateForce(bodies, i, fx, fy, fz, 0.3);
+        direct_force(bodies, i, ex, ey, ez);
+        double norm = std::sqrt(ex * ex + ey * ey + ez * ez);
+        EXPECT_NEAR(fx, ex, norm * 0.02);
+        EXPECT_NEAR(fy, ey, norm * 0.02);
+        EXPECT_NEAR(fz, ez, norm * 0.02);
+    }
+}
+
+// Test przy theta = 0 - drzewo otwierane do liści daje sumę bezpośrednią
+TEST(BHTreeTest, ZeroThetaIsExact) {
+    std::vector<Body> bodies = random_bodies(100, 5);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    double fx = 0.0, fy = 0.0, fz = 0.0;
+    double ex, ey, ez;
+    tree.calculateForce(bodies, 7, fx, fy, fz, 0.0);
+    direct_force(bodies, 7, ex, ey, ez);
+    EXPECT_NEAR(fx, ex, std::abs(ex) * 1e-6);
+    EXPECT_NEAR(fy, ey, std::abs(ey) * 1e-6);
+    EXPECT_NEAR(fz, ez, std::abs(ez) * 1e-6);
+}
+
+// porównanie struktury, mas i środków mas dwóch poddrzew (niezależnie od układu węzłów w puli)
+static void expect_same_subtree(const BHTree& a, uint32_t i, const BHTree& b, uint32_t j) {
+    const BHNode& na = a.nodes[i];
+    const BHNode& nb = b.nodes[j];
+    ASSERT_EQ(na.leaf, nb.leaf);
+    ASSERT_EQ(na.first, nb.first);
+    ASSERT_EQ(na.count, nb.count);
+    EXPECT_EQ(na.mass, nb.mass);
+    EXPECT_EQ(na.center[0], nb.center[0]);
+    EXPECT_EQ(na.center[1], nb.center[1]);
+    EXPECT_EQ(na.center[2], nb.center[2]);
+    EXPECT_EQ(na.region.size, nb.region.size);
+    for (int c = 0; c < 8; ++c) {
+        ASSERT_EQ(na.children[c] == BHNode::NONE, nb.children[c] == BHNode::NONE);
+        if (na.children[c] != BHNode::NONE) expect_same_subtree(a, na.children[c], b, nb.children[c]);
+    }
+}
+
+// Test budowy Mortona - drzewo identyczne z drzewem budowanym przez wstawianie
+TEST(BHTreeTest, MortonBuildMatchesInsertion) {
+    std::vector<Body> bodies = random_bodies(3000, 6);
+    bodies.push_back(bodies[10]);       // para pokrywających się ciał
+    Octant root = bounding_octant(bodies);
+
+    BHTree inserted, sorted;
+    inserted.buildByInsertion(bodies, root);
+    sorted.buildMorton(bodies, root);
+
+    EXPECT_EQ(inserted.nodes.size(), sorted.nodes.size());
+    EXPECT_EQ(inserted.order, sorted.order);
+    expect_same_subtree(inserted, 0, sorted, 0);
+
+    for (uint32_t i = 0; i < bodies.size(); i += 101) {
+        double ax = 0.0, ay = 0.0, az = 0.0, bx = 0.0, by = 0.0, bz = 0.0;
+        inserted.calculateForce(bodies, i, ax, ay, az);
+        sorted.calculateForce(bodies, i, bx, by, bz);
+        EXPECT_EQ(ax, bx);
+        EXPECT_EQ(ay, by);
+        EXPECT_EQ(az, bz);
+    }
+}
+
+// Test niezależności wyniku budowy Mortona od liczby wątków
+TEST(BHTreeTest, MortonBuildIndependentOfThreadCount) {
+    std::vector<Body> bodies = random_bodies(5000, 7);
+    Octant root = bounding_octant(bodies);
+    int threads = omp_get_max_threads();
+
+    BHTree single, parallel;
+    omp_set_num_threads(1);
+    single.buildMorton(bodies, root);
+    omp_set_num_threads(std::max(threads, 4));
+    parallel.buildMorton(bodies, root);
+    omp_set_num_threads(threads);
+
+    ASSERT_EQ(single.nodes.size(), parallel.nodes.size());
+    EXPECT_EQ(single.order, parallel.order);
+    for (size_t k = 0; k < single.nodes.size(); ++k) {
+        EXPECT_EQ(single.nodes[k].mass, parallel.nodes[k].mass);
+        EXPECT_EQ(single.nodes[k].center[0], parallel.nodes[k].center[0]);
+    }
+}
+
+// Test przejścia bez stosu - wyniki identyczne z przejściem rekurencyjnym
+TEST(BHTreeTest, StacklessMatchesRecursive) {
+    std::vector<Body> bodies = random_bodies(2000, 8);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    tree.flatten();
+
+    ASSERT_EQ(tree.flat.size(), tree.nodes.size());
+    EXPECT_EQ(tree.flat[0].skip, tree.flat.size());
+    for (uint32_t i = 0; i < bodies.size(); i += 53) {
+        double ax = 0.0, ay = 0.0, az = 0.0, bx = 0.0, by = 0.0, bz = 0.0;
+        tree.calculateForce(bodies, i, ax, ay, az, 0.5);
+        tree.calculateForceStackless(bodies, i, bx, by, bz, 0.5);
+        EXPECT_EQ(ax, bx);
+        EXPECT_EQ(ay, by);
+        EXPECT_EQ(az, bz);
+    }
+}
+
+// Test spłaszczania drzewa zbudowanego przez wstawianie (ścieżka bez poziomów)
+TEST(BHTreeTest, FlattenInsertionTree) {
+    std::vector<Body> bodies = random_bodies(500, 9);
+    BHTree inserted, sorted;
+    inserted.buildByInsertion(bodies, bounding_octant(bodies));
+    sorted.buildMorton(bodies, bounding_octant(bodies));
+    inserted.flatten();
+    sorted.flatten();
+
+    ASSERT_EQ(inserted.flat.size(), sorted.flat.size());
+    for (size_t k = 0; k < inserted.flat.size(); ++k) {
+        EXPECT_EQ(inserted.flat[k].skip, sorted.flat[k].skip);
+        EXPECT_EQ(inserted.flat[k].mass, sorted.flat[k].mass);
+        EXPECT_EQ(inserted.flat[k].count, sorted.flat[k].count);
+    }
+}
+
+// średni błąd względny sił drzewa względem sumy bezpośredniej
+static double mean_force_error(const BHTree& tree, const std::vector<Body>& bodies, double theta) {
+    double total = 0.0;
+    int samples = 0;
+    for (uint32_t i = 0; i < bodies.size(); i += 17) {
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        double ex, ey, ez;
+        tree.calculateForce(bodies, i, fx, fy, fz, theta);
+        direct_force(bodies, i, ex, ey, ez);
+        double dx = fx - ex, dy = fy - ey, dz = fz - ez;
+        total += std::sqrt(dx * dx + dy * dy + dz * dz) / std::sqrt(ex * ex + ey * ey + ez * ez);
+        ++samples;
+    }
+    return total / samples;
+}
+
+// Test momentu kwadrupolowego pary ciał
+TEST(BHTreeTest, QuadrupoleOfTwoBodies) {
+    std::vector<Body> bodies = {
+        Body(1.0, -1.0, 0.0, 0.0, 0.0, 0.0, 0.0),
+        Body(1.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0)
+    };
+    BHTree tree;
+    tree.multipoleOrder = BHTree::QUADRUPOLE;
+    build_bhtree(bodies, tree);
+
+    const double* q = tree.nodes[0].quad.data();
+    EXPECT_NEAR(q[0], 4.0, 1e-12);      // 2 * (3 - 1)
+    EXPECT_NEAR(q[3], -2.0, 1e-12);
+    EXPECT_NEAR(q[5], -2.0, 1e-12);
+    EXPECT_NEAR(q[1], 0.0, 1e-12);
+    EXPECT_NEAR(q[0] + q[3] + q[5], 0.0, 1e-12);
+}
+
+// Test dokładności - przy tym samym theta kwadrupol daje mniejszy błąd niż monopol
+TEST(BHTreeTest, QuadrupoleIsMoreAccurate) {
+    std::vector<Body> bodies = random_bodies(2000, 10);
+    BHTree monopole, quadrupole;
+    quadrupole.multipoleOrder = BHTree::QUADRUPOLE;
+    build_bhtree(bodies, monopole);
+    build_bhtree(bodies, quadrupole);
+
+    double monopoleError = mean_force_error(monopole, bodies, 0.8);
+    double quadrupoleError = mean_force_error(quadrupole, bodies, 0.8);
+    EXPECT_LT(quadrupoleError, monopoleError * 0.6);
+}
+
+// Test zgodności kwadrupola w przejściu bez stosu
+TEST(BHTreeTest, StacklessQuadrupoleMatchesRecursive) {
+    std::vector<Body> bodies = random_bodies(1000, 11);
+    BHTree tree;
+    tree.multipoleOrder = BHTree::QUADRUPOLE;
+    build_bhtree(bodies, tree);
+    tree.flatten();
+
+    for (uint32_t i = 0; i < bodies.size(); i += 97) {
+        double ax = 0.0, ay = 0.0, az = 0.0, bx = 0.0, by = 0.0, bz = 0.0;
+        tree.calculateForce(bodies, i, ax, ay, az);
+        tree.calculateForceStackless(bodies, i, bx, by, bz);
+        EXPECT_EQ(ax, bx);
+        EXPECT_EQ(az, bz);
+    }
+}
+
+// Test refitu bez przeniesionych ciał - masy i środki mas jak po nowej budowie, ta sama topologia
+TEST(BHTreeTest, RefitUpdatesMoments) {
+    std::vector<Body> bodies = random_bodies(2000, 12);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    const size_t nodeCount = tree.nodes.size();
+
+    for (auto& b : bodies) b.mass *= 2.0;
+    ASSERT_TRUE(tree.refit(bodies));
+    EXPECT_EQ(tree.nodes.size(), nodeCount);
+    EXPECT_EQ(tree.migratedSinceBuild(), 0u);
+
+    BHTree rebuilt;
+    rebuilt.buildMorton(bodies, tree.nodes[0].region);
+    ASSERT_EQ(rebuilt.nodes.size(), nodeCount);
+    for (size_t k = 0; k < nodeCount; ++k) {
+        EXPECT_DOUBLE_EQ(tree.nodes[k].mass, rebuilt.nodes[k].mass);
+        EXPECT_DOUBLE_EQ(tree.nodes[k].center[0], rebuilt.nodes[k].center[0]);
+    }
+}
+
+// Test refitu z ciałami, które zmieniły liść - każde ciało w dokładnie jednym liściu, który je zawiera
+TEST(BHTreeTest, RefitReinsertsMigratedBodies) {
+    std::vector<Body> bodies = random_bodies(2000, 13);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    std::swap(bodies[0].x, bodies[1].x);
+    bodies[2].x = -bodies[2].x;
+    bodies[3].y = -bodies[3].y;
+    ASSERT_TRUE(tree.refit(bodies));
+    EXPECT_GE(tree.migratedSinceBuild(), 2u);
+
+    std::vector<int> seen(bodies.size(), 0);
+    for (const auto& node : tree.nodes) {
+        if (!node.leaf) continue;
+        for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+            seen[tree.order[k]]++;
+            EXPECT_TRUE(node.region.contains(bodies[tree.order[k]]));
+        }
+    }
+    for (int s : seen) EXPECT_EQ(s, 1);
+
+    // przy theta = 0 siła jest sumą bezpośrednią niezależnie od układu drzewa
+    tree.flatten();
+    for (uint32_t i = 0; i < 8; ++i) {
+        double fx = 0.0, fy = 0.0, fz = 0.0, ex, ey, ez;
+        tree.calculateForceStackless(bodies, i, fx, fy, fz, 0.0);
+        direct_force(bodies, i, ex, ey, ez);
+        EXPECT_NEAR(fx, ex, std::abs(ex) * 1e-9);
+        EXPECT_NEAR(fy, ey, std::abs(ey) * 1e-9);
+    }
+}
+
+// Test kryteriów jakości - ciało poza korzeniem i zbyt wiele przeniesionych ciał wymuszają przebudowę
+TEST(BHTreeTest, RefitRejectsDegradedTree) {
+    std::vector<Body> bodies = random_bodies(1000, 14);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+
+    std::vector<Body> escaped = bodies;
+    escaped[0].x = 1.0e6;
+    EXPECT_FALSE(tree.refit(escaped));
+
+    std::vector<Body> mirrored = bodies;
+    for (auto& b : mirrored) b.x = -b.x;
+    EXPECT_FALSE(tree.refit(mirrored, 0.05));
+    EXPECT_TRUE(tree.refit(mirrored, 1.0));
+
+    BHTree empty;
+    EXPECT_FALSE(empty.refit(bodies));
+}
+
+// głębokość najgłębszego liścia
+static int tree_depth(const BHTree& tree, uint32_t node) {
+    int depth = 0;
+    for (uint32_t child : tree.nodes[node].children) {
+        if (child != BHNode::NONE) depth = std::max(depth, 1 + tree_depth(tree, child));
+    }
+    return depth;
+}
+
+// Test pojemności liści - kubełki mają co najwyżej K ciał, a węzły wewnętrzne więcej niż K
+TEST(BHTreeTest, LeafBucketsRespectLeafSize) {
+    std::vector<Body> bodies = random_bodies(3000, 12);
+    Octant root = bounding_octant(bodies);
+    size_t previousNodes = bodies.size() * 2;
+
+    for (int leafSize : {1, 4, 16, 64}) {
+        BHTree inserted, sorted;
+        inserted.leafSize = leafSize;
+        sorted.leafSize = leafSize;
+        inserted.buildByInsertion(bodies, root);
+        sorted.buildMorton(bodies, root);
+
+        for (const auto& node : sorted.nodes) {
+            if (node.leaf) EXPECT_LE(node.count, static_cast<uint32_t>(leafSize));
+            else EXPECT_GT(node.count, static_cast<uint32_t>(leafSize));
+        }
+        EXPECT_LT(sorted.nodes.size(), previousNodes);
+        previousNodes = sorted.nodes.size();
+
+        EXPECT_EQ(inserted.order, sorted.order);
+        expect_same_subtree(inserted, 0, sorted, 0);
+        EXPECT_LT(mean_force_error(sorted, bodies, 0.5), 1e-2);
+    }
+}
+
+// Test maksymalnej głębokości - prawie pokrywające się ciała zostają w jednym przepełnionym liściu
+TEST(BHTreeTest, MaxDepthBoundsTree) {
+    std::vector<Body> bodies = random_bodies(100, 13);
+    for (int i = 0; i < 200; ++i) bodies.emplace_back(1.0e10, 1.0 + i * 1e-13, 1.0, 1.0, 0.0, 0.0, 0.0);
+    Octant root = bounding_octant(bodies);
+
+    for (bool morton : {false, true}) {
+        BHTree tree;
+        tree.leafSize = 4;
+        tree.maxDepth = 6;
+        if (morton) tree.buildMorton(bodies, root);
+        else tree.buildByInsertion(bodies, root);
+
+        EXPECT_LE(tree_depth(tree, 0), 6);
+        uint32_t largest = 0;
+        for (const auto& node : tree.nodes) {
+            if (node.leaf) largest = std::max(largest, node.count);
+        }
+        EXPECT_GE(largest, 200u);
+
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        tree.calculateForce(bodies, 150, fx, fy, fz);
+        EXPECT_TRUE(std::isfinite(fx) && std::isfinite(fy) && std::isfinite(fz));
+    }
+}
+
+// płaski dysk w płaszczyźnie z = 0
+static std::vector<Body> planar_disk(int n, unsigned seed) {
+    std::vector<Body> bodies = random_bodies(n, seed);
+    for (Body& body : bodies) body.z = 0.0;
+    return bodies;
+}
+
+// Test drzewa czwórkowego - węzły mają co najwyżej 4 dzieci, a siły zgadzają się z sumą bezpośrednią
+TEST(BHTreeTest, QuadTreeForceMatchesDirectSum) {
+    std::vector<Body> bodies = planar_disk(400, 21);
+    QuadTree tree;
+    build_bhtree(bodies, tree);
+    EXPECT_EQ(tree.nodes[0].children.size(), 4u);
+    EXPECT_EQ(tree.nodes[0].count, bodies.size());
+
+    for (uint32_t i = 0; i < bodies.size(); i += 41) {
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        double ex, ey, ez;
+        tree.calculateForce(bodies, i, fx, fy, fz, 0.3);
+        direct_force(bodies, i, ex, ey, ez);
+        double norm = std::sqrt(ex * ex + ey * ey);
+        EXPECT_NEAR(fx, ex, norm * 0.02);
+        EXPECT_NEAR(fy, ey, norm * 0.02);
+        EXPECT_EQ(fz, 0.0);
+
+        fx = fy = 0.0;
+        tree.calculateForce(bodies, i, fx, fy, fz, 0.0);
+        EXPECT_NEAR(fx, ex, norm * 1e-9);
+        EXPECT_NEAR(fy, ey, norm * 1e-9);
+    }
+}
+
+// Test drzewa czwórkowego - budowa Mortona, wstawianie, przejście spłaszczone, kwadrupol i refit
+TEST(BHTreeTest, QuadTreeBuildsAndTraversalsAgree) {
+    std::vector<Body> bodies = planar_disk(500, 22);
+    QuadTree sorted, inserted;
+    sorted.multipoleOrder = inserted.multipoleOrder = QuadTree::QUADRUPOLE;
+    build_bhtree(bodies, sorted);
+    inserted.buildByInsertion(bodies, bounding_octant<2>(bodies));
+    EXPECT_EQ(sorted.order, inserted.order);
+    EXPECT_EQ(sorted.nodes.size(), inserted.nodes.size());
+    EXPECT_DOUBLE_EQ(sorted.nodes[0].center[0], inserted.nodes[0].center[0]);
+
+    QuadTree monopole;
+    build_bhtree(bodies, monopole);
+    sorted.flatten();
+    double quadrupoleError = 0.0, monopoleError = 0.0;
+    for (uint32_t i = 0; i < bodies.size(); i += 23) {
+        double ax = 0.0, ay = 0.0, az = 0.0, bx = 0.0, by = 0.0, bz = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+        double ex, ey, ez;
+        sorted.calculateForce(bodies, i, ax, ay, az, 0.6);
+        sorted.calculateForceStackless(bodies, i, bx, by, bz, 0.6);
+        monopole.calculateForce(bodies, i, mx, my, mz, 0.6);
+        EXPECT_EQ(ax, bx);
+        EXPECT_EQ(ay, by);
+        direct_force(bodies, i, ex, ey, ez);
+        double norm = std::sqrt(ex * ex + ey * ey);
+        quadrupoleError += std::hypot(ax - ex, ay - ey) / norm;
+        monopoleError += std::hypot(mx - ex, my - ey) / norm;
+    }
+    EXPECT_LT(quadrupoleError, monopoleError);
+
+    for (Body& body : bodies) body.x += 0.01 * body.y;
+    ASSERT_TRUE(sorted.refit(bodies));
+    double mass = 0.0;
+    for (const Body& body : bodies) mass += body.mass;
+    EXPECT_NEAR(sorted.nodes[0].mass, mass, mass * 1e-12);
+}
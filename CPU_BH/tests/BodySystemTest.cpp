@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+#include "../src/BodySystem.h"
+#include "../src/Simulation.h"
+#include "TestBodies.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Test wyrównania tablic i pojemności zaokrąglonej do pełnych linii 64 bajtów
+TEST(BodySystemTest, ArraysAreAligned) {
+    BodySystem system(random_bodies(37, 1, true));
+    ASSERT_EQ(system.size(), 37u);
+    for (const BodySystem::Array* array : {&system.mass, &system.x, &system.y, &system.z, &system.vx, &system.vy,
+                                           &system.vz, &system.ax, &system.ay, &system.az}) {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(array->data()) % 64, 0u);
+        EXPECT_EQ(array->capacity() % BodySystem::LANE, 0u);
+        EXPECT_EQ(array->size(), 37u);
+    }
+
+    for (int i = 0; i < 30; ++i) system.push_back(Body(1.0, i, i, i, 0.0, 0.0, 0.0));
+    EXPECT_EQ(system.size(), 67u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(system.x.data()) % 64, 0u);
+    EXPECT_DOUBLE_EQ(system.x[66], 29.0);
+}
+
+// Test widoku AoS - odczyt i zapis przez bodies[i] oraz konwersja w obie strony
+TEST(BodySystemTest, AoSViewReadsAndWrites) {
+    std::vector<Body> bodies = random_bodies(10, 2, true);
+    BodySystem system(bodies);
+
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        EXPECT_EQ(system[i].mass, bodies[i].mass);
+        EXPECT_EQ(system[i].x, bodies[i].x);
+        EXPECT_EQ(system[i].vz, bodies[i].vz);
+    }
+
+    system[3].vx += 2.0;
+    system[4] = Body(7.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0);
+    EXPECT_EQ(system.vx[3], bodies[3].vx + 2.0);
+    EXPECT_EQ(system.mass[4], 7.0);
+    EXPECT_EQ(system.vz[4], 6.0);
+
+    Body copy = system[4];
+    EXPECT_EQ(copy.y, 2.0);
+    std::vector<Body> back = system.toBodies();
+    ASSERT_EQ(back.size(), bodies.size());
+    EXPECT_EQ(back[0].z, bodies[0].z);
+    EXPECT_EQ(back[4].vy, 5.0);
+}
+
+// Test zgodności kroków SoA i AoS - te same działania w tej samej kolejności dają identyczny wynik
+TEST(BodySystemTest, StepMatchesAoS) {
+    std::vector<Body> aos = random_bodies(500, 3, true);
+    BodySystem soa(aos);
+    EXPECT_EQ(bounding_octant(soa).size, bounding_octant(aos).size);
+    EXPECT_EQ(bounding_octant(soa).center[0], bounding_octant(aos).center[0]);
+
+    for (bool block : {false, true}) {
+        SimulationContext a, b;
+        a.options.timestepLevels = b.options.timestepLevels = block ? 3 : 0;
+        for (int step = 0; step < 3; ++step) {
+            simulate_step(aos, a);
+            simulate_step(soa, b);
+        }
+        for (size_t i = 0; i < aos.size(); ++i) {
+            EXPECT_EQ(soa.x[i], aos[i].x);
+            EXPECT_EQ(soa.y[i], aos[i].y);
+            EXPECT_EQ(soa.vz[i], aos[i].vz);
+            EXPECT_EQ(soa.ax[i], aos[i].ax);
+        }
+    }
+}
+
+// Test przechowywania w float - połowa pamięci ciał i drzewa, widok AoS zaokrągla wartości
+TEST(BodySystemTest, FloatStorageHalvesMemory) {
+    std::vector<Body> bodies = random_bodies(64, 4, true);
+    BodySystem full(bodies);
+    BodySystemF mixed(bodies);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(mixed.x.data()) % 64, 0u);
+    EXPECT_EQ(mixed.memoryUsage() * 2, full.memoryUsage());
+    EXPECT_EQ(mixed.x[5], static_cast<float>(bodies[5].x));
+    EXPECT_EQ(Body(mixed[5]).mass, static_cast<double>(static_cast<float>(bodies[5].mass)));
+
+    BHTree fullTree;
+    BHTreeF mixedTree;
+    build_bhtree(full, fullTree);
+    build_bhtree(mixed, mixedTree);
+    ASSERT_EQ(mixedTree.nodes.size(), fullTree.nodes.size());
+    EXPECT_LT(sizeof(BHTreeF::Node), sizeof(BHTree::Node));
+    EXPECT_LT(mixedTree.memoryUsage(), fullTree.memoryUsage());
+    EXPECT_NEAR(mixedTree.nodes[0].mass, fullTree.nodes[0].mass, fullTree.nodes[0].mass * 1e-6);
+}
+
+// Test trybu mieszanej precyzji - siły i kolejne kroki bliskie ścieżce double dla każdego sposobu liczenia sił
+TEST(BodySystemTest, MixedPrecisionTracksDouble) {
+    std::vector<Body> bodies = random_bodies(2000, 5, true);
+    for (int mode = 0; mode < 4; ++mode) {
+        BodySystem full(bodies);
+        BodySystemF mixed(bodies);
+        SimulationContext a;
+        SimulationContextF b;
+        if (mode == 1) a.options.traversal = b.options.traversal = TraversalMode::Grouped;
+        if (mode == 2) a.options.solver = b.options.solver = SolverType::FMM;
+        if (mode == 3) a.options.multipoleOrder = b.options.multipoleOrder = BHTree::QUADRUPOLE;
+
+        for (int step = 0; step < 3; ++step) {
+            simulate_step(full, a);
+            simulate_step(mixed, b);
+        }
+        double worst = 0.0;
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            double dx = b.fx[i] - a.fx[i], dy = b.fy[i] - a.fy[i], dz = b.fz[i] - a.fz[i];
+            double norm = std::sqrt(a.fx[i] * a.fx[i] + a.fy[i] * a.fy[i] + a.fz[i] * a.fz[i]);
+            worst = std::max(worst, std::sqrt(dx * dx + dy * dy + dz * dz) / norm);
+            EXPECT_NEAR(mixed.x[i], full.x[i], 1e-3);
+            EXPECT_NEAR(mixed.vy[i], full.vy[i], 1e-5);
+        }
+        EXPECT_LT(worst, 1e-3) << "mode " << mode;
+    }
+}
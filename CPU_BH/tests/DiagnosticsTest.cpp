@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "../src/Diagnostics.h"
+#include "../src/Simulation.h"
+#include "TestBodies.h"
+#include <cmath>
+#include <vector>
+
+// energia potencjalna liczona bezpośrednio, O(N^2)
+static double direct_potential(const std::vector<Body>& bodies) {
+    const double G = 6.67430e-11;
+    double potential = 0.0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        for (size_t j = i + 1; j < bodies.size(); ++j) {
+            double dx = bodies[i].x - bodies[j].x;
+            double dy = bodies[i].y - bodies[j].y;
+            double dz = bodies[i].z - bodies[j].z;
+            potential -= G * bodies[i].mass * bodies[j].mass / std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return potential;
+}
+
+// Test energii potencjalnej z drzewa - theta = 0 daje sumę dokładną, większe theta mały błąd
+TEST(DiagnosticsTest, PotentialMatchesDirectSum) {
+    std::vector<Body> bodies = random_bodies(2000, 1, true);
+    double exact = direct_potential(bodies);
+    BHTree tree;
+
+    EXPECT_NEAR(compute_diagnostics(bodies, tree, 0.0).potential, exact, std::abs(exact) * 1e-10);
+    EXPECT_NEAR(compute_diagnostics(bodies, tree, 0.5).potential, exact, std::abs(exact) * 1e-3);
+
+    // człon kwadrupolowy zmniejsza błąd przy tym samym theta
+    double monopoleError = std::abs(compute_diagnostics(bodies, tree, 0.8).potential - exact);
+    tree.multipoleOrder = BHTree::QUADRUPOLE;
+    double quadrupoleError = std::abs(compute_diagnostics(bodies, tree, 0.8).potential - exact);
+    EXPECT_LT(quadrupoleError, monopoleError);
+}
+
+// Test pędu, momentu pędu i środka masy
+TEST(DiagnosticsTest, MomentumAndCenterOfMass) {
+    std::vector<Body> bodies = {
+        Body(1.0, 1.0, 0.0, 0.0, 0.0, 2.0, 0.0),
+        Body(3.0, -1.0, 0.0, 0.0, 0.0, 0.0, 1.0)
+    };
+    BHTree tree;
+    Diagnostics d = compute_diagnostics(bodies, tree, 0.5);
+
+    EXPECT_DOUBLE_EQ(d.momentum[0], 0.0);
+    EXPECT_DOUBLE_EQ(d.momentum[1], 2.0);
+    EXPECT_DOUBLE_EQ(d.momentum[2], 3.0);
+    // L = m1 * (r1 x v1) + m2 * (r2 x v2) = (0, 0, 2) + (0, 3, 0)
+    EXPECT_DOUBLE_EQ(d.angularMomentum[0], 0.0);
+    EXPECT_DOUBLE_EQ(d.angularMomentum[1], 3.0);
+    EXPECT_DOUBLE_EQ(d.angularMomentum[2], 2.0);
+    EXPECT_DOUBLE_EQ(d.centerOfMass[0], -0.5);
+    EXPECT_DOUBLE_EQ(d.kinetic, 0.5 * 4.0 + 1.5);
+}
+
+// Test próbkowania co `interval` kroków i dryfu energii względem pierwszej próbki
+TEST(DiagnosticsTest, MonitorSamplesAndReportsDrift) {
+    std::vector<Body> bodies = random_bodies(300, 2, true);
+    SimulationContext context;
+    DiagnosticsMonitor monitor;
+    monitor.interval = 5;
+    monitor.theta = 0.0;
+
+    for (int step = 0; step < 20; ++step) {
+        EXPECT_EQ(monitor.sample(bodies, step), step % 5 == 0);
+        simulate_step(bodies, context);
+    }
+
+    ASSERT_EQ(monitor.history().size(), 4u);
+    EXPECT_EQ(monitor.history()[0].energyDrift, 0.0);
+    EXPECT_EQ(monitor.latest().step, 15);
+    const Diagnostics& first = monitor.history().front();
+    const Diagnostics& last = monitor.latest();
+    EXPECT_NEAR(last.energyDrift, (last.total() - first.total()) / std::abs(first.total()), 1e-15);
+    EXPECT_EQ(monitor.energyDrift(), last.energyDrift);
+    EXPECT_LT(std::abs(monitor.energyDrift()), 1e-2);
+
+    // pęd układu izolowanego jest zachowany z dokładnością przybliżenia sił
+    double p0 = std::sqrt(first.momentum[0] * first.momentum[0] + first.momentum[1] * first.momentum[1]);
+    EXPECT_NEAR(last.momentum[0], first.momentum[0], std::abs(p0) * 1e-2 + 1e-3);
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "../src/FMM.h"
+#include "../src/Simulation.h"
+#include "TestBodies.h"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// średni błąd względny sił FMM względem sumy bezpośredniej
+static double fmm_error(const std::vector<Body>& bodies, int order, double theta) {
+    const double G = 6.67430e-11;
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    FMMSolver solver(order);
+    solver.theta = theta;
+    std::vector<double> fx, fy, fz;
+    solver.computeForces(tree, bodies, fx, fy, fz);
+
+    double error = 0.0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        double ex = 0.0, ey = 0.0, ez = 0.0;
+        for (size_t j = 0; j < bodies.size(); ++j) {
+            if (j == i) continue;
+            double dx = bodies[j].x - bodies[i].x;
+            double dy = bodies[j].y - bodies[i].y;
+            double dz = bodies[j].z - bodies[i].z;
+            double dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+            double force = G * bodies[i].mass * bodies[j].mass / (dist * dist * dist);
+            ex += force * dx;
+            ey += force * dy;
+            ez += force * dz;
+        }
+        double diff = std::sqrt((fx[i] - ex) * (fx[i] - ex) + (fy[i] - ey) * (fy[i] - ey) + (fz[i] - ez) * (fz[i] - ez));
+        error += diff / std::sqrt(ex * ex + ey * ey + ez * ez);
+    }
+    return error / bodies.size();
+}
+
+// Test zakresu rzędu rozwinięcia
+TEST(FMMTest, RejectsInvalidOrder) {
+    EXPECT_THROW(FMMSolver(0), std::invalid_argument);
+    EXPECT_THROW(FMMSolver(FMMSolver::MAX_ORDER + 1), std::invalid_argument);
+
+    FMMSolver solver;
+    EXPECT_EQ(solver.order(), FMMSolver::DEFAULT_ORDER);
+    solver.setOrder(6);
+    EXPECT_EQ(solver.order(), 6);
+}
+
+// Test dwóch odległych ciał - siły równe i przeciwne, zgodne z prawem Newtona
+TEST(FMMTest, TwoBodies) {
+    std::vector<Body> bodies = {
+        Body(1.0e12, -50.0, 0.0, 0.0, 0.0, 0.0, 0.0),
+        Body(2.0e12, 50.0, 0.0, 0.0, 0.0, 0.0, 0.0),
+    };
+    EXPECT_LT(fmm_error(bodies, 3, 0.5), 1e-12);
+
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    FMMSolver solver;
+    std::vector<double> fx, fy, fz;
+    solver.computeForces(tree, bodies, fx, fy, fz);
+    EXPECT_NEAR(fx[0], -fx[1], std::abs(fx[0]) * 1e-12);
+    EXPECT_GT(fx[0], 0.0);
+}
+
+// Test dokładności: błąd maleje wraz ze wzrostem rzędu rozwinięcia
+TEST(FMMTest, ErrorDecreasesWithOrder) {
+    std::vector<Body> bodies = random_bodies(3000, 3);
+    double previous = fmm_error(bodies, 1, 0.5);
+    for (int order : {2, 4, 6}) {
+        double error = fmm_error(bodies, order, 0.5);
+        EXPECT_LT(error, previous);
+        previous = error;
+    }
+    EXPECT_LT(previous, 1e-4);
+}
+
+// Test zgodności z Barnes-Hut przy małym theta (krok symulacji z wyborem solvera)
+TEST(FMMTest, SimulationStepMatchesBarnesHut) {
+    std::vector<Body> a = random_bodies(500, 4);
+    std::vector<Body> b = a;
+
+    SimulationContext barnesHut, fmm;
+    barnesHut.options.theta = 0.1;
+    fmm.options.solver = SolverType::FMM;
+    fmm.options.fmmOrder = 6;
+    simulate_step(a, barnesHut);
+    simulate_step(b, fmm);
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        double norm = std::sqrt(a[i].ax * a[i].ax + a[i].ay * a[i].ay + a[i].az * a[i].az);
+        EXPECT_NEAR(b[i].ax, a[i].ax, norm * 1e-2);
+        EXPECT_NEAR(b[i].ay, a[i].ay, norm * 1e-2);
+        EXPECT_NEAR(b[i].az, a[i].az, norm * 1e-2);
+    }
+}
@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+#include "../src/GroupWalk.h"
+#include "../src/Simulation.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+// kilka zwartych skupisk ciał
+static std::vector<Body> clustered_bodies(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> spread(0.0, 5.0);
+    std::uniform_real_distribution<double> centre(-500.0, 500.0);
+    std::vector<Body> bodies;
+    double cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int i = 0; i < n; ++i) {
+        if (i % 250 == 0) {
+            cx = centre(rng);
+            cy = centre(rng);
+            cz = centre(rng);
+        }
+        bodies.emplace_back(1.0e12, cx + spread(rng), cy + spread(rng), cz + spread(rng), 0.0, 0.0, 0.0);
+    }
+    return bodies;
+}
+
+// Test listy oddziaływań
+TEST(GroupWalkTest, InteractionListAddAndClear) {
+    InteractionList list;
+    list.add(1.0, 2.0, 3.0, 4.0);
+    list.add(5.0, 6.0, 7.0, 8.0);
+
+    ASSERT_EQ(list.size(), 2u);
+    EXPECT_DOUBLE_EQ(list.z[1], 7.0);
+    EXPECT_DOUBLE_EQ(list.mass[0], 4.0);
+
+    list.clear();
+    EXPECT_EQ(list.size(), 0u);
+}
+
+// Test zgodności przejścia grupowego z przejściem pojedynczym dla tego samego theta
+TEST(GroupWalkTest, MatchesPerBodyWalk) {
+    std::vector<Body> bodies = clustered_bodies(2000, 1);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    tree.flatten();
+
+    std::vector<double> fx(bodies.size()), fy(bodies.size()), fz(bodies.size());
+    GroupWalkStats stats = compute_forces_grouped(tree, bodies, 0.5, 16, fx, fy, fz);
+    EXPECT_GT(stats.groups, 0u);
+    EXPECT_GT(stats.interactions, 0u);
+
+    for (uint32_t i = 0; i < bodies.size(); i += 41) {
+        double ex = 0.0, ey = 0.0, ez = 0.0;
+        tree.calculateForce(bodies, i, ex, ey, ez, 0.05);   // prawie dokładna wartość odniesienia
+        double norm = std::sqrt(ex * ex + ey * ey + ez * ez);
+        EXPECT_NEAR(fx[i], ex, norm * 0.02);
+        EXPECT_NEAR(fy[i], ey, norm * 0.02);
+        EXPECT_NEAR(fz[i], ez, norm * 0.02);
+    }
+}
+
+// Test przy theta = 0 - lista zawiera wszystkie ciała, wynik jest sumą bezpośrednią
+TEST(GroupWalkTest, ZeroThetaIsDirectSum) {
+    std::vector<Body> bodies = clustered_bodies(300, 2);
+    BHTree tree;
+    build_bhtree(bodies, tree);
+    tree.flatten();
+
+    std::vector<double> fx(bodies.size()), fy(bodies.size()), fz(bodies.size());
+    GroupWalkStats stats = compute_forces_grouped(tree, bodies, 0.0, 8, fx, fy, fz);
+    EXPECT_EQ(stats.interactions, bodies.size() * bodies.size());
+
+    double ex = 0.0, ey = 0.0, ez = 0.0;
+    tree.calculateForce(bodies, 5, ex, ey, ez, 0.0);
+    EXPECT_NEAR(fx[5], ex, std::abs(ex) * 1e-9);
+    EXPECT_NEAR(fy[5], ey, std::abs(ey) * 1e-9);
+}
+
+// Test przejścia grupowego z kwadrupolami
+TEST(GroupWalkTest, QuadrupoleImprovesGroupedForces) {
+    std::vector<Body> bodies = clustered_bodies(2000, 3);
+    BHTree monopole, quadrupole;
+    quadrupole.multipoleOrder = BHTree::QUADRUPOLE;
+    build_bhtree(bodies, monopole);
+    build_bhtree(bodies, quadrupole);
+    monopole.flatten();
+    quadrupole.flatten();
+
+    std::vector<double> mx(bodies.size()), my(bodies.size()), mz(bodies.size());
+    std::vector<double> qx(bodies.size()), qy(bodies.size()), qz(bodies.size());
+    compute_forces_grouped(monopole, bodies, 1.0, 16, mx, my, mz);
+    compute_forces_grouped(quadrupole, bodies, 1.0, 16, qx, qy, qz);
+
+    double monopoleError = 0.0, quadrupoleError = 0.0;
+    for (uint32_t i = 0; i < bodies.size(); i += 13) {
+        double ex = 0.0, ey = 0.0, ez = 0.0;
+        monopole.calculateForce(bodies, i, ex, ey, ez, 0.0);
+        double norm = std::sqrt(ex * ex + ey * ey + ez * ez);
+        monopoleError += std::sqrt((mx[i] - ex) * (mx[i] - ex) + (my[i] - ey) * (my[i] - ey) + (mz[i] - ez) * (mz[i] - ez)) / norm;
+        quadrupoleError += std::sqrt((qx[i] - ex) * (qx[i] - ex) + (qy[i] - ey) * (qy[i] - ey) + (qz[i] - ez) * (qz[i] - ez)) / norm;
+    }
+    EXPECT_LT(quadrupoleError, monopoleError);
+}
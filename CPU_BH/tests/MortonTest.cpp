@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+#include "../src/Morton.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Test przeplatania bitów - bit osi x na pozycji 3i, y na 3i+1, z na 3i+2
+TEST(MortonTest, KeyInterleavesBits) {
+    EXPECT_EQ(morton_key(1, 0, 0), 1u);
+    EXPECT_EQ(morton_key(0, 1, 0), 2u);
+    EXPECT_EQ(morton_key(0, 0, 1), 4u);
+    EXPECT_EQ(morton_key(2, 0, 0), 8u);
+    EXPECT_EQ(morton_key(0x1fffff, 0x1fffff, 0x1fffff), 0x7fffffffffffffffULL);
+}
+
+// Test wyboru oktantu na kolejnych głębokościach
+TEST(MortonTest, OctantAtDepth) {
+    uint32_t top = 1u << (MORTON_BITS - 1);
+    uint64_t key = morton_key(top, 0, top);
+    EXPECT_EQ(morton_octant(key, 0), 5);
+    EXPECT_EQ(morton_octant(key, 1), 0);
+    EXPECT_EQ(morton_octant(morton_key(0, 1, 0), MORTON_BITS - 1), 2);
+}
+
+// Test kluczy 2D - bit osi x na pozycji 2i, y na 2i+1; dziecko zgodne z Quadrant::getSubOctant
+TEST(MortonTest, PlanarKeyInterleavesBits) {
+    EXPECT_EQ(morton_key<2>({1, 0}), 1u);
+    EXPECT_EQ(morton_key<2>({0, 1}), 2u);
+    EXPECT_EQ(morton_key<2>({2, 0}), 4u);
+    EXPECT_EQ(morton_key<2>({0x7fffffff, 0x7fffffff}), 0x3fffffffffffffffULL);
+    EXPECT_EQ(morton_key<3>({1, 2, 3}), morton_key(1, 2, 3));
+
+    uint32_t top = 1u << (morton_bits<2>() - 1);
+    uint64_t key = morton_key<2>({0, top});
+    EXPECT_EQ(morton_child<2>(key, 0), 2);
+    EXPECT_EQ(morton_child<2>(key, 1), 0);
+    EXPECT_EQ(morton_child<2>(morton_key<2>({1, 1}), morton_bits<2>() - 1), 3);
+    EXPECT_EQ(morton_child<3>(key, 4), morton_octant(key, 4));
+}
+
+// Test sortowania pozycyjnego - wynik posortowany i stabilny
+TEST(MortonTest, RadixSortIsSortedAndStable) {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> keys(20000);
+    std::vector<uint32_t> values(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = rng() % 5000;     // dużo powtórzeń
+        values[i] = static_cast<uint32_t>(i);
+    }
+    std::vector<uint64_t> expectedKeys = keys;
+    std::vector<uint32_t> expectedValues = values;
+    std::stable_sort(expectedValues.begin(), expectedValues.end(),
+                     [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    std::sort(expectedKeys.begin(), expectedKeys.end());
+
+    std::vector<uint64_t> keysScratch;
+    std::vector<uint32_t> valuesScratch;
+    radix_sort(keys, values, keysScratch, valuesScratch);
+
+    EXPECT_EQ(keys, expectedKeys);
+    EXPECT_EQ(values, expectedValues);
+}
+
+// Test sumy prefiksowej
+TEST(MortonTest, ExclusiveScan) {
+    std::vector<uint32_t> values = {3, 0, 2, 5, 1};
+    size_t total = exclusive_scan(values, values.size());
+
+    EXPECT_EQ(total, 11u);
+    EXPECT_EQ(values, (std::vector<uint32_t>{0, 3, 3, 5, 10}));
+}
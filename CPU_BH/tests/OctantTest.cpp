@@ -3,17 +3,17 @@
 
 // Test konstruktora klasy Octant
 TEST(OctantTest, ConstructorTest) {
-    Octant octant(0.0, 0.0, 0.0, 10.0);
+    Octant octant({0.0, 0.0, 0.0}, 10.0);
 
-    EXPECT_DOUBLE_EQ(octant.x, 0.0);
-    EXPECT_DOUBLE_EQ(octant.y, 0.0);
-    EXPECT_DOUBLE_EQ(octant.z, 0.0);
+    EXPECT_DOUBLE_EQ(octant.center[0], 0.0);
+    EXPECT_DOUBLE_EQ(octant.center[1], 0.0);
+    EXPECT_DOUBLE_EQ(octant.center[2], 0.0);
     EXPECT_DOUBLE_EQ(octant.size, 10.0);
 }
 
 // Test funkcji contains dla punktu wewnątrz octanta
 TEST(OctantTest, ContainsPointInside) {
-    Octant octant(0.0, 0.0, 0.0, 10.0);
+    Octant octant({0.0, 0.0, 0.0}, 10.0);
     Body body(1.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0); // Punkt w środku octanta
 
     EXPECT_TRUE(octant.contains(body));
@@ -21,7 +21,7 @@ TEST(OctantTest, ContainsPointInside) {
 
 // Test funkcji contains dla punktu na krawędzi octanta
 TEST(OctantTest, ContainsPointOnEdge) {
-    Octant octant(0.0, 0.0, 0.0, 10.0);
+    Octant octant({0.0, 0.0, 0.0}, 10.0);
     Body body(1.0, 5.0, 0.0, 0.0, 0.0, 0.0, 0.0); // Punkt na krawędzi octanta
 
     EXPECT_TRUE(octant.contains(body));
@@ -29,7 +29,7 @@ TEST(OctantTest, ContainsPointOnEdge) {
 
 // Test funkcji contains dla punktu poza octantem
 TEST(OctantTest, ContainsPointOutside) {
-    Octant octant(0.0, 0.0, 0.0, 10.0);
+    Octant octant({0.0, 0.0, 0.0}, 10.0);
     Body body(1.0, 6.0, 6.0, 6.0, 0.0, 0.0, 0.0); // Punkt poza octantem
 
     EXPECT_FALSE(octant.contains(body));
@@ -37,17 +37,36 @@ TEST(OctantTest, ContainsPointOutside) {
 
 // Test funkcji getSubOctant
 TEST(OctantTest, GetSubOctantTest) {
-    Octant octant(0.0, 0.0, 0.0, 10.0);
+    Octant octant({0.0, 0.0, 0.0}, 10.0);
 
     Octant subOctant = octant.getSubOctant(0); // Suboctant o indeksie 0
-    EXPECT_DOUBLE_EQ(subOctant.x, -2.5);
-    EXPECT_DOUBLE_EQ(subOctant.y, -2.5);
-    EXPECT_DOUBLE_EQ(subOctant.z, -2.5);
+    EXPECT_DOUBLE_EQ(subOctant.center[0], -2.5);
+    EXPECT_DOUBLE_EQ(subOctant.center[1], -2.5);
+    EXPECT_DOUBLE_EQ(subOctant.center[2], -2.5);
     EXPECT_DOUBLE_EQ(subOctant.size, 5.0);
 
     Octant subOctant1 = octant.getSubOctant(7); // Suboctant o indeksie 7
-    EXPECT_DOUBLE_EQ(subOctant1.x, 2.5);
-    EXPECT_DOUBLE_EQ(subOctant1.y, 2.5);
-    EXPECT_DOUBLE_EQ(subOctant1.z, 2.5);
+    EXPECT_DOUBLE_EQ(subOctant1.center[0], 2.5);
+    EXPECT_DOUBLE_EQ(subOctant1.center[1], 2.5);
+    EXPECT_DOUBLE_EQ(subOctant1.center[2], 2.5);
     EXPECT_DOUBLE_EQ(subOctant1.size, 5.0);
 }
+
+// Test kwadrantu (drzewo czwórkowe) - cztery dzieci, współrzędna z ciała pomijana
+TEST(OctantTest, QuadrantSubdivisionIgnoresZ) {
+    Quadrant quadrant({0.0, 0.0}, 10.0);
+    EXPECT_EQ(Quadrant::CHILDREN, 4);
+    EXPECT_EQ(Octant::CHILDREN, 8);
+
+    Quadrant upper = quadrant.getSubOctant(3);
+    EXPECT_DOUBLE_EQ(upper.center[0], 2.5);
+    EXPECT_DOUBLE_EQ(upper.center[1], 2.5);
+    EXPECT_DOUBLE_EQ(upper.size, 5.0);
+
+    Quadrant mixed = quadrant.getSubOctant(2);
+    EXPECT_DOUBLE_EQ(mixed.center[0], -2.5);
+    EXPECT_DOUBLE_EQ(mixed.center[1], 2.5);
+
+    EXPECT_TRUE(quadrant.contains(Body(1.0, 4.0, -4.0, 1.0e6, 0.0, 0.0, 0.0)));
+    EXPECT_FALSE(quadrant.contains(Body(1.0, 6.0, 0.0, 0.0, 0.0, 0.0, 0.0)));
+}
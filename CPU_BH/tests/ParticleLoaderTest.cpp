@@ -0,0 +1,196 @@
+#include "gtest/gtest.h"
+#include "../src/ParticleLoader.h"
+#include "../src/Simulation.h"
+#include "../src/Trajectory.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static void write_file(const std::string& filename, const std::string& contents) {
+    std::ofstream out(filename, std::ios::binary);
+    out << contents;
+}
+
+static std::vector<Body> loader_bodies(int n) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> value(-1.0e3, 1.0e3);
+    std::vector<Body> bodies;
+    for (int i = 0; i < n; ++i) {
+        bodies.emplace_back(1.0e10 + std::abs(value(rng)) * 1.0e6, value(rng), value(rng), value(rng), value(rng),
+                            value(rng), value(rng));
+    }
+    return bodies;
+}
+
+static void expect_same_bodies(const BodySystem& loaded, const std::vector<Body>& expected) {
+    ASSERT_EQ(loaded.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(loaded.x[i], expected[i].x) << i;
+        EXPECT_EQ(loaded.y[i], expected[i].y) << i;
+        EXPECT_EQ(loaded.z[i], expected[i].z) << i;
+        EXPECT_EQ(loaded.vx[i], expected[i].vx) << i;
+        EXPECT_EQ(loaded.vy[i], expected[i].vy) << i;
+        EXPECT_EQ(loaded.vz[i], expected[i].vz) << i;
+        EXPECT_EQ(loaded.mass[i], expected[i].mass) << i;
+        EXPECT_EQ(loaded.ax[i], 0.0);
+    }
+}
+
+// liczby zapisane z 17 cyframi wczytują się bit w bit niezależnie od podziału pliku na fragmenty - także gdy
+// granica fragmentu wypada w środku linii, w komentarzu albo w pustej linii
+TEST(ParticleLoaderTest, CsvWithHeaderIsSplitAtLineBoundaries) {
+    const std::string filename = "particles_test.csv";
+    const std::vector<Body> bodies = loader_bodies(200);
+    std::ostringstream csv;
+    csv.precision(17);
+    csv << "# warunki poczatkowe\r\nid; mass; x; y; z; vx; vy; vz\r\n";
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        const Body& b = bodies[i];
+        csv << i << "; " << b.mass << "; " << b.x << ";" << b.y << "; +" << b.z << "\t;" << b.vx << ";" << b.vy
+            << ";" << b.vz << "\r\n";
+        if (i % 37 == 0) csv << "\r\n# komentarz\r\n";
+    }
+    write_file(filename, csv.str());
+
+    for (int chunks : {1, 3, 16, 1000}) {
+        BodySystem loaded;
+        ASSERT_TRUE(load_particles(filename, loaded, chunks)) << chunks;
+        expect_same_bodies(loaded, bodies);
+    }
+    std::remove(filename.c_str());
+}
+
+// bez nagłówka: 7 kolumn to x, y, z, vx, vy, vz, mass, 4 - x, y, z, mass (prędkości zerowe)
+TEST(ParticleLoaderTest, CsvWithoutHeader) {
+    const std::string filename = "particles_plain_test.csv";
+    write_file(filename, "1,2,3,4,5,6,7\n-1e3, 2.5e-2, 0, 0, 0, 0, 1e24\n");
+    BodySystem loaded;
+    ASSERT_TRUE(load_particles(filename, loaded));
+    ASSERT_EQ(loaded.size(), 2u);
+    EXPECT_EQ(loaded.vz[0], 6.0);
+    EXPECT_EQ(loaded.mass[0], 7.0);
+    EXPECT_EQ(loaded.x[1], -1.0e3);
+    EXPECT_EQ(loaded.y[1], 2.5e-2);
+
+    write_file(filename, "1 2 3 10\n4 5 6 20");
+    ASSERT_TRUE(load_particles(filename, loaded, 2));
+    ASSERT_EQ(loaded.size(), 2u);
+    EXPECT_EQ(loaded.z[1], 6.0);
+    EXPECT_EQ(loaded.vx[1], 0.0);
+    EXPECT_EQ(loaded.mass[1], 20.0);
+    std::remove(filename.c_str());
+}
+
+TEST(ParticleLoaderTest, MalformedFilesAreRejected) {
+    const std::string filename = "particles_bad_test.csv";
+    BodySystem loaded;
+    write_file(filename, "x,y,z,mass\n1,2,3,4\n1,2,oops,4\n");
+    EXPECT_FALSE(load_particles(filename, loaded, 2));
+    write_file(filename, "1,2,3,4,5\n");
+    EXPECT_FALSE(load_particles(filename, loaded));
+    write_file(filename, "x,y,z\n1,2,3\n");
+    EXPECT_FALSE(load_particles(filename, loaded));
+    write_file(filename, "# tylko komentarz\n");
+    EXPECT_FALSE(load_particles(filename, loaded));
+    EXPECT_FALSE(load_particles("brak_pliku.csv", loaded));
+    std::remove(filename.c_str());
+}
+
+// surowe rekordy 7 x float64 (np. numpy tofile())
+TEST(ParticleLoaderTest, RawBinaryRecords) {
+    const std::string filename = "particles_test.bin";
+    const std::vector<Body> bodies = loader_bodies(50);
+    std::vector<double> records;
+    for (const Body& b : bodies) records.insert(records.end(), {b.x, b.y, b.z, b.vx, b.vy, b.vz, b.mass});
+    write_file(filename, std::string(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(double)));
+
+    BodySystem loaded;
+    ASSERT_TRUE(load_particles(filename, loaded));
+    expect_same_bodies(loaded, bodies);
+
+    BodySystemF loadedFloat;
+    ASSERT_TRUE(load_particles(filename, loadedFloat));
+    EXPECT_EQ(loadedFloat.x[7], static_cast<float>(bodies[7].x));
+
+    write_file(filename, std::string(reinterpret_cast<const char*>(records.data()), 6 * sizeof(double)));
+    EXPECT_FALSE(load_particles(filename, loaded));
+    std::remove(filename.c_str());
+}
+
+// zapis cpu-proj (jedna linia na klatkę) i GPU_BH / GPU_2_pair (wcięty, klucze p, v, m, bez z w 2D);
+// wczytywana jest ostatnia klatka
+TEST(ParticleLoaderTest, LastFrameOfJsonSnapshots) {
+    const std::string filename = "particles_test.json";
+    const std::vector<Body> bodies = loader_bodies(60);
+    std::ostringstream json;
+    json.precision(17);
+    json << "[\n";
+    for (int frame = 0; frame < 2; ++frame) {
+        json << (frame ? ",\n" : "") << "{\"step\":" << frame << ",\"timestamp\":0,\"bodies\":[";
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            const Body& b = bodies[i];
+            const double shift = frame == 0 ? 1.0 : 0.0;
+            json << (i ? "," : "") << "{\"position\":{\"x\":" << b.x + shift << ",\"y\":" << b.y << ",\"z\":" << b.z
+                 << "},\"velocity\":{\"x\":" << b.vx << ",\"y\":" << b.vy << ",\"z\":" << b.vz
+                 << "},\"acceleration\":{\"x\":1.0,\"y\":null,\"z\":2.0},\"mass\":" << b.mass << "}";
+        }
+        json << "]}";
+    }
+    json << "\n]";
+    write_file(filename, json.str());
+    for (int chunks : {1, 5, 200}) {
+        BodySystem loaded;
+        ASSERT_TRUE(load_particles(filename, loaded, chunks)) << chunks;
+        expect_same_bodies(loaded, bodies);
+    }
+
+    const std::string gpuFilename = "particles_gpu_test.json";
+    write_file(gpuFilename, "[\n  {\n    \"bodies\": [\n      {\n        \"a\": {\n          \"x\": 0.0,\n"
+                            "          \"y\": 0.0\n        },\n        \"id\": 0,\n        \"m\": 1e+16,\n"
+                            "        \"p\": {\n          \"x\": 12517.1376953125,\n          \"y\": -3.5\n        },\n"
+                            "        \"v\": {\n          \"x\": -8540.5,\n          \"y\": 2.0\n        }\n      },\n"
+                            "      {\n        \"id\": 1,\n        \"m\": 2e+16,\n        \"p\": {\"x\": 1.0, \"y\": 2.0},\n"
+                            "        \"v\": {\"x\": 0.0, \"y\": 0.0}\n      }\n    ]\n  }\n]");
+    BodySystem loaded;
+    ASSERT_TRUE(load_particles(gpuFilename, loaded, 3));
+    ASSERT_EQ(loaded.size(), 2u);
+    EXPECT_EQ(loaded.mass[0], 1.0e16);
+    EXPECT_EQ(loaded.x[0], 12517.1376953125);
+    EXPECT_EQ(loaded.y[0], -3.5);
+    EXPECT_EQ(loaded.z[0], 0.0);
+    EXPECT_EQ(loaded.vx[0], -8540.5);
+    EXPECT_EQ(loaded.mass[1], 2.0e16);
+
+    // niekompletna ostatnia klatka (przerwany zapis) i ciało bez masy
+    write_file(gpuFilename, "{\"bodies\":[{\"p\":{\"x\":1,\"y\":2},\"m\":3},{\"p\":{\"x\":1");
+    EXPECT_FALSE(load_particles(gpuFilename, loaded));
+    write_file(gpuFilename, "{\"bodies\":[{\"p\":{\"x\":1,\"y\":2},\"m\":3},{\"p\":{\"x\":1,\"y\":2}}]}\n");
+    EXPECT_FALSE(load_particles(gpuFilename, loaded));
+    std::remove(filename.c_str());
+    std::remove(gpuFilename.c_str());
+}
+
+// przebieg może zacząć się od ostatniej klatki trajektorii .nbt (przyspieszenia są zerowane)
+TEST(ParticleLoaderTest, LastFrameOfTrajectory) {
+    const std::string filename = "particles_test.nbt";
+    BodySystem bodies(loader_bodies(20));
+    TrajectoryWriter writer;
+    ASSERT_TRUE(writer.open<double>(filename, bodies.size(), TIME_STEP));
+    writer.sample(bodies, 0, 0.0);
+    bodies.x[4] = 123.0;
+    bodies.ax[4] = 5.0;
+    writer.sample(bodies, 1, TIME_STEP);
+    writer.close();
+
+    BodySystem loaded;
+    ASSERT_TRUE(load_particles(filename, loaded));
+    ASSERT_EQ(loaded.size(), 20u);
+    EXPECT_EQ(loaded.x[4], 123.0);
+    EXPECT_EQ(loaded.ax[4], 0.0);
+    EXPECT_EQ(loaded.mass[19], bodies.mass[19]);
+    std::remove(filename.c_str());
+}
@@ -1,6 +1,7 @@
 #include "gtest/gtest.h"
 #include "../src/Simulation.h"
 #include "../src/Body.h"
+#include "../src/BodySystem.h"
 #include <vector>
 #include <cmath>
 
@@ -54,7 +55,7 @@ TEST(SimulationTest, SimulateStepTest) {
     }
 }
 
-// Test funkcji calculate_total_energy
+// Test energii całkowitej (compute_diagnostics)
 TEST(SimulationTest, CalculateTotalEnergyTest) {
     // Tworzymy wektor ciał z przykładowymi danymi
     std::vector<Body> bodies = {
@@ -82,9 +83,189 @@ TEST(SimulationTest, CalculateTotalEnergyTest) {
 
     double expected_energy = kinetic_total + potential_total;
 
-    // Obliczamy energię po symulacji
-    calculate_total_energy(bodies);
+    // Energia z modułu diagnostyki (theta = 0 - suma dokładna)
+    BHTree tree;
+    Diagnostics diagnostics = compute_diagnostics(bodies, tree, 0.0);
 
-    // Testujemy, czy energia całkowita nie jest zerowa
-    EXPECT_NEAR(kinetic_total + potential_total, expected_energy, 1e-10);
-}
\ No newline at end of file
+    EXPECT_NEAR(diagnostics.kinetic, kinetic_total, 1e-12);
+    EXPECT_NEAR(diagnostics.total(), expected_energy, std::abs(expected_energy) * 1e-9);
+}
+// Test opcji wiersza poleceń
+TEST(SimulationTest, ParseSimulationOptions) {
+    SimulationOptions options;
+    char program[] = "Simulation";
+    char flag[] = "--traversal";
+    char value[] = "recursive";
+    char* argv[] = {program, flag, value};
+
+    EXPECT_TRUE(parse_simulation_options(3, argv, options));
+    EXPECT_EQ(options.traversal, TraversalMode::Recursive);
+
+    char wrong[] = "sideways";
+    argv[2] = wrong;
+    EXPECT_FALSE(parse_simulation_options(3, argv, options));
+}
+
+// Test opcji --dimensions - FMM i przejście grupowe są tylko trójwymiarowe
+TEST(SimulationTest, ParseDimensions) {
+    SimulationOptions options;
+    char program[] = "Simulation";
+    char flag[] = "--dimensions";
+    char value[] = "2";
+    char traversal[] = "--traversal";
+    char grouped[] = "grouped";
+    char* argv[] = {program, flag, value, traversal, grouped};
+
+    EXPECT_TRUE(parse_simulation_options(3, argv, options));
+    EXPECT_EQ(options.dimensions, 2);
+    EXPECT_FALSE(parse_simulation_options(5, argv, options));
+
+    char four[] = "4";
+    argv[2] = four;
+    EXPECT_FALSE(parse_simulation_options(3, argv, options));
+}
+
+// Test wartości liczbowych - niepoprawny tekst, liczba z dopiskiem i ujemna theta dają false zamiast wyjątku
+TEST(SimulationTest, ParseRejectsMalformedNumbers) {
+    SimulationOptions options;
+    auto parse = [&](const char* flag, const char* value) {
+        std::string program = "Simulation", f = flag, v = value;
+        char* argv[] = {program.data(), f.data(), v.data()};
+        return parse_simulation_options(3, argv, options);
+    };
+
+    EXPECT_TRUE(parse("--theta", "0.5"));
+    EXPECT_DOUBLE_EQ(options.theta, 0.5);
+    EXPECT_FALSE(parse("--theta", "abc"));
+    EXPECT_FALSE(parse("--theta", "-1"));
+    EXPECT_FALSE(parse("--theta", "0.5x"));
+    EXPECT_FALSE(parse("--theta", ""));
+    EXPECT_DOUBLE_EQ(options.theta, 0.5);
+
+    EXPECT_TRUE(parse("--group-size", "16"));
+    EXPECT_EQ(options.groupSize, 16);
+    EXPECT_FALSE(parse("--group-size", "x"));
+    EXPECT_FALSE(parse("--group-size", "99999999999"));
+    EXPECT_FALSE(parse("--leaf-size", "4.5"));
+    EXPECT_FALSE(parse("--fmm-order", "nan"));
+    EXPECT_FALSE(parse("--max-migrated", "inf"));
+    EXPECT_FALSE(parse("--timestep-eta", "0"));
+    EXPECT_FALSE(parse("--diagnostics-interval", "-1"));
+    EXPECT_FALSE(parse("--output-interval", "0"));
+}
+
+// Test kroku z drzewem czwórkowym dla płaskiego dysku - bliski krokowi z drzewem ósemkowym, bez ruchu w z
+TEST(SimulationTest, PlanarStepMatchesOctree) {
+    std::vector<Body> disk;
+    for (int i = 0; i < 300; ++i) {
+        double r = 50.0 + i, phi = i * 2.399;
+        disk.emplace_back(1.0e20, r * std::cos(phi), r * std::sin(phi), 0.0, -std::sin(phi), std::cos(phi), 0.0);
+    }
+    BodySystem planar(disk), spatial(disk);
+    SimulationContextT<double, 2> quadtree;
+    SimulationContext octree;
+    quadtree.options.theta = octree.options.theta = 0.3;
+    quadtree.options.dimensions = 2;
+    for (int step = 0; step < 3; ++step) {
+        simulate_step(planar, quadtree);
+        simulate_step(spatial, octree);
+    }
+
+    for (size_t i = 0; i < disk.size(); ++i) {
+        EXPECT_EQ(planar[i].z, 0.0);
+        EXPECT_EQ(planar[i].vz, 0.0);
+        EXPECT_NEAR(planar[i].ax, spatial[i].ax, std::abs(spatial[i].ax) * 0.05 + 1e-3);
+        EXPECT_NEAR(planar[i].x, spatial[i].x, 1e-6 * std::abs(spatial[i].x));
+    }
+}
+
+// Test, czy oba tryby przechodzenia drzewa dają ten sam krok symulacji
+TEST(SimulationTest, TraversalModesAgree) {
+    std::vector<Body> a;
+    for (int i = 0; i < 200; ++i) {
+        a.emplace_back(1.0e20, std::cos(i * 0.7) * (100.0 + i), std::sin(i * 1.3) * 80.0, i * 0.5, 0.0, 0.0, 0.0);
+    }
+    std::vector<Body> b = a;
+
+    SimulationContext recursive, stackless;
+    recursive.options.traversal = TraversalMode::Recursive;
+    stackless.options.traversal = TraversalMode::Stackless;
+    simulate_step(a, recursive);
+    simulate_step(b, stackless);
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(a[i].x, b[i].x);
+        EXPECT_EQ(a[i].vy, b[i].vy);
+    }
+}
+
+// Test trybu refit - kolejne kroki bliskie krokom z pełną budową drzewa, z mniejszą liczbą budów
+TEST(SimulationTest, RefitStepsMatchRebuild) {
+    std::vector<Body> a;
+    for (int i = 0; i < 500; ++i) {
+        a.emplace_back(1.0e12, std::cos(i * 0.7) * (100.0 + i), std::sin(i * 1.3) * 80.0, i * 0.5,
+                       std::sin(i * 0.3), std::cos(i * 0.9), 0.0);
+    }
+    std::vector<Body> b = a;
+
+    // małe theta - oba drzewa dają prawie dokładne siły, mimo różnych korzeni
+    SimulationContext rebuild, refit;
+    rebuild.options.theta = 0.1;
+    refit.options.theta = 0.1;
+    refit.options.refit = true;
+    for (int step = 0; step < 10; ++step) {
+        simulate_step(a, rebuild);
+        simulate_step(b, refit);
+    }
+
+    EXPECT_EQ(rebuild.rebuilds, 10u);
+    EXPECT_EQ(refit.rebuilds + refit.refits, 10u);
+    EXPECT_GT(refit.refits, 0u);
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_NEAR(a[i].x, b[i].x, 1e-6 * (1.0 + std::abs(a[i].x)));
+        EXPECT_NEAR(a[i].vy, b[i].vy, 1e-4 * (1.0 + std::abs(a[i].vy)));
+    }
+}
+
+// ciasna para ciał na orbicie kołowej i lekkie, odległe ciała - tylko para wymaga krótkiego kroku
+static std::vector<Body> binary_with_field(int field) {
+    const double mass = 1.0e12, separation = 1.0;
+    const double speed = std::sqrt(G * mass / (2.0 * separation));
+    std::vector<Body> bodies = {
+        Body(mass, -0.5 * separation, 0.0, 0.0, 0.0, -speed, 0.0),
+        Body(mass, 0.5 * separation, 0.0, 0.0, 0.0, speed, 0.0)
+    };
+    for (int i = 0; i < field; ++i) {
+        double angle = i * 2.399963;
+        double radius = 100.0 + 5.0 * i;
+        bodies.emplace_back(1.0e8, radius * std::cos(angle), radius * std::sin(angle), (i % 7) - 3.0, 0.0, 0.0, 0.0);
+    }
+    return bodies;
+}
+
+// Test hierarchicznych kroków czasowych - wynik jak przy wspólnym najkrótszym kroku przy wielokrotnie mniejszej
+// liczbie obliczeń sił
+TEST(SimulationTest, BlockTimestepsMatchFineSharedStep) {
+    std::vector<Body> fine = binary_with_field(100);
+    std::vector<Body> block = fine;
+
+    SimulationContext shared, hierarchical;
+    shared.options.timestepLevels = 6;
+    shared.options.timestepEta = 1e-12;     // wszystkie ciała na najkrótszym kroku
+    hierarchical.options.timestepLevels = 6;
+    for (int step = 0; step < 10; ++step) {
+        simulate_step(fine, shared);
+        simulate_step(block, hierarchical);
+    }
+
+    for (size_t i = 0; i < fine.size(); ++i) {
+        EXPECT_NEAR(block[i].x, fine[i].x, 1e-3);
+        EXPECT_NEAR(block[i].y, fine[i].y, 1e-3);
+        EXPECT_NEAR(block[i].z, fine[i].z, 1e-3);
+    }
+    EXPECT_LT(hierarchical.forceEvaluations * 10, shared.forceEvaluations);
+
+    // para ciał pozostaje na orbicie o niezmienionej odległości
+    double dx = block[1].x - block[0].x, dy = block[1].y - block[0].y;
+    EXPECT_NEAR(std::sqrt(dx * dx + dy * dy), 1.0, 1e-2);
+}
@@ -0,0 +1,27 @@
+#ifndef TEST_BODIES_H
+#define TEST_BODIES_H
+
+#include <random>
+#include <vector>
+#include "../src/Body.h"
+
+// Wspólne ciała testowe: pozycje w sześcianie [-100, 100], masy [1e10, 1e12]. Prędkości z [-1, 1] losowane są
+// tylko dla `moving` - bez nich ciała spoczywają, a ten sam seed daje te same pozycje i masy.
+inline std::vector<Body> random_bodies(int n, unsigned seed, bool moving = false) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(-100.0, 100.0);
+    std::uniform_real_distribution<double> vel(-1.0, 1.0);
+    std::uniform_real_distribution<double> mass(1.0e10, 1.0e12);
+    std::vector<Body> bodies;
+    for (int i = 0; i < n; ++i) {
+        if (moving) {
+            bodies.emplace_back(mass(rng), pos(rng), pos(rng), pos(rng), vel(rng), vel(rng), vel(rng));
+        }
+        else {
+            bodies.emplace_back(mass(rng), pos(rng), pos(rng), pos(rng), 0.0, 0.0, 0.0);
+        }
+    }
+    return bodies;
+}
+
+#endif // TEST_BODIES_H
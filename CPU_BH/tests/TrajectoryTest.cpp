@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "../src/Trajectory.h"
+#include "../src/Simulation.h"
+#include "TestBodies.h"
+#include <cstdio>
+#include <vector>
+
+// klatki zapisane w trakcie symulacji odczytywane są z indeksu bit w bit, co `interval` kroków
+TEST(TrajectoryTest, FramesReadBackExactly) {
+    const std::string filename = "trajectory_test.nbt";
+    BodySystem bodies(random_bodies(37, 1, true));
+    SimulationContext context;
+    std::vector<BodySystem> expected;
+
+    TrajectoryWriter writer;
+    writer.interval = 2;
+    ASSERT_TRUE(writer.open<double>(filename, bodies.size(), TIME_STEP));
+    for (int step = 0; step < 6; ++step) {
+        simulate_step(bodies, context);
+        if (writer.sample(bodies, step, (step + 1) * TIME_STEP)) expected.push_back(bodies);
+    }
+    writer.close();
+    ASSERT_EQ(expected.size(), 3u);
+
+    for (size_t k = 0; k < expected.size(); ++k) {
+        BodySystem frame;
+        TrajectoryFrameHeader header;
+        TrajectoryFileHeader fileHeader;
+        ASSERT_TRUE(read_trajectory_frame(filename, k, frame, &header, &fileHeader));
+        EXPECT_EQ(header.step, static_cast<int64_t>(2 * k));
+        EXPECT_EQ(fileHeader.bodyCount, 37u);
+        EXPECT_EQ(fileHeader.scalarBytes, 8u);
+        ASSERT_EQ(frame.size(), expected[k].size());
+        for (size_t i = 0; i < frame.size(); ++i) {
+            EXPECT_EQ(frame.x[i], expected[k].x[i]);
+            EXPECT_EQ(frame.vz[i], expected[k].vz[i]);
+            EXPECT_EQ(frame.ay[i], expected[k].ay[i]);
+            EXPECT_EQ(frame.mass[i], expected[k].mass[i]);
+        }
+    }
+    BodySystem frame;
+    EXPECT_FALSE(read_trajectory_frame(filename, 3, frame));
+    std::remove(filename.c_str());
+}
+
+// mieszana precyzja zapisuje float; plik bez stopki (przerwany zapis) czytany jest po rozmiarze klatki
+TEST(TrajectoryTest, Float32FramesWithoutIndex) {
+    const std::string filename = "trajectory_float_test.nbt";
+    BodySystemF bodies(random_bodies(5, 2, true));
+    {
+        TrajectoryWriter writer;
+        ASSERT_TRUE(writer.open<float>(filename, bodies.size(), TIME_STEP, TRAJ_POSITIONS | TRAJ_MASSES));
+        EXPECT_TRUE(writer.sample(bodies, 0, 0.0));
+        bodies.x[0] += 1.0f;
+        EXPECT_TRUE(writer.sample(bodies, 1, TIME_STEP));
+    }
+    // obcięcie indeksu i stopki
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    std::vector<char> data(1 << 16);
+    data.resize(std::fread(data.data(), 1, data.size(), file));
+    std::fclose(file);
+    const size_t frameBytes = sizeof(TrajectoryFrameHeader) + 4 * 5 * sizeof(float);
+    ASSERT_EQ(data.size(), sizeof(TrajectoryFileHeader) + 2 * frameBytes + 2 * sizeof(uint64_t) + sizeof(TrajectoryTrailer));
+    data.resize(sizeof(TrajectoryFileHeader) + 2 * frameBytes);
+    file = std::fopen(filename.c_str(), "wb");
+    std::fwrite(data.data(), 1, data.size(), file);
+    std::fclose(file);
+
+    BodySystem frame;
+    TrajectoryFileHeader fileHeader;
+    ASSERT_TRUE(read_trajectory_frame(filename, 1, frame, nullptr, &fileHeader));
+    EXPECT_EQ(fileHeader.scalarBytes, 4u);
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        EXPECT_EQ(frame.x[i], static_cast<double>(bodies.x[i]));
+        EXPECT_EQ(frame.mass[i], static_cast<double>(bodies.mass[i]));
+        EXPECT_EQ(frame.vx[i], 0.0);
+    }
+    EXPECT_FALSE(read_trajectory_frame(filename, 2, frame));
+    std::remove(filename.c_str());
+}
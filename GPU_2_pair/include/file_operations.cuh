@@ -1,10 +1,27 @@
 #ifndef CSV_CUH
 #define CSV_CUH
 
+#include <cstdio>
 #include <string>
 
 #include "structures.cuh"
 
-void writeFile(std::string filename, Bodies* bodies, float seconds, int n, bool append = false);
+// SNAPSHOT_JSON_ARRAY keeps the closed JSON array read by the existing tools, SNAPSHOT_NDJSON writes one frame per line
+typedef enum { SNAPSHOT_JSON_ARRAY, SNAPSHOT_NDJSON } SnapshotFormat;
+
+// Streaming writer: every frame is appended in O(frame size) without re-reading the file.
+// A JSON array always ends with "\n]" after a frame, the next frame overwrites these two bytes.
+typedef struct SnapshotWriter {
+  FILE* file = nullptr;
+  SnapshotFormat format = SNAPSHOT_JSON_ARRAY;
+  bool hasFrames = false;
+  std::string buffer;
+} SnapshotWriter;
+
+// .ndjson and .jsonl files are written as NDJSON, everything else as a JSON array
+SnapshotFormat snapshotFormatFor(const std::string& filename);
+bool openSnapshotWriter(SnapshotWriter* writer, const std::string& filename, SnapshotFormat format);
+void writeSnapshot(SnapshotWriter* writer, Bodies* bodies, float seconds, int n);
+void closeSnapshotWriter(SnapshotWriter* writer);
 
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define INITIALIZATION_CUH
 
 #include <math.h>
+#include <stdint.h>
 
 #include "structures.cuh"
 
@@ -9,7 +10,7 @@
 #define INITIAL_SPREAD_Y 10e3 // Initial spread of the bodies in y axis
 #define INITIAL_SPREAD_Z 10e3 // Initial spread of the bodies in z axis
 
-void initializeRandomly(Bodies& bodies, int numberOfBodies, float spreadX = INITIAL_SPREAD_X,
+void initializeRandomly(Bodies& bodies, int numberOfBodies, uint64_t seed, float spreadX = INITIAL_SPREAD_X,
                         float spreadY = INITIAL_SPREAD_Y, float spreadZ = INITIAL_SPREAD_Z);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef PHILOX_CUH
+#define PHILOX_CUH
+
+#include <stdint.h>
+
+// Counter-based Philox4x32-10 generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11).
+// Every output block is the 128-bit counter encrypted with a key derived from the seed, so each body draws from its
+// own stream (counter = body index, block) and the initial conditions for a seed do not depend on the order in
+// which bodies are generated - on one host thread, many, or on the device. Same generator as cpu-proj.
+__host__ __device__ inline void philox4x32(const uint32_t counter[4], uint64_t seed, uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+  for (int round = 0; round < 10; round++) {
+    const uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+    const uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// Block `block` of the stream of body `body`
+__host__ __device__ inline void philoxBlock(uint64_t seed, uint64_t body, uint32_t block, uint32_t out[4]) {
+  const uint32_t counter[4] = {(uint32_t)body, (uint32_t)(body >> 32), block, 0};
+  philox4x32(counter, seed, out);
+}
+
+// Uniform double in (0, 1) from 53 bits of two words
+__host__ __device__ inline double philoxToDouble(uint32_t hi, uint32_t lo) {
+  const uint64_t bits = ((uint64_t)(hi >> 5) << 26) | (lo >> 6);
+  return (bits + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Uniform float in (0, 1) from 24 bits of one word
+__host__ __device__ inline float philoxToFloat(uint32_t word) {
+  return ((word >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -1,52 +1,107 @@
 #include "../include/file_operations.cuh"
-#include <nlohmann/json.hpp>
 
-#include <fstream>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
-using json = nlohmann::json;
-
-void writeFile(std::string filename, Bodies* bodies, float seconds, int n, bool append) {
-  json jsonString;
+// Shortest representation that reads back to the same float; integers get ".0" like nlohmann::json::dump()
+static void appendNumber(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  int length = snprintf(buffer, sizeof(buffer), "%.9g", value);
+  out.append(buffer, length);
+  if (strpbrk(buffer, ".e") == nullptr) {
+    out += ".0";
+  }
+}
 
-  jsonString["time"] = seconds;
-  jsonString["bodies"] = json::array();
+static void appendVector(std::string& out, const char* name, double x, double y, double z) {
+  out += '"';
+  out += name;
+  out += "\":{\"x\":";
+  appendNumber(out, x);
+  out += ",\"y\":";
+  appendNumber(out, y);
+  out += ",\"z\":";
+  appendNumber(out, z);
+  out += '}';
+}
 
-  for (int i = 0; i < n; i++) {
-    json body = {
-        {"id", i},
-        {"p", {{"x", bodies->position[i].x}, {"y", bodies->position[i].y}, {"z", bodies->position[i].z}}},
-        {"v", {{"x", bodies->velocity[i].x}, {"y", bodies->velocity[i].y}, {"z", bodies->velocity[i].z}}},
-        {"a", {{"x", bodies->acceleration[i].x}, {"y", bodies->acceleration[i].y}, {"z", bodies->acceleration[i].z}}},
-        {"m", *bodies->mass}
-    };
-    jsonString["bodies"].push_back(body);
-  }
-
-  if (append) {
-    json existingData;
-
-    std::ifstream file(filename, std::ios::in);
-    if (file.is_open()) {
-      file >> existingData;
-      file.close();
+SnapshotFormat snapshotFormatFor(const std::string& filename) {
+  const char* suffixes[] = {".ndjson", ".jsonl"};
+  for (const char* suffix : suffixes) {
+    size_t length = strlen(suffix);
+    if (filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0) {
+      return SNAPSHOT_NDJSON;
     }
-
-    existingData.push_back(jsonString);
-    jsonString = existingData;
-  } else {  // If we are not appending, we need to wrap the json object in an array
-    json array = json::array();
-    array.push_back(jsonString);
-    jsonString = array;
   }
+  return SNAPSHOT_JSON_ARRAY;
+}
 
-  std::ofstream file(filename, std::ios::out);
-  if (!file.is_open()) {
+bool openSnapshotWriter(SnapshotWriter* writer, const std::string& filename, SnapshotFormat format) {
+  writer->format = format;
+  writer->hasFrames = false;
+  writer->file = fopen(filename.c_str(), "wb");
+  if (writer->file == nullptr) {
     std::cout << "Error opening file." << std::endl;
+    return false;
+  }
+
+  if (format == SNAPSHOT_JSON_ARRAY) {
+    fputs("[\n]", writer->file);
+    fflush(writer->file);
+    fseek(writer->file, -2, SEEK_CUR);
+  }
+  return true;
+}
+
+void writeSnapshot(SnapshotWriter* writer, Bodies* bodies, float seconds, int n) {
+  if (writer->file == nullptr) {
     return;
   }
 
-  file << jsonString.dump(2);
+  std::string& out = writer->buffer;
+  out.clear();
+  if (writer->format == SNAPSHOT_JSON_ARRAY) {
+    out += writer->hasFrames ? ",\n" : "\n";
+  }
 
-  file.close();
-}
\ No newline at end of file
+  out += "{\"time\":";
+  appendNumber(out, seconds);
+  out += ",\"bodies\":[";
+  for (int i = 0; i < n; i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += "{\"id\":";
+    out += std::to_string(i);
+    out += ',';
+    appendVector(out, "p", bodies->position[i].x, bodies->position[i].y, bodies->position[i].z);
+    out += ',';
+    appendVector(out, "v", bodies->velocity[i].x, bodies->velocity[i].y, bodies->velocity[i].z);
+    out += ',';
+    appendVector(out, "a", bodies->acceleration[i].x, bodies->acceleration[i].y, bodies->acceleration[i].z);
+    out += ",\"m\":";
+    appendNumber(out, bodies->mass[i]);
+    out += '}';
+  }
+  out += "]}";
+  out += writer->format == SNAPSHOT_JSON_ARRAY ? "\n]" : "\n";
+
+  fwrite(out.data(), 1, out.size(), writer->file);
+  fflush(writer->file);
+  if (writer->format == SNAPSHOT_JSON_ARRAY) {
+    fseek(writer->file, -2, SEEK_CUR);
+  }
+  writer->hasFrames = true;
+}
+
+void closeSnapshotWriter(SnapshotWriter* writer) {
+  if (writer->file != nullptr) {
+    fclose(writer->file);
+    writer->file = nullptr;
+  }
+}
@@ -1,13 +1,16 @@
 #include "../include/initialization.cuh"
+#include "../include/philox.cuh"
 
-void initializeRandomly(Bodies& bodies, int numberOfBodies, float spreadX, float spreadY, float spreadZ) {
+void initializeRandomly(Bodies& bodies, int numberOfBodies, uint64_t seed, float spreadX, float spreadY, float spreadZ) {
   float mass = 10e15;
 
   for (int i = 0; i < numberOfBodies; i++) {
-    // initialize the bodies randomly spread around 0,0
-    float x = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5;
-    float y = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5;
-    float z = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5;
+    // initialize the bodies randomly spread around 0,0; each body has its own Philox stream
+    uint32_t random[4];
+    philoxBlock(seed, i, 0, random);
+    float x = philoxToFloat(random[0]) - 0.5f;
+    float y = philoxToFloat(random[1]) - 0.5f;
+    float z = philoxToFloat(random[2]) - 0.5f;
     bodies.position[i].x = x * spreadX;
     bodies.position[i].y = y * spreadY;
     bodies.position[i].z = z * spreadZ;
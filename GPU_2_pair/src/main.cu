@@ -6,7 +6,9 @@
 #define BLOCK_SIZE 512
 #define G 6.67430e-11 // Gravitational constant
 
-void initializeBodies(Bodies& bodies, int numberOfBodies) { initializeRandomly(bodies, numberOfBodies); }
+void initializeBodies(Bodies& bodies, int numberOfBodies, uint64_t seed) {
+  initializeRandomly(bodies, numberOfBodies, seed);
+}
 
 __global__ void computeBodyAcceleration(float3* position, float3* accelerations, float* masses, int n) {
   int index = blockDim.x * blockIdx.x + threadIdx.x;
@@ -59,8 +61,6 @@ __global__ void computeNewPositionAndSpeed(float3* positions, float3* velocities
 }
 
 int main(const int argc, const char** argv) {
-  srand(time(NULL));
-
   int numberOfBodies = 1000;
   if (argc > 1) {
     numberOfBodies = atoi(argv[1]);
@@ -86,6 +86,13 @@ int main(const int argc, const char** argv) {
     outputFilename = argv[5];
   }
 
+  // Seed of the initial conditions, by default taken from the clock
+  uint64_t seed = (uint64_t)time(NULL);
+  if (argc > 6) {
+    seed = strtoull(argv[6], nullptr, 10);
+  }
+  std::cout << "Seed: " << seed << std::endl;
+
   int numberOfBlocks = (numberOfBodies + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
   float* cpu_buffer = (float*)malloc(
@@ -93,13 +100,17 @@ int main(const int argc, const char** argv) {
   Bodies cpu_bodies = {(float*)cpu_buffer, (float3*)(cpu_buffer + numberOfBodies),
                        (float3*)(cpu_buffer + 4 * numberOfBodies), (float3*)(cpu_buffer + 7 * numberOfBodies)};
 
-  initializeBodies(cpu_bodies, numberOfBodies);
+  initializeBodies(cpu_bodies, numberOfBodies, seed);
 
   float* gpu_buffer;
   cudaMalloc(&gpu_buffer, numberOfBodies * (sizeof(float) * 10));
   Bodies gpu_bodies = {(float*)gpu_buffer, (float3*)(gpu_buffer + numberOfBodies),
                        (float3*)(gpu_buffer + 4 * numberOfBodies), (float3*)(gpu_buffer + 7 * numberOfBodies)};
 
+  // The output file stays open for the whole run, every snapshot is only appended
+  SnapshotWriter snapshots;
+  openSnapshotWriter(&snapshots, outputFilename, snapshotFormatFor(outputFilename));
+
   for (int i = 0; i < iterations; i++) {
     cudaMemcpy(gpu_buffer, cpu_buffer, numberOfBodies * (sizeof(float) * 10), cudaMemcpyHostToDevice);
 
@@ -113,9 +124,10 @@ int main(const int argc, const char** argv) {
     cudaMemcpy(cpu_buffer, gpu_buffer, numberOfBodies * (sizeof(float) * 10), cudaMemcpyDeviceToHost);
 
     if (saveInterval > 0 && i % saveInterval == 0) {
-      writeFile(outputFilename, &cpu_bodies, i * dt, numberOfBodies, i > saveInterval);
+      writeSnapshot(&snapshots, &cpu_bodies, i * dt, numberOfBodies);
     }
   }
 
+  closeSnapshotWriter(&snapshots);
   cudaFree(gpu_buffer);
 }
\ No newline at end of file
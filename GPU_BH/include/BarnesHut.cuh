@@ -2,8 +2,13 @@
 #define BARNESHUT_CUH
 
 #include <cfloat>
+#include <cmath>
+#include "execution.cuh"
 #define G 6.67430e-11
 
+// Deeper than this the octants no longer separate bodies (coincident positions); such bodies go to any free slot
+#define TREE_MAX_DEPTH 64
+
 // Structure Of Arrays (SoA) for bodies
 typedef struct {
   double* mass;
@@ -12,20 +17,27 @@ typedef struct {
   double3* acceleration;
 } Bodies;
 
+// Nodes live in one pool: nodes[0] is the root, the rest is handed out by an atomic counter while the tree is built.
+// A leaf holds one body and is complete before it is published. Splitting a leaf publishes a new internal node in its
+// slot that adopts the leaf, so an internal node always has a higher index than its parent.
 struct TreeNode {
   double x_min, x_max, y_min, y_max, z_min, z_max;
   double cx, cy, cz;     // center of mass
-  double mass;           // total mass
+  double mass;           // total mass; -1 for an internal node until computeCentersOfMass has summed its children
   TreeNode* children[8]; // children nodes
   int bodyIndex = -1;         // index of the particle in the bodies array
   bool isLeaf = true;           // is leaf node
 };
 
-__global__ void computeBoundingBox(const Bodies& bodies, int n, double* bounds);
-__global__ void buildTree(TreeNode* nodes, Bodies& bodies, int n, double x_min, double x_max, double y_min,
-                          double y_max, double z_min, double z_max);
-__global__ void computeCentersOfMass(TreeNode* nodes, const Bodies& bodies, int n);
-__global__ void computeForces(TreeNode* nodes, const Bodies& bodies, double* forces_x, double* forces_y, double* forces_z, int n, double theta);
-__global__ void updateBodies(Bodies bodies, int n, double* fx, double* fy, double* fz, double dt);
+// bounds = {x_min, x_max, y_min, y_max, z_min, z_max}, reset to {DBL_MAX, -DBL_MAX, ...} before the launch
+__global__ void computeBoundingBox(Bodies bodies, int n, double* bounds);
+// Empty root cube around the bounding box and an empty node pool; one thread is enough
+__global__ void initializeTree(TreeNode* nodes, int* nodeCount, const double* bounds);
+// Afterwards *nodeCount > maxNodes if the pool was too small (or more than 8 bodies share a position)
+__global__ void buildTree(TreeNode* nodes, int* nodeCount, int maxNodes, Bodies bodies, int n);
+__global__ void computeCentersOfMass(TreeNode* nodes, const int* nodeCount, int maxNodes);
+__global__ void computeForces(const TreeNode* nodes, Bodies bodies, double* forces_x, double* forces_y,
+                              double* forces_z, int n, double theta);
+__global__ void updateBodies(Bodies bodies, int n, const double* fx, const double* fy, const double* fz, double dt);
 
-#endif // BARNESHUT_CUH
\ No newline at end of file
+#endif // BARNESHUT_CUH
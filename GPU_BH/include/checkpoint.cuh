@@ -0,0 +1,36 @@
+#ifndef CHECKPOINT_CUH
+#define CHECKPOINT_CUH
+
+#include <cstdint>
+#include <string>
+
+#include "BarnesHut.cuh"
+
+// Checkpoint with the full state needed to resume a run, little-endian:
+//   header (128 B) | mass (N doubles) | position (N double3) | velocity (N double3) | end marker (8 B, "NBCKEND")
+// The arrays are written straight from the host copy of the bodies. Accelerations are recomputed by every step before
+// they are used, so they are not stored. The file is written under a temporary name, flushed to disk and renamed over
+// the previous checkpoint, so a crash always leaves a complete checkpoint behind.
+typedef struct {
+  char magic[8];  // "NBCKBH1"
+  uint32_t version;
+  uint32_t headerBytes;
+  uint64_t bodyCount;
+  int64_t iteration;  // last completed iteration
+  double time;
+  double dt;
+  double theta;
+  uint64_t seed;  // seed of the initial conditions generator
+  char reserved[64];
+} CheckpointHeader;
+
+static_assert(sizeof(CheckpointHeader) == 128, "checkpoint header must be 128 bytes");
+
+// bodies is a host buffer laid out like cpu_bodies in main.cu; returns false and keeps the previous checkpoint on error
+bool writeCheckpoint(const std::string& filename, const CheckpointHeader* header, const Bodies* bodies);
+// Reads only the header, so the caller can allocate buffers for header->bodyCount bodies
+bool readCheckpointHeader(const std::string& filename, CheckpointHeader* header);
+// Reads the bodies of a complete checkpoint into a host buffer for header->bodyCount bodies
+bool readCheckpoint(const std::string& filename, const CheckpointHeader* header, Bodies* bodies);
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef EXECUTION_CUH
+#define EXECUTION_CUH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Execution layer shared by the CUDA and the host backend. Kernels are written once: each one walks its items with
+// a grid-stride loop over gridRange(n) and touches data shared between threads only through the atomics below.
+// Under nvcc launchKernel is a plain <<<blocks, threads>>> launch. Without CUDA (NBODY_HOST_BACKEND) the kernel body
+// runs once on every OpenMP thread, gridRange(n) hands each thread a contiguous slice of [0, n) and the atomics map
+// to std::atomic_ref, so the same kernels can be profiled and tested on machines without a GPU.
+#ifdef __CUDACC__
+#define NBODY_CUDA 1
+#include <cuda_runtime.h>
+#else
+#define NBODY_HOST_BACKEND 1
+#include <atomic>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define __global__
+#define __device__
+#define __host__
+
+struct double3 {
+  double x, y, z;
+};
+
+inline double3 make_double3(double x, double y, double z) { return {x, y, z}; }
+
+// Position of the calling OpenMP thread in the current launch; outside a launch one thread covers every item
+struct HostThread {
+  int index = 0;
+  int count = 1;
+};
+
+inline HostThread& hostThread() {
+  static thread_local HostThread thread;
+  return thread;
+}
+#endif
+
+// Items first, first + stride, ... below last handled by one kernel thread
+struct GridRange {
+  struct Iterator {
+    int index;
+    int stride;
+    __host__ __device__ int operator*() const { return index; }
+    __host__ __device__ Iterator& operator++() {
+      index += stride;
+      return *this;
+    }
+    __host__ __device__ bool operator!=(const Iterator& end) const { return index < end.index; }
+  };
+
+  int first, last, stride;
+  __host__ __device__ Iterator begin() const { return {first, stride}; }
+  __host__ __device__ Iterator end() const { return {last, stride}; }
+};
+
+__device__ inline GridRange gridRange(int n) {
+#ifdef NBODY_CUDA
+  return {(int)(blockIdx.x * blockDim.x + threadIdx.x), n, (int)(blockDim.x * gridDim.x)};
+#else
+  const HostThread& thread = hostThread();
+  return {(int)((long long)n * thread.index / thread.count), (int)((long long)n * (thread.index + 1) / thread.count),
+          1};
+#endif
+}
+
+#ifdef NBODY_CUDA
+#define launchKernel(kernel, blocks, threads, ...) kernel<<<(blocks), (threads)>>>(__VA_ARGS__)
+#else
+// blocks and threads only matter on the device; on the host the launch is as wide as the OpenMP team
+template <typename... Params, typename... Args>
+void launchKernel(void (*kernel)(Params...), int /*blocks*/, int /*threads*/, Args... args) {
+#pragma omp parallel
+  {
+    HostThread& thread = hostThread();
+#ifdef _OPENMP
+    thread.index = omp_get_thread_num();
+    thread.count = omp_get_num_threads();
+#endif
+    kernel(args...);
+    thread = HostThread();
+  }
+}
+#endif
+
+// --- atomics ---
+
+__device__ inline int atomicAddInt(int* address, int value) {
+#ifdef NBODY_CUDA
+  return atomicAdd(address, value);
+#else
+  return std::atomic_ref<int>(*address).fetch_add(value, std::memory_order_relaxed);
+#endif
+}
+
+__device__ inline void atomicMinDouble(double* address, double value) {
+#ifdef NBODY_CUDA
+  unsigned long long* bits = reinterpret_cast<unsigned long long*>(address);
+  unsigned long long old = *bits;
+  while (value < __longlong_as_double((long long)old)) {
+    const unsigned long long assumed = old;
+    old = atomicCAS(bits, assumed, (unsigned long long)__double_as_longlong(value));
+    if (old == assumed) {
+      break;
+    }
+  }
+#else
+  std::atomic_ref<double> target(*address);
+  double old = target.load(std::memory_order_relaxed);
+  while (value < old && !target.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+#endif
+}
+
+__device__ inline void atomicMaxDouble(double* address, double value) {
+#ifdef NBODY_CUDA
+  unsigned long long* bits = reinterpret_cast<unsigned long long*>(address);
+  unsigned long long old = *bits;
+  while (value > __longlong_as_double((long long)old)) {
+    const unsigned long long assumed = old;
+    old = atomicCAS(bits, assumed, (unsigned long long)__double_as_longlong(value));
+    if (old == assumed) {
+      break;
+    }
+  }
+#else
+  std::atomic_ref<double> target(*address);
+  double old = target.load(std::memory_order_relaxed);
+  while (value > old && !target.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+#endif
+}
+
+// Publishing: everything the thread wrote before atomicStore / atomicCasPointer is visible to a thread that reads
+// the published value with atomicLoad and then reads the data through loadVolatile
+template <typename T>
+__device__ inline T atomicLoad(T* address) {
+#ifdef NBODY_CUDA
+  return *const_cast<volatile T*>(address);
+#else
+  return std::atomic_ref<T>(*address).load(std::memory_order_acquire);
+#endif
+}
+
+template <typename T>
+__device__ inline void atomicStore(T* address, T value) {
+#ifdef NBODY_CUDA
+  __threadfence();
+  *const_cast<volatile T*>(address) = value;
+#else
+  std::atomic_ref<T>(*address).store(value, std::memory_order_release);
+#endif
+}
+
+// Returns the previous value; the swap happened when it equals expected
+template <typename T>
+__device__ inline T* atomicCasPointer(T** address, T* expected, T* desired) {
+#ifdef NBODY_CUDA
+  __threadfence();
+  return (T*)atomicCAS(reinterpret_cast<unsigned long long*>(address), (unsigned long long)expected,
+                       (unsigned long long)desired);
+#else
+  std::atomic_ref<T*>(*address).compare_exchange_strong(expected, desired, std::memory_order_acq_rel,
+                                                        std::memory_order_acquire);
+  return expected;
+#endif
+}
+
+// Plain field of a node published by another thread; on the device it must bypass the non-coherent L1 cache
+template <typename T>
+__device__ inline T loadVolatile(const T& value) {
+#ifdef NBODY_CUDA
+  return *const_cast<const volatile T*>(&value);
+#else
+  return value;
+#endif
+}
+
+// --- memory ---
+
+inline void* deviceAllocate(size_t bytes) {
+#ifdef NBODY_CUDA
+  void* memory = nullptr;
+  cudaMalloc(&memory, bytes);
+  return memory;
+#else
+  return std::malloc(bytes);
+#endif
+}
+
+inline void deviceFree(void* memory) {
+#ifdef NBODY_CUDA
+  cudaFree(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+// Page-locked host memory on the device backend, so device-to-host copies run at full speed
+inline void* hostAllocatePinned(size_t bytes) {
+#ifdef NBODY_CUDA
+  void* memory = nullptr;
+  cudaMallocHost(&memory, bytes);
+  return memory;
+#else
+  return std::malloc(bytes);
+#endif
+}
+
+inline void hostFreePinned(void* memory) {
+#ifdef NBODY_CUDA
+  cudaFreeHost(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+// Copies wait for the kernels launched before them, like cudaMemcpy on the default stream
+inline void copyToDevice(void* destination, const void* source, size_t bytes) {
+#ifdef NBODY_CUDA
+  cudaMemcpy(destination, source, bytes, cudaMemcpyHostToDevice);
+#else
+  std::memcpy(destination, source, bytes);
+#endif
+}
+
+inline void copyToHost(void* destination, const void* source, size_t bytes) {
+#ifdef NBODY_CUDA
+  cudaMemcpy(destination, source, bytes, cudaMemcpyDeviceToHost);
+#else
+  std::memcpy(destination, source, bytes);
+#endif
+}
+
+inline void synchronizeDevice() {
+#ifdef NBODY_CUDA
+  cudaDeviceSynchronize();
+#endif
+}
+
+#endif
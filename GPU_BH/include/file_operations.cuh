@@ -1,10 +1,107 @@
 #ifndef CSV_CUH
 #define CSV_CUH
 
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "BarnesHut.cuh"
 
-void writeFile(std::string filename, Bodies* bodies, float seconds, int n, bool append = false);
+// SNAPSHOT_JSON_ARRAY keeps the closed JSON array read by the existing tools, SNAPSHOT_NDJSON writes one frame per line,
+// SNAPSHOT_BINARY writes the columnar trajectory format shared with cpu-proj (TrajectoryTool converts it to JSON)
+typedef enum { SNAPSHOT_JSON_ARRAY, SNAPSHOT_NDJSON, SNAPSHOT_BINARY } SnapshotFormat;
+
+// Binary trajectory (.nbt), little-endian:
+//   file header (64 B) | frame 0 | frame 1 | ... | index: frame offsets (uint64) | trailer (24 B)
+// A frame is a frame header (32 B) followed by N doubles per column x, y, z, vx, vy, vz, ax, ay, az, mass.
+// The trailer points at the index, so any frame can be memory-mapped in O(1).
+typedef struct {
+  char magic[8];  // "NBTRAJ1"
+  uint32_t version;
+  uint32_t fields;       // 15 - positions, velocities, accelerations and masses
+  uint32_t scalarBytes;  // 8 - double
+  uint32_t headerBytes;
+  uint64_t bodyCount;
+  double dt;
+  char units[24];
+} TrajectoryFileHeader;
+
+typedef struct {
+  int64_t step;
+  double time;
+  int64_t timestamp;
+  uint64_t reserved;
+} TrajectoryFrameHeader;
+
+typedef struct {
+  uint64_t frameCount;
+  uint64_t indexOffset;
+  char magic[8];  // "NBTRIDX"
+} TrajectoryTrailer;
+
+// Streaming writer: every frame is appended in O(frame size) without re-reading the file.
+// A JSON array always ends with "\n]" after a frame, the next frame overwrites these two bytes.
+typedef struct SnapshotWriter {
+  FILE* file = nullptr;
+  SnapshotFormat format = SNAPSHOT_JSON_ARRAY;
+  bool hasFrames = false;
+  std::string buffer;
+  double dt = 0.0;
+  uint64_t bodyCount = 0;              // SNAPSHOT_BINARY append: bodies expected in the existing file, 0 - any
+  std::vector<uint64_t> frameOffsets;  // SNAPSHOT_BINARY: index written by closeSnapshotWriter
+  std::vector<double> column;          // SNAPSHOT_BINARY: one component gathered from the double3 arrays
+} SnapshotWriter;
+
+// .ndjson and .jsonl files are written as NDJSON, .nbt as a binary trajectory, everything else as a JSON array
+SnapshotFormat snapshotFormatFor(const std::string& filename);
+// dt is stored in the binary trajectory header; append continues an existing file (a resumed run) instead of
+// truncating it, after cutting the frames of iterations past appendAfter (written after the checkpoint the run
+// resumes from). A file that cannot be continued is left unchanged and the writer stays closed.
+bool openSnapshotWriter(SnapshotWriter* writer, const std::string& filename, SnapshotFormat format, double dt = 0.0,
+                        bool append = false, int64_t appendAfter = INT64_MAX);
+void writeSnapshot(SnapshotWriter* writer, Bodies* bodies, float seconds, int n);
+void closeSnapshotWriter(SnapshotWriter* writer);
+
+// What to do when every buffer is still waiting for the I/O thread: block the step loop or drop the frame
+typedef enum { BACKPRESSURE_BLOCK, BACKPRESSURE_DROP } Backpressure;
+
+// Background writer: the step loop copies the state from the device into a free pinned host buffer and hands it
+// over; a dedicated I/O thread serializes the buffers in submission order while the next steps run on the GPU.
+typedef struct AsyncSnapshotWriter {
+  SnapshotWriter writer;
+  Backpressure backpressure = BACKPRESSURE_BLOCK;
+  int numberOfBodies = 0;
+  std::vector<Bodies> buffers;
+  std::vector<float> times;
+  std::deque<int> freeBuffers;
+  std::deque<int> readyBuffers;
+  int writing = 0;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable bufferFree;
+  std::condition_variable bufferReady;
+  std::thread thread;
+
+  // Metrics
+  int framesWritten = 0;
+  int framesDropped = 0;
+  double waitSeconds = 0.0;   // time the step loop spent waiting for a free buffer
+  double writeSeconds = 0.0;  // time spent serializing and writing on the I/O thread
+} AsyncSnapshotWriter;
+
+bool openAsyncSnapshotWriter(AsyncSnapshotWriter* writer, const std::string& filename, SnapshotFormat format, double dt,
+                             int numberOfBodies, Backpressure backpressure, bool append = false, int bufferCount = 2,
+                             int64_t appendAfter = INT64_MAX);
+// Returns a free host buffer to copy the state into, or nullptr when the frame is dropped
+Bodies* acquireSnapshotBuffer(AsyncSnapshotWriter* writer);
+// Queues a buffer returned by acquireSnapshotBuffer for writing
+void submitSnapshot(AsyncSnapshotWriter* writer, Bodies* buffer, float seconds);
+// Writes the queued frames, stops the I/O thread and closes the file
+void closeAsyncSnapshotWriter(AsyncSnapshotWriter* writer);
 
 #endif
\ No newline at end of file
@@ -1,7 +1,9 @@
 #ifndef INITIALIZATION_CUH
 #define INITIALIZATION_CUH
 
+#include <stdint.h>
 #include <iostream>
+#include <string>
 #include <math.h>
 
 #include "BarnesHut.cuh"
@@ -16,11 +18,21 @@ typedef struct Config {
   int saveInterval = 100;
   float dt = 0.1;
   std::string outputFilename = "output.json";
+  bool dropSnapshots = false;  // drop frames instead of waiting when the snapshot writer falls behind
+  double theta = 0.8;          // Barnes-Hut opening angle
+  unsigned int seed = 0;       // seed of the initial conditions, 0 - taken from the clock
+  std::string checkpointFilename;  // written every checkpointInterval iterations and at the end of the run
+  int checkpointInterval = 0;
+  std::string restartFilename;     // resume from this checkpoint instead of random bodies
 } Config;
 
-void initializeBodies(Bodies bodies, int numberOfBodies, double spreadX = INITIAL_SPREAD_X,
+// Uniform cube of bodies; the same seed gives the same bodies as cpu-proj's "uniform" model streams
+void initializeBodies(Bodies bodies, int numberOfBodies, uint64_t seed, double spreadX = INITIAL_SPREAD_X,
                         double spreadY = INITIAL_SPREAD_Y, double spreadZ = INITIAL_SPREAD_Z);
 Config parseConfig(const int argc, const char** argv);
+// Threads per block and blocks that are resident at once (one per multiprocessor); on the host backend the OpenMP
+// team decides the parallelism and these only size the launches
 int getCudaBlockSize();
+int getMultiprocessorCount();
 
 #endif
\ No newline at end of file
@@ -1,150 +1,187 @@
 #include "../include/BarnesHut.cuh"
 
-// calculate maximum of doubles atomically
-__device__ void atomicMaxDouble(double* address, double val) {
-  unsigned long long* address_as_ull = reinterpret_cast<unsigned long long int*>(address);
-  unsigned long long old = *address_as_ull, assumed;
-  unsigned long long new_val = *reinterpret_cast<unsigned long long*>(&val);
-
-  while (old < new_val) {
-    old = atomicCAS(address_as_ull, assumed, new_val);
+// Each thread reduces its own bodies first, so the shared bounds take six atomics per thread rather than per body.
+// On the device the kernel is launched with one block per multiprocessor and the grid-stride loop covers the rest.
+__global__ void computeBoundingBox(Bodies bodies, int n, double* bounds) {
+  double x_min = DBL_MAX, x_max = -DBL_MAX;
+  double y_min = DBL_MAX, y_max = -DBL_MAX;
+  double z_min = DBL_MAX, z_max = -DBL_MAX;
+  for (int idx : gridRange(n)) {
+    const double3 p = bodies.position[idx];
+    x_min = fmin(x_min, p.x);
+    x_max = fmax(x_max, p.x);
+    y_min = fmin(y_min, p.y);
+    y_max = fmax(y_max, p.y);
+    z_min = fmin(z_min, p.z);
+    z_max = fmax(z_max, p.z);
   }
-}
-
-__device__ void atomicMinDouble(double* address, double val) {
-  unsigned long long* address_as_ull = reinterpret_cast<unsigned long long int*>(address);
-  unsigned long long old = *address_as_ull, assumed;
-  unsigned long long new_val = *reinterpret_cast<unsigned long long*>(&val);
 
-  while (old > new_val) {
-    old = atomicCAS(address_as_ull, assumed, new_val);
-  }
+  atomicMinDouble(&bounds[0], x_min);
+  atomicMaxDouble(&bounds[1], x_max);
+  atomicMinDouble(&bounds[2], y_min);
+  atomicMaxDouble(&bounds[3], y_max);
+  atomicMinDouble(&bounds[4], z_min);
+  atomicMaxDouble(&bounds[5], z_max);
 }
 
-__global__ void computeBoundingBox(const Bodies& bodies, int n, double* bounds) {
-  int idx = threadIdx.x + blockIdx.x * blockDim.x;
-  if (idx >= n) {
-    return;
-  }
-
-  extern __shared__ double shared_data[];
-
-  double* x_min = shared_data;
-  double* x_max = shared_data + blockDim.x;
-  double* y_min = shared_data + 2 * blockDim.x;
-  double* y_max = shared_data + 3 * blockDim.x;
-  double* z_min = shared_data + 4 * blockDim.x;
-  double* z_max = shared_data + 5 * blockDim.x;
-
-  if (idx < n) {
-    x_min[threadIdx.x] = bodies.position[idx].x;
-    x_max[threadIdx.x] = bodies.position[idx].x;
-    y_min[threadIdx.x] = bodies.position[idx].y;
-    y_max[threadIdx.x] = bodies.position[idx].y;
-    z_min[threadIdx.x] = bodies.position[idx].z;
-    z_max[threadIdx.x] = bodies.position[idx].z;
-  } else {
-    // set to extreme values to not interfere with the reduction
-    x_min[threadIdx.x] = DBL_MAX;
-    x_max[threadIdx.x] = -DBL_MAX;
-    y_min[threadIdx.x] = DBL_MAX;
-    y_max[threadIdx.x] = -DBL_MAX;
-    z_min[threadIdx.x] = DBL_MAX;
-    z_max[threadIdx.x] = -DBL_MAX;
-  }
-
-  __syncthreads();
-
-  // reduction
-  // basically a tournament tree for comparing the values
-  for (int stride = blockDim.x / 2; stride > 0; stride >>= 1) {
-    if (threadIdx.x < stride) {
-      x_min[threadIdx.x] = fmin(x_min[threadIdx.x], x_min[threadIdx.x + stride]);
-      x_max[threadIdx.x] = fmax(x_max[threadIdx.x], x_max[threadIdx.x + stride]);
-      y_min[threadIdx.x] = fmin(y_min[threadIdx.x], y_min[threadIdx.x + stride]);
-      y_max[threadIdx.x] = fmax(y_max[threadIdx.x], y_max[threadIdx.x + stride]);
-      z_min[threadIdx.x] = fmin(z_min[threadIdx.x], z_min[threadIdx.x + stride]);
-      z_max[threadIdx.x] = fmax(z_max[threadIdx.x], z_max[threadIdx.x + stride]);
-    }
-    __syncthreads();
+__device__ inline void clearChildren(TreeNode* node) {
+  for (int i = 0; i < 8; i++) {
+    node->children[i] = nullptr;
   }
+}
 
-  if (threadIdx.x == 0) {
-    atomicMinDouble(&bounds[0], x_min[0]);
-    atomicMaxDouble(&bounds[1], x_max[0]);
-    atomicMinDouble(&bounds[2], y_min[0]);
-    atomicMaxDouble(&bounds[3], y_max[0]);
+__global__ void initializeTree(TreeNode* nodes, int* nodeCount, const double* bounds) {
+  for (int idx : gridRange(1)) {
+    // the root is a cube, so every octant is a cube as well and x_max - x_min is the size of a node
+    double size = fmax(fmax(bounds[1] - bounds[0], bounds[3] - bounds[2]), bounds[5] - bounds[4]);
+    size = size > 0.0 ? size : 1.0;  // no bodies or all of them at one point
+    const double half = size / 2;
+    const double x = (bounds[0] + bounds[1]) / 2, y = (bounds[2] + bounds[3]) / 2, z = (bounds[4] + bounds[5]) / 2;
+
+    TreeNode* root = &nodes[idx];
+    root->x_min = x - half;
+    root->x_max = x + half;
+    root->y_min = y - half;
+    root->y_max = y + half;
+    root->z_min = z - half;
+    root->z_max = z + half;
+    root->cx = root->cy = root->cz = 0.0;
+    root->mass = -1.0;
+    root->bodyIndex = -1;
+    root->isLeaf = false;
+    clearChildren(root);
+    *nodeCount = 1;
   }
 }
 
-__device__ void insertBody(TreeNode* node, const Bodies& bodies, int bodyIdx, double x_min, double x_max, double y_min,
-                           double y_max, double z_min, double z_max) {
-  double x = bodies.position[bodyIdx].x;
-  double y = bodies.position[bodyIdx].y;
-  double z = bodies.position[bodyIdx].z;
-
-  if (node->isLeaf) {
-    if (node->bodyIndex == -1) {
-      node->bodyIndex = bodyIdx;
-    } else {
-      node->isLeaf = false;
+__device__ inline int octantOf(const TreeNode* node, double x, double y, double z) {
+  bool x_lower = x < (node->x_min + node->x_max) / 2;
+  bool y_lower = y < (node->y_min + node->y_max) / 2;
+  bool z_lower = z < (node->z_min + node->z_max) / 2;
+  return (x_lower ? 0 : 1) + (y_lower ? 0 : 2) + (z_lower ? 0 : 4);
+}
 
-      double x_mid = (node->x_min + node->x_max) / 2;
-      double y_mid = (node->y_min + node->y_max) / 2;
-      double z_mid = (node->z_min + node->z_max) / 2;
+__device__ inline void setOctantBounds(TreeNode* child, const TreeNode* parent, int octant) {
+  double x_mid = (parent->x_min + parent->x_max) / 2;
+  double y_mid = (parent->y_min + parent->y_max) / 2;
+  double z_mid = (parent->z_min + parent->z_max) / 2;
+  child->x_min = octant & 1 ? x_mid : parent->x_min;
+  child->x_max = octant & 1 ? parent->x_max : x_mid;
+  child->y_min = octant & 2 ? y_mid : parent->y_min;
+  child->y_max = octant & 2 ? parent->y_max : y_mid;
+  child->z_min = octant & 4 ? z_mid : parent->z_min;
+  child->z_max = octant & 4 ? parent->z_max : z_mid;
+}
 
-      bool x_lower = x < x_mid;
-      bool y_lower = y < y_mid;
-      bool z_lower = z < z_mid;
+// nullptr when the pool is exhausted; the counter keeps growing, so the host sees *nodeCount > maxNodes
+__device__ inline TreeNode* allocateNode(TreeNode* nodes, int* nodeCount, int maxNodes) {
+  const int index = atomicAddInt(nodeCount, 1);
+  return index < maxNodes ? &nodes[index] : nullptr;
+}
 
-      int childIndex = (x_lower ? 0 : 1) + (y_lower ? 0 : 2) + (z_lower ? 0 : 4);
+// Marks a slot whose leaf is being split; other threads wait for the new internal node
+__device__ inline TreeNode* lockedSlot() { return reinterpret_cast<TreeNode*>((uintptr_t)1); }
+
+// Lock-free insertion: an empty slot takes the leaf with one compare-and-swap, an occupied leaf slot is locked,
+// replaced with a new internal node adopting the old leaf, and the descent continues. On the device the spinning on
+// a locked slot needs independent thread scheduling (sm_70 or newer).
+__global__ void buildTree(TreeNode* nodes, int* nodeCount, int maxNodes, Bodies bodies, int n) {
+  for (int idx : gridRange(n)) {
+    const double x = bodies.position[idx].x;
+    const double y = bodies.position[idx].y;
+    const double z = bodies.position[idx].z;
+
+    TreeNode* leaf = allocateNode(nodes, nodeCount, maxNodes);
+    if (leaf == nullptr) {
+      return;
+    }
+    leaf->cx = x;
+    leaf->cy = y;
+    leaf->cz = z;
+    leaf->mass = bodies.mass[idx];
+    leaf->bodyIndex = idx;
+    leaf->isLeaf = true;
+    clearChildren(leaf);
+
+    TreeNode* node = &nodes[0];
+    int depth = 0;
+    while (true) {
+      int octant = octantOf(node, x, y, z);
+      if (depth >= TREE_MAX_DEPTH) {
+        // the octant does not separate the bodies any more - take the first free slot
+        octant = 0;
+        while (octant < 8 && atomicLoad(&node->children[octant]) != nullptr) {
+          octant++;
+        }
+        if (octant == 8) {
+          atomicAddInt(nodeCount, maxNodes);
+          return;
+        }
+      }
 
-      insertBody(node->children[childIndex], bodies, bodyIdx, x_min, x_max, y_min, y_max, z_min, z_max);
+      TreeNode** slot = &node->children[octant];
+      TreeNode* child = atomicLoad(slot);
+      if (child == nullptr) {
+        setOctantBounds(leaf, node, octant);
+        if (atomicCasPointer(slot, (TreeNode*)nullptr, leaf) == nullptr) {
+          break;
+        }
+      } else if (child == lockedSlot()) {
+        // another thread is splitting this leaf
+      } else if (!loadVolatile(child->isLeaf)) {
+        node = child;
+        depth++;
+      } else if (atomicCasPointer(slot, child, lockedSlot()) == child) {
+        TreeNode* inner = allocateNode(nodes, nodeCount, maxNodes);
+        if (inner == nullptr) {
+          atomicStore(slot, child);
+          return;
+        }
+        setOctantBounds(inner, node, octant);
+        inner->cx = inner->cy = inner->cz = 0.0;
+        inner->mass = -1.0;
+        inner->bodyIndex = -1;
+        inner->isLeaf = false;
+        clearChildren(inner);
+        const int childOctant =
+            octantOf(inner, loadVolatile(child->cx), loadVolatile(child->cy), loadVolatile(child->cz));
+        setOctantBounds(child, inner, childOctant);
+        inner->children[childOctant] = child;
+        atomicStore(slot, inner);
+        node = inner;
+        depth++;
+      }
     }
   }
 }
 
-__global__ void buildTree(TreeNode* nodes, Bodies& bodies, int n, double x_min, double x_max, double y_min,
-                          double y_max, double z_min, double z_max) {
-  int idx = threadIdx.x + blockIdx.x * blockDim.x;
-  if (idx >= n) {
-    return;
-  }
-
-  TreeNode* node = &nodes[0];
-
-  insertBody(node, bodies, idx, x_min, x_max, y_min, y_max, z_min, z_max);
-}
-
-__global__ void computeCentersOfMass(TreeNode* nodes, const Bodies& bodies, int n) {
-  int idx = threadIdx.x + blockIdx.x * blockDim.x;
-  if (idx >= n) {
-    return;
-  }
-
-  TreeNode* node = &nodes[idx];
+// Internal nodes are summed from the end of the pool: children of an internal node are leaves (complete since
+// buildTree) or internal nodes with higher indices, which a thread either has already summed itself or waits for.
+// On the device the kernel must be launched with no more blocks than can be resident at once.
+__global__ void computeCentersOfMass(TreeNode* nodes, const int* nodeCount, int maxNodes) {
+  const int count = *nodeCount < maxNodes ? *nodeCount : maxNodes;
+  for (int k : gridRange(count)) {
+    TreeNode* node = &nodes[count - 1 - k];
+    if (node->isLeaf) {
+      // for leaf nodes, the center of mass is the body itself
+      continue;
+    }
 
-  if (node->isLeaf) {
-    // for leaf nodes, the center of mass is the body itself
-    int bodyIdx = node->bodyIndex;
-    node->cx = bodies.position[bodyIdx].x;
-    node->cy = bodies.position[bodyIdx].y;
-    node->cz = bodies.position[bodyIdx].z;
-    node->mass = bodies.mass[bodyIdx];
-  } else {
     // for internal nodes, the center of mass is the weighted average of the children's center of mass
     double totalMass = 0.0;
     double cx = 0.0, cy = 0.0, cz = 0.0;
-
-    // calculate center of mass
     for (int i = 0; i < 8; i++) {
-      TreeNode* child = node->children[i];
-      if (node->children[i] != nullptr) {
-        totalMass += node->children[i]->mass;
-        cx += child->cx * child->mass;
-        cy += child->cy * child->mass;
-        cz += child->cz * child->mass;
+      const TreeNode* child = node->children[i];
+      if (child == nullptr) {
+        continue;
+      }
+      double childMass;
+      while ((childMass = atomicLoad(const_cast<double*>(&child->mass))) < 0.0) {
       }
+      totalMass += childMass;
+      cx += loadVolatile(child->cx) * childMass;
+      cy += loadVolatile(child->cy) * childMass;
+      cz += loadVolatile(child->cz) * childMass;
     }
 
     if (totalMass > 0.0) {
@@ -152,12 +189,12 @@ __global__ void computeCentersOfMass(TreeNode* nodes, const Bodies& bodies, int
       node->cy = cy / totalMass;
       node->cz = cz / totalMass;
     }
-    node->mass = totalMass;
+    atomicStore(&node->mass, totalMass);
   }
 }
 
-__device__ void computeForcesRecursively(TreeNode* node, const Bodies& bodies, int idx, double mass, double x, double y,
-                                         double z, double* fx, double* fy, double* fz, double theta) {
+__device__ void computeForcesRecursively(const TreeNode* node, int idx, double x, double y, double z, double* fx,
+                                         double* fy, double* fz, double theta) {
   if (node == nullptr) {
     return;
   }
@@ -168,11 +205,10 @@ __device__ void computeForcesRecursively(TreeNode* node, const Bodies& bodies, i
   double dz = node->cz - z;
   double distance = sqrt(dx * dx + dy * dy + dz * dz);
 
-  if (node->isLeaf) {
-    if (node->bodyIndex != idx) {
-      // calculate force between the body and the node
-      double distanceSquared = distance * distance;
-      double distanceCubed = distanceSquared * distance;
+  // a leaf, or a node that is small compared to its distance (size / distance < theta), acts as a single body
+  if (node->isLeaf || node->x_max - node->x_min < theta * distance) {
+    if (node->bodyIndex != idx && distance > 0.0) {
+      double distanceCubed = distance * distance * distance;
       double acceleration = G * node->mass / distanceCubed;
 
       *fx += dx * acceleration;
@@ -180,60 +216,44 @@ __device__ void computeForcesRecursively(TreeNode* node, const Bodies& bodies, i
       *fz += dz * acceleration;
     }
   } else {
-    if (distance / (node->x_max - node->x_min) < theta) {
-      // if the ratio of the distance to the size of the node is less than theta, use the center of mass as a single
-      // body
-      double distanceSquared = distance * distance;
-      double distanceCubed = distanceSquared * distance;
-      double acceleration = G * node->mass / distanceCubed;
-
-      *fx += dx * acceleration;
-      *fy += dy * acceleration;
-      *fz += dz * acceleration;
-    } else {
-      // otherwise, recursively calculate the forces from the children
-      for (int i = 0; i < 8; i++) {
-        computeForcesRecursively(node->children[i], bodies, idx, mass, x, y, z, fx, fy, fz, theta);
-      }
+    // otherwise, recursively calculate the forces from the children
+    for (int i = 0; i < 8; i++) {
+      computeForcesRecursively(node->children[i], idx, x, y, z, fx, fy, fz, theta);
     }
   }
 }
 
-__global__ void computeForces(TreeNode* nodes, const Bodies& bodies, double* forces_x, double* forces_y,
+__global__ void computeForces(const TreeNode* nodes, Bodies bodies, double* forces_x, double* forces_y,
                               double* forces_z, int n, double theta) {
-  int idx = threadIdx.x + blockIdx.x * blockDim.x;
-  if (idx >= n) {
-    return;
+  for (int idx : gridRange(n)) {
+    double ax = 0.0, ay = 0.0, az = 0.0;
+    double x = bodies.position[idx].x;
+    double y = bodies.position[idx].y;
+    double z = bodies.position[idx].z;
+    double mass = bodies.mass[idx];
+
+    // traverse the tree to sum the accelerations
+    computeForcesRecursively(&nodes[0], idx, x, y, z, &ax, &ay, &az, theta);
+    forces_x[idx] = ax * mass;
+    forces_y[idx] = ay * mass;
+    forces_z[idx] = az * mass;
   }
-
-  double fx = 0.0, fy = 0.0, fz = 0.0;
-  double x = bodies.position[idx].x;
-  double y = bodies.position[idx].y;
-  double z = bodies.position[idx].z;
-  double mass = bodies.mass[idx];
-
-  // transverse the tree to calculate the forces
-  TreeNode* node = &nodes[0];
-  computeForcesRecursively(node, bodies, idx, mass, x, y, z, &fx, &fy, &fz, theta);
 }
 
-__global__ void updateBodies(Bodies bodies, int n, double* fx, double* fy, double* fz, double dt) {
-  int idx = threadIdx.x + blockIdx.x * blockDim.x;
-  if (idx >= n) {
-    return;
-  }
+__global__ void updateBodies(Bodies bodies, int n, const double* fx, const double* fy, const double* fz, double dt) {
+  for (int idx : gridRange(n)) {
+    const double mass = bodies.mass[idx];
 
-  const double mass = bodies.mass[idx];
+    bodies.acceleration[idx].x = fx[idx] / mass;
+    bodies.acceleration[idx].y = fy[idx] / mass;
+    bodies.acceleration[idx].z = fz[idx] / mass;
 
-  bodies.acceleration[idx].x = fx[idx] / mass;
-  bodies.acceleration[idx].y = fy[idx] / mass;
-  bodies.acceleration[idx].z = fz[idx] / mass;
+    bodies.velocity[idx].x += bodies.acceleration[idx].x * dt;
+    bodies.velocity[idx].y += bodies.acceleration[idx].y * dt;
+    bodies.velocity[idx].z += bodies.acceleration[idx].z * dt;
 
-  bodies.velocity[idx].x += bodies.acceleration[idx].x * dt;
-  bodies.velocity[idx].y += bodies.acceleration[idx].y * dt;
-  bodies.velocity[idx].z += bodies.acceleration[idx].z * dt;
-
-  bodies.position[idx].x += bodies.velocity[idx].x * dt;
-  bodies.position[idx].y += bodies.velocity[idx].y * dt;
-  bodies.position[idx].z += bodies.velocity[idx].z * dt;
+    bodies.position[idx].x += bodies.velocity[idx].x * dt;
+    bodies.position[idx].y += bodies.velocity[idx].y * dt;
+    bodies.position[idx].z += bodies.velocity[idx].z * dt;
+  }
 }
@@ -0,0 +1,97 @@
+#include "../include/checkpoint.cuh"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define CHECKPOINT_FSYNC 1
+#endif
+
+static const char CHECKPOINT_MAGIC[8] = "NBCKBH1";
+static const char CHECKPOINT_END_MAGIC[8] = "NBCKEND";
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+bool writeCheckpoint(const std::string& filename, const CheckpointHeader* state, const Bodies* bodies) {
+  CheckpointHeader header = *state;
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.headerBytes = sizeof(CheckpointHeader);
+  memset(header.reserved, 0, sizeof(header.reserved));
+  const size_t n = header.bodyCount;
+
+  std::string temporary = filename + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << "Error writing checkpoint " << temporary << std::endl;
+    return false;
+  }
+
+  // Large fwrite calls go straight to write(), bypassing the FILE buffer
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bodies->mass, sizeof(double), n, file) == n &&
+            fwrite(bodies->position, sizeof(double3), n, file) == n &&
+            fwrite(bodies->velocity, sizeof(double3), n, file) == n &&
+            fwrite(CHECKPOINT_END_MAGIC, sizeof(CHECKPOINT_END_MAGIC), 1, file) == 1 && fflush(file) == 0;
+#ifdef CHECKPOINT_FSYNC
+  // The data has to reach the disk before the rename, otherwise a system crash could leave the new name on an empty file
+  ok = ok && fsync(fileno(file)) == 0;
+#endif
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(temporary.c_str(), filename.c_str()) == 0;
+  if (!ok) {
+    std::cerr << "Error writing checkpoint " << filename << std::endl;
+    remove(temporary.c_str());
+    return false;
+  }
+#ifdef CHECKPOINT_FSYNC
+  // Persist the rename itself
+  size_t slash = filename.find_last_of('/');
+  std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+  int fd = open(directory.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+  return true;
+}
+
+bool readCheckpointHeader(const std::string& filename, CheckpointHeader* header) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    std::cerr << "Error opening checkpoint " << filename << std::endl;
+    return false;
+  }
+  bool ok = fread(header, sizeof(CheckpointHeader), 1, file) == 1 &&
+            memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == CHECKPOINT_VERSION && header->headerBytes == sizeof(CheckpointHeader);
+  // A truncated file (e.g. copied while being written) is rejected by its size
+  const uint64_t expectedBytes = sizeof(CheckpointHeader) + header->bodyCount * 7 * sizeof(double) + 8;
+  ok = ok && fseek(file, 0, SEEK_END) == 0 && (uint64_t)ftell(file) == expectedBytes;
+  fclose(file);
+  if (!ok) {
+    std::cerr << filename << " is not a complete checkpoint" << std::endl;
+  }
+  return ok;
+}
+
+bool readCheckpoint(const std::string& filename, const CheckpointHeader* header, Bodies* bodies) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    std::cerr << "Error opening checkpoint " << filename << std::endl;
+    return false;
+  }
+  const size_t n = header->bodyCount;
+  char end[8];
+  bool ok = fseek(file, sizeof(CheckpointHeader), SEEK_SET) == 0 && fread(bodies->mass, sizeof(double), n, file) == n &&
+            fread(bodies->position, sizeof(double3), n, file) == n &&
+            fread(bodies->velocity, sizeof(double3), n, file) == n && fread(end, sizeof(end), 1, file) == 1 &&
+            memcmp(end, CHECKPOINT_END_MAGIC, sizeof(end)) == 0;
+  fclose(file);
+  if (!ok) {
+    std::cerr << filename << " is not a complete checkpoint" << std::endl;
+  }
+  return ok;
+}
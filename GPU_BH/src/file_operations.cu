@@ -1,52 +1,452 @@
 #include "../include/BarnesHut.cuh"
 #include "../include/file_operations.cuh"
-#include <nlohmann/json.hpp>
 
-#include <fstream>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
-using json = nlohmann::json;
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
 
-void writeFile(std::string filename, Bodies* bodies, float seconds, int n, bool append) {
-  json jsonString;
+// Shortest representation that reads back to the same double; integers get ".0" like nlohmann::json::dump()
+static void appendNumber(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  int length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+  out.append(buffer, length);
+  if (strpbrk(buffer, ".e") == nullptr) {
+    out += ".0";
+  }
+}
 
-  jsonString["time"] = seconds;
-  jsonString["bodies"] = json::array();
+static void appendVector(std::string& out, const char* name, double x, double y, double z) {
+  out += '"';
+  out += name;
+  out += "\":{\"x\":";
+  appendNumber(out, x);
+  out += ",\"y\":";
+  appendNumber(out, y);
+  out += ",\"z\":";
+  appendNumber(out, z);
+  out += '}';
+}
 
-  for (int i = 0; i < n; i++) {
-    json body = {
-        {"id", i},
-        {"p", {{"x", bodies->position[i].x}, {"y", bodies->position[i].y}, {"z", bodies->position[i].z}}},
-        {"v", {{"x", bodies->velocity[i].x}, {"y", bodies->velocity[i].y}, {"z", bodies->velocity[i].z}}},
-        {"a", {{"x", bodies->acceleration[i].x}, {"y", bodies->acceleration[i].y}, {"z", bodies->acceleration[i].z}}},
-        {"m", *bodies->mass}};
-    jsonString["bodies"].push_back(body);
+SnapshotFormat snapshotFormatFor(const std::string& filename) {
+  if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".nbt") == 0) {
+    return SNAPSHOT_BINARY;
   }
+  const char* suffixes[] = {".ndjson", ".jsonl"};
+  for (const char* suffix : suffixes) {
+    size_t length = strlen(suffix);
+    if (filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0) {
+      return SNAPSHOT_NDJSON;
+    }
+  }
+  return SNAPSHOT_JSON_ARRAY;
+}
 
-  if (append) {
-    json existingData;
+static const uint64_t TRAJECTORY_FIELDS = 15;
+static const int TRAJECTORY_COLUMNS = 10;
+
+// Cuts an open file to `size` bytes
+static bool truncateFile(FILE* file, long size) {
+  fflush(file);
+#if defined(__unix__) || defined(__APPLE__)
+  return ftruncate(fileno(file), size) == 0;
+#elif defined(_WIN32)
+  return _chsize_s(_fileno(file), size) == 0;
+#else
+  return false;
+#endif
+}
+
+// Searches the JSON frames backwards for the ones written after iteration appendAfter, i.e. frames starting a line
+// with {"time": and a time past appendAfter * dt. Frames are in time order, so the search stops at the first earlier
+// frame. Returns the position of the '{' of the earliest later frame, or -1 when there is none.
+static long findFramesAfter(FILE* file, long size, double dt, int64_t appendAfter) {
+  static const char marker[] = "{\"time\":";
+  const long markerLength = sizeof(marker) - 1;
+  const long block = 1L << 16;
+  long cut = -1;
+  std::string buffer;
+  for (long end = size; end > 0;) {
+    // the overlap with the next block covers a marker with its number and the character before a marker
+    const long from = end > block ? end - block : 0;
+    const long first = from > 0 ? from - 1 : 0;
+    const long last = end + markerLength + 32 < size ? end + markerLength + 32 : size;
+    buffer.resize(last - first);
+    fseek(file, first, SEEK_SET);
+    if (fread(&buffer[0], 1, buffer.size(), file) != buffer.size()) {
+      break;
+    }
+    size_t limit = end - first;
+    while (limit > (size_t)(from - first)) {
+      const size_t found = buffer.rfind(marker, limit - 1);
+      if (found == std::string::npos || found < (size_t)(from - first)) {
+        break;
+      }
+      limit = found;
+      if (first + (long)found > 0 && buffer[found - 1] != '\n') {
+        continue;
+      }
+      char* numberEnd = nullptr;
+      const double seconds = strtod(buffer.c_str() + found + markerLength, &numberEnd);
+      if (numberEnd == buffer.c_str() + found + markerLength) {
+        continue;
+      }
+      if (llround(seconds / dt) <= appendAfter) {
+        return cut;
+      }
+      cut = first + (long)found;
+    }
+    end = from;
+  }
+  return cut;
+}
+
+// Positions the writer after the last frame of an existing file, cutting the frames written after iteration
+// appendAfter; returns false when there is nothing to append to
+static bool reopenSnapshotFile(SnapshotWriter* writer, const std::string& filename, int64_t appendAfter) {
+  writer->file = fopen(filename.c_str(), "r+b");
+  if (writer->file == nullptr) {
+    return false;
+  }
+  fseek(writer->file, 0, SEEK_END);
+  long size = ftell(writer->file);
+
+  if (writer->format != SNAPSHOT_BINARY && appendAfter != INT64_MAX && writer->dt > 0.0) {
+    const long cut = findFramesAfter(writer->file, size, writer->dt, appendAfter);
+    if (cut >= 0 && writer->format == SNAPSHOT_NDJSON) {
+      size = cut;
+    } else if (cut >= 2) {
+      // A frame follows ",\n" (an earlier frame stays) or "[\n"; the closing "\n]" is written below
+      fseek(writer->file, cut - 2, SEEK_SET);
+      const long end = fgetc(writer->file) == ',' ? cut - 2 : cut - 1;
+      fseek(writer->file, end, SEEK_SET);
+      fputs("\n]", writer->file);
+      size = end + 2;
+    }
+    if (cut >= 0 && !truncateFile(writer->file, size)) {
+      fclose(writer->file);
+      writer->file = nullptr;
+      return false;
+    }
+  }
 
-    std::ifstream file(filename, std::ios::in);
-    if (file.is_open()) {
-      file >> existingData;
-      file.close();
+  if (writer->format == SNAPSHOT_NDJSON) {
+    writer->hasFrames = size > 0;
+    fseek(writer->file, 0, SEEK_END);
+    return true;
+  }
+
+  if (writer->format == SNAPSHOT_JSON_ARRAY) {
+    // The next frame overwrites the closing "\n]"; a frame before it ends with '}'
+    char tail[64];
+    long start = size > (long)sizeof(tail) ? size - (long)sizeof(tail) : 0;
+    fseek(writer->file, start, SEEK_SET);
+    size_t length = fread(tail, 1, size - start, writer->file);
+    long bracket = (long)length - 1;
+    while (bracket >= 0 && tail[bracket] != ']') {
+      bracket--;
+    }
+    if (bracket < 0) {
+      fclose(writer->file);
+      writer->file = nullptr;
+      return false;
     }
+    long end = bracket > 0 && tail[bracket - 1] == '\n' ? bracket - 1 : bracket;
+    long last = end - 1;
+    while (last >= 0 && isspace((unsigned char)tail[last])) {
+      last--;
+    }
+    writer->hasFrames = last >= 0 && tail[last] == '}';
+    fseek(writer->file, start + end, SEEK_SET);
+    fputs("\n]", writer->file);
+    fflush(writer->file);
+    fseek(writer->file, start + end, SEEK_SET);
+    return true;
+  }
 
-    existingData.push_back(jsonString);
-    jsonString = existingData;
-  } else { // If we are not appending, we need to wrap the json object in an array
-    json array = json::array();
-    array.push_back(jsonString);
-    jsonString = array;
+  // Binary trajectory: frames are listed by the index, or follow from the fixed frame size when the run was killed
+  // before the index was written; the next frame overwrites the old index and trailer
+  TrajectoryFileHeader header;
+  TrajectoryTrailer trailer;
+  fseek(writer->file, 0, SEEK_SET);
+  if (fread(&header, sizeof(header), 1, writer->file) != 1 || memcmp(header.magic, "NBTRAJ1", 8) != 0 ||
+      header.version != 1 || header.scalarBytes != sizeof(double) || header.fields != TRAJECTORY_FIELDS ||
+      (writer->bodyCount != 0 && header.bodyCount != writer->bodyCount)) {
+    fclose(writer->file);
+    writer->file = nullptr;
+    return false;
+  }
+  const uint64_t frameBytes = sizeof(TrajectoryFrameHeader) + TRAJECTORY_COLUMNS * header.bodyCount * sizeof(double);
+  uint64_t frames = (size - sizeof(header)) / frameBytes;
+  if (size >= (long)(sizeof(header) + sizeof(trailer)) && fseek(writer->file, size - sizeof(trailer), SEEK_SET) == 0 &&
+      fread(&trailer, sizeof(trailer), 1, writer->file) == 1 && memcmp(trailer.magic, "NBTRIDX", 8) == 0) {
+    frames = trailer.frameCount;
+  }
+  // Frames of the interrupted run past the checkpoint are recomputed by the resumed run
+  TrajectoryFrameHeader frame;
+  while (frames > 0 && fseek(writer->file, sizeof(header) + (frames - 1) * frameBytes, SEEK_SET) == 0 &&
+         fread(&frame, sizeof(frame), 1, writer->file) == 1 && frame.step > appendAfter) {
+    frames--;
+  }
+  writer->frameOffsets.clear();
+  for (uint64_t k = 0; k < frames; k++) {
+    writer->frameOffsets.push_back(sizeof(TrajectoryFileHeader) + k * frameBytes);
+  }
+  writer->hasFrames = true;
+  if (appendAfter != INT64_MAX && !truncateFile(writer->file, sizeof(header) + frames * frameBytes)) {
+    fclose(writer->file);
+    writer->file = nullptr;
+    return false;
   }
+  fseek(writer->file, sizeof(header) + frames * frameBytes, SEEK_SET);
+  return true;
+}
 
-  std::ofstream file(filename, std::ios::out);
-  if (!file.is_open()) {
+bool openSnapshotWriter(SnapshotWriter* writer, const std::string& filename, SnapshotFormat format, double dt,
+                        bool append, int64_t appendAfter) {
+  writer->format = format;
+  writer->hasFrames = false;
+  writer->dt = dt;
+  writer->frameOffsets.clear();
+  if (append && reopenSnapshotFile(writer, filename, appendAfter)) {
+    return true;
+  }
+  // An existing file that cannot be continued is never truncated
+  if (append) {
+    FILE* existing = fopen(filename.c_str(), "rb");
+    if (existing != nullptr) {
+      fclose(existing);
+      std::cout << "Error: " << filename << " cannot be continued by this run and is left unchanged." << std::endl;
+      return false;
+    }
+  }
+  writer->hasFrames = false;
+  writer->file = fopen(filename.c_str(), "wb");
+  if (writer->file == nullptr) {
     std::cout << "Error opening file." << std::endl;
+    return false;
+  }
+
+  if (format == SNAPSHOT_JSON_ARRAY) {
+    fputs("[\n]", writer->file);
+    fflush(writer->file);
+    fseek(writer->file, -2, SEEK_CUR);
+  }
+  return true;
+}
+
+// The file header is written with the first frame, when the number of bodies is known
+static void writeTrajectoryFrame(SnapshotWriter* writer, Bodies* bodies, float seconds, int n) {
+  const uint64_t frameBytes = sizeof(TrajectoryFrameHeader) + TRAJECTORY_COLUMNS * (uint64_t)n * sizeof(double);
+  if (!writer->hasFrames) {
+    TrajectoryFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "NBTRAJ1", 8);
+    header.version = 1;
+    header.fields = TRAJECTORY_FIELDS;
+    header.scalarBytes = sizeof(double);
+    header.headerBytes = sizeof(TrajectoryFileHeader);
+    header.bodyCount = n;
+    header.dt = writer->dt;
+    strcpy(header.units, "m kg s");
+    fwrite(&header, sizeof(header), 1, writer->file);
+  }
+
+  TrajectoryFrameHeader frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.step = writer->dt > 0.0 ? llround(seconds / writer->dt) : (int64_t)writer->frameOffsets.size();
+  frame.time = seconds;
+  frame.timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+  writer->frameOffsets.push_back(sizeof(TrajectoryFileHeader) + writer->frameOffsets.size() * frameBytes);
+  fwrite(&frame, sizeof(frame), 1, writer->file);
+
+  // Columns x, y, z, vx, vy, vz, ax, ay, az are gathered from the interleaved double3 arrays
+  double3* vectors[3] = {bodies->position, bodies->velocity, bodies->acceleration};
+  std::vector<double>& column = writer->column;
+  column.resize(n);
+  for (int v = 0; v < 3; v++) {
+    for (int component = 0; component < 3; component++) {
+      for (int i = 0; i < n; i++) {
+        column[i] = component == 0 ? vectors[v][i].x : component == 1 ? vectors[v][i].y : vectors[v][i].z;
+      }
+      fwrite(column.data(), sizeof(double), n, writer->file);
+    }
+  }
+  fwrite(bodies->mass, sizeof(double), n, writer->file);
+  fflush(writer->file);
+  writer->hasFrames = true;
+}
+
+void writeSnapshot(SnapshotWriter* writer, Bodies* bodies, float seconds, int n) {
+  if (writer->file == nullptr) {
     return;
   }
+  if (writer->format == SNAPSHOT_BINARY) {
+    writeTrajectoryFrame(writer, bodies, seconds, n);
+    return;
+  }
+
+  std::string& out = writer->buffer;
+  out.clear();
+  if (writer->format == SNAPSHOT_JSON_ARRAY) {
+    out += writer->hasFrames ? ",\n" : "\n";
+  }
 
-  file << jsonString.dump(2);
+  out += "{\"time\":";
+  appendNumber(out, seconds);
+  out += ",\"bodies\":[";
+  for (int i = 0; i < n; i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += "{\"id\":";
+    out += std::to_string(i);
+    out += ',';
+    appendVector(out, "p", bodies->position[i].x, bodies->position[i].y, bodies->position[i].z);
+    out += ',';
+    appendVector(out, "v", bodies->velocity[i].x, bodies->velocity[i].y, bodies->velocity[i].z);
+    out += ',';
+    appendVector(out, "a", bodies->acceleration[i].x, bodies->acceleration[i].y, bodies->acceleration[i].z);
+    out += ",\"m\":";
+    appendNumber(out, bodies->mass[i]);
+    out += '}';
+  }
+  out += "]}";
+  out += writer->format == SNAPSHOT_JSON_ARRAY ? "\n]" : "\n";
+
+  fwrite(out.data(), 1, out.size(), writer->file);
+  fflush(writer->file);
+  if (writer->format == SNAPSHOT_JSON_ARRAY) {
+    fseek(writer->file, -2, SEEK_CUR);
+  }
+  writer->hasFrames = true;
+}
+
+void closeSnapshotWriter(SnapshotWriter* writer) {
+  if (writer->file != nullptr && writer->format == SNAPSHOT_BINARY && writer->hasFrames) {
+    // Index of frame offsets and the trailer pointing at it
+    TrajectoryTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.frameCount = writer->frameOffsets.size();
+    trailer.indexOffset = ftell(writer->file);
+    memcpy(trailer.magic, "NBTRIDX", 8);
+    fwrite(writer->frameOffsets.data(), sizeof(uint64_t), writer->frameOffsets.size(), writer->file);
+    fwrite(&trailer, sizeof(trailer), 1, writer->file);
+#if defined(__unix__) || defined(__APPLE__)
+    // An appended file may still hold a torn frame of the interrupted run past the new trailer
+    fflush(writer->file);
+    if (ftruncate(fileno(writer->file), ftell(writer->file)) != 0) {
+      std::cout << "Error truncating the trajectory file." << std::endl;
+    }
+#endif
+  }
+  if (writer->file != nullptr) {
+    fclose(writer->file);
+    writer->file = nullptr;
+  }
+}
 
-  file.close();
-}
\ No newline at end of file
+static void runSnapshotThread(AsyncSnapshotWriter* writer) {
+  std::unique_lock<std::mutex> lock(writer->mutex);
+  while (true) {
+    writer->bufferReady.wait(lock, [writer] { return writer->stopping || !writer->readyBuffers.empty(); });
+    if (writer->readyBuffers.empty()) {
+      return;
+    }
+    int buffer = writer->readyBuffers.front();
+    writer->readyBuffers.pop_front();
+    writer->writing++;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    writeSnapshot(&writer->writer, &writer->buffers[buffer], writer->times[buffer], writer->numberOfBodies);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    writer->writing--;
+    writer->framesWritten++;
+    writer->writeSeconds += seconds;
+    writer->freeBuffers.push_back(buffer);
+    writer->bufferFree.notify_all();
+  }
+}
+
+bool openAsyncSnapshotWriter(AsyncSnapshotWriter* writer, const std::string& filename, SnapshotFormat format, double dt,
+                             int numberOfBodies, Backpressure backpressure, bool append, int bufferCount,
+                             int64_t appendAfter) {
+  writer->writer.bodyCount = numberOfBodies;
+  if (!openSnapshotWriter(&writer->writer, filename, format, dt, append, appendAfter)) {
+    return false;
+  }
+  writer->backpressure = backpressure;
+  writer->numberOfBodies = numberOfBodies;
+  writer->stopping = false;
+  bufferCount = bufferCount < 1 ? 1 : bufferCount;
+
+  // Host memory laid out like cpu_bodies in main.cu, pinned on the device backend
+  writer->buffers.resize(bufferCount);
+  writer->times.assign(bufferCount, 0.0f);
+  for (int b = 0; b < bufferCount; b++) {
+    double* memory = (double*)hostAllocatePinned(numberOfBodies * sizeof(double) * 10);
+    writer->buffers[b] = {memory, (double3*)(memory + numberOfBodies), (double3*)(memory + 4 * numberOfBodies),
+                          (double3*)(memory + 7 * numberOfBodies)};
+    writer->freeBuffers.push_back(b);
+  }
+  writer->thread = std::thread(runSnapshotThread, writer);
+  return true;
+}
+
+Bodies* acquireSnapshotBuffer(AsyncSnapshotWriter* writer) {
+  if (writer->writer.file == nullptr) {
+    return nullptr;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(writer->mutex);
+  if (writer->freeBuffers.empty() && writer->backpressure == BACKPRESSURE_DROP) {
+    writer->framesDropped++;
+    return nullptr;
+  }
+  writer->bufferFree.wait(lock, [writer] { return !writer->freeBuffers.empty(); });
+  int buffer = writer->freeBuffers.front();
+  writer->freeBuffers.pop_front();
+  writer->waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return &writer->buffers[buffer];
+}
+
+void submitSnapshot(AsyncSnapshotWriter* writer, Bodies* buffer, float seconds) {
+  int index = (int)(buffer - writer->buffers.data());
+  {
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->times[index] = seconds;
+    writer->readyBuffers.push_back(index);
+  }
+  writer->bufferReady.notify_one();
+}
+
+void closeAsyncSnapshotWriter(AsyncSnapshotWriter* writer) {
+  if (writer->thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(writer->mutex);
+      writer->stopping = true;
+    }
+    writer->bufferReady.notify_one();
+    writer->thread.join();
+  }
+  for (size_t b = 0; b < writer->buffers.size(); b++) {
+    hostFreePinned(writer->buffers[b].mass);
+  }
+  writer->buffers.clear();
+  writer->freeBuffers.clear();
+  closeSnapshotWriter(&writer->writer);
+}
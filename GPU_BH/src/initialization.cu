@@ -1,19 +1,24 @@
 #include "../include/initialization.cuh"
+#include "../include/philox.cuh"
 #include <fstream>
 #include <nlohmann/json.hpp>
+#include <vector>
 
-void initializeBodies(Bodies bodies, int numberOfBodies, double spreadX,
+void initializeBodies(Bodies bodies, int numberOfBodies, uint64_t seed, double spreadX,
                         double spreadY, double spreadZ) {
     double mass = 10e15;
 
   for (int i = 0; i < numberOfBodies; i++) {
-    // initialize the bodies randomly spread around 0,0
-    double x = static_cast<double>(rand()) / static_cast<double>(RAND_MAX) - 0.5;
-    double y = static_cast<double>(rand()) / static_cast<double>(RAND_MAX) - 0.5;
-    double z = static_cast<double>(rand()) / static_cast<double>(RAND_MAX) - 0.5;
+    // initialize the bodies randomly spread around 0,0; each body has its own Philox stream
+    uint32_t random[8];
+    philoxBlock(seed, i, 0, random);
+    philoxBlock(seed, i, 1, random + 4);
+    double x = philoxToDouble(random[0], random[1]) - 0.5;
+    double y = philoxToDouble(random[2], random[3]) - 0.5;
+    double z = philoxToDouble(random[4], random[5]) - 0.5;
     bodies.position[i].x = x * spreadX;
-    bodies.position[i].y = x * spreadY;
-    bodies.position[i].z = x * spreadZ;
+    bodies.position[i].y = y * spreadY;
+    bodies.position[i].z = z * spreadZ;
 
     bodies.velocity[i].x = 0;
     bodies.velocity[i].y = 0;
@@ -32,16 +37,30 @@ using json = nlohmann::json;
 Config parseConfig(const int argc, const char** argv) {
   Config config;
 
-  if (argc <= 1) {
-    return config;
+  // Checkpoint and seed options may appear anywhere, the remaining arguments are positional
+  std::vector<const char*> args = {argv[0]};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      config.checkpointFilename = argv[++i];
+    } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+      config.checkpointInterval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--restart") == 0 && i + 1 < argc) {
+      config.restartFilename = argv[++i];
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      config.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+    } else {
+      args.push_back(argv[i]);
+    }
   }
+  const int positional = (int)args.size();
 
-  if (argc > 1) {
-    if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
-      std::cout << "Usage: " << argv[0] << " [number of bodies] [iterations] [save interval] [dt] [output filename]" << std::endl;
+  if (positional > 1) {
+    if (strcmp(args[1], "--help") == 0 || strcmp(args[1], "-h") == 0) {
+      std::cout << "Usage: " << args[0] << " [number of bodies] [iterations] [save interval] [dt] [output filename] [block|drop]"
+                << " [--checkpoint file] [--checkpoint-interval iterations] [--restart file] [--seed seed]" << std::endl;
       exit(0);
-    } else if (strcmp(argv[1], "--config") == 0 || strcmp(argv[1], "-c") == 0) {
-      std::ifstream file(argv[2]);
+    } else if ((strcmp(args[1], "--config") == 0 || strcmp(args[1], "-c") == 0) && positional > 2) {
+      std::ifstream file(args[2]);
       if (file.is_open()) {
         json configJson;
         file >> configJson;
@@ -52,38 +71,48 @@ Config parseConfig(const int argc, const char** argv) {
         config.saveInterval = configJson["saveInterval"];
         config.dt = configJson["dt"];
         config.outputFilename = configJson["outputFilename"];
+        config.dropSnapshots = configJson.value("snapshotBackpressure", std::string("block")) == "drop";
+        config.checkpointFilename = configJson.value("checkpointFilename", config.checkpointFilename);
+        config.checkpointInterval = configJson.value("checkpointInterval", config.checkpointInterval);
+        config.restartFilename = configJson.value("restartFilename", config.restartFilename);
+        config.seed = configJson.value("seed", config.seed);
       } else {
         std::cout << "Error opening file." << std::endl;
         exit(0);
       }
     } else {
-      config.numberOfBodies = atoi(argv[1]);
-    }
+      // Positional arguments only without a config file - otherwise they would overwrite it with atoi("--config")
+      config.numberOfBodies = atoi(args[1]);
 
-    if (argc > 1) {
-      config.numberOfBodies = atoi(argv[1]);
-    }
+      if (positional > 2) {
+        config.iterations = atoi(args[2]);
+      }
 
-    if (argc > 2) {
-      config.iterations = atoi(argv[2]);
-    }
+      if (positional > 3) {
+        config.saveInterval = atoi(args[3]);
+      }
 
-    if (argc > 3) {
-      config.saveInterval = atoi(argv[3]);
-    }
+      if (positional > 4) {
+        config.dt = atof(args[4]);
+      }
 
-    if (argc > 4) {
-      config.dt = atof(argv[4]);
-    }
+      if (positional > 5) {
+        config.outputFilename = args[5];
+      }
 
-    if (argc > 5) {
-      config.outputFilename = argv[5];
+      if (positional > 6) {
+        config.dropSnapshots = strcmp(args[6], "drop") == 0;
+      }
     }
   }
 
+  if (config.checkpointInterval > 0 && config.checkpointFilename.empty()) {
+    config.checkpointFilename = "checkpoint.nbc";
+  }
   return config;
 }
 
+#ifdef NBODY_CUDA
 int getCudaBlockSize() {
   int deviceCount;
   cudaError_t err = cudaGetDeviceCount(&deviceCount);
@@ -103,4 +132,28 @@ int getCudaBlockSize() {
     std::cout << "Block size: " << prop.maxThreadsPerBlock << std::endl;
     return prop.maxThreadsPerBlock;
   }
-}
\ No newline at end of file
+}
+
+int getMultiprocessorCount() {
+  cudaDeviceProp prop;
+  cudaGetDeviceProperties(&prop, 0);
+  return prop.multiProcessorCount;
+}
+#else
+int getCudaBlockSize() {
+#ifdef _OPENMP
+  std::cout << "Host backend: " << omp_get_max_threads() << " OpenMP threads" << std::endl;
+#else
+  std::cout << "Host backend: 1 thread (built without OpenMP)" << std::endl;
+#endif
+  return 256;
+}
+
+int getMultiprocessorCount() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+#endif
@@ -1,31 +1,47 @@
 #include "../include/BarnesHut.cuh"
+#include "../include/checkpoint.cuh"
 #include "../include/file_operations.cuh"
 #include "../include/initialization.cuh"
+#include <chrono>
 #include <iostream>
 
 // #define BLOCK_SIZE 256
 #define G 6.67430e-11 // Gravitational constant
 
 void cleanup(Bodies& bodies, TreeNode* nodes) {
-  cudaFree(bodies.mass);
-  cudaFree(bodies.position);
-  cudaFree(bodies.velocity);
-  cudaFree(bodies.acceleration);
-
-  cudaFree(nodes);
+  // the four arrays share one allocation starting at bodies.mass
+  deviceFree(bodies.mass);
+  deviceFree(nodes);
 }
 
 int main(const int argc, const char** argv) {
-  srand(time(NULL));
   Config config = parseConfig(argc, argv);
 
+  // A resumed run takes the state, the iteration and the solver parameters from the checkpoint
+  CheckpointHeader checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  const bool restart = !config.restartFilename.empty();
+  if (restart) {
+    if (!readCheckpointHeader(config.restartFilename, &checkpoint)) {
+      return 1;
+    }
+    config.numberOfBodies = (int)checkpoint.bodyCount;
+    config.dt = (float)checkpoint.dt;
+    config.theta = checkpoint.theta;
+    config.seed = (unsigned int)checkpoint.seed;
+    std::cout << "Resuming from " << config.restartFilename << " after iteration " << checkpoint.iteration << std::endl;
+  } else if (config.seed == 0) {
+    config.seed = (unsigned int)time(NULL);
+  }
+  std::cout << "Seed: " << config.seed << std::endl;
+
   int blockSize = getCudaBlockSize();
+  int residentBlocks = getMultiprocessorCount();
 
-  // GPU bodies
-  double* gpu_buffer;
-  cudaMalloc(&gpu_buffer, config.numberOfBodies * (sizeof(double) * 10));
+  // GPU bodies (host memory on the host backend)
+  double* gpu_buffer = (double*)deviceAllocate(config.numberOfBodies * (sizeof(double) * 10));
   Bodies gpu_bodies = {(double*)gpu_buffer, (double3*)(gpu_buffer + config.numberOfBodies),
-                       (double3*)(gpu_buffer + 3 * config.numberOfBodies), (double3*)(gpu_buffer + 5 * config.numberOfBodies)};
+                       (double3*)(gpu_buffer + 4 * config.numberOfBodies), (double3*)(gpu_buffer + 7 * config.numberOfBodies)};
 
   // CPU bodies
   double* cpu_buffer = (double*)malloc(config.numberOfBodies * sizeof(double) * 10);
@@ -33,58 +49,142 @@ int main(const int argc, const char** argv) {
                        (double3*)(cpu_buffer + 4 * config.numberOfBodies),
                        (double3*)(cpu_buffer + 7 * config.numberOfBodies)};
 
-  initializeBodies(cpu_bodies, config.numberOfBodies);
-
-
-  cudaMemcpy(gpu_buffer, cpu_buffer, config.numberOfBodies * (sizeof(double) * 10), cudaMemcpyHostToDevice);
-
-  int maxNodes = 8 * config.numberOfBodies;
-  TreeNode* nodes;
-  cudaMalloc((void**)&nodes, sizeof(TreeNode) * maxNodes);
+  if (restart) {
+    if (!readCheckpoint(config.restartFilename, &checkpoint, &cpu_bodies)) {
+      free(cpu_buffer);
+      return 1;
+    }
+  } else {
+    initializeBodies(cpu_bodies, config.numberOfBodies, config.seed);
+  }
 
-  TreeNode* nodesCPU = (TreeNode*)malloc(config.numberOfBodies * sizeof(TreeNode) * maxNodes);
 
-  double cpuBounds[6] = {0};
+  copyToDevice(gpu_buffer, cpu_buffer, config.numberOfBodies * (sizeof(double) * 10));
 
-  double bounds[6];
-  cudaMalloc((void**)bounds, sizeof(double));
+  // one leaf per body plus the internal nodes; clustered bodies need more levels than a uniform cube
+  int maxNodes = 8 * config.numberOfBodies + 1;
+  TreeNode* nodes = (TreeNode*)deviceAllocate(sizeof(TreeNode) * maxNodes);
+  int* nodeCount = (int*)deviceAllocate(sizeof(int));
 
-  cudaMemcpy(bounds, cpuBounds, 6 * sizeof(double), cudaMemcpyHostToDevice);
+  // every iteration starts the bounding box reduction from empty bounds
+  const double emptyBounds[6] = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+  double* bounds = (double*)deviceAllocate(sizeof(emptyBounds));
 
   int numberOfBlocks = (config.numberOfBodies + blockSize - 1) / blockSize;
 
-  double *fx, *fy, *fz;
-  cudaMalloc((void**)&fx, sizeof(double) * config.numberOfBodies);
-  cudaMalloc((void**)&fy, sizeof(double) * config.numberOfBodies);
-  cudaMalloc((void**)&fz, sizeof(double) * config.numberOfBodies);
-
-  for (int i = 0; i < config.iterations; i++) {
-    computeBoundingBox<<<numberOfBlocks, blockSize>>>(gpu_bodies, config.numberOfBodies, bounds);
-    cudaDeviceSynchronize();
-    buildTree<<<numberOfBlocks, blockSize>>>(nodes, gpu_bodies, config.numberOfBodies, bounds[0], bounds[1], bounds[2],
-                                             bounds[3], bounds[4], bounds[5]);
-    cudaDeviceSynchronize();
-    computeForces<<<numberOfBlocks, blockSize>>>(nodes, gpu_bodies, fx, fy, fz, config.numberOfBodies, .8);
-    cudaDeviceSynchronize();
-    updateBodies<<<numberOfBlocks, blockSize>>>(gpu_bodies, config.numberOfBodies, fx, fy, fz, config.dt);
+  double* fx = (double*)deviceAllocate(sizeof(double) * config.numberOfBodies);
+  double* fy = (double*)deviceAllocate(sizeof(double) * config.numberOfBodies);
+  double* fz = (double*)deviceAllocate(sizeof(double) * config.numberOfBodies);
+
+  // The output file stays open for the whole run, every snapshot is only appended by a background I/O thread.
+  // A resumed run appends to the output of the interrupted one, after its last frame up to the checkpoint
+  AsyncSnapshotWriter snapshots;
+  if (!openAsyncSnapshotWriter(&snapshots, config.outputFilename, snapshotFormatFor(config.outputFilename), config.dt,
+                               config.numberOfBodies, config.dropSnapshots ? BACKPRESSURE_DROP : BACKPRESSURE_BLOCK,
+                               restart, 2, restart ? checkpoint.iteration : INT64_MAX) &&
+      restart) {
+    cleanup(gpu_bodies, nodes);
+    deviceFree(nodeCount);
+    deviceFree(fx);
+    deviceFree(fy);
+    deviceFree(fz);
+    deviceFree(bounds);
+    free(cpu_buffer);
+    return 1;
+  }
+  double snapshotSeconds = 0.0;
+
+  // The host copy of the bodies is free after the initialization and serves as the checkpoint buffer
+  int checkpoints = 0;
+  double checkpointSeconds = 0.0;
+  auto writeRunCheckpoint = [&](int iteration) {
+    auto start = std::chrono::steady_clock::now();
+    synchronizeDevice();
+    copyToHost(cpu_bodies.mass, gpu_bodies.mass, config.numberOfBodies * sizeof(double));
+    copyToHost(cpu_bodies.position, gpu_bodies.position, config.numberOfBodies * (sizeof(double) * 3));
+    copyToHost(cpu_bodies.velocity, gpu_bodies.velocity, config.numberOfBodies * (sizeof(double) * 3));
+    checkpoint.bodyCount = config.numberOfBodies;
+    checkpoint.iteration = iteration;
+    checkpoint.time = (iteration + 1) * (double)config.dt;
+    checkpoint.dt = config.dt;
+    checkpoint.theta = config.theta;
+    checkpoint.seed = config.seed;
+    if (writeCheckpoint(config.checkpointFilename, &checkpoint, &cpu_bodies)) {
+      checkpoints++;
+    }
+    checkpointSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  const int firstIteration = restart ? (int)checkpoint.iteration + 1 : 0;
+  int lastCheckpoint = restart ? (int)checkpoint.iteration : -1;
+  bool treeOverflow = false;
+  auto simulationStart = std::chrono::steady_clock::now();
+  for (int i = firstIteration; i < config.iterations; i++) {
+    // kernels of one iteration run in launch order; only the node count comes back to the host
+    copyToDevice(bounds, emptyBounds, sizeof(emptyBounds));
+    launchKernel(computeBoundingBox, residentBlocks, blockSize, gpu_bodies, config.numberOfBodies, bounds);
+    launchKernel(initializeTree, 1, 1, nodes, nodeCount, bounds);
+    launchKernel(buildTree, numberOfBlocks, blockSize, nodes, nodeCount, maxNodes, gpu_bodies, config.numberOfBodies);
+    int usedNodes = 0;
+    copyToHost(&usedNodes, nodeCount, sizeof(int));
+    if (usedNodes > maxNodes) {
+      std::cerr << "Error: the tree needs more than " << maxNodes << " nodes in iteration " << i
+                << " (or more than 8 bodies share a position)" << std::endl;
+      treeOverflow = true;
+      break;
+    }
+    launchKernel(computeCentersOfMass, residentBlocks, blockSize, nodes, nodeCount, maxNodes);
+    launchKernel(computeForces, numberOfBlocks, blockSize, nodes, gpu_bodies, fx, fy, fz,
+                 config.numberOfBodies, config.theta);
+    launchKernel(updateBodies, numberOfBlocks, blockSize, gpu_bodies, config.numberOfBodies, fx, fy, fz,
+                 config.dt);
 
     if (config.saveInterval > 0 && i % config.saveInterval == 0) {
-      cudaDeviceSynchronize();
-      cudaMemcpy(cpu_bodies.mass, gpu_bodies.mass, config.numberOfBodies * sizeof(double), cudaMemcpyDeviceToHost);
-      cudaMemcpy(cpu_bodies.acceleration, gpu_bodies.acceleration, config.numberOfBodies * (sizeof(double) * 3),
-                 cudaMemcpyDeviceToHost);
-      cudaMemcpy(cpu_bodies.position, gpu_bodies.position, config.numberOfBodies * (sizeof(double) * 3),
-                 cudaMemcpyDeviceToHost);
-      cudaMemcpy(cpu_bodies.velocity, gpu_bodies.velocity, config.numberOfBodies * (sizeof(double) * 3),
-                 cudaMemcpyDeviceToHost);
-      writeFile(config.outputFilename, &cpu_bodies, i * config.dt, config.numberOfBodies, i > config.saveInterval);
+      // Only the device-to-host copy stays in the step loop, serialization runs on the I/O thread
+      auto saveStart = std::chrono::steady_clock::now();
+      Bodies* frame = acquireSnapshotBuffer(&snapshots);
+      if (frame != nullptr) {
+        synchronizeDevice();
+        copyToHost(frame->mass, gpu_bodies.mass, config.numberOfBodies * sizeof(double));
+        copyToHost(frame->acceleration, gpu_bodies.acceleration, config.numberOfBodies * (sizeof(double) * 3));
+        copyToHost(frame->position, gpu_bodies.position, config.numberOfBodies * (sizeof(double) * 3));
+        copyToHost(frame->velocity, gpu_bodies.velocity, config.numberOfBodies * (sizeof(double) * 3));
+        submitSnapshot(&snapshots, frame, i * config.dt);
+      }
+      snapshotSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+    }
+
+    if (config.checkpointInterval > 0 && (i + 1) % config.checkpointInterval == 0) {
+      writeRunCheckpoint(i);
+      lastCheckpoint = i;
     }
   }
+  synchronizeDevice();
+  const double simulationSeconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - simulationStart).count();
+  const int simulatedIterations = config.iterations > firstIteration ? config.iterations - firstIteration : 0;
+  std::cout << "Simulation: " << simulationSeconds * 1000.0 << " ms, "
+            << (simulatedIterations > 0 ? simulationSeconds * 1000.0 / simulatedIterations : 0.0)
+            << " ms per iteration" << std::endl;
+
+  // The final checkpoint lets a finished run be extended with --restart and more iterations
+  if (!treeOverflow && !config.checkpointFilename.empty() && config.iterations > 0 && lastCheckpoint < config.iterations - 1) {
+    writeRunCheckpoint(config.iterations - 1);
+  }
 
+  closeAsyncSnapshotWriter(&snapshots);
+  std::cout << "Snapshots: " << snapshots.framesWritten << " written, " << snapshots.framesDropped << " dropped, "
+            << snapshotSeconds * 1000.0 << " ms in the step loop (" << snapshots.waitSeconds * 1000.0
+            << " ms waiting for a buffer), " << snapshots.writeSeconds * 1000.0 << " ms on the I/O thread" << std::endl;
+  if (checkpoints > 0) {
+    std::cout << "Checkpoints: " << checkpoints << " written in " << checkpointSeconds * 1000.0 << " ms" << std::endl;
+  }
   cleanup(gpu_bodies, nodes);
-  cudaFree(fx);
-  cudaFree(fy);
-  cudaFree(fz);
-  cudaFree(bounds);
+  deviceFree(nodeCount);
+  deviceFree(fx);
+  deviceFree(fy);
+  deviceFree(fz);
+  deviceFree(bounds);
   free(cpu_buffer);
+  return treeOverflow ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "gtest/gtest.h"
+#include "../include/BarnesHut.cuh"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Bodies, tree and force buffers allocated through the execution layer, so the tests run the kernels on the device
+// or on the host backend, whichever is built
+struct KernelSystem {
+  explicit KernelSystem(const std::vector<double>& hostBuffer) : n((int)(hostBuffer.size() / 10)) {
+    buffer = (double*)deviceAllocate(hostBuffer.size() * sizeof(double));
+    copyToDevice(buffer, hostBuffer.data(), hostBuffer.size() * sizeof(double));
+    bodies = {buffer, (double3*)(buffer + n), (double3*)(buffer + 4 * n), (double3*)(buffer + 7 * n)};
+    maxNodes = 8 * n + 1;
+    nodes = (TreeNode*)deviceAllocate(sizeof(TreeNode) * maxNodes);
+    nodeCount = (int*)deviceAllocate(sizeof(int));
+    bounds = (double*)deviceAllocate(6 * sizeof(double));
+    fx = (double*)deviceAllocate(n * sizeof(double));
+    fy = (double*)deviceAllocate(n * sizeof(double));
+    fz = (double*)deviceAllocate(n * sizeof(double));
+  }
+
+  ~KernelSystem() {
+    for (void* memory : {(void*)buffer, (void*)nodes, (void*)nodeCount, (void*)bounds, (void*)fx, (void*)fy,
+                         (void*)fz}) {
+      deviceFree(memory);
+    }
+  }
+
+  int blocks() const { return (n + 255) / 256; }
+
+  std::vector<double> boundingBox() {
+    const double emptyBounds[6] = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+    copyToDevice(bounds, emptyBounds, sizeof(emptyBounds));
+    launchKernel(computeBoundingBox, 4, 256, bodies, n, bounds);
+    std::vector<double> result(6);
+    copyToHost(result.data(), bounds, sizeof(emptyBounds));
+    return result;
+  }
+
+  // Returns the number of nodes used by the tree
+  int tree() {
+    boundingBox();
+    launchKernel(initializeTree, 1, 1, nodes, nodeCount, bounds);
+    launchKernel(buildTree, blocks(), 256, nodes, nodeCount, maxNodes, bodies, n);
+    int used = 0;
+    copyToHost(&used, nodeCount, sizeof(int));
+    return used;
+  }
+
+  void centersOfMass() { launchKernel(computeCentersOfMass, 4, 256, nodes, nodeCount, maxNodes); }
+
+  void forces(double theta) { launchKernel(computeForces, blocks(), 256, nodes, bodies, fx, fy, fz, n, theta); }
+
+  std::vector<TreeNode> downloadNodes(int count) const {
+    std::vector<TreeNode> result(count);
+    copyToHost(result.data(), nodes, count * sizeof(TreeNode));
+    return result;
+  }
+
+  // Index of a child in the pool; the pointers in the downloaded nodes are device addresses
+  int indexOf(const TreeNode* child) const { return child == nullptr ? -1 : (int)(child - nodes); }
+
+  std::vector<double> download(const double* array, int count) const {
+    std::vector<double> result(count);
+    copyToHost(result.data(), array, count * sizeof(double));
+    return result;
+  }
+
+  int n;
+  int maxNodes;
+  double* buffer;
+  Bodies bodies;
+  TreeNode* nodes;
+  int* nodeCount;
+  double* bounds;
+  double *fx, *fy, *fz;
+};
+
+static void setThreads(int threads) {
+#if defined(NBODY_HOST_BACKEND) && defined(_OPENMP)
+  omp_set_num_threads(threads);
+#else
+  (void)threads;
+#endif
+}
+
+// Host buffer laid out like cpu_bodies in main.cu; half of the bodies in a dense clump, so the tree gets deep
+static std::vector<double> randomBodies(int n, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> cube(-5e3, 5e3);
+  std::normal_distribution<double> clump(1e3, 10.0);
+  std::uniform_real_distribution<double> mass(1e15, 1e16);
+  std::vector<double> buffer(10 * n, 0.0);
+  for (int i = 0; i < n; i++) {
+    buffer[i] = mass(rng);
+    for (int k = 0; k < 3; k++) {
+      buffer[n + 3 * i + k] = i % 2 ? clump(rng) : cube(rng);
+      buffer[4 * n + 3 * i + k] = cube(rng) * 1e-3;
+    }
+  }
+  return buffer;
+}
+
+static double3 positionOf(const std::vector<double>& buffer, int n, int i) {
+  return make_double3(buffer[n + 3 * i], buffer[n + 3 * i + 1], buffer[n + 3 * i + 2]);
+}
+
+TEST(BarnesHutTest, BoundingBoxCoversEveryBody) {
+  const int n = 3001;
+  const std::vector<double> buffer = randomBodies(n, 1);
+  double expected[6] = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+  for (int i = 0; i < n; i++) {
+    const double3 p = positionOf(buffer, n, i);
+    const double coordinates[3] = {p.x, p.y, p.z};
+    for (int k = 0; k < 3; k++) {
+      expected[2 * k] = std::min(expected[2 * k], coordinates[k]);
+      expected[2 * k + 1] = std::max(expected[2 * k + 1], coordinates[k]);
+    }
+  }
+
+  for (int threads : {1, 3}) {
+    setThreads(threads);
+    KernelSystem system(buffer);
+    const std::vector<double> bounds = system.boundingBox();
+    for (int k = 0; k < 6; k++) {
+      EXPECT_EQ(bounds[k], expected[k]) << k;
+    }
+  }
+}
+
+// Every body sits in exactly one leaf inside the bounds of its node, and internal children follow their parent in
+// the pool (computeCentersOfMass relies on it)
+TEST(BarnesHutTest, BuildTreeHoldsEveryBodyOnce) {
+  const int n = 4000;
+  const std::vector<double> buffer = randomBodies(n, 2);
+  for (int threads : {1, 4}) {
+    setThreads(threads);
+    KernelSystem system(buffer);
+    const int used = system.tree();
+    ASSERT_GT(used, n);
+    ASSERT_LE(used, system.maxNodes);
+    const std::vector<TreeNode> nodes = system.downloadNodes(used);
+
+    std::vector<int> seen(n, 0);
+    std::vector<int> stack = {0};
+    while (!stack.empty()) {
+      const int index = stack.back();
+      stack.pop_back();
+      const TreeNode& node = nodes[index];
+      EXPECT_NEAR(node.x_max - node.x_min, node.y_max - node.y_min, 1e-12 * (nodes[0].x_max - nodes[0].x_min));
+      if (node.isLeaf) {
+        ASSERT_GE(node.bodyIndex, 0);
+        ASSERT_LT(node.bodyIndex, n);
+        seen[node.bodyIndex]++;
+        const double3 p = positionOf(buffer, n, node.bodyIndex);
+        EXPECT_TRUE(p.x >= node.x_min && p.x <= node.x_max && p.y >= node.y_min && p.y <= node.y_max &&
+                    p.z >= node.z_min && p.z <= node.z_max)
+            << node.bodyIndex;
+        continue;
+      }
+      for (int c = 0; c < 8; c++) {
+        const int child = system.indexOf(node.children[c]);
+        if (child < 0) {
+          continue;
+        }
+        ASSERT_LT(child, used);
+        if (!nodes[child].isLeaf) {
+          EXPECT_GT(child, index);
+        }
+        stack.push_back(child);
+      }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), n) << threads << " threads";
+  }
+}
+
+// Up to 8 bodies at one position end in one node at the depth limit; more are reported as an overflow
+TEST(BarnesHutTest, BuildTreeHandlesCoincidentBodies) {
+  for (int coincident : {8, 9}) {
+    std::vector<double> buffer = randomBodies(100, 3);
+    for (int i = 0; i < coincident; i++) {
+      buffer[100 + 3 * i] = buffer[100 + 3 * i + 1] = buffer[100 + 3 * i + 2] = 12.5;
+    }
+    KernelSystem system(buffer);
+    if (coincident <= 8) {
+      EXPECT_LE(system.tree(), system.maxNodes);
+    } else {
+      EXPECT_GT(system.tree(), system.maxNodes);
+    }
+  }
+}
+
+TEST(BarnesHutTest, CentersOfMassMatchDirectSums) {
+  const int n = 2000;
+  const std::vector<double> buffer = randomBodies(n, 4);
+  double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+  for (int i = 0; i < n; i++) {
+    const double3 p = positionOf(buffer, n, i);
+    mass += buffer[i];
+    cx += buffer[i] * p.x;
+    cy += buffer[i] * p.y;
+    cz += buffer[i] * p.z;
+  }
+
+  for (int threads : {1, 4}) {
+    setThreads(threads);
+    KernelSystem system(buffer);
+    const int used = system.tree();
+    system.centersOfMass();
+    const std::vector<TreeNode> nodes = system.downloadNodes(used);
+    EXPECT_NEAR(nodes[0].mass / mass, 1.0, 1e-12);
+    EXPECT_NEAR(nodes[0].cx, cx / mass, 1e-9 * 5e3);
+    EXPECT_NEAR(nodes[0].cy, cy / mass, 1e-9 * 5e3);
+    EXPECT_NEAR(nodes[0].cz, cz / mass, 1e-9 * 5e3);
+
+    // every internal node holds the sum of its children
+    for (int index = 0; index < used; index++) {
+      const TreeNode& node = nodes[index];
+      if (node.isLeaf) {
+        continue;
+      }
+      double childMass = 0.0;
+      for (int c = 0; c < 8; c++) {
+        const int child = system.indexOf(node.children[c]);
+        childMass += child < 0 ? 0.0 : nodes[child].mass;
+      }
+      EXPECT_NEAR(node.mass / childMass, 1.0, 1e-12) << index;
+    }
+  }
+}
+
+// theta = 0 opens every node, so the tree walk reduces to the direct sum; theta = 0.5 stays within a percent
+TEST(BarnesHutTest, ForcesMatchDirectSum) {
+  const int n = 1500;
+  const std::vector<double> buffer = randomBodies(n, 5);
+  std::vector<double> direct(3 * n, 0.0);
+  for (int i = 0; i < n; i++) {
+    const double3 p = positionOf(buffer, n, i);
+    for (int j = 0; j < n; j++) {
+      if (j == i) {
+        continue;
+      }
+      const double3 q = positionOf(buffer, n, j);
+      const double dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+      const double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+      const double force = G * buffer[i] * buffer[j] / (distance * distance * distance);
+      direct[3 * i] += dx * force;
+      direct[3 * i + 1] += dy * force;
+      direct[3 * i + 2] += dz * force;
+    }
+  }
+
+  setThreads(4);
+  KernelSystem system(buffer);
+  system.tree();
+  system.centersOfMass();
+  for (double theta : {0.0, 0.5}) {
+    system.forces(theta);
+    const std::vector<double> fx = system.download(system.fx, n);
+    const std::vector<double> fy = system.download(system.fy, n);
+    const std::vector<double> fz = system.download(system.fz, n);
+    double squaredError = 0.0;
+    for (int i = 0; i < n; i++) {
+      const double magnitude = std::sqrt(direct[3 * i] * direct[3 * i] + direct[3 * i + 1] * direct[3 * i + 1] +
+                                         direct[3 * i + 2] * direct[3 * i + 2]);
+      const double error = std::sqrt(std::pow(fx[i] - direct[3 * i], 2) + std::pow(fy[i] - direct[3 * i + 1], 2) +
+                                     std::pow(fz[i] - direct[3 * i + 2], 2));
+      if (theta == 0.0) {
+        EXPECT_LT(error, 1e-10 * magnitude) << i;
+      }
+      squaredError += std::pow(error / magnitude, 2) / n;
+    }
+    EXPECT_LT(std::sqrt(squaredError), 1e-2) << theta;
+  }
+}
+
+TEST(BarnesHutTest, UpdateBodiesIntegratesSemiImplicitEuler) {
+  const int n = 700;
+  const double dt = 0.25;
+  const std::vector<double> buffer = randomBodies(n, 6);
+  std::vector<double> forces(3 * n);
+  for (int i = 0; i < 3 * n; i++) {
+    forces[i] = (i % 7 - 3) * 1e14;
+  }
+
+  setThreads(3);
+  KernelSystem system(buffer);
+  for (int k = 0; k < 3; k++) {
+    double* column = k == 0 ? system.fx : k == 1 ? system.fy : system.fz;
+    std::vector<double> values(n);
+    for (int i = 0; i < n; i++) {
+      values[i] = forces[3 * i + k];
+    }
+    copyToDevice(column, values.data(), n * sizeof(double));
+  }
+  launchKernel(updateBodies, system.blocks(), 256, system.bodies, n, system.fx, system.fy, system.fz, dt);
+  const std::vector<double> result = system.download(system.buffer, 10 * n);
+
+  for (int i = 0; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      const double acceleration = forces[3 * i + k] / buffer[i];
+      const double velocity = buffer[4 * n + 3 * i + k] + acceleration * dt;
+      EXPECT_EQ(result[7 * n + 3 * i + k], acceleration);
+      EXPECT_EQ(result[4 * n + 3 * i + k], velocity);
+      EXPECT_EQ(result[n + 3 * i + k], buffer[n + 3 * i + k] + velocity * dt);
+    }
+    EXPECT_EQ(result[i], buffer[i]);
+  }
+}
@@ -0,0 +1,90 @@
+#include <memory>
+#include <vector>
+#include "Harness.h"
+#include "Body.h"
+#include "BodySystem.h"
+#include "BHTree.h"
+#include "GroupWalk.h"
+#include "Simulation.h"
+
+// Drzewo Barnes-Hut z CPU_BH: te same wywołania co simulate_step() dla BodySystem, rozdzielone na fazy
+// (budowa drzewa Mortona ze spłaszczeniem, siły, całkowanie leapfrog).
+
+struct TreeState {
+    BodySystem bodies;
+    BHTree tree;
+    std::vector<double> fx, fy, fz;
+    double theta = BHTree::DEFAULT_THETA;
+};
+
+static std::shared_ptr<TreeState> make_state(const InitialBodies& initial, double theta) {
+    std::vector<Body> bodies;
+    bodies.reserve(initial.size());
+    for (int i = 0; i < initial.size(); ++i) {
+        bodies.emplace_back(initial.mass[i], initial.x[i], initial.y[i], initial.z[i], initial.vx[i], initial.vy[i],
+                            initial.vz[i]);
+    }
+    auto state = std::make_shared<TreeState>();
+    state->bodies = BodySystem(bodies);
+    state->fx.resize(bodies.size());
+    state->fy.resize(bodies.size());
+    state->fz.resize(bodies.size());
+    state->theta = theta;
+    return state;
+}
+
+// przejście spłaszczonego drzewa dla każdego ciała osobno, w kolejności Mortona (TraversalMode::Stackless)
+static PhaseTimes stackless_step(TreeState& state) {
+    PhaseTimes times;
+    times.emplace_back("build", time_ms([&] {
+        build_bhtree(state.bodies, state.tree);
+        state.tree.flatten();
+    }));
+    times.emplace_back("forces", time_ms([&] {
+        const int n = static_cast<int>(state.bodies.size());
+        #pragma omp parallel for
+        for (int k = 0; k < n; ++k) {
+            const uint32_t i = state.tree.order[k];
+            double fx = 0.0, fy = 0.0, fz = 0.0;
+            state.tree.calculateForceStackless(state.bodies, i, fx, fy, fz, state.theta);
+            state.fx[i] = fx;
+            state.fy[i] = fy;
+            state.fz[i] = fz;
+        }
+    }));
+    times.emplace_back("update", time_ms([&] { update_bodies_leapfrog(state.bodies, state.fx, state.fy, state.fz); }));
+    return times;
+}
+
+// wspólne listy oddziaływań dla grup sąsiednich ciał (TraversalMode::Grouped)
+static PhaseTimes grouped_step(TreeState& state) {
+    PhaseTimes times;
+    times.emplace_back("build", time_ms([&] {
+        build_bhtree(state.bodies, state.tree);
+        state.tree.flatten();
+    }));
+    times.emplace_back("forces", time_ms([&] {
+        compute_forces_grouped(state.tree, state.bodies, state.theta, SimulationOptions().groupSize, state.fx,
+                               state.fy, state.fz);
+    }));
+    times.emplace_back("update", time_ms([&] { update_bodies_leapfrog(state.bodies, state.fx, state.fy, state.fz); }));
+    return times;
+}
+
+int main(int argc, char** argv) {
+    std::vector<BenchSolver> solvers = {
+        {"cpu-bh", true, [](const InitialBodies& bodies, double theta) -> std::function<PhaseTimes()> {
+            auto state = make_state(bodies, theta);
+            return [state] { return stackless_step(*state); };
+        }},
+        {"cpu-bh-grouped", true, [](const InitialBodies& bodies, double theta) -> std::function<PhaseTimes()> {
+            auto state = make_state(bodies, theta);
+            return [state] { return grouped_step(*state); };
+        }},
+    };
+
+    BenchConfig config;
+    config.sizes = {1000, 10000, 100000, 1000000};
+    config.thetas = {BHTree::DEFAULT_THETA};
+    return bench_main(argc, argv, config, solvers);
+}
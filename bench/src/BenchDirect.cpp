@@ -0,0 +1,46 @@
+#include <memory>
+#include <vector>
+#include "Harness.h"
+#include "physics.h"
+
+// Suma bezpośrednia z cpu-proj dla trzech kerneli sił NBodySimulationCPU (symmetric, simd, tiled).
+// Faza "forces" to update_velocities() - przyspieszenia i zmiana prędkości, "update" - update_positions().
+
+static constexpr double TIME_STEP = 0.01;
+
+static std::function<PhaseTimes()> prepare_direct(const InitialBodies& initial, Kernel kernel) {
+    const int n = initial.size();
+    auto bodies = std::make_shared<Body>();
+    bodies->resize(n);
+    for (int i = 0; i < n; i++) {
+        bodies->mass[i] = initial.mass[i];
+        bodies->x[i] = initial.x[i];
+        bodies->y[i] = initial.y[i];
+        bodies->z[i] = initial.z[i];
+        bodies->vx[i] = initial.vx[i];
+        bodies->vy[i] = initial.vy[i];
+        bodies->vz[i] = initial.vz[i];
+    }
+    // zestaw instrukcji wybierany raz, tak jak w main.cpp
+    const SimdIsa isa = detect_simd_isa();
+    return [bodies, n, kernel, isa] {
+        PhaseTimes times;
+        times.emplace_back("forces", time_ms([&] { update_velocities(*bodies, n, TIME_STEP, kernel, isa); }));
+        times.emplace_back("update", time_ms([&] { update_positions(*bodies, n, TIME_STEP); }));
+        return times;
+    };
+}
+
+int main(int argc, char** argv) {
+    std::vector<BenchSolver> solvers = {
+        {"direct", false, [](const InitialBodies& bodies, double) { return prepare_direct(bodies, Kernel::Symmetric); }},
+        {"direct-simd", false, [](const InitialBodies& bodies, double) { return prepare_direct(bodies, Kernel::Simd); }},
+        {"direct-tiled", false,
+         [](const InitialBodies& bodies, double) { return prepare_direct(bodies, Kernel::Tiled); }},
+    };
+
+    // O(N^2) - rozmiary o rząd wielkości mniejsze niż dla drzew
+    BenchConfig config;
+    config.sizes = {1000, 5000, 20000};
+    return bench_main(argc, argv, config, solvers);
+}
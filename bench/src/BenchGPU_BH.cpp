@@ -0,0 +1,115 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Harness.h"
+#include "BarnesHut.cuh"
+
+// Kernele GPU_BH na backendzie hostowym (OpenMP, include/execution.cuh) w kolejności z pętli w main.cu. Liczba
+// bloków i wątków ma znaczenie tylko na urządzeniu - na hoście szerokość uruchomienia to liczba wątków OpenMP.
+
+static constexpr double TIME_STEP = 0.01;
+static constexpr int BLOCK_SIZE = 256;
+
+// bufory jak w main.cu: ciała w jednym bloku 10 liczb na ciało, pula węzłów 8n + 1
+struct KernelState {
+    int n = 0;
+    int maxNodes = 0;
+    double theta = 0.8;
+    double* buffer = nullptr;
+    Bodies bodies{};
+    TreeNode* nodes = nullptr;
+    int* nodeCount = nullptr;
+    double* bounds = nullptr;
+    double* fx = nullptr;
+    double* fy = nullptr;
+    double* fz = nullptr;
+
+    ~KernelState() {
+        for (void* memory : {(void*)buffer, (void*)nodes, (void*)nodeCount, (void*)bounds, (void*)fx, (void*)fy,
+                             (void*)fz}) {
+            deviceFree(memory);
+        }
+    }
+};
+
+static std::shared_ptr<KernelState> make_state(const InitialBodies& initial, double theta) {
+    auto state = std::make_shared<KernelState>();
+    const int n = initial.size();
+    state->n = n;
+    state->maxNodes = 8 * n + 1;
+    state->theta = theta;
+
+    std::vector<double> host(10 * (size_t)n, 0.0);
+    for (int i = 0; i < n; ++i) {
+        host[i] = initial.mass[i];
+        host[n + 3 * i] = initial.x[i];
+        host[n + 3 * i + 1] = initial.y[i];
+        host[n + 3 * i + 2] = initial.z[i];
+        host[4 * n + 3 * i] = initial.vx[i];
+        host[4 * n + 3 * i + 1] = initial.vy[i];
+        host[4 * n + 3 * i + 2] = initial.vz[i];
+    }
+    state->buffer = (double*)deviceAllocate(host.size() * sizeof(double));
+    copyToDevice(state->buffer, host.data(), host.size() * sizeof(double));
+    state->bodies = {state->buffer, (double3*)(state->buffer + n), (double3*)(state->buffer + 4 * n),
+                     (double3*)(state->buffer + 7 * n)};
+
+    state->nodes = (TreeNode*)deviceAllocate(sizeof(TreeNode) * state->maxNodes);
+    state->nodeCount = (int*)deviceAllocate(sizeof(int));
+    state->bounds = (double*)deviceAllocate(6 * sizeof(double));
+    state->fx = (double*)deviceAllocate(sizeof(double) * n);
+    state->fy = (double*)deviceAllocate(sizeof(double) * n);
+    state->fz = (double*)deviceAllocate(sizeof(double) * n);
+    return state;
+}
+
+// każda faza kończy się synchronizacją, żeby czas obejmował wykonanie kerneli, a nie tylko ich uruchomienie
+static PhaseTimes kernel_step(KernelState& state) {
+    const double emptyBounds[6] = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+    const int blocks = (state.n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    PhaseTimes times;
+    times.emplace_back("bbox", time_ms([&] {
+        copyToDevice(state.bounds, emptyBounds, sizeof(emptyBounds));
+        launchKernel(computeBoundingBox, 1, BLOCK_SIZE, state.bodies, state.n, state.bounds);
+        synchronizeDevice();
+    }));
+    int usedNodes = 0;
+    times.emplace_back("build", time_ms([&] {
+        launchKernel(initializeTree, 1, 1, state.nodes, state.nodeCount, state.bounds);
+        launchKernel(buildTree, blocks, BLOCK_SIZE, state.nodes, state.nodeCount, state.maxNodes, state.bodies,
+                     state.n);
+        copyToHost(&usedNodes, state.nodeCount, sizeof(int));
+    }));
+    if (usedNodes > state.maxNodes) {
+        throw std::runtime_error("drzewo potrzebuje wiecej niz " + std::to_string(state.maxNodes) + " wezlow");
+    }
+    times.emplace_back("com", time_ms([&] {
+        launchKernel(computeCentersOfMass, 1, BLOCK_SIZE, state.nodes, state.nodeCount, state.maxNodes);
+        synchronizeDevice();
+    }));
+    times.emplace_back("forces", time_ms([&] {
+        launchKernel(computeForces, blocks, BLOCK_SIZE, state.nodes, state.bodies, state.fx, state.fy, state.fz,
+                     state.n, state.theta);
+        synchronizeDevice();
+    }));
+    times.emplace_back("update", time_ms([&] {
+        launchKernel(updateBodies, blocks, BLOCK_SIZE, state.bodies, state.n, state.fx, state.fy, state.fz,
+                     TIME_STEP);
+        synchronizeDevice();
+    }));
+    return times;
+}
+
+int main(int argc, char** argv) {
+    std::vector<BenchSolver> solvers = {
+        {"gpu-bh-host", true, [](const InitialBodies& bodies, double theta) -> std::function<PhaseTimes()> {
+            auto state = make_state(bodies, theta);
+            return [state] { return kernel_step(*state); };
+        }},
+    };
+
+    BenchConfig config;
+    config.sizes = {1000, 10000, 100000};
+    return bench_main(argc, argv, config, solvers);
+}
@@ -0,0 +1,74 @@
+#include "Distributions.h"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+const std::vector<std::string>& distribution_names() {
+    static const std::vector<std::string> names = {"uniform", "clustered", "plummer"};
+    return names;
+}
+
+bool is_distribution(const std::string& name) {
+    for (const auto& known : distribution_names()) {
+        if (known == name) return true;
+    }
+    return false;
+}
+
+InitialBodies generate_bodies(const std::string& distribution, int n, unsigned seed) {
+    if (!is_distribution(distribution)) {
+        throw std::invalid_argument("nieznany rozklad: " + distribution);
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> cube(-1000.0, 1000.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_real_distribution<double> mass(1.0e20, 1.0e21);
+    std::normal_distribution<double> spread(0.0, 10.0);
+    const double plummerRadius = 100.0;
+
+    InitialBodies bodies;
+    bodies.mass.resize(n);
+    bodies.x.resize(n);
+    bodies.y.resize(n);
+    bodies.z.resize(n);
+    bodies.vx.assign(n, 0.0);
+    bodies.vy.assign(n, 0.0);
+    bodies.vz.assign(n, 0.0);
+
+    double cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int i = 0; i < n; ++i) {
+        bodies.mass[i] = mass(rng);
+        if (distribution == "uniform") {
+            bodies.x[i] = cube(rng);
+            bodies.y[i] = cube(rng);
+            bodies.z[i] = cube(rng);
+        }
+        else if (distribution == "clustered") {
+            if (i % 1000 == 0) {
+                cx = cube(rng);
+                cy = cube(rng);
+                cz = cube(rng);
+            }
+            bodies.x[i] = cx + spread(rng);
+            bodies.y[i] = cy + spread(rng);
+            bodies.z[i] = cz + spread(rng);
+        }
+        else {
+            // odwrócona dystrybuanta masy sfery Plummera; kierunek jednorodny na sferze
+            double r;
+            do {
+                const double u = unit(rng);
+                r = plummerRadius / std::sqrt(std::pow(u, -2.0 / 3.0) - 1.0);
+            } while (!(r < 10.0 * plummerRadius));
+            const double cosTheta = 2.0 * unit(rng) - 1.0;
+            const double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            const double phi = 2.0 * M_PI * unit(rng);
+            bodies.x[i] = r * sinTheta * std::cos(phi);
+            bodies.y[i] = r * sinTheta * std::sin(phi);
+            bodies.z[i] = r * cosTheta;
+        }
+    }
+    return bodies;
+}
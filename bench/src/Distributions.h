@@ -0,0 +1,27 @@
+#ifndef DISTRIBUTIONS_H
+#define DISTRIBUTIONS_H
+
+#include <string>
+#include <vector>
+
+// ciała początkowe wspólne dla wszystkich solverów (SoA w double); każdy program przepisuje je do własnego
+// układu danych poza pomiarem
+struct InitialBodies {
+    std::vector<double> mass;
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+
+    int size() const { return static_cast<int>(mass.size()); }
+};
+
+// nazwy rozkładów przyjmowanych przez --distribution
+const std::vector<std::string>& distribution_names();
+bool is_distribution(const std::string& name);
+
+// uniform   - sześcian o boku 2000 m (jak random_bodies w CPU_BH/bench/Benchmark.cpp)
+// clustered - skupiska po 1000 ciał o rozkładzie normalnym (sigma 10 m) w takim samym sześcianie
+// plummer   - sfera Plummera o promieniu skali 100 m, obcięta na 10 promieniach
+// Masy z przedziału [1e20, 1e21] kg, prędkości zerowe; ten sam seed daje te same ciała.
+InitialBodies generate_bodies(const std::string& distribution, int n, unsigned seed);
+
+#endif // DISTRIBUTIONS_H
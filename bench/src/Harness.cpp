@@ -0,0 +1,421 @@
+#include "Harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <omp.h>
+#include <sstream>
+
+using json = nlohmann::json;
+
+// lista wartości rozdzielonych przecinkami; false dla pustej listy lub elementu, którego nie da się odczytać
+template <typename T, typename Parse>
+static bool parse_list(const std::string& value, std::vector<T>& list, Parse parse) {
+    std::vector<T> parsed;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        T element;
+        if (item.empty() || !parse(item, element)) return false;
+        parsed.push_back(element);
+    }
+    if (parsed.empty()) return false;
+    list = parsed;
+    return true;
+}
+
+static bool parse_int(const std::string& text, int& value) {
+    size_t used = 0;
+    try {
+        value = std::stoi(text, &used);
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    return used == text.size();
+}
+
+static bool parse_double(const std::string& text, double& value) {
+    size_t used = 0;
+    try {
+        value = std::stod(text, &used);
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    return used == text.size();
+}
+
+static bool parse_positive(const std::string& text, int& value) { return parse_int(text, value) && value > 0; }
+
+bool parse_bench_options(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+
+        if (arg == "--solver") {
+            if (!parse_list(value, config.solvers, [](const std::string& item, std::string& name) {
+                name = item;
+                return true;
+            })) return false;
+        }
+        else if (arg == "--distribution") {
+            if (!parse_list(value, config.distributions, [](const std::string& item, std::string& name) {
+                name = item;
+                return is_distribution(item);
+            })) return false;
+        }
+        else if (arg == "--sizes") {
+            if (!parse_list(value, config.sizes, parse_positive)) return false;
+        }
+        else if (arg == "--threads") {
+            if (!parse_list(value, config.threads, parse_positive)) return false;
+        }
+        else if (arg == "--theta") {
+            if (!parse_list(value, config.thetas, [](const std::string& item, double& theta) {
+                return parse_double(item, theta) && theta >= 0.0;
+            })) return false;
+        }
+        else if (arg == "--warmup") {
+            if (!parse_int(value, config.warmup) || config.warmup < 0) return false;
+        }
+        else if (arg == "--repeats") {
+            if (!parse_positive(value, config.repeats)) return false;
+        }
+        else if (arg == "--seed") {
+            int seed;
+            if (!parse_int(value, seed)) return false;
+            config.seed = static_cast<unsigned>(seed);
+        }
+        else if (arg == "--csv") {
+            config.csvFile = value;
+        }
+        else if (arg == "--json") {
+            config.jsonFile = value;
+        }
+        else if (arg == "--baseline") {
+            config.baselineFile = value;
+        }
+        else if (arg == "--tolerance") {
+            if (!parse_double(value, config.tolerance) || config.tolerance < 0.0) return false;
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_bench_usage(const char* program, const std::vector<BenchSolver>& solvers) {
+    std::string names, distributions;
+    for (const auto& solver : solvers) names += (names.empty() ? "" : ",") + solver.name;
+    for (const auto& name : distribution_names()) distributions += (distributions.empty() ? "" : ",") + name;
+    std::cerr << "Uzycie: " << program << " [--solver " << names << "] [--distribution " << distributions << "]\n"
+              << "    [--sizes N1,N2,...] [--threads T1,T2,...] [--theta t1,t2,...] [--warmup kroki]"
+              << " [--repeats kroki] [--seed s]\n"
+              << "    [--csv plik] [--json plik] [--baseline plik.csv|plik.json] [--tolerance 0.1]\n";
+}
+
+static double median_of(std::vector<double>& values) {
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double median = values[middle];
+    if (values.size() % 2 == 0) {
+        median = (median + *std::max_element(values.begin(), values.begin() + middle)) / 2.0;
+    }
+    return median;
+}
+
+void summarize_samples(std::vector<double> samples, BenchResult& result) {
+    result.repeats = static_cast<int>(samples.size());
+    if (samples.empty()) return;
+    result.min = *std::min_element(samples.begin(), samples.end());
+    result.max = *std::max_element(samples.begin(), samples.end());
+    result.median = median_of(samples);
+    for (double& sample : samples) sample = std::abs(sample - result.median);
+    result.mad = median_of(samples);
+}
+
+std::vector<BenchResult> run_benchmarks(const BenchConfig& config, const std::vector<BenchSolver>& solvers,
+                                        std::ostream& csv) {
+    const std::vector<int> threadCounts = config.threads.empty() ? std::vector<int>{omp_get_max_threads()}
+                                                                 : config.threads;
+    std::vector<BenchResult> results;
+    write_csv_header(csv);
+    for (const auto& distribution : config.distributions) {
+        for (int n : config.sizes) {
+            const InitialBodies bodies = generate_bodies(distribution, n, config.seed);
+            for (const auto& solver : solvers) {
+                if (!config.solvers.empty()
+                    && std::find(config.solvers.begin(), config.solvers.end(), solver.name) == config.solvers.end()) {
+                    continue;
+                }
+                const std::vector<double> thetas = solver.usesTheta ? config.thetas : std::vector<double>{-1.0};
+                for (int threads : threadCounts) {
+                    omp_set_num_threads(threads);
+                    for (double theta : thetas) {
+                        // każdy punkt zaczyna od tych samych ciał; stan solvera (pule, bufory) przechodzi
+                        // między krokami jak w symulacji
+                        std::function<PhaseTimes()> step = solver.prepare(bodies, theta);
+                        for (int r = 0; r < config.warmup; ++r) step();
+
+                        std::vector<std::string> phases;
+                        std::map<std::string, std::vector<double>> samples;
+                        for (int r = 0; r < config.repeats; ++r) {
+                            double total = 0.0;
+                            for (const auto& [phase, ms] : step()) {
+                                if (samples.find(phase) == samples.end()) phases.push_back(phase);
+                                samples[phase].push_back(ms);
+                                total += ms;
+                            }
+                            samples["step"].push_back(total);
+                        }
+                        phases.push_back("step");
+
+                        for (const auto& phase : phases) {
+                            BenchResult result;
+                            result.solver = solver.name;
+                            result.distribution = distribution;
+                            result.n = n;
+                            result.threads = threads;
+                            result.theta = theta;
+                            result.phase = phase;
+                            summarize_samples(samples[phase], result);
+                            write_csv_row(csv, result);
+                            results.push_back(result);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return results;
+}
+
+static std::string format_theta(double theta) {
+    if (theta < 0.0) return "-";
+    std::ostringstream text;
+    text << theta;
+    return text.str();
+}
+
+void write_csv_header(std::ostream& out) {
+    out << "Solver;Distribution;N;Threads;Theta;Phase;ExecutionTime(ms);Min(ms);Max(ms);MAD(ms);Repeats\n";
+}
+
+void write_csv_row(std::ostream& out, const BenchResult& result) {
+    std::ostringstream row;
+    row << std::fixed << std::setprecision(4) << result.solver << ";" << result.distribution << ";" << result.n
+        << ";" << result.threads << ";" << format_theta(result.theta) << ";" << result.phase << ";" << result.median
+        << ";" << result.min << ";" << result.max << ";" << result.mad << ";" << result.repeats << "\n";
+    out << row.str() << std::flush;
+}
+
+bool write_csv(const std::string& filename, const std::vector<BenchResult>& results) {
+    std::ofstream file(filename);
+    if (!file) return false;
+    write_csv_header(file);
+    for (const auto& result : results) write_csv_row(file, result);
+    return static_cast<bool>(file);
+}
+
+bool write_json(const std::string& filename, const std::vector<BenchResult>& results, const BenchConfig& config) {
+    std::ofstream file(filename);
+    if (!file) return false;
+    json rows = json::array();
+    for (const auto& result : results) {
+        rows.push_back({{"Solver", result.solver},
+                        {"Distribution", result.distribution},
+                        {"N", result.n},
+                        {"Threads", result.threads},
+                        {"Theta", result.theta < 0.0 ? json(nullptr) : json(result.theta)},
+                        {"Phase", result.phase},
+                        {"ExecutionTime(ms)", result.median},
+                        {"Min(ms)", result.min},
+                        {"Max(ms)", result.max},
+                        {"MAD(ms)", result.mad},
+                        {"Repeats", result.repeats}});
+    }
+    json document = {{"warmup", config.warmup}, {"repeats", config.repeats}, {"seed", config.seed},
+                     {"results", rows}};
+    file << document.dump(2) << "\n";
+    return static_cast<bool>(file);
+}
+
+static bool read_baseline_json(std::ifstream& file, std::vector<BenchResult>& baseline) {
+    json document = json::parse(file, nullptr, false);
+    if (document.is_discarded() || !document.contains("results") || !document["results"].is_array()) return false;
+    for (const auto& row : document["results"]) {
+        BenchResult result;
+        result.solver = row.value("Solver", "");
+        result.distribution = row.value("Distribution", "");
+        result.n = row.value("N", 0);
+        result.threads = row.value("Threads", 0);
+        result.theta = row.contains("Theta") && row["Theta"].is_number() ? row["Theta"].get<double>() : -1.0;
+        result.phase = row.value("Phase", "");
+        result.median = row.value("ExecutionTime(ms)", 0.0);
+        result.min = row.value("Min(ms)", result.median);
+        result.max = row.value("Max(ms)", result.median);
+        result.mad = row.value("MAD(ms)", 0.0);
+        result.repeats = row.value("Repeats", 0);
+        baseline.push_back(result);
+    }
+    return true;
+}
+
+static bool read_baseline_csv(std::ifstream& file, std::vector<BenchResult>& baseline) {
+    std::string line;
+    if (!std::getline(file, line)) return false;
+    // kolumny według nagłówka, więc plik może pochodzić ze starszej wersji z innym zestawem kolumn
+    std::map<std::string, size_t> columns;
+    std::stringstream header(line);
+    std::string name;
+    while (std::getline(header, name, ';')) {
+        if (!name.empty() && name.back() == '\r') name.pop_back();
+        const size_t index = columns.size();
+        columns[name] = index;
+    }
+    for (const char* required : {"Solver", "Distribution", "N", "Threads", "Theta", "Phase", "ExecutionTime(ms)"}) {
+        if (columns.find(required) == columns.end()) return false;
+    }
+
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        std::string field;
+        while (std::getline(row, field, ';')) fields.push_back(field);
+        auto column = [&](const char* key) -> std::string {
+            auto it = columns.find(key);
+            return it != columns.end() && it->second < fields.size() ? fields[it->second] : "";
+        };
+
+        BenchResult result;
+        result.solver = column("Solver");
+        result.distribution = column("Distribution");
+        result.phase = column("Phase");
+        const std::string theta = column("Theta");
+        if (!parse_int(column("N"), result.n) || !parse_int(column("Threads"), result.threads)
+            || !parse_double(column("ExecutionTime(ms)"), result.median)) {
+            return false;
+        }
+        if (theta != "-" && !parse_double(theta, result.theta)) return false;
+        if (!parse_double(column("MAD(ms)"), result.mad)) result.mad = 0.0;
+        if (!parse_double(column("Min(ms)"), result.min)) result.min = result.median;
+        if (!parse_double(column("Max(ms)"), result.max)) result.max = result.median;
+        if (!parse_int(column("Repeats"), result.repeats)) result.repeats = 0;
+        baseline.push_back(result);
+    }
+    return true;
+}
+
+bool read_baseline(const std::string& filename, std::vector<BenchResult>& baseline) {
+    std::ifstream file(filename);
+    if (!file) return false;
+    const bool isJson = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+    return isJson ? read_baseline_json(file, baseline) : read_baseline_csv(file, baseline);
+}
+
+static bool same_point(const BenchResult& a, const BenchResult& b) {
+    return a.solver == b.solver && a.distribution == b.distribution && a.n == b.n && a.threads == b.threads
+        && std::abs(a.theta - b.theta) < 1e-9 && a.phase == b.phase;
+}
+
+std::vector<BaselineComparison> compare_with_baseline(const std::vector<BenchResult>& results,
+                                                      const std::vector<BenchResult>& baseline, double tolerance) {
+    std::vector<BaselineComparison> comparisons;
+    for (const auto& result : results) {
+        BaselineComparison comparison;
+        comparison.result = result;
+        auto it = std::find_if(baseline.begin(), baseline.end(),
+                               [&](const BenchResult& stored) { return same_point(stored, result); });
+        if (it != baseline.end()) {
+            comparison.found = true;
+            comparison.baseline = it->median;
+            const double difference = result.median - it->median;
+            const double threshold = std::max(tolerance * it->median, 3.0 * std::max(result.mad, it->mad));
+            comparison.change = it->median > 0.0 ? difference / it->median : 0.0;
+            comparison.regression = difference > threshold;
+            comparison.improvement = -difference > threshold;
+        }
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+void print_comparison(std::ostream& out, const std::vector<BaselineComparison>& comparisons) {
+    out << "Solver;Distribution;N;Threads;Theta;Phase;Baseline(ms);ExecutionTime(ms);Change(%);Status\n";
+    for (const auto& comparison : comparisons) {
+        const BenchResult& result = comparison.result;
+        const char* status = !comparison.found ? "BRAK"
+                           : comparison.regression ? "REGRESJA"
+                           : comparison.improvement ? "POPRAWA" : "OK";
+        out << std::fixed << std::setprecision(4) << result.solver << ";" << result.distribution << ";" << result.n
+            << ";" << result.threads << ";" << format_theta(result.theta) << ";" << result.phase << ";";
+        if (comparison.found) {
+            out << comparison.baseline << ";" << result.median << ";" << std::setprecision(1)
+                << comparison.change * 100.0 << ";" << status << "\n";
+        }
+        else {
+            out << "-;" << result.median << ";-;" << status << "\n";
+        }
+    }
+}
+
+int bench_main(int argc, char** argv, BenchConfig config, const std::vector<BenchSolver>& solvers) {
+    if (!parse_bench_options(argc, argv, config)) {
+        print_bench_usage(argv[0], solvers);
+        return 1;
+    }
+    for (const auto& name : config.solvers) {
+        if (std::none_of(solvers.begin(), solvers.end(), [&](const BenchSolver& s) { return s.name == name; })) {
+            std::cerr << "Blad: nieznany solver " << name << "\n";
+            print_bench_usage(argv[0], solvers);
+            return 1;
+        }
+    }
+    // plik bazowy czytany przed pomiarem - błąd w nazwie nie marnuje całego przeglądu
+    std::vector<BenchResult> baseline;
+    if (!config.baselineFile.empty() && !read_baseline(config.baselineFile, baseline)) {
+        std::cerr << "Blad: nie mozna wczytac pliku bazowego " << config.baselineFile << "\n";
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    try {
+        results = run_benchmarks(config, solvers, std::cout);
+    }
+    catch (const std::exception& error) {
+        std::cerr << "Blad: " << error.what() << "\n";
+        return 1;
+    }
+
+    if (!config.csvFile.empty() && !write_csv(config.csvFile, results)) {
+        std::cerr << "Blad: nie mozna zapisac " << config.csvFile << "\n";
+        return 1;
+    }
+    if (!config.jsonFile.empty() && !write_json(config.jsonFile, results, config)) {
+        std::cerr << "Blad: nie mozna zapisac " << config.jsonFile << "\n";
+        return 1;
+    }
+
+    if (!config.baselineFile.empty()) {
+        const auto comparisons = compare_with_baseline(results, baseline, config.tolerance);
+        std::cout << "\n";
+        print_comparison(std::cout, comparisons);
+        const auto regressions = std::count_if(comparisons.begin(), comparisons.end(),
+                                               [](const BaselineComparison& c) { return c.regression; });
+        if (regressions > 0) {
+            std::cerr << "Regresje wzgledem " << config.baselineFile << ": " << regressions << "\n";
+            return 2;
+        }
+    }
+    return 0;
+}
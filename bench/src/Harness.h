@@ -0,0 +1,104 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <chrono>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Distributions.h"
+
+// Wspólna część programów pomiarowych: przegląd parametrów, rozgrzewka i powtórzenia kroków, statystyki faz,
+// zapis CSV/JSON oraz porównanie z plikiem bazowym. Solvery liczone są w tym samym procesie, więc pomiar nie
+// obejmuje startu programu, inicjalizacji ciał ani zapisu wyników (jak test_script.py mierzący cały proces).
+
+// czasy faz jednego kroku symulacji w ms, w kolejności wykonania
+using PhaseTimes = std::vector<std::pair<std::string, double>>;
+
+// wariant solvera: prepare() tworzy jego stan dla ciał początkowych i theta (poza pomiarem) i zwraca funkcję
+// wykonującą jeden krok symulacji; kolejne wywołania kontynuują symulację
+struct BenchSolver {
+    std::string name;
+    bool usesTheta = false;
+    std::function<std::function<PhaseTimes()>(const InitialBodies&, double)> prepare;
+};
+
+struct BenchConfig {
+    std::vector<std::string> solvers;       // puste - wszystkie warianty programu
+    std::vector<std::string> distributions = {"uniform"};
+    std::vector<int> sizes = {1000, 10000, 100000};
+    std::vector<int> threads;               // puste - omp_get_max_threads()
+    std::vector<double> thetas = {0.8};
+    int warmup = 1;                         // kroki przed pomiarem (pule pamięci, pamięć podręczna)
+    int repeats = 5;                        // mierzone kroki
+    unsigned seed = 42;
+    std::string csvFile;
+    std::string jsonFile;
+    std::string baselineFile;
+    double tolerance = 0.10;                // dopuszczalny względny wzrost mediany względem bazy
+};
+
+// statystyki jednej fazy w jednym punkcie przeglądu; faza "step" to suma faz kroku
+struct BenchResult {
+    std::string solver;
+    std::string distribution;
+    int n = 0;
+    int threads = 0;
+    double theta = -1.0;                    // < 0 - solver bez parametru theta
+    std::string phase;
+    int repeats = 0;
+    double median = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double mad = 0.0;                       // mediana odchyleń bezwzględnych od mediany
+};
+
+struct BaselineComparison {
+    BenchResult result;
+    bool found = false;                     // punkt jest w pliku bazowym
+    double baseline = 0.0;                  // mediana z pliku bazowego
+    double change = 0.0;                    // względna zmiana mediany
+    bool regression = false;
+    bool improvement = false;
+};
+
+// wczytuje opcje (np. --sizes 1000,10000 --threads 1,2); zwraca false przy błędzie
+bool parse_bench_options(int argc, char** argv, BenchConfig& config);
+void print_bench_usage(const char* program, const std::vector<BenchSolver>& solvers);
+
+// czas wykonania f w ms
+template <typename F>
+double time_ms(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// mediana, minimum, maksimum i MAD pomiarów do `result`
+void summarize_samples(std::vector<double> samples, BenchResult& result);
+
+// przegląd wszystkich kombinacji; każdy wynik trafia od razu do `csv` (z nagłówkiem na początku)
+std::vector<BenchResult> run_benchmarks(const BenchConfig& config, const std::vector<BenchSolver>& solvers,
+                                        std::ostream& csv);
+
+// format N;ExecutionTime(ms) z barnes_hut_results.csv rozszerzony o parametry punktu; ExecutionTime to mediana
+void write_csv_header(std::ostream& out);
+void write_csv_row(std::ostream& out, const BenchResult& result);
+bool write_csv(const std::string& filename, const std::vector<BenchResult>& results);
+bool write_json(const std::string& filename, const std::vector<BenchResult>& results, const BenchConfig& config);
+// plik bazowy zapisany wcześniej przez --csv albo --json (rozpoznawany po rozszerzeniu .json)
+bool read_baseline(const std::string& filename, std::vector<BenchResult>& baseline);
+
+// Regresja: mediana wzrosła o więcej niż tolerance * baza i więcej niż 3 MAD (większy z obu pomiarów), więc
+// pojedyncze zakłócenia nie są zgłaszane; poprawa - symetrycznie
+std::vector<BaselineComparison> compare_with_baseline(const std::vector<BenchResult>& results,
+                                                      const std::vector<BenchResult>& baseline, double tolerance);
+void print_comparison(std::ostream& out, const std::vector<BaselineComparison>& comparisons);
+
+// Cały program pomiarowy: opcje, przegląd, pliki wynikowe i porównanie. Kod wyjścia: 0 - bez regresji,
+// 1 - błąd opcji lub plików, 2 - wykryto regresję.
+int bench_main(int argc, char** argv, BenchConfig config, const std::vector<BenchSolver>& solvers);
+
+#endif // HARNESS_H
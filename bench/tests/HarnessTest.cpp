@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <sstream>
+#include "Harness.h"
+
+TEST(HarnessTest, SummarizeReportsMedianAndSpread) {
+    BenchResult result;
+    summarize_samples({5.0, 1.0, 4.0, 2.0, 100.0}, result);
+    EXPECT_EQ(result.repeats, 5);
+    EXPECT_DOUBLE_EQ(result.median, 4.0);
+    EXPECT_DOUBLE_EQ(result.min, 1.0);
+    EXPECT_DOUBLE_EQ(result.max, 100.0);
+    // odchylenia {1, 3, 0, 2, 96} - jedna odstająca wartość nie zmienia MAD
+    EXPECT_DOUBLE_EQ(result.mad, 2.0);
+
+    summarize_samples({4.0, 1.0, 3.0, 2.0}, result);
+    EXPECT_DOUBLE_EQ(result.median, 2.5);
+    EXPECT_DOUBLE_EQ(result.mad, 1.0);
+}
+
+TEST(HarnessTest, ParsesSweepOptions) {
+    const char* argv[] = {"bench", "--sizes", "10,200", "--threads", "1,2", "--theta", "0.5,1",
+                          "--distribution", "plummer", "--repeats", "3", "--warmup", "0"};
+    BenchConfig config;
+    ASSERT_TRUE(parse_bench_options(13, const_cast<char**>(argv), config));
+    EXPECT_EQ(config.sizes, (std::vector<int>{10, 200}));
+    EXPECT_EQ(config.threads, (std::vector<int>{1, 2}));
+    EXPECT_EQ(config.thetas, (std::vector<double>{0.5, 1.0}));
+    EXPECT_EQ(config.distributions, (std::vector<std::string>{"plummer"}));
+    EXPECT_EQ(config.repeats, 3);
+    EXPECT_EQ(config.warmup, 0);
+
+    const char* badSize[] = {"bench", "--sizes", "10,x"};
+    EXPECT_FALSE(parse_bench_options(3, const_cast<char**>(badSize), config));
+    const char* badDistribution[] = {"bench", "--distribution", "ring"};
+    EXPECT_FALSE(parse_bench_options(3, const_cast<char**>(badDistribution), config));
+}
+
+TEST(HarnessTest, DistributionsAreSeeded) {
+    for (const auto& name : distribution_names()) {
+        InitialBodies a = generate_bodies(name, 2000, 7);
+        InitialBodies b = generate_bodies(name, 2000, 7);
+        ASSERT_EQ(a.size(), 2000);
+        EXPECT_EQ(a.x, b.x);
+        EXPECT_EQ(a.mass, b.mass);
+        EXPECT_NE(a.x, generate_bodies(name, 2000, 8).x);
+    }
+}
+
+TEST(HarnessTest, RunsEveryPointWithWarmupAndStepTotal) {
+    int calls = 0;
+    std::vector<BenchSolver> solvers = {
+        {"fake", true, [&](const InitialBodies& bodies, double theta) -> std::function<PhaseTimes()> {
+            EXPECT_EQ(bodies.size(), 16);
+            return [&calls, theta] {
+                ++calls;
+                return PhaseTimes{{"build", 1.0}, {"forces", 2.0 + theta}};
+            };
+        }},
+        {"plain", false, [](const InitialBodies&, double theta) -> std::function<PhaseTimes()> {
+            EXPECT_LT(theta, 0.0);
+            return [] { return PhaseTimes{{"forces", 1.0}}; };
+        }},
+    };
+    BenchConfig config;
+    config.sizes = {16};
+    config.threads = {1};
+    config.thetas = {0.5, 1.0};
+    config.warmup = 2;
+    config.repeats = 3;
+
+    std::ostringstream csv;
+    std::vector<BenchResult> results = run_benchmarks(config, solvers, csv);
+    EXPECT_EQ(calls, 2 * (2 + 3));
+    // fake: 2 theta x {build, forces, step}, plain: {forces, step}
+    ASSERT_EQ(results.size(), 8u);
+    EXPECT_EQ(results[2].phase, "step");
+    EXPECT_DOUBLE_EQ(results[2].median, 3.5);
+    EXPECT_EQ(results[2].repeats, 3);
+    EXPECT_DOUBLE_EQ(results[5].theta, 1.0);
+    EXPECT_EQ(results[6].solver, "plain");
+    EXPECT_EQ(csv.str().rfind("Solver;Distribution;N;Threads;Theta;Phase;ExecutionTime(ms)", 0), 0u);
+}
+
+TEST(HarnessTest, BaselineRoundTripFlagsRegressions) {
+    BenchResult build;
+    build.solver = "cpu-bh";
+    build.distribution = "uniform";
+    build.n = 1000;
+    build.threads = 1;
+    build.theta = 0.8;
+    build.phase = "build";
+    build.repeats = 5;
+    build.median = 10.0;
+    build.mad = 0.1;
+    BenchResult update = build;
+    update.theta = -1.0;
+    update.phase = "update";
+    update.median = 1.0;
+
+    for (const char* filename : {"baseline_test.csv", "baseline_test.json"}) {
+        const bool isJson = std::string(filename).find(".json") != std::string::npos;
+        ASSERT_TRUE(isJson ? write_json(filename, {build, update}, BenchConfig())
+                           : write_csv(filename, {build, update}));
+        std::vector<BenchResult> baseline;
+        ASSERT_TRUE(read_baseline(filename, baseline));
+        std::remove(filename);
+        ASSERT_EQ(baseline.size(), 2u);
+        EXPECT_DOUBLE_EQ(baseline[0].theta, 0.8);
+        EXPECT_LT(baseline[1].theta, 0.0);
+        EXPECT_DOUBLE_EQ(baseline[0].median, 10.0);
+
+        BenchResult slower = build;
+        slower.median = 12.0;
+        BenchResult noisy = update;     // +20%, ale w granicach 3 MAD
+        noisy.median = 1.2;
+        noisy.mad = 0.1;
+        BenchResult unknown = build;
+        unknown.n = 2000;
+        auto comparisons = compare_with_baseline({slower, noisy, unknown}, baseline, 0.1);
+        ASSERT_EQ(comparisons.size(), 3u);
+        EXPECT_TRUE(comparisons[0].regression);
+        EXPECT_NEAR(comparisons[0].change, 0.2, 1e-9);
+        EXPECT_FALSE(comparisons[1].regression);
+        EXPECT_TRUE(comparisons[1].found);
+        EXPECT_FALSE(comparisons[2].found);
+
+        slower.median = 8.0;
+        EXPECT_TRUE(compare_with_baseline({slower}, baseline, 0.1)[0].improvement);
+    }
+}
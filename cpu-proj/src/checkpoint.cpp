@@ -0,0 +1,148 @@
+#include "checkpoint.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHECKPOINT_FSYNC 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const int CHECKPOINT_COLUMNS = 7;
+
+// Tablica Body (także const) odpowiadająca kolumnie pliku
+template <typename Bodies>
+static auto* checkpoint_column(Bodies& bodies, int column) {
+  decltype(&bodies.x) columns[CHECKPOINT_COLUMNS] = {&bodies.x,  &bodies.y,  &bodies.z,   &bodies.vx,
+                                                     &bodies.vy, &bodies.vz, &bodies.mass};
+  return columns[column];
+}
+
+bool write_checkpoint(const std::string& filename, const Body& bodies, int n, const CheckpointState& state) {
+  CheckpointHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.headerBytes = sizeof(CheckpointHeader);
+  header.bodyCount = n;
+  header.step = state.step;
+  header.time = state.time;
+  header.dt = state.dt;
+  header.kernel = (uint32_t)state.kernel;
+  header.isa = (uint32_t)state.isa;
+  header.tileSize = state.tileSize;
+  header.threads = state.threads;
+  header.rngBytes = state.rng.size();
+  header.codec = state.compression.codec;
+  header.keyframeInterval = state.compression.keyframeInterval;
+  header.tolerance = state.compression.tolerance;
+
+  std::string temporary = filename + ".tmp";
+  std::FILE* file = std::fopen(temporary.c_str(), "wb");
+  if (!file) {
+    std::cerr << "Błąd: nie można zapisać punktu kontrolnego " << temporary << std::endl;
+    return false;
+  }
+
+  // Kolumny o rozmiarze megabajtów i większym fwrite przekazuje wprost do write(), z pominięciem bufora FILE
+  static const char padding[8] = {};
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(state.rng.data(), 1, state.rng.size(), file) == state.rng.size() &&
+            std::fwrite(padding, 1, (8 - state.rng.size() % 8) % 8, file) == (8 - state.rng.size() % 8) % 8;
+  for (int c = 0; c < CHECKPOINT_COLUMNS && ok; c++) {
+    ok = std::fwrite(checkpoint_column(bodies, c)->data(), sizeof(double), n, file) == (size_t)n;
+  }
+  ok = ok && std::fwrite(CHECKPOINT_END_MAGIC, 8, 1, file) == 1 && std::fflush(file) == 0;
+#ifdef CHECKPOINT_FSYNC
+  // Dane muszą być na dysku przed rename - inaczej po awarii systemu nowa nazwa mogłaby wskazywać pusty plik
+  ok = ok && fsync(fileno(file)) == 0;
+#endif
+  ok = std::fclose(file) == 0 && ok;
+
+  std::error_code error;
+  if (ok) {
+    std::filesystem::rename(temporary, filename, error);
+  }
+  if (!ok || error) {
+    std::cerr << "Błąd: nie można zapisać punktu kontrolnego " << filename << std::endl;
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+#ifdef CHECKPOINT_FSYNC
+  // Utrwalenie samej zmiany nazwy w katalogu
+  std::string directory = std::filesystem::absolute(filename).parent_path().string();
+  int fd = ::open(directory.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    ::close(fd);
+  }
+#endif
+  return true;
+}
+
+bool read_checkpoint(const std::string& filename, Body& bodies, int& n, CheckpointState& state) {
+  std::FILE* file = std::fopen(filename.c_str(), "rb");
+  if (!file) {
+    std::cerr << "Błąd: nie można otworzyć punktu kontrolnego " << filename << std::endl;
+    return false;
+  }
+
+  CheckpointHeader header;
+  bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+            std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 &&
+            (header.version == 1 || header.version == CHECKPOINT_VERSION) &&
+            header.headerBytes == sizeof(CheckpointHeader) &&
+            header.bodyCount <= (uint64_t)std::numeric_limits<int>::max() && header.rngBytes < (1u << 20);
+  // Rozmiar pliku musi dokładnie odpowiadać nagłówkowi - plik ucięty albo dłuższy jest odrzucany
+  const uint64_t rngPadded = ok ? (header.rngBytes + 7) / 8 * 8 : 0;
+  const uint64_t expectedBytes = sizeof(header) + rngPadded + CHECKPOINT_COLUMNS * header.bodyCount * sizeof(double) + 8;
+  std::error_code error;
+  ok = ok && std::filesystem::file_size(filename, error) == expectedBytes && !error;
+
+  if (ok) {
+    n = (int)header.bodyCount;
+    state.rng.assign(header.rngBytes, '\0');
+    ok = std::fread(&state.rng[0], 1, header.rngBytes, file) == header.rngBytes &&
+         std::fseek(file, (long)(sizeof(header) + rngPadded), SEEK_SET) == 0;
+    bodies.resize(n);
+    for (int c = 0; c < CHECKPOINT_COLUMNS && ok; c++) {
+      ok = std::fread(checkpoint_column(bodies, c)->data(), sizeof(double), n, file) == (size_t)n;
+    }
+    char end[8];
+    ok = ok && std::fread(end, 8, 1, file) == 1 && std::memcmp(end, CHECKPOINT_END_MAGIC, 8) == 0;
+  }
+  std::fclose(file);
+  if (!ok) {
+    std::cerr << "Błąd: " << filename << " nie jest pełnym punktem kontrolnym" << std::endl;
+    return false;
+  }
+  if (header.version == 1) {
+    header.codec = TRAJ_CODEC_NONE;
+    header.keyframeInterval = TrajectoryCompression().keyframeInterval;
+    header.tolerance = TrajectoryCompression().tolerance;
+  }
+  // Rozmiar się zgadza, ale pola muszą mieścić się w zakresach typów - inaczej przebieg ruszyłby z nieistniejącym
+  // kernelem albo kodekiem
+  if (header.kernel > (uint32_t)Kernel::Tiled || header.isa > (uint32_t)SimdIsa::Avx512 ||
+      header.codec > TRAJ_CODEC_QUANTIZE || header.keyframeInterval == 0 || !std::isfinite(header.tolerance) ||
+      header.threads < 1) {
+    std::cerr << "Błąd: " << filename << " zawiera niepoprawne parametry przebiegu" << std::endl;
+    return false;
+  }
+
+  state.step = header.step;
+  state.time = header.time;
+  state.dt = header.dt;
+  state.kernel = (Kernel)header.kernel;
+  state.isa = (SimdIsa)header.isa;
+  state.tileSize = header.tileSize;
+  state.threads = header.threads;
+  state.compression.codec = (TrajectoryCodec)header.codec;
+  state.compression.keyframeInterval = header.keyframeInterval;
+  state.compression.tolerance = header.tolerance;
+  return true;
+}
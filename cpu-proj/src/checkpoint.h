@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "physics.h"
+#include "trajectory.h"
+
+// Punkt kontrolny - pełny stan przebiegu potrzebny do wznowienia bit w bit, little-endian:
+//   nagłówek (128 B) | stan generatora liczb losowych (rngBytes, dopełniony do 8 B) |
+//   kolumny x, y, z, vx, vy, vz, mass po N liczb float64 | stopka (8 B, "NBCKEND")
+// Kolumny zapisywane są prosto z tablic Body, bez serializacji. Przyspieszeń nie ma - każdy krok liczy je
+// od nowa przed użyciem, więc plik jest o 30% mniejszy. Plik powstaje pod nazwą tymczasową
+// i po fsync zastępuje poprzedni punkt kontrolny przez rename, więc na dysku zawsze jest pełny punkt kontrolny.
+// Razem ze stanem zapisywane są parametry, od których zależą zaokrąglenia sił (kernel, zestaw instrukcji,
+// rozmiar kafla, liczba wątków) - po wznowieniu liczby zmiennoprzecinkowe sumowane są w tej samej kolejności.
+// Zapisywana jest też kompresja pliku wynikowego - wznowiony przebieg dopisuje klatki tym samym kodekiem.
+// Wersja 1 nie miała pól kompresji (były zarezerwowane i wyzerowane) - czytana jest jako plik bez kompresji.
+
+#define CHECKPOINT_MAGIC "NBCKPT1"
+#define CHECKPOINT_END_MAGIC "NBCKEND"
+#define CHECKPOINT_VERSION 2
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerBytes;  // sizeof(CheckpointHeader)
+  uint64_t bodyCount;
+  int64_t step;          // ostatni zakończony krok
+  double time;
+  double dt;
+  uint32_t kernel;       // Kernel
+  uint32_t isa;          // SimdIsa
+  int32_t tileSize;
+  int32_t threads;
+  uint64_t rngBytes;     // długość stanu generatora
+  uint32_t codec;        // TrajectoryCodec pliku wynikowego (od wersji 2)
+  uint32_t keyframeInterval;
+  double tolerance;
+  char reserved[40];
+};
+
+static_assert(sizeof(CheckpointHeader) == 128, "nagłówek punktu kontrolnego musi mieć 128 bajtów");
+
+struct CheckpointState {
+  int64_t step = 0;
+  double time = 0.0;
+  double dt = 0.0;
+  Kernel kernel = Kernel::Symmetric;
+  SimdIsa isa = SimdIsa::Scalar;
+  int tileSize = 0;
+  int threads = 1;
+  TrajectoryCompression compression;  // kompresja pliku wynikowego .nbt
+  std::string rng;  // generator warunków początkowych: model i ziarno Philox (licznikowy - ziarno to cały stan)
+};
+
+// Zapisuje punkt kontrolny atomowo (plik tymczasowy, fsync, rename); zwraca false przy błędzie -
+// poprzedni punkt kontrolny zostaje wtedy nienaruszony
+bool write_checkpoint(const std::string &filename, const Body &bodies, int n, const CheckpointState &state);
+// Wczytuje punkt kontrolny; zwraca false dla pliku niepełnego, w innym formacie albo z wartościami spoza
+// zakresu (kernel, zestaw instrukcji, kodek, liczba wątków)
+bool read_checkpoint(const std::string &filename, Body &bodies, int &n, CheckpointState &state);
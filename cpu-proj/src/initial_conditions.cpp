@@ -0,0 +1,304 @@
+#include "initial_conditions.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+void Philox4x32::operator()(const uint32_t counter[4], uint32_t out[4]) const {
+  const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    const uint64_t p0 = (uint64_t)M0 * c0;
+    const uint64_t p1 = (uint64_t)M1 * c2;
+    const uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+    const uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += W0;
+    k1 += W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+double PhiloxStream::uniform() {
+  if (used > 2) {
+    const uint32_t counter[4] = {(uint32_t)body, (uint32_t)(body >> 32), block++, 0};
+    philox(counter, buffer);
+    used = 0;
+  }
+  // 53 bity z dwóch słów, środek przedziału - wynik w (0, 1)
+  const uint64_t bits = ((uint64_t)(buffer[used] >> 5) << 26) | (buffer[used + 1] >> 6);
+  used += 2;
+  return (bits + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+double PhiloxStream::normal() {
+  return std::sqrt(-2.0 * std::log(uniform())) * std::cos(2.0 * PI * uniform());
+}
+
+bool parse_initial_model(const std::string& name, InitialModel& model) {
+  for (InitialModel candidate : {InitialModel::Uniform, InitialModel::Plummer, InitialModel::Hernquist,
+                                 InitialModel::ExponentialDisk, InitialModel::CollidingGalaxies}) {
+    if (name == initial_model_name(candidate)) {
+      model = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* initial_model_name(InitialModel model) {
+  switch (model) {
+    case InitialModel::Plummer:
+      return "plummer";
+    case InitialModel::Hernquist:
+      return "hernquist";
+    case InitialModel::ExponentialDisk:
+      return "disk";
+    case InitialModel::CollidingGalaxies:
+      return "galaxies";
+    default:
+      return "uniform";
+  }
+}
+
+// Wektor o długości `length` i kierunku jednostajnym na sferze
+static void isotropic(PhiloxStream& random, double length, double& x, double& y, double& z) {
+  const double cosTheta = 2.0 * random.uniform() - 1.0;
+  const double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+  const double phi = 2.0 * PI * random.uniform();
+  x = length * sinTheta * std::cos(phi);
+  y = length * sinTheta * std::sin(phi);
+  z = length * cosTheta;
+}
+
+// Sfera Plummera (Aarseth, Hénon, Wielen 1974): promień z odwróconej dystrybuanty masy, prędkość z funkcji
+// rozkładu g(q) = q^2 (1 - q^2)^3.5 metodą odrzucania; obcięcie na 20a (0.4% masy)
+static void plummer_body(PhiloxStream& random, double a, double GM, double& x, double& y, double& z, double& vx,
+                         double& vy, double& vz) {
+  double r;
+  do {
+    const double u = random.uniform();
+    r = a / std::sqrt(1.0 / std::cbrt(u * u) - 1.0);
+  } while (r > 20.0 * a);
+  isotropic(random, r, x, y, z);
+
+  double q, g, w;
+  do {
+    q = random.uniform();
+    g = 0.1 * random.uniform();
+    w = 1.0 - q * q;
+  } while (g > q * q * w * w * w * std::sqrt(w));
+  const double escape = std::sqrt(2.0 * GM / a / std::sqrt(1.0 + r * r / (a * a)));
+  isotropic(random, q * escape, vx, vy, vz);
+}
+
+// Sfera Hernquista (1990): M(r) = M r^2 / (r + a)^2; prędkości z rozkładu Maxwella o dyspersji z izotropowego
+// równania Jeansa (wzór 10 w pracy Hernquista), poniżej 0.95 prędkości ucieczki; obcięcie na 100a (2% masy)
+static void hernquist_body(PhiloxStream& random, double a, double GM, double& x, double& y, double& z, double& vx,
+                           double& vy, double& vz) {
+  double r;
+  do {
+    const double s = std::sqrt(random.uniform());
+    r = a * s / (1.0 - s);
+  } while (r > 100.0 * a);
+  isotropic(random, r, x, y, z);
+
+  const double u = r / a;
+  const double sigma2 = GM / (12.0 * a) *
+                        (12.0 * u * std::pow(1.0 + u, 3) * std::log((1.0 + u) / u) -
+                         u / (1.0 + u) * (25.0 + 52.0 * u + 42.0 * u * u + 12.0 * u * u * u));
+  const double sigma = std::sqrt(std::max(sigma2, 0.0));
+  const double escape2 = 0.95 * 0.95 * 2.0 * GM / (r + a);
+  do {
+    vx = sigma * random.normal();
+    vy = sigma * random.normal();
+    vz = sigma * random.normal();
+  } while (vx * vx + vy * vy + vz * vz > escape2);
+}
+
+// Prędkość kołowa cienkiego dysku wykładniczego (Freeman 1970); bez funkcji specjalnych C++17 - przybliżenie
+// sferyczne G M(<R) / R
+static double disk_circular_velocity(double R, double Rd, double GM) {
+#if defined(__cpp_lib_math_special_functions) || defined(__STDCPP_MATH_SPEC_FUNCS__)
+  const double y = R / (2.0 * Rd);
+  const double bessel = std::cyl_bessel_i(0.0, y) * std::cyl_bessel_k(0.0, y) -
+                        std::cyl_bessel_i(1.0, y) * std::cyl_bessel_k(1.0, y);
+  return y > 0.0 ? std::sqrt(std::max(2.0 * GM / Rd * y * y * bessel, 0.0)) : 0.0;
+#else
+  const double enclosed = 1.0 - (1.0 + R / Rd) * std::exp(-R / Rd);
+  return R > 0.0 ? std::sqrt(GM * enclosed / R) : 0.0;
+#endif
+}
+
+// Krzywa rotacji dysku stablicowana co 15 Rd / 4096 - funkcje Bessela liczone dla każdego ciała są kilka razy
+// droższe niż całe losowanie, a interpolacja liniowa myli się o mniej niż 1e-5 vc
+class DiskRotationCurve {
+ public:
+  DiskRotationCurve() : step(1.0) {}
+  DiskRotationCurve(double Rd, double GM) : step(15.0 * Rd / POINTS), velocity(POINTS + 2) {
+    for (int k = 0; k < POINTS + 2; k++) {
+      velocity[k] = disk_circular_velocity(k * step, Rd, GM);
+    }
+  }
+
+  double operator()(double R) const {
+    const double position = R / step;
+    const int k = std::min((int)position, POINTS);
+    const double t = position - k;
+    return velocity[k] + t * (velocity[k + 1] - velocity[k]);
+  }
+
+ private:
+  static constexpr int POINTS = 4096;
+  double step;
+  std::vector<double> velocity;
+};
+
+// Dysk wykładniczy Σ ∝ exp(-R / Rd): R ma rozkład gamma(2) (-Rd ln(u1 u2)), profil pionowy sech^2(z / z0),
+// obrót przeciwny do ruchu wskazówek zegara wokół osi z; obcięcie na 15 Rd
+static void disk_body(PhiloxStream& random, const InitialConditions& ic, double Rd, const DiskRotationCurve& rotation,
+                      double& x, double& y, double& z, double& vx, double& vy, double& vz) {
+  double R;
+  do {
+    R = -Rd * std::log(random.uniform() * random.uniform());
+  } while (R > 15.0 * Rd);
+  const double phi = 2.0 * PI * random.uniform();
+  x = R * std::cos(phi);
+  y = R * std::sin(phi);
+  z = ic.diskThickness * Rd * std::atanh(2.0 * random.uniform() - 1.0);
+
+  const double vc = rotation(R);
+  const double sigma = ic.diskDispersion * vc;
+  const double vR = sigma * random.normal();
+  const double vPhi = vc + sigma * random.normal();
+  vx = vR * std::cos(phi) - vPhi * std::sin(phi);
+  vy = vR * std::sin(phi) + vPhi * std::cos(phi);
+  vz = sigma * random.normal();
+}
+
+// Przesuwa ciała [first, last) do układu środka masy. Sumy częściowe liczone są w blokach stałej długości i dodawane
+// po kolei, więc wynik jest ten sam dla każdej liczby wątków
+static void to_center_of_mass_frame(Body& bodies, int first, int last) {
+  const int BLOCK = 1 << 14;
+  const int blocks = (last - first + BLOCK - 1) / BLOCK;
+  if (blocks <= 0) {
+    return;
+  }
+  std::vector<double> partial(7 * (size_t)blocks, 0.0);
+
+#pragma omp parallel for schedule(static)
+  for (int b = 0; b < blocks; b++) {
+    double* sum = partial.data() + 7 * (size_t)b;
+    const int end = std::min(first + (b + 1) * BLOCK, last);
+    for (int i = first + b * BLOCK; i < end; i++) {
+      const double m = bodies.mass[i];
+      sum[0] += m;
+      sum[1] += m * bodies.x[i];
+      sum[2] += m * bodies.y[i];
+      sum[3] += m * bodies.z[i];
+      sum[4] += m * bodies.vx[i];
+      sum[5] += m * bodies.vy[i];
+      sum[6] += m * bodies.vz[i];
+    }
+  }
+
+  double total[7] = {};
+  for (int b = 0; b < blocks; b++) {
+    for (int k = 0; k < 7; k++) total[k] += partial[7 * (size_t)b + k];
+  }
+  if (total[0] <= 0.0) {
+    return;
+  }
+  const double cx = total[1] / total[0], cy = total[2] / total[0], cz = total[3] / total[0];
+  const double cvx = total[4] / total[0], cvy = total[5] / total[0], cvz = total[6] / total[0];
+
+#pragma omp parallel for schedule(static)
+  for (int i = first; i < last; i++) {
+    bodies.x[i] -= cx;
+    bodies.y[i] -= cy;
+    bodies.z[i] -= cz;
+    bodies.vx[i] -= cvx;
+    bodies.vy[i] -= cvy;
+    bodies.vz[i] -= cvz;
+  }
+}
+
+void generate_initial_conditions(Body& bodies, int n, const InitialConditions& ic) {
+  bodies.resize(n);
+  if (n <= 0) {
+    return;
+  }
+  const Philox4x32 philox(ic.seed);
+  const double scale = ic.scale > 0.0 ? ic.scale : ic.model == InitialModel::Uniform ? 100.0 : 10.0;
+  const double totalMass = ic.totalMass > 0.0 ? ic.totalMass : 5.5 * n;
+  const double bodyMass = totalMass / n;
+  const InitialModel model = ic.model;
+
+  // Zderzenie: dwie sfery Plummera po połowie ciał i masy
+  const int firstGalaxy = model == InitialModel::CollidingGalaxies ? n / 2 : n;
+  const double galaxyGM = G * (model == InitialModel::CollidingGalaxies ? 0.5 * totalMass : totalMass);
+  const DiskRotationCurve rotation =
+      model == InitialModel::ExponentialDisk ? DiskRotationCurve(scale, galaxyGM) : DiskRotationCurve();
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    PhiloxStream random(philox, (uint64_t)i);
+    double x, y, z, vx = 0.0, vy = 0.0, vz = 0.0;
+    double mass = bodyMass;
+    switch (model) {
+      case InitialModel::Uniform:
+        x = (random.uniform() - 0.5) * scale;
+        y = (random.uniform() - 0.5) * scale;
+        z = (random.uniform() - 0.5) * scale;
+        mass = bodyMass * (1.0 + 9.0 * random.uniform()) / 5.5;
+        break;
+      case InitialModel::Hernquist:
+        hernquist_body(random, scale, galaxyGM, x, y, z, vx, vy, vz);
+        break;
+      case InitialModel::ExponentialDisk:
+        disk_body(random, ic, scale, rotation, x, y, z, vx, vy, vz);
+        break;
+      default:
+        plummer_body(random, scale, galaxyGM, x, y, z, vx, vy, vz);
+        break;
+    }
+    bodies.x[i] = x;
+    bodies.y[i] = y;
+    bodies.z[i] = z;
+    bodies.vx[i] = vx;
+    bodies.vy[i] = vy;
+    bodies.vz[i] = vz;
+    bodies.ax[i] = bodies.ay[i] = bodies.az[i] = 0.0;
+    bodies.mass[i] = mass;
+  }
+
+  if (model == InitialModel::Uniform) {
+    return;
+  }
+  to_center_of_mass_frame(bodies, 0, firstGalaxy);
+  if (model != InitialModel::CollidingGalaxies) {
+    return;
+  }
+  to_center_of_mass_frame(bodies, firstGalaxy, n);
+
+  // Galaktyki na osi x w odległości `separation`, przesunięte o parametr zderzenia w y, zbliżają się
+  // z prędkością paraboliczną sqrt(2 G M / d)
+  const double d = ic.separation * scale, b = ic.impactParameter * scale;
+  const double approach = std::sqrt(2.0 * G * totalMass / std::sqrt(d * d + b * b));
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    const double side = i < firstGalaxy ? -0.5 : 0.5;
+    bodies.x[i] += side * d;
+    bodies.y[i] += side * b;
+    bodies.vx[i] -= side * approach;
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "physics.h"
+
+// Licznikowy generator Philox4x32-10 (Salmon i in., "Parallel random numbers: as easy as 1, 2, 3", SC'11):
+// wynik to szyfr 128-bitowego licznika kluczem z ziarna, więc dowolny element strumienia liczy się w O(1).
+// Każde ciało ma własny strumień (licznik = numer ciała, numer bloku), dlatego warunki początkowe są takie
+// same dla danego ziarna niezależnie od liczby wątków i kolejności ich pracy.
+struct Philox4x32 {
+  uint32_t key[2];
+
+  explicit Philox4x32(uint64_t seed) : key{(uint32_t)seed, (uint32_t)(seed >> 32)} {}
+  void operator()(const uint32_t counter[4], uint32_t out[4]) const;
+};
+
+// Kolejne liczby losowe strumienia jednego ciała
+class PhiloxStream {
+ public:
+  PhiloxStream(const Philox4x32 &philox, uint64_t body) : philox(philox), body(body) {}
+
+  // Rozkład jednostajny na (0, 1) - bez zera, więc można go logarytmować
+  double uniform();
+  // Rozkład normalny N(0, 1) (Box-Muller)
+  double normal();
+
+ private:
+  const Philox4x32 &philox;
+  uint64_t body;
+  uint32_t block = 0;
+  uint32_t buffer[4];
+  int used = 4;
+};
+
+enum class InitialModel { Uniform, Plummer, Hernquist, ExponentialDisk, CollidingGalaxies };
+
+struct InitialConditions {
+  InitialModel model = InitialModel::Uniform;
+  uint64_t seed = 0;
+  // Bok sześcianu (Uniform), promień skali a (Plummer, Hernquist, każda z galaktyk) albo skala dysku Rd;
+  // 0 - 100 dla sześcianu (ciała w [-50, 50]), 10 dla pozostałych modeli
+  double scale = 0.0;
+  // Masa całkowita; 0 - 5.5 na ciało (średnia dotychczasowych mas z przedziału [1, 10])
+  double totalMass = 0.0;
+  // Dysk: grubość sech^2 i rozrzut prędkości względem prędkości kołowej
+  double diskThickness = 0.1;
+  double diskDispersion = 0.05;
+  // Zderzenie galaktyk: odległość środków i parametr zderzenia w jednostkach `scale`; galaktyki zbliżają się
+  // z prędkością paraboliczną dla mas punktowych
+  double separation = 10.0;
+  double impactParameter = 2.0;
+};
+
+// Nazwy modeli w wierszu poleceń: uniform, plummer, hernquist, disk, galaxies
+bool parse_initial_model(const std::string &name, InitialModel &model);
+const char *initial_model_name(InitialModel model);
+
+// Wypełnia n ciał równolegle (schedule(static), jak pętle kroków - strony tablic trafiają do węzłów NUMA wątków,
+// które będą je liczyć). Sfery i galaktyki są przesuwane do układu środka masy (sumy w stałych blokach,
+// więc też niezależne od liczby wątków); przyspieszenia są zerowane.
+void generate_initial_conditions(Body &bodies, int n, const InitialConditions &ic);
@@ -1,62 +1,271 @@
+#include <cstring>
+#include <ctime>
+#include <filesystem>
 #include <iostream>
+
+#include "checkpoint.h"
+#include "initial_conditions.h"
+#include "particle_loader.h"
 #include "physics.h"
+#include "snapshot.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 int main(const int argc, const char** argv) {
-  srand(time(NULL));
+  // Opcje punktów kontrolnych i warunków początkowych mogą stać w dowolnym miejscu, pozostałe argumenty są pozycyjne
+  std::string checkpointFilename, restartFilename, inputFilename;
+  int checkpointInterval = 0;
+  InitialConditions initial;
+  initial.seed = (uint64_t)time(NULL);
+  std::vector<const char*> args = {argv[0]};
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      checkpointFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+      checkpointInterval = atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--restart") == 0 && i + 1 < argc) {
+      restartFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      inputFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--ic") == 0 && i + 1 < argc) {
+      if (!parse_initial_model(argv[++i], initial.model)) {
+        std::cerr << "Nieznany model warunków początkowych: " << argv[i]
+                  << " (dostępne: uniform, plummer, hernquist, disk, galaxies)" << std::endl;
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      initial.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--ic-scale") == 0 && i + 1 < argc) {
+      initial.scale = atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--ic-mass") == 0 && i + 1 < argc) {
+      initial.totalMass = atof(argv[++i]);
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  const int positional = (int)args.size();
+  if (checkpointInterval > 0 && checkpointFilename.empty()) {
+    checkpointFilename = "checkpoint.nbc";
+  }
 
   int n = 1000;
-  if (argc > 1) {
-    n = atoi(argv[1]);
+  if (positional > 1) {
+    n = atoi(args[1]);
   }
 
   int steps = 1000;
-  if (argc > 2) {
-    steps = atoi(argv[2]);
+  if (positional > 2) {
+    steps = atoi(args[2]);
   }
 
   int saveInterval = 100;
-  if (argc > 3) {
-    saveInterval = atoi(argv[3]);
+  if (positional > 3) {
+    saveInterval = atoi(args[3]);
   }
 
   double dt = 0.01;
-  if (argc > 4) {
-    dt = atof(argv[4]);
+  if (positional > 4) {
+    dt = atof(args[4]);
   }
 
   std::string outputFilename = "output.json";
-  if (argc > 5) {
-    outputFilename = argv[5];
+  if (positional > 5) {
+    outputFilename = args[5];
+  }
+
+  Kernel kernel = Kernel::Symmetric;
+  if (positional > 6) {
+    std::string kernelName = args[6];
+    if (kernelName == "simd") {
+      kernel = Kernel::Simd;
+    } else if (kernelName == "tiled") {
+      kernel = Kernel::Tiled;
+    } else if (kernelName != "symmetric") {
+      std::cerr << "Nieznany kernel: " << kernelName << " (dostępne: symmetric, simd, tiled)" << std::endl;
+      return 1;
+    }
+  }
+
+  // sync - zapis w pętli kroków, block / drop - zapis w tle, przy zajętych buforach czekanie albo pominięcie klatki
+  std::string outputMode = "block";
+  if (positional > 7) {
+    outputMode = args[7];
+    if (outputMode != "sync" && outputMode != "block" && outputMode != "drop") {
+      std::cerr << "Nieznany tryb zapisu: " << outputMode << " (dostępne: sync, block, drop)" << std::endl;
+      return 1;
+    }
+  }
+
+  // Kompresja trajektorii binarnej (.nbt): none, xor (bezstratna) albo quantize (błąd do tolerancji
+  // razy bok prostopadłościanu ograniczającego, domyślnie 1e-6)
+  TrajectoryCompression compression;
+  if (positional > 8 && !parse_trajectory_codec(args[8], compression.codec)) {
+    std::cerr << "Nieznana kompresja: " << args[8] << " (dostępne: none, xor, quantize)" << std::endl;
+    return 1;
+  }
+  if (positional > 9) {
+    compression.tolerance = atof(args[9]);
   }
 
   Body bodies;
-  bodies.resize(n);
+  CheckpointState state;
+  const bool restart = !restartFilename.empty();
 
-  for (int i = 0; i < n; i++) {
-    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
-    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
-    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
-    bodies.vx[i] = bodies.vy[i] = bodies.vz[i] = 0.0;
-    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  if (restart) {
+    // Wznowienie: stan, krok i parametry wpływające na zaokrąglenia pochodzą z punktu kontrolnego,
+    // argumenty pozycyjne liczby ciał, dt, kernela i kompresji są pomijane
+    if (!read_checkpoint(restartFilename, bodies, n, state)) {
+      return 1;
+    }
+    dt = state.dt;
+    kernel = state.kernel;
+    compression = state.compression;
+    if (state.isa > detect_simd_isa()) {
+      std::cerr << "Uwaga: procesor nie obsługuje " << simd_isa_name(state.isa)
+                << " - wyniki po wznowieniu nie będą identyczne bit w bit" << std::endl;
+      state.isa = detect_simd_isa();
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(state.threads);
+#endif
+    std::cout << "Wznowienie z " << restartFilename << ": krok " << state.step << ", " << n << " ciał, dt " << dt
+              << ", wątki " << state.threads << ", warunki początkowe " << state.rng << std::endl;
+  } else {
+    auto generateStart = std::chrono::high_resolution_clock::now();
+    if (!inputFilename.empty()) {
+      // Ciała z pliku (CSV, .bin, JSON albo .nbt) - liczba ciał z argumentów jest pomijana
+      if (!load_particles(inputFilename, bodies, n)) {
+        return 1;
+      }
+      std::chrono::duration<double> loadTime = std::chrono::high_resolution_clock::now() - generateStart;
+      std::cout << "Wczytano " << n << " ciał z " << inputFilename << " (" << loadTime.count() * 1000.0 << " ms)"
+                << std::endl;
+      state.rng = "input " + inputFilename;
+    } else {
+      // Każde ciało ma własny strumień Philox - ten sam model i ziarno dają te same ciała przy dowolnej liczbie wątków
+      generate_initial_conditions(bodies, n, initial);
+      std::chrono::duration<double> generateTime = std::chrono::high_resolution_clock::now() - generateStart;
+      std::cout << "Warunki początkowe: " << initial_model_name(initial.model) << ", ziarno " << initial.seed << " ("
+                << generateTime.count() * 1000.0 << " ms)" << std::endl;
+      state.rng = std::string(initial_model_name(initial.model)) + " " + std::to_string(initial.seed);
+    }
+    state.dt = dt;
+    state.kernel = kernel;
+    state.compression = compression;
+    state.isa = detect_simd_isa();
+    state.tileSize = default_tile_size();
+#ifdef _OPENMP
+    state.threads = omp_get_max_threads();
+#endif
   }
 
-  save_state(bodies, n, outputFilename, 0, false);
+  if (kernel == Kernel::Simd) {
+    std::cout << "Kernel: simd (" << simd_isa_name(state.isa) << ")" << std::endl;
+  } else if (kernel == Kernel::Tiled) {
+    std::cout << "Kernel: tiled (" << simd_isa_name(state.isa) << ", kafel " << state.tileSize << " ciał)" << std::endl;
+  } else {
+    std::cout << "Kernel: symmetric" << std::endl;
+  }
+
+  // Plik otwarty przez cały przebieg - każda klatka jest tylko dopisywana; poza trybem sync
+  // serializacją i zapisem zajmuje się osobny wątek, a pętla kroków tylko kopiuje stan do bufora.
+  // Po wznowieniu klatki dopisywane są do pliku przerwanego przebiegu, za ostatnią klatką sprzed punktu kontrolnego
+  SnapshotFormat format = snapshot_format_for(outputFilename);
+  std::string mismatch;
+  if (restart && format == SnapshotFormat::Binary && std::filesystem::exists(outputFilename) &&
+      !trajectory_can_append(outputFilename, n, TRAJ_ALL_FIELDS, false, compression.codec, mismatch)) {
+    std::cerr << "Błąd: " << outputFilename << " nie pasuje do wznawianego przebiegu (" << mismatch
+              << ") - plik nie zostanie nadpisany" << std::endl;
+    return 1;
+  }
+  // Klatki zapisane przez przerwany przebieg po punkcie kontrolnym są odcinane - wznowiony przebieg liczy je od nowa
+  const int64_t appendAfter = restart ? state.step : INT64_MAX;
+  std::unique_ptr<SnapshotWriter> snapshots;
+  std::unique_ptr<AsyncSnapshotWriter> asyncSnapshots;
+  if (outputMode == "sync") {
+    snapshots = std::make_unique<SnapshotWriter>(outputFilename, format, restart, dt, compression, appendAfter);
+  } else {
+    asyncSnapshots = std::make_unique<AsyncSnapshotWriter>(
+        outputFilename, format, restart, dt, outputMode == "drop" ? Backpressure::Drop : Backpressure::Block, 2,
+        compression, appendAfter);
+  }
+  std::chrono::duration<double> saveTime(0.0);
+  auto save = [&](int step) {
+    auto saveStart = std::chrono::high_resolution_clock::now();
+    if (snapshots) {
+      snapshots->write(bodies, n, step);
+    } else {
+      asyncSnapshots->write(bodies, n, step);
+    }
+    saveTime += std::chrono::high_resolution_clock::now() - saveStart;
+  };
+  if (!restart) {
+    save(0);
+  }
+
+  std::chrono::duration<double> checkpointTime(0.0);
+  int checkpoints = 0;
+  auto checkpoint = [&](int step) {
+    auto checkpointStart = std::chrono::high_resolution_clock::now();
+    state.step = step;
+    state.time = step * dt;
+    if (write_checkpoint(checkpointFilename, bodies, n, state)) {
+      checkpoints++;
+    }
+    checkpointTime += std::chrono::high_resolution_clock::now() - checkpointStart;
+  };
 
   auto start = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> forceTime(0.0);
 
-  for (int step = 1; step < steps; step++) {
-    update_velocities(bodies, n, dt);
+  const int firstStep = (int)state.step + 1;
+  for (int step = firstStep; step < steps; step++) {
+    auto forceStart = std::chrono::high_resolution_clock::now();
+    update_velocities(bodies, n, dt, kernel, state.isa, state.tileSize);
+    forceTime += std::chrono::high_resolution_clock::now() - forceStart;
     update_positions(bodies, n, dt);
 
     if (saveInterval > 0 && step % saveInterval == 0) {
       std::cout << "Krok: " << step << "/" << steps << std::endl;
-      save_state(bodies, n, outputFilename, step, true); // Dopisuj kolejne kroki
+      save(step);
     }
+    if (checkpointInterval > 0 && step % checkpointInterval == 0) {
+      checkpoint(step);
+    }
+  }
+  if (asyncSnapshots) {
+    asyncSnapshots->flush();
+  }
+  // Końcowy punkt kontrolny pozwala przedłużyć zakończony przebieg (--restart z większą liczbą kroków)
+  const int lastStep = std::max(steps - 1, (int)state.step);
+  if (!checkpointFilename.empty() && (int)state.step != lastStep) {
+    checkpoint(lastStep);
   }
 
   auto end = std::chrono::high_resolution_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
   std::cout << "Czas wykonania: " << duration.count() << " ms" << std::endl;
 
+  // Interakcje liczone jak dla pełnej sumy (n * (n - 1) na krok), niezależnie od kernela
+  if (steps > firstStep && forceTime.count() > 0.0) {
+    double interactions = (double)n * (n - 1) * (steps - firstStep);
+    std::cout << "Interakcje par na sekundę: " << interactions / forceTime.count() << std::endl;
+  }
+
+  // Czas zapisu widoczny dla pętli kroków (w tle: kopiowanie i czekanie na wolny bufor)
+  std::cout << "Zapis w pętli kroków: " << saveTime.count() * 1000.0 << " ms" << std::endl;
+  if (asyncSnapshots) {
+    SnapshotStats stats = asyncSnapshots->stats();
+    std::cout << "Zapis w tle: " << stats.writeSeconds * 1000.0 << " ms, czekanie na bufor: " << stats.waitSeconds * 1000.0
+              << " ms, kopiowanie: " << stats.copySeconds * 1000.0 << " ms, zapisane klatki: " << stats.framesWritten
+              << ", pominięte: " << stats.framesDropped << std::endl;
+  }
+  if (checkpoints > 0) {
+    std::cout << "Punkty kontrolne: " << checkpoints << ", zapis: " << checkpointTime.count() * 1000.0 << " ms"
+              << std::endl;
+  }
+
   return 0;
 }
\ No newline at end of file
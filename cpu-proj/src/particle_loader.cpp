@@ -0,0 +1,613 @@
+#include "particle_loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <omp.h>
+#include <string_view>
+
+#include "trajectory.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PARTICLE_LOADER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Kolumny wczytywanego ciała, w kolejności plików .bin i CSV bez nagłówka
+enum ParticleColumn { COL_X, COL_Y, COL_Z, COL_VX, COL_VY, COL_VZ, COL_MASS, PARTICLE_COLUMNS };
+
+// Plik zmapowany do pamięci tylko do odczytu; bez mmap wczytywany w całości
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename) {
+#ifdef PARTICLE_LOADER_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+      length = info.st_size;
+      opened = true;
+      if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+          opened = false;
+          length = 0;
+        } else {
+          // Każdy wątek czyta swój fragment po kolei - większy odczyt z wyprzedzeniem
+          madvise(mapped, length, MADV_SEQUENTIAL);
+          mapping = static_cast<const char*>(mapped);
+        }
+      }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+      return;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    opened = true;
+    mapping = fallback.data();
+    length = fallback.size();
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef PARTICLE_LOADER_MMAP
+    if (mapping) {
+      munmap(const_cast<char*>(mapping), length);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool is_open() const { return opened; }
+  const char* data() const { return mapping; }
+  size_t size() const { return length; }
+
+ private:
+  const char* mapping = nullptr;
+  size_t length = 0;
+  bool opened = false;
+#ifndef PARTICLE_LOADER_MMAP
+  std::vector<char> fallback;
+#endif
+};
+
+ParticleFormat particle_format_for(const std::string& filename) {
+  auto ends_with = [&](const char* suffix) {
+    const size_t length = std::strlen(suffix);
+    return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+  };
+  if (ends_with(".bin")) return ParticleFormat::Binary;
+  if (ends_with(".nbt")) return ParticleFormat::Trajectory;
+  if (ends_with(".json") || ends_with(".ndjson") || ends_with(".jsonl")) return ParticleFormat::Json;
+  return ParticleFormat::Csv;
+}
+
+// Liczba fragmentów parsowanych równolegle: po jednym na wątek, nie mniejszych niż 1 MB
+static int chunk_count(size_t bytes, int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  return (int)std::min<size_t>(omp_get_max_threads(), bytes / (1 << 20) + 1);
+}
+
+// Granice fragmentów [begin, end); find(p) zwraca pierwszy początek rekordu nie wcześniejszy niż p
+template <typename Find>
+static std::vector<const char*> split_chunks(const char* begin, const char* end, int chunks, Find find) {
+  std::vector<const char*> bounds(chunks + 1, end);
+  bounds[0] = begin;
+  const size_t size = end - begin;
+  for (int c = 1; c < chunks; c++) {
+    bounds[c] = std::max(bounds[c - 1], find(begin + size / chunks * c));
+  }
+  return bounds;
+}
+
+// Pozycje pierwszych ciał fragmentów - sumy prefiksowe liczników z pierwszego przebiegu
+static std::vector<size_t> chunk_offsets(const std::vector<size_t>& counts) {
+  std::vector<size_t> offsets(counts.size() + 1, 0);
+  for (size_t c = 0; c < counts.size(); c++) {
+    offsets[c + 1] = offsets[c] + counts[c];
+  }
+  return offsets;
+}
+
+// Wczytane ciała trafiają wprost do tablic Body; przyspieszenia zostają zerami z Body::resize
+static void store_body(Body& bodies, size_t i, const double values[PARTICLE_COLUMNS]) {
+  bodies.x[i] = values[COL_X];
+  bodies.y[i] = values[COL_Y];
+  bodies.z[i] = values[COL_Z];
+  bodies.vx[i] = values[COL_VX];
+  bodies.vy[i] = values[COL_VY];
+  bodies.vz[i] = values[COL_VZ];
+  bodies.mass[i] = values[COL_MASS];
+}
+
+static bool resize_bodies(const std::string& filename, Body& bodies, int& n, size_t count) {
+  if (count > (size_t)std::numeric_limits<int>::max()) {
+    std::cerr << "Błąd: " << filename << " zawiera za dużo ciał (" << count << ")" << std::endl;
+    return false;
+  }
+  n = (int)count;
+  bodies.resize(0);
+  bodies.resize(n);
+  return true;
+}
+
+// Pierwszy błąd (z najwcześniejszego fragmentu); numer linii liczony dopiero teraz, szeregowo
+static bool report_error(const std::string& filename, const char* data, const std::vector<const char*>& errors,
+                         const char* what) {
+  for (const char* error : errors) {
+    if (error) {
+      std::cerr << "Błąd: " << filename << ":" << 1 + std::count(data, error, '\n') << ": " << what << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Liczba od p; from_chars nie przyjmuje '+' przed liczbą
+static bool parse_number(const char*& p, const char* end, double& value) {
+  if (p < end && *p == '+') {
+    p++;
+  }
+  std::from_chars_result result = std::from_chars(p, end, value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  p = result.ptr;
+  return true;
+}
+
+// --- CSV ---
+
+static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static bool is_separator(char c) { return c == ',' || c == ';' || is_blank(c); }
+
+static const char* skip_blanks(const char* p, const char* end) {
+  while (p < end && is_blank(*p)) p++;
+  return p;
+}
+
+static const char* line_end(const char* p, const char* end) {
+  if (p >= end) {
+    return end;
+  }
+  const void* newline = std::memchr(p, '\n', end - p);
+  return newline ? static_cast<const char*>(newline) : end;
+}
+
+// Linia z danymi: niepusta i nie komentarz
+static bool is_data_line(const char* p, const char* end) {
+  p = skip_blanks(p, end);
+  return p < end && *p != '#';
+}
+
+// Pola pierwszej linii (nagłówka albo danych) rozdzielone separatorami
+static std::vector<std::string_view> split_fields(const char* p, const char* end) {
+  std::vector<std::string_view> fields;
+  while (true) {
+    while (p < end && is_separator(*p)) p++;
+    if (p >= end) {
+      return fields;
+    }
+    const char* start = p;
+    while (p < end && !is_separator(*p)) p++;
+    fields.emplace_back(start, p - start);
+  }
+}
+
+static int csv_column(std::string_view name) {
+  std::string key;
+  for (char c : name) {
+    if (c != '"' && c != '\'') key += (char)std::tolower((unsigned char)c);
+  }
+  static const char* const names[PARTICLE_COLUMNS] = {"x", "y", "z", "vx", "vy", "vz", "mass"};
+  for (int column = 0; column < PARTICLE_COLUMNS; column++) {
+    if (key == names[column]) return column;
+  }
+  return key == "m" ? COL_MASS : -1;
+}
+
+// Pola linii CSV do values według layout (pole -> kolumna, -1 - pole pomijane)
+static bool parse_csv_line(const char* p, const char* end, const std::vector<int>& layout,
+                           double values[PARTICLE_COLUMNS]) {
+  for (size_t field = 0; field < layout.size(); field++) {
+    p = skip_blanks(p, end);
+    if (field > 0 && p < end && (*p == ',' || *p == ';')) {
+      p = skip_blanks(p + 1, end);
+    }
+    if (layout[field] < 0) {
+      while (p < end && !is_separator(*p)) p++;
+    } else if (!parse_number(p, end, values[layout[field]])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool load_csv(const std::string& filename, const char* data, size_t size, Body& bodies, int& n,
+                     int chunks) {
+  const char* end = data + size;
+
+  // Nagłówek: pierwsza linia z danymi, której pierwsze pole nie jest liczbą
+  const char* first = data;
+  while (first < end && !is_data_line(first, line_end(first, end))) {
+    first = std::min(line_end(first, end) + 1, end);
+  }
+  const char* firstEnd = line_end(first, end);
+  const std::vector<std::string_view> fields = split_fields(first, firstEnd);
+  double probe;
+  const char* probeEnd = fields.empty() ? end : fields[0].data();
+  const bool header = !fields.empty() &&
+                      !(parse_number(probeEnd, end, probe) && probeEnd == fields[0].data() + fields[0].size());
+
+  std::vector<int> layout;
+  if (header) {
+    for (std::string_view name : fields) {
+      layout.push_back(csv_column(name));
+    }
+    auto has = [&](int column) { return std::find(layout.begin(), layout.end(), column) != layout.end(); };
+    if (!has(COL_X) || !has(COL_Y) || !has(COL_MASS)) {
+      std::cerr << "Błąd: " << filename << ": nagłówek CSV musi zawierać kolumny x, y i mass" << std::endl;
+      return false;
+    }
+  } else if (fields.size() == 7) {
+    layout = {COL_X, COL_Y, COL_Z, COL_VX, COL_VY, COL_VZ, COL_MASS};
+  } else if (fields.size() == 4) {
+    layout = {COL_X, COL_Y, COL_Z, COL_MASS};
+  } else if (!fields.empty()) {
+    std::cerr << "Błąd: " << filename << ": CSV bez nagłówka musi mieć 7 kolumn (x, y, z, vx, vy, vz, mass)"
+              << " albo 4 (x, y, z, mass), a ma " << fields.size() << std::endl;
+    return false;
+  }
+  const char* begin = header ? std::min(firstEnd + 1, end) : data;
+
+  chunks = chunk_count(end - begin, chunks);
+  const std::vector<const char*> bounds = split_chunks(begin, end, chunks, [&](const char* p) {
+    return p == begin || p[-1] == '\n' ? p : std::min(line_end(p, end) + 1, end);
+  });
+
+  std::vector<size_t> counts(chunks, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < chunks; c++) {
+    size_t count = 0;
+    for (const char* p = bounds[c]; p < bounds[c + 1];) {
+      const char* e = line_end(p, end);
+      if (is_data_line(p, e)) count++;
+      p = e < end ? e + 1 : end;
+    }
+    counts[c] = count;
+  }
+  const std::vector<size_t> offsets = chunk_offsets(counts);
+  if (!resize_bodies(filename, bodies, n, offsets.back())) {
+    return false;
+  }
+
+  std::vector<const char*> errors(chunks, nullptr);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < chunks; c++) {
+    size_t i = offsets[c];
+    for (const char* p = bounds[c]; p < bounds[c + 1];) {
+      const char* e = line_end(p, end);
+      if (is_data_line(p, e)) {
+        double values[PARTICLE_COLUMNS] = {};
+        if (!parse_csv_line(p, e, layout, values)) {
+          errors[c] = p;
+          break;
+        }
+        store_body(bodies, i++, values);
+      }
+      p = e < end ? e + 1 : end;
+    }
+  }
+  return report_error(filename, data, errors, "niepoprawna liczba albo za mało kolumn");
+}
+
+// --- JSON ---
+
+static bool is_json_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+static const char* skip_json_space(const char* p, const char* end) {
+  while (p < end && is_json_space(*p)) p++;
+  return p;
+}
+
+// '{' otwiera obiekt ciała, gdy poprzedza go (z pominięciem białych znaków) przecinek albo początek tablicy -
+// wewnątrz ciała nawias klamrowy stoi zawsze po dwukropku
+static bool is_body_start(const char* p, const char* arrayBegin) {
+  while (p > arrayBegin && is_json_space(p[-1])) p--;
+  return p == arrayBegin || p[-1] == ',';
+}
+
+static const char* next_body(const char* p, const char* arrayBegin, const char* arrayEnd) {
+  while (p < arrayEnd) {
+    const void* brace = std::memchr(p, '{', arrayEnd - p);
+    if (!brace) {
+      return arrayEnd;
+    }
+    p = static_cast<const char*>(brace);
+    if (is_body_start(p, arrayBegin)) {
+      return p;
+    }
+    p++;
+  }
+  return arrayEnd;
+}
+
+// Klucz "nazwa" z dwukropkiem; p ustawiany na wartość
+static bool parse_json_key(const char*& p, const char* end, std::string_view& key) {
+  p = skip_json_space(p, end);
+  if (p >= end || *p != '"') {
+    return false;
+  }
+  const char* quote = static_cast<const char*>(std::memchr(p + 1, '"', end - p - 1));
+  if (!quote) {
+    return false;
+  }
+  key = std::string_view(p + 1, quote - p - 1);
+  p = skip_json_space(quote + 1, end);
+  if (p >= end || *p != ':') {
+    return false;
+  }
+  p = skip_json_space(p + 1, end);
+  return true;
+}
+
+// Liczba albo null - tak snapshot zapisuje wartości nieskończone i NaN
+static bool parse_json_number(const char*& p, const char* end, double& value) {
+  if (end - p >= 4 && std::memcmp(p, "null", 4) == 0) {
+    value = std::numeric_limits<double>::quiet_NaN();
+    p += 4;
+    return true;
+  }
+  return parse_number(p, end, value);
+}
+
+// Pomija dowolną wartość (napis, liczbę, literał, obiekt albo tablicę)
+static bool skip_json_value(const char*& p, const char* end) {
+  int depth = 0;
+  do {
+    if (p >= end) {
+      return false;
+    }
+    if (*p == '"') {
+      for (p++; p < end && *p != '"'; p++) {
+        if (*p == '\\') p++;
+      }
+      if (p >= end) {
+        return false;
+      }
+      p++;
+    } else if (*p == '{' || *p == '[') {
+      depth++;
+      p++;
+    } else if (*p == '}' || *p == ']') {
+      if (depth == 0) {
+        return false;
+      }
+      depth--;
+      p++;
+    } else if (depth == 0) {
+      while (p < end && *p != ',' && *p != '}' && *p != ']' && !is_json_space(*p)) p++;
+    } else {
+      p++;
+    }
+  } while (depth > 0);
+  return true;
+}
+
+// Obiekt {"klucz": wartość, ...}; field(key, p) wczytuje wartość klucza i zwraca false przy błędzie
+template <typename Field>
+static bool parse_json_object(const char*& p, const char* end, Field field) {
+  p = skip_json_space(p, end);
+  if (p >= end || *p != '{') {
+    return false;
+  }
+  p = skip_json_space(p + 1, end);
+  if (p < end && *p == '}') {
+    p++;
+    return true;
+  }
+  while (true) {
+    std::string_view key;
+    if (!parse_json_key(p, end, key) || !field(key, p)) {
+      return false;
+    }
+    p = skip_json_space(p, end);
+    if (p >= end) {
+      return false;
+    }
+    if (*p == '}') {
+      p++;
+      return true;
+    }
+    if (*p != ',') {
+      return false;
+    }
+    p++;
+  }
+}
+
+static bool parse_json_vector(const char*& p, const char* end, double* values) {
+  return parse_json_object(p, end, [&](std::string_view key, const char*& value) {
+    if (key.size() == 1 && key[0] >= 'x' && key[0] <= 'z') {
+      return parse_json_number(value, end, values[key[0] - 'x']);
+    }
+    return skip_json_value(value, end);
+  });
+}
+
+// Ciało w układzie cpu-proj ("position", "velocity", "mass") albo GPU ("p", "v", "m"); pozycja i masa są wymagane
+static bool parse_json_body(const char*& p, const char* end, double values[PARTICLE_COLUMNS]) {
+  bool position = false, mass = false;
+  bool ok = parse_json_object(p, end, [&](std::string_view key, const char*& value) {
+    if (key == "position" || key == "p") return position = parse_json_vector(value, end, values + COL_X);
+    if (key == "velocity" || key == "v") return parse_json_vector(value, end, values + COL_VX);
+    if (key == "mass" || key == "m") return mass = parse_json_number(value, end, values[COL_MASS]);
+    return skip_json_value(value, end);
+  });
+  return ok && position && mass;
+}
+
+// Początek ostatniego klucza "bodies" - szukany od końca blokami po 16 MB; w bloku find() przeskakuje memchr
+// do rzadkiej w zapisie liczb litery 'b' zamiast porównywać każdy bajt jak rfind()
+static const char* find_last_bodies_key(const char* data, size_t size) {
+  const std::string_view key = "bodies\"";
+  const size_t BLOCK = size_t(1) << 24;
+  for (size_t hi = size; hi > 0;) {
+    const size_t lo = hi > BLOCK ? hi - BLOCK : 0;
+    const std::string_view block(data + lo, std::min(size, hi + key.size()) - lo);
+    const char* found = nullptr;
+    for (size_t k = block.find(key); k != std::string_view::npos && k < hi - lo; k = block.find(key, k + 1)) {
+      if (lo + k > 0 && data[lo + k - 1] == '"') found = data + lo + k - 1;
+    }
+    if (found) {
+      return found;
+    }
+    hi = lo;
+  }
+  return nullptr;
+}
+
+static bool load_json(const std::string& filename, const char* data, size_t size, Body& bodies, int& n,
+                      int chunks) {
+  const char* end = data + size;
+
+  // Tablica "bodies" ostatniej klatki - zapis snapshot (tablica klatek albo NDJSON) kończy się ostatnią klatką
+  const char* key = find_last_bodies_key(data, size);
+  const char* p = key ? skip_json_space(key + 8, end) : end;
+  if (p < end && *p == ':') {
+    p = skip_json_space(p + 1, end);
+  }
+  if (p >= end || *p != '[') {
+    std::cerr << "Błąd: " << filename << ": brak tablicy \"bodies\"" << std::endl;
+    return false;
+  }
+  const char* arrayBegin = p + 1;
+  // Ciała nie zawierają tablic, więc pierwszy ']' zamyka tablicę ciał
+  const char* arrayEnd = static_cast<const char*>(std::memchr(arrayBegin, ']', end - arrayBegin));
+  if (!arrayEnd) {
+    std::cerr << "Błąd: " << filename << ": niekompletna ostatnia klatka" << std::endl;
+    return false;
+  }
+
+  chunks = chunk_count(arrayEnd - arrayBegin, chunks);
+  const std::vector<const char*> bounds = split_chunks(
+      arrayBegin, arrayEnd, chunks, [&](const char* q) { return next_body(q, arrayBegin, arrayEnd); });
+
+  std::vector<size_t> counts(chunks, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < chunks; c++) {
+    size_t count = 0;
+    for (const char* q = next_body(bounds[c], arrayBegin, arrayEnd); q < bounds[c + 1];
+         q = next_body(q + 1, arrayBegin, arrayEnd)) {
+      count++;
+    }
+    counts[c] = count;
+  }
+  const std::vector<size_t> offsets = chunk_offsets(counts);
+  if (!resize_bodies(filename, bodies, n, offsets.back())) {
+    return false;
+  }
+
+  std::vector<const char*> errors(chunks, nullptr);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int c = 0; c < chunks; c++) {
+    size_t i = offsets[c];
+    for (const char* q = next_body(bounds[c], arrayBegin, arrayEnd); q < bounds[c + 1];
+         q = next_body(q, arrayBegin, arrayEnd)) {
+      const char* body = q;
+      double values[PARTICLE_COLUMNS] = {};
+      if (!parse_json_body(q, arrayEnd, values)) {
+        errors[c] = body;
+        break;
+      }
+      store_body(bodies, i++, values);
+    }
+  }
+  return report_error(filename, data, errors, "niepoprawny obiekt ciała (wymagane position/p i mass/m)");
+}
+
+// --- binarne ---
+
+static bool load_binary(const std::string& filename, const char* data, size_t size, Body& bodies, int& n) {
+  const size_t record = PARTICLE_COLUMNS * sizeof(double);
+  if (size % record != 0) {
+    std::cerr << "Błąd: " << filename << ": rozmiar pliku nie jest wielokrotnością " << record << " B" << std::endl;
+    return false;
+  }
+  if (!resize_bodies(filename, bodies, n, size / record)) {
+    return false;
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    double values[PARTICLE_COLUMNS];
+    std::memcpy(values, data + i * record, record);
+    store_body(bodies, i, values);
+  }
+  return true;
+}
+
+// Ostatnia klatka .nbt (TrajectoryReader dekoduje też pliki skompresowane); brakujące kolumny są zerami
+static bool load_trajectory(const std::string& filename, Body& bodies, int& n) {
+  TrajectoryReader reader(filename);
+  TrajectoryFrame frame;
+  if (reader.is_open() && reader.frame_count() > 0) {
+    frame = reader.frame(reader.frame_count() - 1);
+  }
+  if (!frame.header || !frame.columns[TRAJ_X] || !frame.columns[TRAJ_MASS]) {
+    std::cerr << "Błąd: nie można odczytać ostatniej klatki trajektorii " << filename << std::endl;
+    return false;
+  }
+  if (!resize_bodies(filename, bodies, n, reader.header().bodyCount)) {
+    return false;
+  }
+  static const int columns[PARTICLE_COLUMNS] = {TRAJ_X, TRAJ_Y, TRAJ_Z, TRAJ_VX, TRAJ_VY, TRAJ_VZ, TRAJ_MASS};
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    double values[PARTICLE_COLUMNS];
+    for (int c = 0; c < PARTICLE_COLUMNS; c++) {
+      values[c] = frame.columns[columns[c]] ? frame.value(columns[c], i) : 0.0;
+    }
+    store_body(bodies, i, values);
+  }
+  return true;
+}
+
+bool load_particles(const std::string& filename, Body& bodies, int& n, int chunks) {
+  const ParticleFormat format = particle_format_for(filename);
+  bool ok;
+  if (format == ParticleFormat::Trajectory) {
+    ok = load_trajectory(filename, bodies, n);
+  } else {
+    MappedFile file(filename);
+    if (!file.is_open()) {
+      std::cerr << "Błąd: nie można otworzyć pliku " << filename << std::endl;
+      return false;
+    }
+    if (format == ParticleFormat::Binary) {
+      ok = load_binary(filename, file.data(), file.size(), bodies, n);
+    } else if (format == ParticleFormat::Json) {
+      ok = load_json(filename, file.data(), file.size(), bodies, n, chunks);
+    } else {
+      ok = load_csv(filename, file.data(), file.size(), bodies, n, chunks);
+    }
+  }
+  if (ok && n == 0) {
+    std::cerr << "Błąd: plik " << filename << " nie zawiera ciał" << std::endl;
+    ok = false;
+  }
+  return ok;
+}
@@ -1,38 +1,104 @@
 #include "physics.h"
 
-void update_velocities(Body& bodies, int n, double dt) {
-#pragma omp parallel for schedule(dynamic, 64)
-  for (int i = 0; i < n; i++) {
-    double ax_i = 0.0, ay_i = 0.0, az_i = 0.0;
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void compute_accelerations(Body& bodies, int n) {
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  // Prywatne bufory przyspieszeń każdego wątku: wkład pary (i, j) do ciała j
+  // trafia do bufora wątku liczącego wiersz i, więc nie potrzeba operacji atomowych.
+  // Bufor żyje między krokami i tylko rośnie; Column nie zeruje nowych elementów, więc
+  // każdą stronę pierwszy dotyka wątek, który zeruje i wypełnia swój fragment (NUMA).
+  // Zespół może być mniejszy niż threads (OMP_DYNAMIC, limit wątków, wywołanie z regionu równoległego) -
+  // redukcja sumuje wtedy tylko bufory wątków, które faktycznie liczyły
+  static Column partial;
+  const size_t needed = 3 * (size_t)n * threads;
+  if (partial.size() < needed) {
+    Column().swap(partial);
+    partial.resize(needed);
+  }
+
+  int team = 1;
+#pragma omp parallel num_threads(threads)
+  {
+    int thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#pragma omp single
+    team = omp_get_num_threads();
+#endif
+    double* ax = partial.data() + 3 * (size_t)n * thread;
+    double* ay = ax + n;
+    double* az = ay + n;
+    std::fill(ax, ax + 3 * (size_t)n, 0.0);
+
+    // Stały cykliczny przydział wierszy (a nie dynamic): przy tej samej liczbie wątków każdy wiersz trafia
+    // do tego samego bufora, więc wynik jest powtarzalny bit w bit - wymaga tego wznowienie z punktu kontrolnego.
+    // Paczki po 64 wiersze na przemian między wątkami wyrównują obciążenie pętli trójkątnej
+#pragma omp for schedule(static, 64)
+    for (int i = 0; i < n; i++) {
+      double ax_i = 0.0, ay_i = 0.0, az_i = 0.0;
+
+      for (int j = i + 1; j < n; j++) {
+        double dx = bodies.x[j] - bodies.x[i];
+        double dy = bodies.y[j] - bodies.y[i];
+        double dz = bodies.z[j] - bodies.z[i];
+        double dist = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-9;
+        double s = G / (dist * dist * dist);
 
-    for (int j = i + 1; j < n; j++) {
-      double dx = bodies.x[j] - bodies.x[i];
-      double dy = bodies.y[j] - bodies.y[i];
-      double dz = bodies.z[j] - bodies.z[i];
-      double dist = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-9;
-      double F = G * bodies.mass[i] * bodies.mass[j] / (dist * dist);
+        // Siły są symetryczne: Fij = -Fji
+        ax_i += s * bodies.mass[j] * dx;
+        ay_i += s * bodies.mass[j] * dy;
+        az_i += s * bodies.mass[j] * dz;
 
-      double Fx = F * dx / dist;
-      double Fy = F * dy / dist;
-      double Fz = F * dz / dist;
+        ax[j] -= s * bodies.mass[i] * dx;
+        ay[j] -= s * bodies.mass[i] * dy;
+        az[j] -= s * bodies.mass[i] * dz;
+      }
 
-      // Siły są symetryczne: Fij = -Fji
-      ax_i += Fx / bodies.mass[i];
-      ay_i += Fy / bodies.mass[i];
-      az_i += Fz / bodies.mass[i];
+      ax[i] += ax_i;
+      ay[i] += ay_i;
+      az[i] += az_i;
+    }
 
-#pragma omp atomic
-      bodies.vx[j] -= dt * Fx / bodies.mass[j];
-#pragma omp atomic
-      bodies.vy[j] -= dt * Fy / bodies.mass[j];
-#pragma omp atomic
-      bodies.vz[j] -= dt * Fz / bodies.mass[j];
+    // Równoległa redukcja buforów: każdy wątek sumuje swój zakres ciał
+#pragma omp for schedule(static)
+    for (int i = 0; i < n; i++) {
+      double sx = 0.0, sy = 0.0, sz = 0.0;
+      for (int t = 0; t < team; t++) {
+        const double* p = partial.data() + 3 * (size_t)n * t;
+        sx += p[i];
+        sy += p[n + i];
+        sz += p[2 * n + i];
+      }
+      bodies.ax[i] = sx;
+      bodies.ay[i] = sy;
+      bodies.az[i] = sz;
     }
+  }
+}
+
+
+void update_velocities(Body& bodies, int n, double dt, Kernel kernel, SimdIsa isa, int tileSize) {
+  if (kernel == Kernel::Simd) {
+    compute_accelerations_simd(bodies, n, isa);
+  } else if (kernel == Kernel::Tiled) {
+    compute_accelerations_tiled(bodies, n, tileSize, isa);
+  } else {
+    compute_accelerations(bodies, n);
+  }
 
-    // Aktualizacja prędkości ciała i
-    bodies.vx[i] += dt * ax_i;
-    bodies.vy[i] += dt * ay_i;
-    bodies.vz[i] += dt * az_i;
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    bodies.vx[i] += dt * bodies.ax[i];
+    bodies.vy[i] += dt * bodies.ay[i];
+    bodies.vz[i] += dt * bodies.az[i];
   }
 }
 
@@ -45,48 +111,3 @@ void update_positions(Body& bodies, int n, double dt) {
     bodies.z[i] += bodies.vz[i] * dt;
   }
 }
-
-
-void save_state(const Body& bodies, int n, const std::string& filename, int step, bool append = true) {
-  json step_data;
-  step_data["step"] = step;
-  step_data["timestamp"] = std::chrono::system_clock::now().time_since_epoch().count();
-
-  json bodies_array = json::array();
-  for (int i = 0; i < n; i++) {
-    bodies_array.push_back(bodies.to_json(i));
-  }
-  step_data["bodies"] = bodies_array;
-
-  json jsonData;
-
-  if (append) {
-    std::ifstream inFile(filename);
-    if (inFile.is_open()) {
-      try {
-        inFile >> jsonData;
-        inFile.close();
-      } catch (const json::parse_error& e) {
-        // empty or invalid
-        jsonData = json::array();
-      }
-    } else {
-      // not found
-      jsonData = json::array();
-    }
-  } else {
-    // overwrite
-    jsonData = json::array();
-  }
-
-  jsonData.push_back(step_data);
-
-  std::ofstream outFile(filename);
-  if (!outFile.is_open()) {
-    std::cerr << "Błąd: Nie można otworzyć pliku do zapisu: " << filename << std::endl;
-    return;
-  }
-  
-  outFile << jsonData.dump(2);
-  outFile.close();
-}
\ No newline at end of file
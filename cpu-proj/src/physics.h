@@ -4,25 +4,54 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <vector>
 
 using json = nlohmann::json;
 #define G 6.67430e-11 
 
+// Alokator bez zerowania nowych elementów w std::vector::resize - zeruje je dopiero Body::resize, równolegle
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+  template <typename U>
+  struct rebind {
+    using other = DefaultInitAllocator<U>;
+  };
+  DefaultInitAllocator() = default;
+  template <typename U>
+  DefaultInitAllocator(const DefaultInitAllocator<U> &) noexcept {}
+
+  template <typename U>
+  void construct(U *p) noexcept {
+    ::new (static_cast<void *>(p)) U;
+  }
+  template <typename U, typename... Args>
+  void construct(U *p, Args &&...args) {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+using Column = std::vector<double, DefaultInitAllocator<double>>;
+
 struct Body {
-  std::vector<double> x, y, z;
-  std::vector<double> vx, vy, vz;
-  std::vector<double> mass;
+  Column x, y, z;
+  Column vx, vy, vz;
+  Column ax, ay, az;
+  Column mass;
 
+  // Nowe elementy zerowane są równolegle z podziałem schedule(static) jak w pętlach kroków, więc przy pierwszym
+  // dotknięciu strony pamięci trafiają do węzła NUMA wątku, który będzie je liczył
   void resize(int n) {
-    x.resize(n);
-    y.resize(n);
-    z.resize(n);
-    vx.resize(n);
-    vy.resize(n);
-    vz.resize(n);
-    mass.resize(n);
+    for (Column *column : {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass}) {
+      const int old = (int)column->size();
+      column->resize(n);
+      double *data = column->data();
+#pragma omp parallel for schedule(static) if (n - old > 65536)
+      for (int i = old; i < n; i++) {
+        data[i] = 0.0;
+      }
+    }
   }
 
   json to_json(int i) const {
@@ -33,6 +62,27 @@ struct Body {
   }
 };
 
-void update_velocities(Body &body, int param, double dt);
+// Kernel sił: symetryczny (i < j, wygładzenie +1e-9 odległości), wektorowy (wszystkie pary, r^2 + 0.01)
+// albo wektorowy z kaflami źródeł dopasowanymi do pamięci podręcznej
+enum class Kernel { Symmetric, Simd, Tiled };
+
+// Zestawy instrukcji kernela wektorowego, od najsłabszego
+enum class SimdIsa { Scalar, Sse2, Avx2, Avx512 };
+
+// Najlepszy zestaw instrukcji dostępny na tym procesorze
+SimdIsa detect_simd_isa();
+const char *simd_isa_name(SimdIsa isa);
+
+// Liczy przyspieszenia wszystkich ciał do body.ax/ay/az (bez zmiany prędkości)
+// Kernel symetryczny trzyma bufory wątków między wywołaniami - nie wywoływać go równolegle z kilku wątków
+void compute_accelerations(Body &body, int param);
+void compute_accelerations_simd(Body &body, int param, SimdIsa isa = detect_simd_isa());
+// Rozmiar kafla źródeł (liczba ciał) dobrany do rozmiaru L1
+int default_tile_size();
+// tileSize <= 0 - rozmiar z default_tile_size()
+void compute_accelerations_tiled(Body &body, int param, int tileSize = 0, SimdIsa isa = detect_simd_isa());
+// isa i tileSize - dla kerneli simd i tiled (ustalane jawnie przy wznowieniu z punktu kontrolnego)
+void update_velocities(Body &body, int param, double dt, Kernel kernel = Kernel::Symmetric,
+                       SimdIsa isa = detect_simd_isa(), int tileSize = 0);
 void update_positions(Body &body, int param, double dt);
-void save_state(const Body &body, int param, const std::string &filename, int mode, bool append);
\ No newline at end of file
+void save_state(const Body &body, int param, const std::string &filename, int mode, bool append = true);
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "physics.h"
+
+#include <algorithm>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define NBODY_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Wygładzenie jak w GPU_2_pair: r^2 + 0.01, więc para i == i daje zerowy wkład bez rozgałęzienia
+#define SOFTENING2 0.01
+
+namespace {
+
+// Dodaje do a przyspieszenie ciała i od ciał [from, to) - pętla skalarna (fallback i końcówki pętli wektorowych)
+void accel_tail(const Body& b, int from, int to, int i, double a[3]) {
+  for (int j = from; j < to; j++) {
+    double dx = b.x[j] - b.x[i];
+    double dy = b.y[j] - b.y[i];
+    double dz = b.z[j] - b.z[i];
+    double r2 = dx * dx + dy * dy + dz * dz + SOFTENING2;
+    double rinv = 1.0 / std::sqrt(r2);
+    double s = G * b.mass[j] * rinv * rinv * rinv;
+    a[0] += s * dx;
+    a[1] += s * dy;
+    a[2] += s * dz;
+  }
+}
+
+void accel_row_scalar(const Body& b, int from, int to, int i, double a[3]) { accel_tail(b, from, to, i, a); }
+
+#ifdef NBODY_X86_SIMD
+
+// rsqrt w pojedynczej precyzji (12 bitów) + dwa kroki Newtona: y = y * (1.5 - 0.5 * r2 * y^2)
+inline __m128d rsqrt_sse2(__m128d r2) {
+  __m128d y = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(r2)));
+  const __m128d half = _mm_set1_pd(0.5), threeHalves = _mm_set1_pd(1.5);
+  const __m128d h = _mm_mul_pd(half, r2);
+  y = _mm_mul_pd(y, _mm_sub_pd(threeHalves, _mm_mul_pd(h, _mm_mul_pd(y, y))));
+  y = _mm_mul_pd(y, _mm_sub_pd(threeHalves, _mm_mul_pd(h, _mm_mul_pd(y, y))));
+  return y;
+}
+
+inline double hsum_sse2(__m128d v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+
+void accel_row_sse2(const Body& b, int from, int to, int i, double a[3]) {
+  const __m128d xi = _mm_set1_pd(b.x[i]), yi = _mm_set1_pd(b.y[i]), zi = _mm_set1_pd(b.z[i]);
+  const __m128d eps2 = _mm_set1_pd(SOFTENING2), g = _mm_set1_pd(G);
+  __m128d ax = _mm_setzero_pd(), ay = _mm_setzero_pd(), az = _mm_setzero_pd();
+
+  int j = from;
+  for (; j + 2 <= to; j += 2) {
+    __m128d dx = _mm_sub_pd(_mm_loadu_pd(&b.x[j]), xi);
+    __m128d dy = _mm_sub_pd(_mm_loadu_pd(&b.y[j]), yi);
+    __m128d dz = _mm_sub_pd(_mm_loadu_pd(&b.z[j]), zi);
+    __m128d r2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_add_pd(_mm_mul_pd(dz, dz), eps2));
+    __m128d rinv = rsqrt_sse2(r2);
+    __m128d s = _mm_mul_pd(_mm_mul_pd(g, _mm_loadu_pd(&b.mass[j])), _mm_mul_pd(rinv, _mm_mul_pd(rinv, rinv)));
+    ax = _mm_add_pd(ax, _mm_mul_pd(s, dx));
+    ay = _mm_add_pd(ay, _mm_mul_pd(s, dy));
+    az = _mm_add_pd(az, _mm_mul_pd(s, dz));
+  }
+
+  a[0] += hsum_sse2(ax);
+  a[1] += hsum_sse2(ay);
+  a[2] += hsum_sse2(az);
+  accel_tail(b, j, to, i, a);
+}
+
+__attribute__((target("avx2,fma"))) inline __m256d rsqrt_avx2(__m256d r2) {
+  __m256d y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+  const __m256d threeHalves = _mm256_set1_pd(1.5);
+  const __m256d h = _mm256_mul_pd(_mm256_set1_pd(0.5), r2);
+  y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), threeHalves));
+  y = _mm256_mul_pd(y, _mm256_fnmadd_pd(h, _mm256_mul_pd(y, y), threeHalves));
+  return y;
+}
+
+__attribute__((target("avx2,fma"))) inline double hsum_avx2(__m256d v) {
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2,fma"))) void accel_row_avx2(const Body& b, int from, int to, int i, double a[3]) {
+  const __m256d xi = _mm256_set1_pd(b.x[i]), yi = _mm256_set1_pd(b.y[i]), zi = _mm256_set1_pd(b.z[i]);
+  const __m256d eps2 = _mm256_set1_pd(SOFTENING2), g = _mm256_set1_pd(G);
+  __m256d ax = _mm256_setzero_pd(), ay = _mm256_setzero_pd(), az = _mm256_setzero_pd();
+
+  int j = from;
+  for (; j + 4 <= to; j += 4) {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&b.x[j]), xi);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&b.y[j]), yi);
+    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(&b.z[j]), zi);
+    __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, eps2)));
+    __m256d rinv = rsqrt_avx2(r2);
+    __m256d s = _mm256_mul_pd(_mm256_mul_pd(g, _mm256_loadu_pd(&b.mass[j])), _mm256_mul_pd(rinv, _mm256_mul_pd(rinv, rinv)));
+    ax = _mm256_fmadd_pd(s, dx, ax);
+    ay = _mm256_fmadd_pd(s, dy, ay);
+    az = _mm256_fmadd_pd(s, dz, az);
+  }
+
+  a[0] += hsum_avx2(ax);
+  a[1] += hsum_avx2(ay);
+  a[2] += hsum_avx2(az);
+  accel_tail(b, j, to, i, a);
+}
+
+// Nagłówki AVX-512 w GCC 12 ostrzegają o _mm512_undefined_pd użytym wewnątrz rsqrt14/reduce_add
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// rsqrt14 daje 14 bitów, więc po dwóch krokach Newtona wynik ma pełną precyzję double
+__attribute__((target("avx512f"))) inline __m512d rsqrt_avx512(__m512d r2) {
+  __m512d y = _mm512_rsqrt14_pd(r2);
+  const __m512d threeHalves = _mm512_set1_pd(1.5);
+  const __m512d h = _mm512_mul_pd(_mm512_set1_pd(0.5), r2);
+  y = _mm512_mul_pd(y, _mm512_fnmadd_pd(h, _mm512_mul_pd(y, y), threeHalves));
+  y = _mm512_mul_pd(y, _mm512_fnmadd_pd(h, _mm512_mul_pd(y, y), threeHalves));
+  return y;
+}
+
+__attribute__((target("avx512f"))) void accel_row_avx512(const Body& b, int from, int to, int i, double a[3]) {
+  const __m512d xi = _mm512_set1_pd(b.x[i]), yi = _mm512_set1_pd(b.y[i]), zi = _mm512_set1_pd(b.z[i]);
+  const __m512d eps2 = _mm512_set1_pd(SOFTENING2), g = _mm512_set1_pd(G);
+  __m512d ax = _mm512_setzero_pd(), ay = _mm512_setzero_pd(), az = _mm512_setzero_pd();
+
+  int j = from;
+  for (; j + 8 <= to; j += 8) {
+    __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(&b.x[j]), xi);
+    __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(&b.y[j]), yi);
+    __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(&b.z[j]), zi);
+    __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, eps2)));
+    __m512d rinv = rsqrt_avx512(r2);
+    __m512d s = _mm512_mul_pd(_mm512_mul_pd(g, _mm512_loadu_pd(&b.mass[j])), _mm512_mul_pd(rinv, _mm512_mul_pd(rinv, rinv)));
+    ax = _mm512_fmadd_pd(s, dx, ax);
+    ay = _mm512_fmadd_pd(s, dy, ay);
+    az = _mm512_fmadd_pd(s, dz, az);
+  }
+
+  a[0] += _mm512_reduce_add_pd(ax);
+  a[1] += _mm512_reduce_add_pd(ay);
+  a[2] += _mm512_reduce_add_pd(az);
+  accel_tail(b, j, to, i, a);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+using RowKernel = void (*)(const Body&, int, int, int, double[3]);
+
+RowKernel row_kernel(SimdIsa isa) {
+  switch (isa) {
+#ifdef NBODY_X86_SIMD
+    case SimdIsa::Avx512:
+      return accel_row_avx512;
+    case SimdIsa::Avx2:
+      return accel_row_avx2;
+    case SimdIsa::Sse2:
+      return accel_row_sse2;
+#endif
+    default:
+      return accel_row_scalar;
+  }
+}
+
+}  // namespace
+
+SimdIsa detect_simd_isa() {
+  // Wybór raz, przy pierwszym wywołaniu (start programu)
+  static const SimdIsa isa = [] {
+#ifdef NBODY_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdIsa::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdIsa::Avx2;
+    return SimdIsa::Sse2;
+#else
+    return SimdIsa::Scalar;
+#endif
+  }();
+  return isa;
+}
+
+const char* simd_isa_name(SimdIsa isa) {
+  switch (isa) {
+    case SimdIsa::Avx512:
+      return "avx512";
+    case SimdIsa::Avx2:
+      return "avx2";
+    case SimdIsa::Sse2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+void compute_accelerations_simd(Body& bodies, int n, SimdIsa isa) {
+  RowKernel row = row_kernel(isa);
+
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < n; i++) {
+    double a[3] = {0.0, 0.0, 0.0};
+    row(bodies, 0, n, i, a);
+    bodies.ax[i] = a[0];
+    bodies.ay[i] = a[1];
+    bodies.az[i] = a[2];
+  }
+}
+
+int default_tile_size() {
+  // Kafel źródeł zajmuje połowę L1 (x, y, z, masa = 32 bajty na ciało). Kafle wielkości L2 wypadały
+  // wolniej - przy 64 celach na blok kafel i tak jest czytany wielokrotnie, więc liczy się opóźnienie L1
+  long cacheBytes = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  cacheBytes = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+  if (cacheBytes <= 0) {
+    cacheBytes = 32 * 1024;
+  }
+  int tile = (int)(cacheBytes / 2 / (4 * sizeof(double)));
+  return std::max(256, tile - tile % 64);
+}
+
+void compute_accelerations_tiled(Body& bodies, int n, int tileSize, SimdIsa isa) {
+  RowKernel row = row_kernel(isa);
+  if (tileSize <= 0) {
+    tileSize = default_tile_size();
+  }
+
+  // Jak w kernelu GPU z pamięcią współdzieloną: blok celów przechodzi po kolejnych kaflach źródeł,
+  // więc każdy kafel jest czytany z pamięci raz na TARGET_BLOCK celów, a nie raz na cel
+  const int TARGET_BLOCK = 64;
+  const int blocks = (n + TARGET_BLOCK - 1) / TARGET_BLOCK;
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int block = 0; block < blocks; block++) {
+    const int first = block * TARGET_BLOCK;
+    const int last = std::min(first + TARGET_BLOCK, n);
+    double acc[TARGET_BLOCK][3] = {};
+
+    for (int from = 0; from < n; from += tileSize) {
+      const int to = std::min(from + tileSize, n);
+      for (int i = first; i < last; i++) {
+        row(bodies, from, to, i, acc[i - first]);
+      }
+    }
+
+    for (int i = first; i < last; i++) {
+      bodies.ax[i] = acc[i - first][0];
+      bodies.ay[i] = acc[i - first][1];
+      bodies.az[i] = acc[i - first][2];
+    }
+  }
+}
@@ -0,0 +1,357 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+void append_vector(std::string& out, const char* name, double x, double y, double z) {
+  out += '"';
+  out += name;
+  out += "\":{\"x\":";
+  append_json_number(out, x);
+  out += ",\"y\":";
+  append_json_number(out, y);
+  out += ",\"z\":";
+  append_json_number(out, z);
+  out += '}';
+}
+
+// Szuka końcowego ']' tablicy JSON w pliku. Zwraca jego pozycję albo -1, gdy plik nie istnieje
+// lub nie kończy się tablicą (wtedy zapis zaczyna się od nowa, jak przy błędzie parsowania).
+long find_array_end(const std::string& filename, bool& nonEmpty) {
+  std::FILE* in = std::fopen(filename.c_str(), "rb");
+  if (!in) {
+    return -1;
+  }
+  std::fseek(in, 0, SEEK_END);
+  long size = std::ftell(in);
+  long tail = std::min(size, 4096L);
+  std::string buffer(tail, '\0');
+  std::fseek(in, size - tail, SEEK_SET);
+  size_t read = std::fread(&buffer[0], 1, tail, in);
+  std::fclose(in);
+  if ((long)read != tail) {
+    return -1;
+  }
+
+  long i = tail - 1;
+  while (i >= 0 && std::isspace((unsigned char)buffer[i])) i--;
+  if (i < 0 || buffer[i] != ']') {
+    return -1;
+  }
+  long bracket = i--;
+  while (i >= 0 && std::isspace((unsigned char)buffer[i])) i--;
+  if (i < 0) {
+    return -1;
+  }
+  nonEmpty = buffer[i] != '[';
+  return size - tail + bracket;
+}
+
+// Szuka od końca pliku klatek zapisanych przez append_frame ({"step": na początku linii) o kroku większym
+// niż appendAfter. Kroki rosną, więc przeszukiwanie kończy się na pierwszej wcześniejszej klatce. Zwraca
+// pozycję '{' najwcześniejszej z późniejszych klatek albo -1, gdy takich klatek nie ma.
+long find_frames_after(const std::string& filename, int64_t appendAfter) {
+  std::FILE* in = std::fopen(filename.c_str(), "rb");
+  if (!in) {
+    return -1;
+  }
+  static const char marker[] = "{\"step\":";
+  const long markerLength = sizeof(marker) - 1;
+  const long block = 1L << 16;
+  std::fseek(in, 0, SEEK_END);
+  const long size = std::ftell(in);
+
+  // Bloki czytane od końca; zakład z sąsiednim blokiem obejmuje znacznik z numerem kroku i poprzedni znak
+  long cut = -1;
+  std::string buffer;
+  for (long end = size; end > 0;) {
+    const long from = std::max(end - block, 0L);
+    const long first = std::max(from - 1, 0L);
+    const long last = std::min(end + markerLength + 24, size);
+    buffer.resize(last - first);
+    std::fseek(in, first, SEEK_SET);
+    if (std::fread(&buffer[0], 1, buffer.size(), in) != buffer.size()) {
+      break;
+    }
+    // znaczniki zaczynające się w [from, end), od ostatniego
+    size_t limit = end - first;
+    while (limit > (size_t)(from - first)) {
+      const size_t found = buffer.rfind(marker, limit - 1);
+      if (found == std::string::npos || found < (size_t)(from - first)) {
+        break;
+      }
+      limit = found;
+      const long position = first + (long)found;
+      if (position > 0 && buffer[found - 1] != '\n') {
+        continue;
+      }
+      int64_t step = 0;
+      const char* number = buffer.data() + found + markerLength;
+      if (std::from_chars(number, buffer.data() + buffer.size(), step).ec != std::errc()) {
+        continue;
+      }
+      if (step <= appendAfter) {
+        std::fclose(in);
+        return cut;
+      }
+      cut = position;
+    }
+    end = from;
+  }
+  std::fclose(in);
+  return cut;
+}
+
+}  // namespace
+
+void append_json_number(std::string& out, double value) {
+  if (!std::isfinite(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+  // Liczby całkowite z ".0", żeby czytniki JSON widziały je jako zmiennoprzecinkowe
+  if (std::find_if(buffer, end, [](char c) { return c == '.' || c == 'e'; }) == end) {
+    *end++ = '.';
+    *end++ = '0';
+  }
+  out.append(buffer, end);
+}
+
+SnapshotFormat snapshot_format_for(const std::string& filename) {
+  auto endsWith = [&](const char* suffix) {
+    size_t length = std::strlen(suffix);
+    return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+  };
+  if (endsWith(".nbt")) return SnapshotFormat::Binary;
+  return endsWith(".ndjson") || endsWith(".jsonl") ? SnapshotFormat::Ndjson : SnapshotFormat::JsonArray;
+}
+
+void append_frame(std::string& out, const Body& bodies, int n, int step, long long timestamp) {
+  out += "{\"step\":";
+  out += std::to_string(step);
+  out += ",\"timestamp\":";
+  out += std::to_string(timestamp);
+  out += ",\"bodies\":[";
+  for (int i = 0; i < n; i++) {
+    if (i > 0) out += ',';
+    out += '{';
+    append_vector(out, "position", bodies.x[i], bodies.y[i], bodies.z[i]);
+    out += ',';
+    append_vector(out, "velocity", bodies.vx[i], bodies.vy[i], bodies.vz[i]);
+    out += ",\"mass\":";
+    append_json_number(out, bodies.mass[i]);
+    out += '}';
+  }
+  out += "]}";
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& filename, SnapshotFormat format, bool append, double dt,
+                               const TrajectoryCompression& compression, int64_t appendAfter)
+    : format(format), filename(filename), append(append), dt(dt), compression(compression), appendAfter(appendAfter) {
+  // Klatki po appendAfter zostały zapisane przez przerwany przebieg po jego punkcie kontrolnym - wznowiony przebieg
+  // zapisze je ponownie, więc są odcinane przed dopisywaniem
+  long cut = -1;
+  if (append && appendAfter != INT64_MAX && format != SnapshotFormat::Binary) {
+    cut = find_frames_after(filename, appendAfter);
+  }
+  std::error_code error;
+  if (format == SnapshotFormat::Binary) {
+    return;
+  } else if (format == SnapshotFormat::Ndjson) {
+    if (cut >= 0) {
+      std::filesystem::resize_file(filename, cut, error);
+    }
+    file = error ? nullptr : std::fopen(filename.c_str(), append ? "ab" : "wb");
+  } else {
+    long end = -1;
+    if (cut >= 2) {
+      // Przed klatką jest ",\n" (wtedy zostaje wcześniejsza klatka) albo "[\n"
+      char separator = 0;
+      if (std::FILE* in = std::fopen(filename.c_str(), "rb")) {
+        std::fseek(in, cut - 2, SEEK_SET);
+        separator = (char)std::fgetc(in);
+        std::fclose(in);
+      }
+      end = separator == ',' ? cut - 2 : cut - 1;
+      hasFrames = separator == ',';
+      std::filesystem::resize_file(filename, end, error);
+    } else if (append) {
+      end = find_array_end(filename, hasFrames);
+    }
+    if (error) {
+      // nieudane odcięcie - plik zostaje bez zmian, zapis nie rusza
+    } else if (end >= 0) {
+      file = std::fopen(filename.c_str(), "r+b");
+      if (file) std::fseek(file, end, SEEK_SET);
+    } else {
+      hasFrames = false;
+      file = std::fopen(filename.c_str(), "wb");
+      if (file) std::fputc('[', file);
+    }
+    if (file) {
+      std::fputs("\n]", file);
+      std::fflush(file);
+      std::fseek(file, -2, SEEK_CUR);
+    }
+  }
+
+  if (!file) {
+    std::cerr << "Błąd: Nie można otworzyć pliku do zapisu: " << filename << std::endl;
+  }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  if (file) std::fclose(file);
+}
+
+void SnapshotWriter::write(const Body& bodies, int n, int step) {
+  write(bodies, n, step, std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+void SnapshotWriter::write(const Body& bodies, int n, int step, long long timestamp) {
+  if (format == SnapshotFormat::Binary) {
+    if (!trajectory) {
+      trajectory = std::make_unique<TrajectoryWriter>(filename, n, dt, TRAJ_ALL_FIELDS, false, append,
+                                                      TRAJECTORY_DEFAULT_UNITS, compression, appendAfter);
+    }
+    trajectory->write(bodies, step, step * dt, timestamp);
+    return;
+  }
+  if (!file) {
+    return;
+  }
+
+  buffer.clear();
+  if (format == SnapshotFormat::JsonArray) {
+    buffer += hasFrames ? ",\n" : "\n";
+  }
+  append_frame(buffer, bodies, n, step, timestamp);
+  buffer += format == SnapshotFormat::JsonArray ? "\n]" : "\n";
+
+  std::fwrite(buffer.data(), 1, buffer.size(), file);
+  std::fflush(file);
+  if (format == SnapshotFormat::JsonArray) {
+    std::fseek(file, -2, SEEK_CUR);
+  }
+  hasFrames = true;
+}
+
+void save_state(const Body& bodies, int n, const std::string& filename, int step, bool append) {
+  SnapshotWriter writer(filename, snapshot_format_for(filename), append);
+  writer.write(bodies, n, step);
+}
+
+namespace {
+
+void copy_column(Column& to, const Column& from, int n) {
+  to.assign(from.begin(), from.begin() + n);
+}
+
+}  // namespace
+
+AsyncSnapshotWriter::AsyncSnapshotWriter(const std::string& filename, SnapshotFormat format, bool append, double dt,
+                                         Backpressure backpressure, int bufferCount,
+                                         const TrajectoryCompression& compression, int64_t appendAfter)
+    : writer(filename, format, append, dt, compression, appendAfter),
+      backpressure(backpressure),
+      frames(std::max(bufferCount, 1)) {
+  for (Frame& frame : frames) {
+    freeFrames.push_back(&frame);
+  }
+  thread = std::thread(&AsyncSnapshotWriter::run, this);
+}
+
+AsyncSnapshotWriter::~AsyncSnapshotWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  frameReady.notify_one();
+  thread.join();
+}
+
+bool AsyncSnapshotWriter::write(const Body& bodies, int n, int step) {
+  long long timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+  auto waitStart = std::chrono::steady_clock::now();
+  Frame* frame;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (freeFrames.empty() && backpressure == Backpressure::Drop) {
+      counters.framesDropped++;
+      return false;
+    }
+    frameFree.wait(lock, [&] { return !freeFrames.empty(); });
+    frame = freeFrames.front();
+    freeFrames.pop_front();
+  }
+  auto copyStart = std::chrono::steady_clock::now();
+
+  // Bufor po pierwszym użyciu ma już pojemność n, więc kopiowanie nie alokuje pamięci
+  Body& copy = frame->bodies;
+  copy_column(copy.x, bodies.x, n);
+  copy_column(copy.y, bodies.y, n);
+  copy_column(copy.z, bodies.z, n);
+  copy_column(copy.vx, bodies.vx, n);
+  copy_column(copy.vy, bodies.vy, n);
+  copy_column(copy.vz, bodies.vz, n);
+  copy_column(copy.ax, bodies.ax, n);
+  copy_column(copy.ay, bodies.ay, n);
+  copy_column(copy.az, bodies.az, n);
+  copy_column(copy.mass, bodies.mass, n);
+  frame->n = n;
+  frame->step = step;
+  frame->timestamp = timestamp;
+  auto copyEnd = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    readyFrames.push_back(frame);
+    counters.waitSeconds += std::chrono::duration<double>(copyStart - waitStart).count();
+    counters.copySeconds += std::chrono::duration<double>(copyEnd - copyStart).count();
+  }
+  frameReady.notify_one();
+  return true;
+}
+
+void AsyncSnapshotWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  frameFree.wait(lock, [&] { return readyFrames.empty() && writing == 0; });
+}
+
+SnapshotStats AsyncSnapshotWriter::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+void AsyncSnapshotWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    frameReady.wait(lock, [&] { return stopping || !readyFrames.empty(); });
+    if (readyFrames.empty()) {
+      return;
+    }
+    Frame* frame = readyFrames.front();
+    readyFrames.pop_front();
+    writing++;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    writer.write(frame->bodies, frame->n, frame->step, frame->timestamp);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    writing--;
+    counters.framesWritten++;
+    counters.writeSeconds += seconds;
+    freeFrames.push_back(frame);
+    frameFree.notify_all();
+  }
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "physics.h"
+#include "trajectory.h"
+
+// JsonArray - zamknięta tablica JSON (zgodna z dotychczasowymi odbiorcami),
+// Ndjson - jedna klatka na linię, Binary - kolumnowy format trajektorii (trajectory.h)
+enum class SnapshotFormat { JsonArray, Ndjson, Binary };
+
+// Pliki .ndjson i .jsonl zapisywane są jako NDJSON, .nbt jako trajektoria binarna, pozostałe jako tablica JSON
+SnapshotFormat snapshot_format_for(const std::string &filename);
+
+// Najkrótszy zapis liczby, który wczytuje się z powrotem do tej samej wartości (jak dump() w nlohmann::json)
+void append_json_number(std::string &out, double value);
+
+// Dopisuje do out jedną klatkę {"step", "timestamp", "bodies"} bez budowania drzewa nlohmann::json
+void append_frame(std::string &out, const Body &bodies, int n, int step, long long timestamp);
+
+// Strumieniowy zapis klatek: każda klatka kosztuje O(rozmiar klatki), bez ponownego czytania pliku.
+// W formacie JsonArray plik po każdej klatce kończy się "\n]", więc zawsze jest poprawnym JSON-em -
+// kolejna klatka nadpisuje te dwa znaki.
+class SnapshotWriter {
+ public:
+  // append - dopisywanie do istniejącego pliku (także zapisanego przez starą wersję save_state);
+  // dt - krok czasowy zapisywany w nagłówku trajektorii binarnej (czas klatki = step * dt);
+  // compression - kodek klatek trajektorii binarnej (formaty JSON go ignorują);
+  // appendAfter - przy dopisywaniu odcinane są klatki o kroku większym (wznowienie z punktu kontrolnego)
+  SnapshotWriter(const std::string &filename, SnapshotFormat format, bool append = false, double dt = 0.0,
+                 const TrajectoryCompression &compression = TrajectoryCompression(),
+                 int64_t appendAfter = INT64_MAX);
+  ~SnapshotWriter();
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  // Trajektoria binarna otwierana jest przy pierwszej klatce (nagłówek potrzebuje liczby ciał)
+  bool is_open() const {
+    return format == SnapshotFormat::Binary ? !trajectory || trajectory->is_open() : file != nullptr;
+  }
+  void write(const Body &bodies, int n, int step);
+  // timestamp - chwila zrzutu stanu (dla zapisu w tle różna od chwili zapisu)
+  void write(const Body &bodies, int n, int step, long long timestamp);
+
+ private:
+  std::FILE *file = nullptr;
+  SnapshotFormat format;
+  bool hasFrames = false;
+  std::string buffer;
+  std::string filename;
+  bool append;
+  double dt;
+  TrajectoryCompression compression;
+  int64_t appendAfter;
+  std::unique_ptr<TrajectoryWriter> trajectory;
+};
+
+// Co robić, gdy wszystkie bufory czekają na zapis: Block - pętla kroków czeka na wolny bufor,
+// Drop - klatka jest pomijana (liczona w SnapshotStats::framesDropped)
+enum class Backpressure { Block, Drop };
+
+struct SnapshotStats {
+  size_t framesWritten = 0;
+  size_t framesDropped = 0;
+  double waitSeconds = 0.0;   // czas pętli kroków spędzony na czekaniu na wolny bufor
+  double copySeconds = 0.0;   // czas kopiowania stanu do bufora
+  double writeSeconds = 0.0;  // czas serializacji i zapisu w wątku wejścia-wyjścia
+};
+
+// Zapis klatek w osobnym wątku. write() kopiuje stan do wolnego bufora z puli `bufferCount` buforów
+// (domyślnie dwa - podwójne buforowanie) i od razu wraca; wątek wejścia-wyjścia serializuje klatki
+// przez SnapshotWriter w kolejności zgłoszenia, równolegle z kolejnymi krokami symulacji.
+class AsyncSnapshotWriter {
+ public:
+  AsyncSnapshotWriter(const std::string &filename, SnapshotFormat format, bool append = false, double dt = 0.0,
+                      Backpressure backpressure = Backpressure::Block, int bufferCount = 2,
+                      const TrajectoryCompression &compression = TrajectoryCompression(),
+                      int64_t appendAfter = INT64_MAX);
+  // zapisuje klatki oczekujące w kolejce
+  ~AsyncSnapshotWriter();
+
+  AsyncSnapshotWriter(const AsyncSnapshotWriter &) = delete;
+  AsyncSnapshotWriter &operator=(const AsyncSnapshotWriter &) = delete;
+
+  bool is_open() const { return writer.is_open(); }
+  // Zwraca false, gdy klatka została pominięta (Backpressure::Drop)
+  bool write(const Body &bodies, int n, int step);
+  // Czeka, aż wszystkie zgłoszone klatki trafią do pliku
+  void flush();
+  SnapshotStats stats() const;
+
+ private:
+  struct Frame {
+    Body bodies;
+    int n = 0;
+    int step = 0;
+    long long timestamp = 0;
+  };
+
+  void run();
+
+  SnapshotWriter writer;
+  Backpressure backpressure;
+  std::vector<Frame> frames;
+  std::deque<Frame *> freeFrames;
+  std::deque<Frame *> readyFrames;
+  size_t writing = 0;
+  bool stopping = false;
+  SnapshotStats counters;
+  mutable std::mutex mutex;
+  std::condition_variable frameFree;
+  std::condition_variable frameReady;
+  std::thread thread;
+};
@@ -0,0 +1,776 @@
+#include "trajectory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "snapshot.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRAJECTORY_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool trajectory_has_column(uint32_t fields, int column) {
+  static const uint32_t group[TRAJ_COLUMNS] = {TRAJ_POSITIONS,     TRAJ_POSITIONS,     TRAJ_POSITIONS, TRAJ_VELOCITIES,
+                                               TRAJ_VELOCITIES,    TRAJ_VELOCITIES,    TRAJ_ACCELERATIONS,
+                                               TRAJ_ACCELERATIONS, TRAJ_ACCELERATIONS, TRAJ_MASSES};
+  return (fields & group[column]) != 0;
+}
+
+uint64_t trajectory_frame_bytes(const TrajectoryFileHeader& header) {
+  uint64_t columns = 0;
+  for (int c = 0; c < TRAJ_COLUMNS; c++) {
+    if (trajectory_has_column(header.fields, c)) columns++;
+  }
+  uint64_t bytes = columns * header.bodyCount * header.scalarBytes;
+  return sizeof(TrajectoryFrameHeader) + (bytes + 7) / 8 * 8;
+}
+
+const char* trajectory_codec_name(uint32_t codec) {
+  switch (codec) {
+    case TRAJ_CODEC_XOR:
+      return "xor";
+    case TRAJ_CODEC_QUANTIZE:
+      return "quantize";
+    default:
+      return "none";
+  }
+}
+
+bool parse_trajectory_codec(const std::string& name, TrajectoryCodec& codec) {
+  if (name == "none") {
+    codec = TRAJ_CODEC_NONE;
+  } else if (name == "xor") {
+    codec = TRAJ_CODEC_XOR;
+  } else if (name == "quantize") {
+    codec = TRAJ_CODEC_QUANTIZE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+enum ColumnCodec : unsigned char { COLUMN_XOR = 0, COLUMN_QUANTIZED = 1 };
+
+uint64_t value_bits(double value, bool singlePrecision) {
+  if (singlePrecision) {
+    float single = (float)value;
+    uint32_t bits;
+    std::memcpy(&bits, &single, sizeof(bits));
+    return bits;
+  }
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double bits_value(uint64_t bits, bool singlePrecision) {
+  if (singlePrecision) {
+    uint32_t low = (uint32_t)bits;
+    float single;
+    std::memcpy(&single, &low, sizeof(single));
+    return single;
+  }
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Ten sam wzór w koderze i dekoderze, więc obie strony odtwarzają identyczne wartości
+double dequantize(double prediction, int64_t q, double step) { return prediction + (double)q * step; }
+
+int significant_bytes(uint64_t x) {
+#if defined(__GNUC__)
+  return x ? (71 - __builtin_clzll(x)) / 8 : 0;
+#else
+  int bytes = 0;
+  while (x) {
+    x >>= 8;
+    bytes++;
+  }
+  return bytes;
+#endif
+}
+
+// Kolumna XOR. reconstructed - na wejściu poprzednia klatka (poza klatką kluczową), na wyjściu bieżąca
+void encode_xor_column(std::vector<unsigned char>& out, std::vector<uint64_t>& residuals, const double* values,
+                       double* reconstructed, size_t n, bool keyframe, bool singlePrecision) {
+  residuals.resize(n);
+  int shift = 8;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t prediction = keyframe ? (i > 0 ? value_bits(reconstructed[i - 1], singlePrecision) : 0)
+                                   : value_bits(reconstructed[i], singlePrecision);
+    uint64_t bits = value_bits(values[i], singlePrecision);
+    residuals[i] = bits ^ prediction;
+    reconstructed[i] = bits_value(bits, singlePrecision);
+    if (residuals[i] && shift > 0) {
+      int zeroBytes = 0;
+      while (((residuals[i] >> (8 * zeroBytes)) & 0xff) == 0) zeroBytes++;
+      shift = std::min(shift, zeroBytes);
+    }
+  }
+  if (shift == 8) shift = 0;
+
+  // Bufor powiększany raz o najgorszy przypadek: każda różnica zapisywana jest pełnym słowem (little-endian),
+  // a wskaźnik przesuwany tylko o jej znaczące bajty
+  size_t start = out.size();
+  out.resize(start + 2 + (n + 1) / 2 + 8 * n + 8, 0);
+  unsigned char* nibbles = out.data() + start + 2;
+  unsigned char* p = nibbles + (n + 1) / 2;
+  out[start] = COLUMN_XOR;
+  out[start + 1] = (unsigned char)shift;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = residuals[i] >> (8 * shift);
+    int bytes = significant_bytes(x);
+    nibbles[i / 2] |= (unsigned char)(bytes << (4 * (i % 2)));
+    for (int b = 0; b < 8; b++) p[b] = (unsigned char)(x >> (8 * b));
+    p += bytes;
+  }
+  out.resize(p - out.data());
+}
+
+unsigned char* put_varint(unsigned char* p, uint64_t value) {
+  while (value >= 0x80) {
+    *p++ = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (unsigned char)value;
+  return p;
+}
+
+// Kolumna kwantyzowana z krokiem `step`; false (bez zmiany `out` i `reconstructed`), gdy kolumna zawiera
+// NaN/inf albo różnica nie mieści się w int64 - wtedy kolumna kodowana jest przez XOR
+bool encode_quantized_column(std::vector<unsigned char>& out, std::vector<uint64_t>& residuals, const double* values,
+                             double* reconstructed, size_t n, bool keyframe, double step) {
+  if (!(step > 0.0) || !std::isfinite(step)) return false;
+  residuals.resize(n);
+  double last = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    double prediction = keyframe ? last : reconstructed[i];
+    double scaled = (values[i] - prediction) / step;
+    if (!std::isfinite(scaled) || std::fabs(scaled) > 4.0e18) return false;
+    int64_t q = std::llround(scaled);
+    residuals[i] = ((uint64_t)q << 1) ^ (uint64_t)(q >> 63);
+    last = dequantize(prediction, q, step);
+  }
+
+  out.push_back(COLUMN_QUANTIZED);
+  const unsigned char* stepBytes = reinterpret_cast<const unsigned char*>(&step);
+  out.insert(out.end(), stepBytes, stepBytes + sizeof(step));
+  size_t start = out.size();
+  out.resize(start + 10 * n);  // varint uint64 ma najwyżej 10 bajtów
+  unsigned char* p = out.data() + start;
+  last = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    p = put_varint(p, residuals[i]);
+    double prediction = keyframe ? last : reconstructed[i];
+    int64_t q = (int64_t)(residuals[i] >> 1) ^ -(int64_t)(residuals[i] & 1);
+    reconstructed[i] = last = dequantize(prediction, q, step);
+  }
+  out.resize(p - out.data());
+  return true;
+}
+
+// Dekoduje jedną kolumnę z [p, end); przesuwa p za kolumnę. false - uszkodzone dane
+bool decode_column(const unsigned char*& p, const unsigned char* end, double* reconstructed, size_t n, bool keyframe,
+                   bool singlePrecision) {
+  if (p >= end) return false;
+  unsigned char codec = *p++;
+  if (codec == COLUMN_XOR) {
+    if (end - p < (ptrdiff_t)(1 + (n + 1) / 2)) return false;
+    int shift = *p++;
+    const unsigned char* nibbles = p;
+    p += (n + 1) / 2;
+    for (size_t i = 0; i < n; i++) {
+      int bytes = (nibbles[i / 2] >> (4 * (i % 2))) & 0xf;
+      if (bytes > 8 || shift + bytes > 8 || end - p < bytes) return false;
+      uint64_t x = 0;
+      for (int b = 0; b < bytes; b++) x |= (uint64_t)p[b] << (8 * b);  // GCC łączy to w jeden odczyt przy bytes = 8
+      p += bytes;
+      uint64_t prediction = keyframe ? (i > 0 ? value_bits(reconstructed[i - 1], singlePrecision) : 0)
+                                     : value_bits(reconstructed[i], singlePrecision);
+      reconstructed[i] = bits_value((x << (8 * shift)) ^ prediction, singlePrecision);
+    }
+    return true;
+  }
+  if (codec == COLUMN_QUANTIZED) {
+    double step;
+    if (end - p < (ptrdiff_t)sizeof(step)) return false;
+    std::memcpy(&step, p, sizeof(step));
+    p += sizeof(step);
+    double last = 0.0;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t zigzag = 0;
+      for (int shift = 0;; shift += 7) {
+        if (p >= end || shift > 63) return false;
+        unsigned char byte = *p++;
+        zigzag |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+      }
+      int64_t q = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+      double prediction = keyframe ? last : reconstructed[i];
+      reconstructed[i] = last = dequantize(prediction, q, step);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Krok kwantyzacji grupy (pozycje, prędkości albo przyspieszenia): 2 * tolerance * największy bok
+// prostopadłościanu ograniczającego, a dla grupy bez rozrzutu - względem największej wartości bezwzględnej
+double quantization_step(const double* const* columns, int first, size_t n, double tolerance) {
+  double extent = 0.0, magnitude = 0.0;
+  for (int c = first; c < first + 3; c++) {
+    if (n == 0) break;
+    auto [low, high] = std::minmax_element(columns[c], columns[c] + n);
+    extent = std::max(extent, *high - *low);
+    magnitude = std::max({magnitude, std::fabs(*low), std::fabs(*high)});
+  }
+  double scale = extent > 0.0 ? extent : magnitude > 0.0 ? magnitude : 1.0;
+  return 2.0 * tolerance * scale;
+}
+
+}  // namespace
+
+TrajectoryWriter::TrajectoryWriter(const std::string& filename, uint64_t bodyCount, double dt, uint32_t fields,
+                                   bool singlePrecision, bool append, const char* units,
+                                   const TrajectoryCompression& compression, int64_t appendAfter)
+    : filename(filename) {
+  const bool compressed = compression.codec != TRAJ_CODEC_NONE;
+  std::memset(&fileHeader, 0, sizeof(fileHeader));
+  std::memcpy(fileHeader.magic, TRAJECTORY_MAGIC, sizeof(fileHeader.magic));
+  fileHeader.version = compressed ? TRAJECTORY_COMPRESSED_VERSION : TRAJECTORY_VERSION;
+  fileHeader.fields = fields;
+  fileHeader.scalarBytes = singlePrecision ? 4 : 8;
+  fileHeader.headerBytes = sizeof(TrajectoryFileHeader) + (compressed ? sizeof(TrajectoryCodecHeader) : 0);
+  fileHeader.bodyCount = bodyCount;
+  fileHeader.dt = dt;
+  std::strncpy(fileHeader.units, units, sizeof(fileHeader.units) - 1);
+  codecHeader.codec = compression.codec;
+  codecHeader.keyframeInterval = std::max(compression.keyframeInterval, 1u);
+  codecHeader.tolerance = compression.tolerance;
+  nextOffset = fileHeader.headerBytes;
+  if (compressed) {
+    previous.assign(TRAJ_COLUMNS, std::vector<double>(bodyCount, 0.0));
+  }
+
+  if (append) {
+    // Istniejącego pliku nigdy nie obcinamy: niezgodny albo nieczytelny plik zostaje nietknięty, a zapis nie rusza
+    std::error_code error;
+    if (std::filesystem::exists(filename, error) && !open_existing(filename, appendAfter)) {
+      std::cerr << "Błąd: Nie można dopisać klatek do " << filename
+                << " (inna liczba ciał, pola, precyzja lub kodek) - plik nie zostanie nadpisany" << std::endl;
+      return;
+    }
+    if (file) {
+      return;
+    }
+  }
+
+  file = std::fopen(filename.c_str(), "wb");
+  if (!file) {
+    std::cerr << "Błąd: Nie można otworzyć pliku do zapisu: " << filename << std::endl;
+    return;
+  }
+  std::fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+  if (compressed) {
+    std::fwrite(&codecHeader, sizeof(codecHeader), 1, file);
+  }
+}
+
+namespace {
+
+// Pusty napis, jeśli do pliku z czytnika można dopisać klatki o podanych parametrach; inaczej opis niezgodności
+std::string append_mismatch(const TrajectoryReader& reader, uint64_t bodyCount, uint32_t fields, uint32_t scalarBytes,
+                            uint32_t codec) {
+  if (!reader.is_open()) {
+    return "plik nie jest czytelną trajektorią";
+  }
+  const TrajectoryFileHeader& existing = reader.header();
+  if (existing.bodyCount != bodyCount) {
+    return "liczba ciał " + std::to_string(existing.bodyCount) + ", a nie " + std::to_string(bodyCount);
+  }
+  if (existing.fields != fields || existing.scalarBytes != scalarBytes) {
+    return "inne pola lub precyzja kolumn";
+  }
+  const uint32_t existingCodec = reader.compression().codec;
+  if (existingCodec != codec) {
+    return std::string("kodek ") + trajectory_codec_name(existingCodec) + ", a nie " + trajectory_codec_name(codec);
+  }
+  return "";
+}
+
+}  // namespace
+
+bool trajectory_can_append(const std::string& filename, uint64_t bodyCount, uint32_t fields, bool singlePrecision,
+                           TrajectoryCodec codec, std::string& reason) {
+  TrajectoryReader reader(filename);
+  reason = append_mismatch(reader, bodyCount, fields, singlePrecision ? 4 : 8, codec);
+  return reason.empty();
+}
+
+bool TrajectoryWriter::open_existing(const std::string& filename, int64_t appendAfter) {
+  uint64_t end;
+  {
+    TrajectoryReader reader(filename);
+    if (!append_mismatch(reader, fileHeader.bodyCount, fileHeader.fields, fileHeader.scalarBytes, codecHeader.codec)
+             .empty()) {
+      return false;
+    }
+    const TrajectoryFileHeader& existing = reader.header();
+    TrajectoryCompression compression = reader.compression();
+    fileHeader = existing;
+    codecHeader.keyframeInterval = compression.keyframeInterval;
+    codecHeader.tolerance = compression.tolerance;
+    // Klatki są w kolejności kroków; od pierwszej klatki po appendAfter plik jest odcinany
+    size_t kept = 0;
+    while (kept < reader.frame_count() && reader.frame_header(kept).step <= appendAfter) {
+      offsets.push_back(reader.frame_offset(kept++));
+    }
+    end = fileHeader.headerBytes;
+    if (kept < reader.frame_count()) {
+      end = reader.frame_offset(kept);
+    }
+    if (!offsets.empty()) {
+      // Ostatnia klatka odkodowana przez czytnik to predykcja dla następnej klatki
+      TrajectoryFrame last = reader.frame(offsets.size() - 1);
+      for (int c = 0; c < TRAJ_COLUMNS && codecHeader.codec != TRAJ_CODEC_NONE; c++) {
+        if (!trajectory_has_column(fileHeader.fields, c)) continue;
+        if (!last.columns[c]) return false;
+        for (size_t i = 0; i < fileHeader.bodyCount; i++) previous[c][i] = last.value(c, i);
+      }
+      if (kept == reader.frame_count()) {
+        end = offsets.back() + (codecHeader.codec != TRAJ_CODEC_NONE
+                                    ? sizeof(TrajectoryFrameHeader) + last.header->payloadBytes
+                                    : trajectory_frame_bytes(fileHeader));
+      }
+    }
+  }
+  nextOffset = end;
+
+  // Indeks i stopka zostaną zapisane od nowa przy zamknięciu; obcięcie od razu sprawia, że przerwany zapis
+  // zostawia plik bez stopki (czytany po rozmiarze klatki), a nie ze stopką wskazującą na nadpisane dane
+  std::error_code error;
+  std::filesystem::resize_file(filename, end, error);
+  if (error) {
+    return false;
+  }
+  file = std::fopen(filename.c_str(), "r+b");
+  if (!file) {
+    return false;
+  }
+  std::fseek(file, (long)end, SEEK_SET);
+  return true;
+}
+
+TrajectoryWriter::~TrajectoryWriter() { close(); }
+
+void TrajectoryWriter::encode_frame(const double* const* columns) {
+  const size_t n = fileHeader.bodyCount;
+  const bool keyframe = offsets.size() % codecHeader.keyframeInterval == 0;
+  const bool singlePrecision = fileHeader.scalarBytes == 4;
+  payload.clear();
+  for (int c = 0; c < TRAJ_COLUMNS; c++) {
+    if (!trajectory_has_column(fileHeader.fields, c)) continue;
+    bool quantized = false;
+    if (codecHeader.codec == TRAJ_CODEC_QUANTIZE && c != TRAJ_MASS && codecHeader.tolerance > 0.0) {
+      double step = quantization_step(columns, c - c % 3, n, codecHeader.tolerance);
+      quantized = encode_quantized_column(payload, residuals, columns[c], previous[c].data(), n, keyframe, step);
+    }
+    if (!quantized) {
+      encode_xor_column(payload, residuals, columns[c], previous[c].data(), n, keyframe, singlePrecision);
+    }
+  }
+  payload.resize((payload.size() + 7) / 8 * 8, 0);
+}
+
+void TrajectoryWriter::write_frame(const TrajectoryFrameHeader& frame, const double* const* columns) {
+  if (!file) {
+    return;
+  }
+
+  if (codecHeader.codec != TRAJ_CODEC_NONE) {
+    encode_frame(columns);
+    offsets.push_back(nextOffset);
+    TrajectoryFrameHeader compressed = frame;
+    compressed.payloadBytes = payload.size();
+    std::fwrite(&compressed, sizeof(compressed), 1, file);
+    std::fwrite(payload.data(), 1, payload.size(), file);
+    nextOffset += sizeof(compressed) + payload.size();
+    return;
+  }
+
+  offsets.push_back(nextOffset);
+  nextOffset += trajectory_frame_bytes(fileHeader);
+  std::fwrite(&frame, sizeof(frame), 1, file);
+  uint64_t bytes = 0;
+  const size_t n = fileHeader.bodyCount;
+  for (int c = 0; c < TRAJ_COLUMNS; c++) {
+    if (!trajectory_has_column(fileHeader.fields, c)) continue;
+    if (fileHeader.scalarBytes == 8) {
+      std::fwrite(columns[c], sizeof(double), n, file);
+    } else {
+      scratch.assign(columns[c], columns[c] + n);
+      std::fwrite(scratch.data(), sizeof(float), n, file);
+    }
+    bytes += n * fileHeader.scalarBytes;
+  }
+
+  static const char padding[8] = {};
+  std::fwrite(padding, 1, (8 - bytes % 8) % 8, file);
+}
+
+void TrajectoryWriter::write(const Body& bodies, int step, double time, int64_t timestamp) {
+  const double* columns[TRAJ_COLUMNS] = {bodies.x.data(),  bodies.y.data(),  bodies.z.data(),  bodies.vx.data(),
+                                         bodies.vy.data(), bodies.vz.data(), bodies.ax.data(), bodies.ay.data(),
+                                         bodies.az.data(), bodies.mass.data()};
+  TrajectoryFrameHeader frame = {step, time, timestamp, 0};
+  write_frame(frame, columns);
+}
+
+void TrajectoryWriter::close() {
+  if (!file) {
+    return;
+  }
+
+  TrajectoryTrailer trailer;
+  trailer.frameCount = offsets.size();
+  trailer.indexOffset = nextOffset;
+  std::memcpy(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic));
+
+  std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file);
+  std::fwrite(&trailer, sizeof(trailer), 1, file);
+  std::fclose(file);
+  file = nullptr;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& filename) {
+#ifdef TRAJECTORY_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      data = static_cast<const unsigned char*>(mapped);
+      size = info.st_size;
+    }
+  }
+  ::close(fd);
+#else
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    return;
+  }
+  fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  if (!fallback.empty()) {
+    data = fallback.data();
+    size = fallback.size();
+  }
+#endif
+  if (!data) {
+    return;
+  }
+
+  const TrajectoryFileHeader& h = header();
+  const bool compressed = size >= sizeof(TrajectoryFileHeader) && h.version == TRAJECTORY_COMPRESSED_VERSION;
+  const uint32_t expectedHeaderBytes = sizeof(TrajectoryFileHeader) + (compressed ? sizeof(TrajectoryCodecHeader) : 0);
+  if (size < sizeof(TrajectoryFileHeader) || std::memcmp(h.magic, TRAJECTORY_MAGIC, sizeof(h.magic)) != 0 ||
+      (h.version != TRAJECTORY_VERSION && !compressed) || h.headerBytes != expectedHeaderBytes ||
+      size < h.headerBytes || (h.scalarBytes != 4 && h.scalarBytes != 8)) {
+    std::cerr << "Błąd: " << filename << " nie jest plikiem trajektorii" << std::endl;
+#ifdef TRAJECTORY_MMAP
+    munmap(const_cast<unsigned char*>(data), size);
+#endif
+    data = nullptr;
+    return;
+  }
+
+  if (compressed) {
+    codec = reinterpret_cast<const TrajectoryCodecHeader*>(data + sizeof(TrajectoryFileHeader));
+    decoded.assign(TRAJ_COLUMNS, std::vector<double>());
+    for (int c = 0; c < TRAJ_COLUMNS; c++) {
+      if (trajectory_has_column(h.fields, c)) decoded[c].resize(h.bodyCount);
+    }
+  }
+
+  if (size >= h.headerBytes + sizeof(TrajectoryTrailer)) {
+    TrajectoryTrailer trailer;
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    if (std::memcmp(trailer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+        trailer.indexOffset + trailer.frameCount * sizeof(uint64_t) + sizeof(trailer) == size) {
+      index = reinterpret_cast<const uint64_t*>(data + trailer.indexOffset);
+      frameCount = trailer.frameCount;
+      return;
+    }
+  }
+  if (!compressed) {
+    frameCount = (size - sizeof(TrajectoryFileHeader)) / trajectory_frame_bytes(h);
+    return;
+  }
+  // Klatki skompresowane mają różne rozmiary - bez stopki offsety wyznacza przejście po nagłówkach klatek
+  uint64_t offset = h.headerBytes;
+  while (offset + sizeof(TrajectoryFrameHeader) <= size) {
+    const TrajectoryFrameHeader* frameHeader = reinterpret_cast<const TrajectoryFrameHeader*>(data + offset);
+    uint64_t end = offset + sizeof(TrajectoryFrameHeader) + frameHeader->payloadBytes;
+    if (end > size || end <= offset) break;
+    walkedOffsets.push_back(offset);
+    offset = end;
+  }
+  index = walkedOffsets.data();
+  frameCount = walkedOffsets.size();
+}
+
+TrajectoryCompression TrajectoryReader::compression() const {
+  TrajectoryCompression compression;
+  if (codec) {
+    compression.codec = (TrajectoryCodec)codec->codec;
+    compression.keyframeInterval = codec->keyframeInterval;
+    compression.tolerance = codec->tolerance;
+  }
+  return compression;
+}
+
+bool TrajectoryReader::decode_frame(size_t k) const {
+  const TrajectoryFileHeader& h = header();
+  const TrajectoryFrameHeader* frameHeader = reinterpret_cast<const TrajectoryFrameHeader*>(data + index[k]);
+  const unsigned char* p = data + index[k] + sizeof(TrajectoryFrameHeader);
+  const unsigned char* end = p + frameHeader->payloadBytes;
+  const bool keyframe = k % std::max(codec->keyframeInterval, 1u) == 0;
+  for (int c = 0; c < TRAJ_COLUMNS; c++) {
+    if (!trajectory_has_column(h.fields, c)) continue;
+    if (!decode_column(p, end, decoded[c].data(), h.bodyCount, keyframe, h.scalarBytes == 4)) {
+      decodedFrame = SIZE_MAX;
+      return false;
+    }
+  }
+  decodedFrame = k;
+  return true;
+}
+
+TrajectoryReader::~TrajectoryReader() {
+#ifdef TRAJECTORY_MMAP
+  if (data) munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+uint64_t TrajectoryReader::frame_offset(size_t k) const {
+  return index ? index[k] : sizeof(TrajectoryFileHeader) + k * trajectory_frame_bytes(header());
+}
+
+TrajectoryFrame TrajectoryReader::frame(size_t k) const {
+  const TrajectoryFileHeader& h = header();
+  uint64_t offset = frame_offset(k);
+
+  TrajectoryFrame frame;
+  frame.scalarBytes = h.scalarBytes;
+  frame.header = reinterpret_cast<const TrajectoryFrameHeader*>(data + offset);
+  if (codec) {
+    // Dekodowanie od klatki kluczowej, chyba że odkodowana jest już wcześniejsza klatka z tego samego odcinka
+    size_t keyframe = k - k % std::max(codec->keyframeInterval, 1u);
+    size_t first = decodedFrame != SIZE_MAX && decodedFrame >= keyframe && decodedFrame <= k ? decodedFrame + 1
+                                                                                              : keyframe;
+    for (size_t j = first; j <= k; j++) {
+      if (!decode_frame(j)) return frame;
+    }
+    frame.scalarBytes = 8;
+    for (int c = 0; c < TRAJ_COLUMNS; c++) {
+      if (trajectory_has_column(h.fields, c)) frame.columns[c] = decoded[c].data();
+    }
+    return frame;
+  }
+  const unsigned char* column = data + offset + sizeof(TrajectoryFrameHeader);
+  for (int c = 0; c < TRAJ_COLUMNS; c++) {
+    if (!trajectory_has_column(h.fields, c)) continue;
+    frame.columns[c] = column;
+    column += h.bodyCount * h.scalarBytes;
+  }
+  return frame;
+}
+
+namespace {
+
+void append_xyz(std::string& out, const char* name, const TrajectoryFrame& frame, int column, size_t i) {
+  out += '"';
+  out += name;
+  out += "\":{\"x\":";
+  append_json_number(out, frame.value(column, i));
+  out += ",\"y\":";
+  append_json_number(out, frame.value(column + 1, i));
+  out += ",\"z\":";
+  append_json_number(out, frame.value(column + 2, i));
+  out += '}';
+}
+
+// null zapisywany jest zamiast NaN i nieskończoności; brak osi (płaskie klatki GPU_2_pair bez "z") to 0
+double json_coordinate(const json& vector, const char* axis) {
+  if (!vector.contains(axis)) return 0.0;
+  const json& value = vector.at(axis);
+  return value.is_null() ? NAN : value.get<double>();
+}
+
+}  // namespace
+
+bool trajectory_to_json(const std::string& input, const std::string& output, bool gpuLayout) {
+  TrajectoryReader reader(input);
+  if (!reader.is_open()) {
+    std::cerr << "Błąd: Nie można odczytać trajektorii: " << input << std::endl;
+    return false;
+  }
+  std::FILE* out = std::fopen(output.c_str(), "wb");
+  if (!out) {
+    std::cerr << "Błąd: Nie można otworzyć pliku do zapisu: " << output << std::endl;
+    return false;
+  }
+
+  const bool ndjson = snapshot_format_for(output) == SnapshotFormat::Ndjson;
+  const uint32_t fields = reader.header().fields;
+  const size_t n = reader.header().bodyCount;
+  std::string buffer;
+  if (!ndjson) std::fputc('[', out);
+
+  for (size_t k = 0; k < reader.frame_count(); k++) {
+    TrajectoryFrame frame = reader.frame(k);
+    buffer.clear();
+    if (!ndjson) buffer += k > 0 ? ",\n" : "\n";
+
+    if (gpuLayout) {
+      buffer += "{\"time\":";
+      append_json_number(buffer, frame.header->time);
+    } else {
+      buffer += "{\"step\":" + std::to_string(frame.header->step);
+      buffer += ",\"timestamp\":" + std::to_string(frame.header->timestamp);
+    }
+    buffer += ",\"bodies\":[";
+    for (size_t i = 0; i < n; i++) {
+      if (i > 0) buffer += ',';
+      buffer += '{';
+      if (gpuLayout) buffer += "\"id\":" + std::to_string(i) + ",";
+      bool first = true;
+      auto separator = [&] {
+        if (!first) buffer += ',';
+        first = false;
+      };
+      if (fields & TRAJ_POSITIONS) {
+        separator();
+        append_xyz(buffer, gpuLayout ? "p" : "position", frame, TRAJ_X, i);
+      }
+      if (fields & TRAJ_VELOCITIES) {
+        separator();
+        append_xyz(buffer, gpuLayout ? "v" : "velocity", frame, TRAJ_VX, i);
+      }
+      if (gpuLayout && (fields & TRAJ_ACCELERATIONS)) {
+        separator();
+        append_xyz(buffer, "a", frame, TRAJ_AX, i);
+      }
+      if (fields & TRAJ_MASSES) {
+        separator();
+        buffer += gpuLayout ? "\"m\":" : "\"mass\":";
+        append_json_number(buffer, frame.value(TRAJ_MASS, i));
+      }
+      buffer += '}';
+    }
+    buffer += "]}";
+    if (ndjson) buffer += '\n';
+    std::fwrite(buffer.data(), 1, buffer.size(), out);
+  }
+
+  if (!ndjson) std::fputs("\n]", out);
+  std::fclose(out);
+  return true;
+}
+
+bool json_to_trajectory(const std::string& input, const std::string& output, bool singlePrecision, double dt,
+                        const TrajectoryCompression& compression) {
+  std::ifstream in(input);
+  if (!in.is_open()) {
+    std::cerr << "Błąd: Nie można otworzyć pliku: " << input << std::endl;
+    return false;
+  }
+
+  json frames = json::array();
+  try {
+    if (snapshot_format_for(input) == SnapshotFormat::Ndjson) {
+      std::string line;
+      while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") != std::string::npos) frames.push_back(json::parse(line));
+      }
+    } else {
+      in >> frames;
+    }
+  } catch (const json::parse_error& e) {
+    std::cerr << "Błąd: Niepoprawny JSON w " << input << ": " << e.what() << std::endl;
+    return false;
+  }
+  if (!frames.is_array() || frames.empty() || !frames[0].contains("bodies")) {
+    std::cerr << "Błąd: " << input << " nie zawiera klatek symulacji" << std::endl;
+    return false;
+  }
+
+  const json& firstBodies = frames[0]["bodies"];
+  const size_t n = firstBodies.size();
+  const bool gpuLayout = n > 0 && firstBodies[0].contains("p");
+  uint32_t fields = TRAJ_POSITIONS | TRAJ_VELOCITIES | TRAJ_MASSES;
+  if (gpuLayout && firstBodies[0].contains("a")) fields |= TRAJ_ACCELERATIONS;
+
+  const char* positionKey = gpuLayout ? "p" : "position";
+  const char* velocityKey = gpuLayout ? "v" : "velocity";
+  const char* massKey = gpuLayout ? "m" : "mass";
+
+  TrajectoryWriter writer(output, n, dt, fields, singlePrecision, false, TRAJECTORY_DEFAULT_UNITS, compression);
+  if (!writer.is_open()) {
+    return false;
+  }
+
+  std::vector<std::vector<double>> columns(TRAJ_COLUMNS, std::vector<double>(n, 0.0));
+  const double* pointers[TRAJ_COLUMNS];
+  for (int c = 0; c < TRAJ_COLUMNS; c++) pointers[c] = columns[c].data();
+
+  try {
+    for (size_t k = 0; k < frames.size(); k++) {
+      const json& frame = frames[k];
+      const json& bodies = frame.at("bodies");
+      if (bodies.size() != n) {
+        std::cerr << "Błąd: Klatka " << k << " ma " << bodies.size() << " ciał zamiast " << n << std::endl;
+        return false;
+      }
+      for (size_t i = 0; i < n; i++) {
+        const json& body = bodies[i];
+        const json& position = body.at(positionKey);
+        const json& velocity = body.at(velocityKey);
+        columns[TRAJ_X][i] = json_coordinate(position, "x");
+        columns[TRAJ_Y][i] = json_coordinate(position, "y");
+        columns[TRAJ_Z][i] = json_coordinate(position, "z");
+        columns[TRAJ_VX][i] = json_coordinate(velocity, "x");
+        columns[TRAJ_VY][i] = json_coordinate(velocity, "y");
+        columns[TRAJ_VZ][i] = json_coordinate(velocity, "z");
+        if (fields & TRAJ_ACCELERATIONS) {
+          const json& acceleration = body.at("a");
+          columns[TRAJ_AX][i] = json_coordinate(acceleration, "x");
+          columns[TRAJ_AY][i] = json_coordinate(acceleration, "y");
+          columns[TRAJ_AZ][i] = json_coordinate(acceleration, "z");
+        }
+        columns[TRAJ_MASS][i] = body.at(massKey).get<double>();
+      }
+
+      TrajectoryFrameHeader header = {0, 0.0, 0, 0};
+      header.step = frame.value("step", (int64_t)k);
+      header.time = frame.value("time", header.step * dt);
+      header.timestamp = frame.value("timestamp", (int64_t)0);
+      writer.write_frame(header, pointers);
+    }
+  } catch (const json::exception& e) {
+    std::cerr << "Błąd: Niepoprawna klatka w " << input << ": " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
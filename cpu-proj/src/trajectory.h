@@ -0,0 +1,197 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "physics.h"
+
+// Binarny format trajektorii (.nbt), little-endian:
+//   nagłówek pliku (64 B) | klatka 0 | klatka 1 | ... | indeks: offsety klatek (uint64) | stopka (24 B)
+// Klatka: nagłówek klatki (32 B), potem kolumny po N wartości (float64 albo float32) w kolejności
+// x, y, z, vx, vy, vz, ax, ay, az, mass - tylko grupy zaznaczone w `fields`; klatka dopełniona do 8 B.
+// Stopka pozwala znaleźć indeks bez czytania pliku, więc dowolną klatkę można odczytać z mmap w O(1).
+// Plik bez stopki (przerwany zapis) jest odczytywany na podstawie stałego rozmiaru klatki.
+//
+// Wersja 2 - klatki skompresowane: za nagłówkiem pliku nagłówek kodeka (16 B), a klatka to nagłówek klatki
+// i `payloadBytes` bajtów zakodowanych kolumn. Kolumna kodowana jest względem tej samej kolumny poprzedniej
+// klatki, a w klatce kluczowej (co `keyframeInterval` klatek) - względem poprzedniego ciała, więc odczyt
+// dowolnej klatki dekoduje najwyżej `keyframeInterval` klatek. Kodeki kolumny:
+//   XOR (bezstratny) - bajt kodeka, przesunięcie s (wspólna liczba zerowych młodszych bajtów), półbajty z liczbą
+//     znaczących bajtów każdej różnicy XOR (po przesunięciu o s bajtów), potem te bajty;
+//   kwantyzacja (stratny) - bajt kodeka, krok q (double), różnice w krokach q jako zigzag varint. Błąd wartości
+//     nie przekracza q / 2 = tolerance * największy bok prostopadłościanu ograniczającego grupy (pozycje,
+//     prędkości albo przyspieszenia) w danej klatce. Masy i kolumny z NaN/inf kodowane są zawsze przez XOR.
+
+#define TRAJECTORY_MAGIC "NBTRAJ1"
+#define TRAJECTORY_INDEX_MAGIC "NBTRIDX"
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_COMPRESSED_VERSION 2
+#define TRAJECTORY_DEFAULT_UNITS "m kg s"
+
+enum TrajectoryFields : uint32_t {
+  TRAJ_POSITIONS = 1,
+  TRAJ_VELOCITIES = 2,
+  TRAJ_ACCELERATIONS = 4,
+  TRAJ_MASSES = 8,
+  TRAJ_ALL_FIELDS = 15
+};
+
+enum TrajectoryCodec : uint32_t { TRAJ_CODEC_NONE = 0, TRAJ_CODEC_XOR = 1, TRAJ_CODEC_QUANTIZE = 2 };
+
+enum TrajectoryColumn { TRAJ_X, TRAJ_Y, TRAJ_Z, TRAJ_VX, TRAJ_VY, TRAJ_VZ, TRAJ_AX, TRAJ_AY, TRAJ_AZ, TRAJ_MASS, TRAJ_COLUMNS };
+
+struct TrajectoryFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t fields;       // maska TrajectoryFields
+  uint32_t scalarBytes;  // 8 - float64, 4 - float32
+  uint32_t headerBytes;  // sizeof(TrajectoryFileHeader)
+  uint64_t bodyCount;
+  double dt;
+  char units[24];        // jednostki długości, masy i czasu, np. "m kg s"
+};
+
+struct TrajectoryFrameHeader {
+  int64_t step;
+  double time;
+  int64_t timestamp;
+  uint64_t payloadBytes;  // rozmiar zakodowanych kolumn (wersja 2), 0 - kolumny bez kompresji
+};
+
+struct TrajectoryCodecHeader {
+  uint32_t codec;             // TrajectoryCodec
+  uint32_t keyframeInterval;
+  double tolerance;           // kwantyzacja: błąd względem boku prostopadłościanu ograniczającego
+};
+
+struct TrajectoryTrailer {
+  uint64_t frameCount;
+  uint64_t indexOffset;
+  char magic[8];
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 64, "nagłówek pliku trajektorii musi mieć 64 bajty");
+static_assert(sizeof(TrajectoryFrameHeader) == 32, "nagłówek klatki musi mieć 32 bajty");
+static_assert(sizeof(TrajectoryTrailer) == 24, "stopka trajektorii musi mieć 24 bajty");
+static_assert(sizeof(TrajectoryCodecHeader) == 16, "nagłówek kodeka musi mieć 16 bajtów");
+
+struct TrajectoryCompression {
+  TrajectoryCodec codec = TRAJ_CODEC_NONE;
+  double tolerance = 1e-6;
+  uint32_t keyframeInterval = 32;
+};
+
+const char *trajectory_codec_name(uint32_t codec);
+// "none", "xor" albo "quantize"; zwraca false dla nieznanej nazwy
+bool parse_trajectory_codec(const std::string &name, TrajectoryCodec &codec);
+
+// Czy do istniejącego pliku można dopisać klatki o tych parametrach (jak TrajectoryWriter z append);
+// reason - opis niezgodności, gdy zwraca false
+bool trajectory_can_append(const std::string &filename, uint64_t bodyCount, uint32_t fields, bool singlePrecision,
+                           TrajectoryCodec codec, std::string &reason);
+
+// Kolumna należy do pliku, jeśli jej grupa jest zaznaczona w `fields`
+bool trajectory_has_column(uint32_t fields, int column);
+// Rozmiar klatki w bajtach (z nagłówkiem i dopełnieniem do 8 B)
+uint64_t trajectory_frame_bytes(const TrajectoryFileHeader &header);
+
+class TrajectoryWriter {
+ public:
+  // append - dopisywanie klatek do istniejącego pliku o tej samej liczbie ciał, polach i kodeku; gdy pliku nie ma,
+  // zapis zaczyna się od nowa. Niezgodny plik nie jest nadpisywany - writer pozostaje wtedy zamknięty (is_open())
+  // compression - kodek klatek; przy dopisywaniu musi zgadzać się z kodekiem istniejącego pliku
+  // appendAfter - przy dopisywaniu odcinane są klatki o kroku większym (zapisane po punkcie kontrolnym,
+  // od którego wznawiany jest przebieg), więc kroki w pliku się nie powtarzają
+  TrajectoryWriter(const std::string &filename, uint64_t bodyCount, double dt, uint32_t fields = TRAJ_ALL_FIELDS,
+                   bool singlePrecision = false, bool append = false, const char *units = TRAJECTORY_DEFAULT_UNITS,
+                   const TrajectoryCompression &compression = TrajectoryCompression(),
+                   int64_t appendAfter = INT64_MAX);
+  // zapisuje indeks i stopkę
+  ~TrajectoryWriter();
+
+  TrajectoryWriter(const TrajectoryWriter &) = delete;
+  TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+  bool is_open() const { return file != nullptr; }
+  const TrajectoryFileHeader &header() const { return fileHeader; }
+  size_t frame_count() const { return offsets.size(); }
+  // Bajty zapisanych klatek (z nagłówkami klatek)
+  uint64_t frame_bytes_written() const { return nextOffset - fileHeader.headerBytes; }
+
+  // columns[TRAJ_COLUMNS] - kolumny w typie double; pomijane są kolumny spoza `fields`
+  void write_frame(const TrajectoryFrameHeader &frame, const double *const *columns);
+  void write(const Body &bodies, int step, double time, int64_t timestamp = 0);
+  void close();
+
+ private:
+  bool open_existing(const std::string &filename, int64_t appendAfter);
+  void encode_frame(const double *const *columns);
+
+  std::FILE *file = nullptr;
+  std::string filename;
+  TrajectoryFileHeader fileHeader;
+  TrajectoryCodecHeader codecHeader;
+  std::vector<uint64_t> offsets;
+  uint64_t nextOffset = 0;
+  std::vector<float> scratch;
+  std::vector<std::vector<double>> previous;  // odtworzona poprzednia klatka - predykcja kodeka
+  std::vector<unsigned char> payload;
+  std::vector<uint64_t> residuals;
+};
+
+// Widok klatki bez kopiowania - wskaźniki prowadzą do zmapowanego pliku, a w plikach skompresowanych do bufora
+// odkodowanej klatki w czytniku (ważnego do następnego wywołania frame())
+struct TrajectoryFrame {
+  const TrajectoryFrameHeader *header = nullptr;
+  const void *columns[TRAJ_COLUMNS] = {};
+  uint32_t scalarBytes = 8;
+
+  double value(int column, size_t i) const {
+    return scalarBytes == 8 ? static_cast<const double *>(columns[column])[i]
+                            : static_cast<const float *>(columns[column])[i];
+  }
+};
+
+class TrajectoryReader {
+ public:
+  explicit TrajectoryReader(const std::string &filename);
+  ~TrajectoryReader();
+
+  TrajectoryReader(const TrajectoryReader &) = delete;
+  TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+  bool is_open() const { return data != nullptr; }
+  const TrajectoryFileHeader &header() const { return *reinterpret_cast<const TrajectoryFileHeader *>(data); }
+  TrajectoryCompression compression() const;
+  size_t frame_count() const { return frameCount; }
+  // Położenie nagłówka klatki k w pliku
+  uint64_t frame_offset(size_t k) const;
+  // Nagłówek klatki k bez dekodowania kolumn
+  const TrajectoryFrameHeader &frame_header(size_t k) const {
+    return *reinterpret_cast<const TrajectoryFrameHeader *>(data + frame_offset(k));
+  }
+  // W plikach skompresowanych dekoduje klatki od najbliższej klatki kluczowej (kolejne klatki - po jednej),
+  // więc czytnik nie może być używany równocześnie z wielu wątków. Zwraca klatkę bez kolumn przy błędzie danych.
+  TrajectoryFrame frame(size_t k) const;
+
+ private:
+  bool decode_frame(size_t k) const;
+
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+  const uint64_t *index = nullptr;  // nullptr - plik bez stopki, klatki co trajectory_frame_bytes()
+  size_t frameCount = 0;
+  std::vector<unsigned char> fallback;  // bufor zamiast mmap na systemach bez POSIX
+  const TrajectoryCodecHeader *codec = nullptr;  // nullptr - plik bez kompresji
+  std::vector<uint64_t> walkedOffsets;  // plik skompresowany bez stopki - offsety znalezione przy otwarciu
+  mutable std::vector<std::vector<double>> decoded;
+  mutable size_t decodedFrame = SIZE_MAX;
+};
+
+// Konwersje do i z JSON. Układ "cpu" - klatki {"step", "timestamp", "bodies": [{"position", "velocity", "mass"}]}
+// (cpu-proj), układ "gpu" - {"time", "bodies": [{"id", "p", "v", "a", "m"}]} (GPU_BH / GPU_2_pair).
+// Pliki .ndjson/.jsonl mają jedną klatkę na linię. Zwracają false i wypisują błąd, gdy plik jest niepoprawny.
+bool trajectory_to_json(const std::string &input, const std::string &output, bool gpuLayout = false);
+bool json_to_trajectory(const std::string &input, const std::string &output, bool singlePrecision = false,
+                        double dt = 0.0, const TrajectoryCompression &compression = TrajectoryCompression());
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "trajectory.h"
+
+// Konwersja trajektorii binarnej (.nbt) do i z JSON
+static int usage(const char* program) {
+  std::cerr << "Użycie:\n"
+            << "  " << program << " to-json wejście.nbt wyjście.json|wyjście.ndjson [--gpu-layout]\n"
+            << "  " << program << " from-json wejście.json|wejście.ndjson wyjście.nbt [--float32] [--dt krok]"
+            << " [--codec none|xor|quantize] [--tolerance t] [--keyframe k]\n"
+            << "  " << program << " compress wejście.nbt wyjście.nbt [--float32]"
+            << " [--codec none|xor|quantize] [--tolerance t] [--keyframe k]\n"
+            << "  " << program << " info wejście.nbt" << std::endl;
+  return 1;
+}
+
+// Opcje kompresji wspólne dla from-json i compress; zwraca false dla nieznanej opcji
+static bool parse_compression(int argc, const char** argv, int& i, TrajectoryCompression& compression) {
+  if (std::strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+    return parse_trajectory_codec(argv[++i], compression.codec);
+  } else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+    compression.tolerance = atof(argv[++i]);
+  } else if (std::strcmp(argv[i], "--keyframe") == 0 && i + 1 < argc) {
+    compression.keyframeInterval = std::max(atoi(argv[++i]), 1);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Przepisuje trajektorię z nowym kodekiem; wypisuje współczynnik kompresji względem kolumn float64,
+// przepustowość kodowania i dekodowania oraz największy błąd (dla kwantyzacji)
+static int compress(const std::string& input, const std::string& output, bool singlePrecision,
+                    const TrajectoryCompression& compression) {
+  TrajectoryReader reader(input);
+  if (!reader.is_open()) {
+    return 1;
+  }
+  const TrajectoryFileHeader& header = reader.header();
+  const size_t n = header.bodyCount;
+  std::vector<std::vector<double>> columns(TRAJ_COLUMNS, std::vector<double>(n, 0.0));
+  const double* pointers[TRAJ_COLUMNS];
+  for (int c = 0; c < TRAJ_COLUMNS; c++) pointers[c] = columns[c].data();
+
+  std::chrono::duration<double> encodeTime(0.0);
+  uint64_t rawBytes = 0, frameBytes = 0;
+  {
+    TrajectoryWriter writer(output, n, header.dt, header.fields, singlePrecision, false, header.units, compression);
+    if (!writer.is_open()) {
+      return 1;
+    }
+    for (size_t k = 0; k < reader.frame_count(); k++) {
+      TrajectoryFrame frame = reader.frame(k);
+      for (int c = 0; c < TRAJ_COLUMNS; c++) {
+        if (!frame.columns[c]) continue;
+        for (size_t i = 0; i < n; i++) columns[c][i] = frame.value(c, i);
+        rawBytes += n * sizeof(double);
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      writer.write_frame(*frame.header, pointers);
+      encodeTime += std::chrono::high_resolution_clock::now() - start;
+    }
+    frameBytes = writer.frame_bytes_written();
+  }
+
+  TrajectoryReader compressed(output);
+  double maxError[TRAJ_COLUMNS] = {};
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t k = 0; k < compressed.frame_count(); k++) {
+    compressed.frame(k);
+  }
+  std::chrono::duration<double> decodeTime = std::chrono::high_resolution_clock::now() - start;
+  for (size_t k = 0; k < reader.frame_count() && k < compressed.frame_count(); k++) {
+    TrajectoryFrame original = reader.frame(k), decoded = compressed.frame(k);
+    for (int c = 0; c < TRAJ_COLUMNS; c++) {
+      if (!original.columns[c] || !decoded.columns[c]) continue;
+      for (size_t i = 0; i < n; i++) {
+        maxError[c] = std::max(maxError[c], std::fabs(original.value(c, i) - decoded.value(c, i)));
+      }
+    }
+  }
+
+  const double megabytes = rawBytes / 1e6;
+  std::cout << "Kodek: " << trajectory_codec_name(compression.codec) << "\n"
+            << "Klatki: " << compressed.frame_count() << "\n"
+            << "Dane float64: " << rawBytes << " B, po kompresji: " << frameBytes << " B (z nagłówkami klatek)\n"
+            << "Współczynnik kompresji: " << (frameBytes ? (double)rawBytes / frameBytes : 0.0) << "\n"
+            << "Kodowanie: " << megabytes / encodeTime.count() << " MB/s, dekodowanie: "
+            << megabytes / decodeTime.count() << " MB/s\n"
+            << "Największy błąd bezwzględny: pozycje "
+            << std::max({maxError[TRAJ_X], maxError[TRAJ_Y], maxError[TRAJ_Z]}) << ", prędkości "
+            << std::max({maxError[TRAJ_VX], maxError[TRAJ_VY], maxError[TRAJ_VZ]}) << ", przyspieszenia "
+            << std::max({maxError[TRAJ_AX], maxError[TRAJ_AY], maxError[TRAJ_AZ]}) << ", masy " << maxError[TRAJ_MASS]
+            << std::endl;
+  return compressed.frame_count() == reader.frame_count() ? 0 : 1;
+}
+
+int main(const int argc, const char** argv) {
+  if (argc < 3) {
+    return usage(argv[0]);
+  }
+  std::string command = argv[1];
+
+  if (command == "info") {
+    TrajectoryReader reader(argv[2]);
+    if (!reader.is_open()) {
+      return 1;
+    }
+    const TrajectoryFileHeader& header = reader.header();
+    std::cout << "Ciała: " << header.bodyCount << "\n"
+              << "Klatki: " << reader.frame_count() << "\n"
+              << "dt: " << header.dt << "\n"
+              << "Jednostki: " << header.units << "\n"
+              << "Precyzja: float" << header.scalarBytes * 8 << "\n"
+              << "Kompresja: " << trajectory_codec_name(reader.compression().codec) << "\n"
+              << "Pola:" << (header.fields & TRAJ_POSITIONS ? " pozycje" : "")
+              << (header.fields & TRAJ_VELOCITIES ? " prędkości" : "")
+              << (header.fields & TRAJ_ACCELERATIONS ? " przyspieszenia" : "")
+              << (header.fields & TRAJ_MASSES ? " masy" : "") << std::endl;
+    return 0;
+  }
+
+  if (argc < 4) {
+    return usage(argv[0]);
+  }
+
+  if (command == "to-json") {
+    bool gpuLayout = false;
+    for (int i = 4; i < argc; i++) {
+      if (std::strcmp(argv[i], "--gpu-layout") == 0) {
+        gpuLayout = true;
+      } else {
+        return usage(argv[0]);
+      }
+    }
+    return trajectory_to_json(argv[2], argv[3], gpuLayout) ? 0 : 1;
+  }
+
+  if (command == "from-json" || command == "compress") {
+    bool singlePrecision = false;
+    double dt = 0.0;
+    TrajectoryCompression compression;
+    for (int i = 4; i < argc; i++) {
+      if (std::strcmp(argv[i], "--float32") == 0) {
+        singlePrecision = true;
+      } else if (command == "from-json" && std::strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+        dt = atof(argv[++i]);
+      } else if (!parse_compression(argc, argv, i, compression)) {
+        return usage(argv[0]);
+      }
+    }
+    if (command == "compress") {
+      return compress(argv[2], argv[3], singlePrecision, compression);
+    }
+    return json_to_trajectory(argv[2], argv[3], singlePrecision, dt, compression) ? 0 : 1;
+  }
+
+  return usage(argv[0]);
+}
@@ -1,38 +1,26 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <fstream>
 #include "nlohmann/json.hpp"
 #include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <omp.h>
 
-#define G 6.67430e-11
+#include "../src/checkpoint.h"
+#include "../src/initial_conditions.h"
+#include "../src/particle_loader.h"
+#include "../src/physics.h"
+#include "../src/snapshot.h"
+#include "../src/trajectory.h"
 
-struct Body {
-  std::vector<double> x, y, z;
-  std::vector<double> vx, vy, vz;
-  std::vector<double> mass;
-
-  void resize(int n) {
-    x.resize(n);
-    y.resize(n);
-    z.resize(n);
-    vx.resize(n);
-    vy.resize(n);
-    vz.resize(n);
-    mass.resize(n);
-  }
-
-  nlohmann::json to_json(int i) const {
-    return {
-        {"position", {{"x", x[i]}, {"y", y[i]}, {"z", z[i]}}},
-        {"velocity", {{"x", vx[i]}, {"y", vy[i]}, {"z", vz[i]}}},
-        {"mass", mass[i]}};
-  }
-};
-
-void update_velocities(Body& bodies, int n, double dt);
-void update_positions(Body& bodies, int n, double dt);
-void save_state(const Body& bodies, int n, const std::string& filename, int step, bool append = true);
+// Plik w katalogu tymczasowym - testy zapisu nie zostawiają wyników w katalogu roboczym
+static std::string temp_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
 
 // --- Testy ---
 TEST(BodyTest, ResizeTest) {
@@ -100,7 +88,7 @@ TEST(SaveStateTest, JsonOutputTest) {
   bodies.vz = {0.0, 0.0};
   bodies.mass = {1.0, 1.0};
 
-  std::string filename = "test_output.json";
+  std::string filename = temp_path("test_output.json");
   save_state(bodies, 2, filename, 1, false);
 
   // Wczytanie pliku
@@ -115,6 +103,896 @@ TEST(SaveStateTest, JsonOutputTest) {
   ASSERT_EQ(jsonData[0]["step"], 1);
   EXPECT_NEAR(jsonData[0]["bodies"][0]["position"]["x"], 0.0, 1e-9);
   EXPECT_NEAR(jsonData[0]["bodies"][1]["position"]["x"], 1.0, 1e-9);
+  std::remove(filename.c_str());
+}
+
+TEST(SaveStateTest, AppendsToLegacyPrettyPrintedFile) {
+  Body bodies;
+  bodies.resize(2);
+  bodies.x = {0.0, 1.0};
+  bodies.y = {0.0, 0.0};
+  bodies.z = {0.0, 0.0};
+  bodies.vx = {0.0, 0.0};
+  bodies.vy = {0.0, 0.0};
+  bodies.vz = {0.0, 0.0};
+  bodies.mass = {1.0, 2.0};
+
+  // Plik w formacie poprzedniej wersji save_state (dump(2))
+  std::string filename = temp_path("test_legacy.json");
+  {
+    nlohmann::json legacy = nlohmann::json::array();
+    legacy.push_back({{"step", 0}, {"timestamp", 1}, {"bodies", nlohmann::json::array({bodies.to_json(0)})}});
+    std::ofstream outFile(filename);
+    outFile << legacy.dump(2);
+  }
+
+  save_state(bodies, 2, filename, 1, true);
+
+  std::ifstream inFile(filename);
+  nlohmann::json jsonData;
+  inFile >> jsonData;
+
+  ASSERT_EQ(jsonData.size(), 2);
+  EXPECT_EQ(jsonData[0]["step"], 0);
+  EXPECT_EQ(jsonData[1]["step"], 1);
+  EXPECT_EQ(jsonData[1]["bodies"].size(), 2);
+  EXPECT_EQ(jsonData[1]["bodies"][1]["mass"], 2.0);
+  std::remove(filename.c_str());
+}
+
+TEST(SnapshotTest, ArrayIsValidAfterEveryFrame) {
+  Body bodies;
+  bodies.resize(3);
+  bodies.x = {0.1, -2.5e-7, 1e300};
+  bodies.y = {1.0 / 3.0, 0.0, -0.0};
+  bodies.z = {42.0, 1e-300, 7.0};
+  bodies.vx = {0.0, 0.0, 0.0};
+  bodies.vy = {0.0, 0.0, 0.0};
+  bodies.vz = {0.0, 0.0, 0.0};
+  bodies.mass = {1.0, 2.0, 3.0};
+
+  std::string filename = "test_stream.json";
+  SnapshotWriter writer(filename, SnapshotFormat::JsonArray);
+  ASSERT_TRUE(writer.is_open());
+
+  for (int step = 0; step < 3; step++) {
+    writer.write(bodies, 3, step);
+
+    // Plik czytany w trakcie zapisu - writer jest wciąż otwarty
+    std::ifstream inFile(filename);
+    nlohmann::json jsonData;
+    inFile >> jsonData;
+    ASSERT_EQ(jsonData.size(), step + 1);
+    EXPECT_EQ(jsonData[step]["step"], step);
+
+    // Liczby zapisane bez utraty precyzji
+    for (int i = 0; i < 3; i++) {
+      EXPECT_EQ(jsonData[step]["bodies"][i]["position"]["x"].get<double>(), bodies.x[i]);
+      EXPECT_EQ(jsonData[step]["bodies"][i]["position"]["y"].get<double>(), bodies.y[i]);
+      EXPECT_EQ(jsonData[step]["bodies"][i]["position"]["z"].get<double>(), bodies.z[i]);
+    }
+    EXPECT_TRUE(jsonData[step]["bodies"][2]["mass"].is_number_float());
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(SnapshotTest, NdjsonWritesOneFramePerLine) {
+  Body bodies;
+  bodies.resize(2);
+  bodies.x = {0.0, 1.0};
+  bodies.y = {0.0, 0.0};
+  bodies.z = {0.0, 0.0};
+  bodies.vx = {0.5, 0.0};
+  bodies.vy = {0.0, 0.0};
+  bodies.vz = {0.0, 0.0};
+  bodies.mass = {1.0, 1.0};
+
+  std::string filename = "test_stream.ndjson";
+  ASSERT_EQ(snapshot_format_for(filename), SnapshotFormat::Ndjson);
+  ASSERT_EQ(snapshot_format_for("output.json"), SnapshotFormat::JsonArray);
+
+  save_state(bodies, 2, filename, 0, false);
+  save_state(bodies, 2, filename, 1, true);
+  save_state(bodies, 2, filename, 2, true);
+
+  std::ifstream inFile(filename);
+  std::string line;
+  int lines = 0;
+  while (std::getline(inFile, line)) {
+    nlohmann::json frame = nlohmann::json::parse(line);
+    EXPECT_EQ(frame["step"], lines);
+    EXPECT_EQ(frame["bodies"][0]["velocity"]["x"], 0.5);
+    lines++;
+  }
+  EXPECT_EQ(lines, 3);
+  std::remove(filename.c_str());
+}
+
+TEST(AsyncSnapshotTest, MatchesSynchronousOutput) {
+  Body bodies;
+  bodies.resize(50);
+  for (int i = 0; i < 50; i++) {
+    bodies.x[i] = 0.1 * i;
+    bodies.mass[i] = 1.0 + i;
+  }
+
+  std::string asyncFilename = "test_async.ndjson";
+  std::string syncFilename = "test_sync.ndjson";
+  {
+    AsyncSnapshotWriter asyncWriter(asyncFilename, SnapshotFormat::Ndjson);
+    SnapshotWriter syncWriter(syncFilename, SnapshotFormat::Ndjson);
+    ASSERT_TRUE(asyncWriter.is_open());
+    for (int step = 0; step < 10; step++) {
+      EXPECT_TRUE(asyncWriter.write(bodies, 50, step));
+      syncWriter.write(bodies, 50, step);
+      // Stan zmienia się od razu po zgłoszeniu - wątek zapisu pracuje na kopii
+      for (int i = 0; i < 50; i++) {
+        bodies.x[i] += 1.0;
+        bodies.vy[i] -= 0.5;
+      }
+    }
+    asyncWriter.flush();
+    SnapshotStats stats = asyncWriter.stats();
+    EXPECT_EQ(stats.framesWritten, 10u);
+    EXPECT_EQ(stats.framesDropped, 0u);
+  }
+
+  std::ifstream asyncFile(asyncFilename), syncFile(syncFilename);
+  std::string asyncLine, syncLine;
+  int lines = 0;
+  while (std::getline(syncFile, syncLine)) {
+    ASSERT_TRUE(std::getline(asyncFile, asyncLine));
+    nlohmann::json asyncFrame = nlohmann::json::parse(asyncLine), syncFrame = nlohmann::json::parse(syncLine);
+    asyncFrame.erase("timestamp");
+    syncFrame.erase("timestamp");
+    EXPECT_EQ(asyncFrame, syncFrame);
+    lines++;
+  }
+  EXPECT_EQ(lines, 10);
+  EXPECT_FALSE(std::getline(asyncFile, asyncLine));
+  std::remove(asyncFilename.c_str());
+  std::remove(syncFilename.c_str());
+}
+
+TEST(AsyncSnapshotTest, DroppedFramesAreCountedAndSkipped) {
+  Body bodies;
+  bodies.resize(20000);
+  std::string filename = "test_async_drop.json";
+  size_t accepted = 0;
+  std::vector<int> acceptedSteps;
+  {
+    // Jeden bufor - klatki zgłaszane szybciej, niż są zapisywane, mogą zostać pominięte
+    AsyncSnapshotWriter writer(filename, SnapshotFormat::JsonArray, false, 0.0, Backpressure::Drop, 1);
+    for (int step = 0; step < 20; step++) {
+      if (writer.write(bodies, 20000, step)) {
+        accepted++;
+        acceptedSteps.push_back(step);
+      }
+    }
+    writer.flush();
+    SnapshotStats stats = writer.stats();
+    EXPECT_EQ(stats.framesWritten, accepted);
+    EXPECT_EQ(stats.framesWritten + stats.framesDropped, 20u);
+    EXPECT_GE(accepted, 1u);
+  }
+
+  std::ifstream inFile(filename);
+  nlohmann::json jsonData;
+  inFile >> jsonData;
+  ASSERT_EQ(jsonData.size(), accepted);
+  for (size_t k = 0; k < accepted; k++) {
+    EXPECT_EQ(jsonData[k]["step"], acceptedSteps[k]);
+  }
+  std::remove(filename.c_str());
+}
+
+static const double* column_of(const Body& bodies, int column) {
+  const Column* columns[TRAJ_COLUMNS] = {&bodies.x,  &bodies.y,  &bodies.z,  &bodies.vx, &bodies.vy,
+                                                      &bodies.vz, &bodies.ax, &bodies.ay, &bodies.az, &bodies.mass};
+  return columns[column]->data();
+}
+
+static Body make_trajectory_bodies(int n) {
+  Body bodies;
+  bodies.resize(n);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = 0.1 * i;
+    bodies.y[i] = -1.0 / (i + 1);
+    bodies.z[i] = 1e-7 * i * i;
+    bodies.vx[i] = 0.5 * i;
+    bodies.vy[i] = 0.25;
+    bodies.vz[i] = -0.125 * i;
+    bodies.ax[i] = 3.0 * i;
+    bodies.ay[i] = 0.0;
+    bodies.az[i] = -1.0;
+    bodies.mass[i] = 1.0 + i;
+  }
+  return bodies;
+}
+
+TEST(TrajectoryTest, FramesReadBackWithoutCopying) {
+  const int n = 5;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_trajectory.nbt";
+  {
+    SnapshotWriter writer(filename, snapshot_format_for(filename), false, 0.01);
+    for (int step = 0; step < 4; step++) {
+      writer.write(bodies, n, step * 10);
+      update_positions(bodies, n, 1.0);
+    }
+  }
+
+  TrajectoryReader reader(filename);
+  ASSERT_TRUE(reader.is_open());
+  EXPECT_EQ(reader.header().bodyCount, (uint64_t)n);
+  EXPECT_EQ(reader.header().fields, (uint32_t)TRAJ_ALL_FIELDS);
+  EXPECT_DOUBLE_EQ(reader.header().dt, 0.01);
+  ASSERT_EQ(reader.frame_count(), 4u);
+
+  Body expected = make_trajectory_bodies(n);
+  for (size_t k = 0; k < 4; k++) {
+    TrajectoryFrame frame = reader.frame(k);
+    EXPECT_EQ(frame.header->step, (int64_t)k * 10);
+    EXPECT_DOUBLE_EQ(frame.header->time, k * 10 * 0.01);
+    // Kolumny są wyrównane do 8 bajtów i czytane wprost z pliku
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(frame.columns[TRAJ_X]) % 8, 0u);
+    const double* x = static_cast<const double*>(frame.columns[TRAJ_X]);
+    for (int i = 0; i < n; i++) {
+      EXPECT_EQ(x[i], expected.x[i]);
+      EXPECT_EQ(frame.value(TRAJ_AX, i), expected.ax[i]);
+      EXPECT_EQ(frame.value(TRAJ_MASS, i), expected.mass[i]);
+    }
+    update_positions(expected, n, 1.0);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(TrajectoryTest, AppendAndRecoveryWithoutIndex) {
+  const int n = 3;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_trajectory_append.nbt";
+
+  save_state(bodies, n, filename, 0, false);
+  save_state(bodies, n, filename, 1, true);
+  save_state(bodies, n, filename, 2, true);
+  {
+    TrajectoryReader reader(filename);
+    ASSERT_EQ(reader.frame_count(), 3u);
+    EXPECT_EQ(reader.frame(2).header->step, 2);
+  }
+
+  uint64_t frameBytes;
+  {
+    TrajectoryWriter writer(filename, n, 0.0, TRAJ_ALL_FIELDS, false, true);
+    ASSERT_EQ(writer.frame_count(), 3u);
+    writer.write(bodies, 3, 0.0);
+    frameBytes = trajectory_frame_bytes(writer.header());
+  }
+
+  // Przerwany zapis: plik bez indeksu i stopki, z niepełną ostatnią klatką
+  std::filesystem::resize_file(filename, sizeof(TrajectoryFileHeader) + 3 * frameBytes + frameBytes / 2);
+  {
+    TrajectoryReader reader(filename);
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(reader.frame_count(), 3u);
+    EXPECT_EQ(reader.frame(2).header->step, 2);
+    EXPECT_EQ(reader.frame(2).value(TRAJ_MASS, 2), 3.0);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(TrajectoryTest, Float32ColumnsAndJsonRoundTrip) {
+  const int n = 4;
+  Body bodies = make_trajectory_bodies(n);
+  std::string json = "test_trajectory_in.json";
+  std::string binary = "test_trajectory_f32.nbt";
+  std::string back = "test_trajectory_out.ndjson";
+
+  save_state(bodies, n, json, 0, false);
+  update_positions(bodies, n, 1.0);
+  save_state(bodies, n, json, 1, true);
+
+  ASSERT_TRUE(json_to_trajectory(json, binary, true, 0.5));
+  {
+    TrajectoryReader reader(binary);
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.header().scalarBytes, 4u);
+    EXPECT_EQ(reader.header().fields, (uint32_t)(TRAJ_POSITIONS | TRAJ_VELOCITIES | TRAJ_MASSES));
+    ASSERT_EQ(reader.frame_count(), 2u);
+    TrajectoryFrame frame = reader.frame(1);
+    EXPECT_EQ(frame.columns[TRAJ_AX], nullptr);
+    for (int i = 0; i < n; i++) {
+      EXPECT_EQ(frame.value(TRAJ_X, i), (double)(float)bodies.x[i]);
+    }
+  }
+
+  ASSERT_TRUE(trajectory_to_json(binary, back));
+  std::ifstream inFile(back);
+  std::string line;
+  int frames = 0;
+  while (std::getline(inFile, line)) {
+    nlohmann::json frame = nlohmann::json::parse(line);
+    EXPECT_EQ(frame["step"], frames);
+    EXPECT_EQ(frame["bodies"].size(), (size_t)n);
+    EXPECT_EQ(frame["bodies"][3]["mass"], 4.0);
+    frames++;
+  }
+  EXPECT_EQ(frames, 2);
+
+  std::remove(json.c_str());
+  std::remove(binary.c_str());
+  std::remove(back.c_str());
+}
+
+TEST(TrajectoryTest, XorCodecIsLosslessAcrossKeyframesAndAppend) {
+  const int n = 33;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_trajectory_xor.nbt";
+  TrajectoryCompression compression;
+  compression.codec = TRAJ_CODEC_XOR;
+  compression.keyframeInterval = 3;
+
+  std::vector<Body> expected;
+  {
+    TrajectoryWriter writer(filename, n, 0.1, TRAJ_ALL_FIELDS, false, false, TRAJECTORY_DEFAULT_UNITS, compression);
+    for (int step = 0; step < 5; step++) {
+      writer.write(bodies, step, step * 0.1);
+      expected.push_back(bodies);
+      update_positions(bodies, n, 0.37);
+    }
+  }
+  // Dopisywanie kontynuuje predykcję od ostatniej zapisanej klatki
+  uint64_t compressedEnd;
+  {
+    TrajectoryWriter writer(filename, n, 0.1, TRAJ_ALL_FIELDS, false, true, TRAJECTORY_DEFAULT_UNITS, compression);
+    ASSERT_EQ(writer.frame_count(), 5u);
+    for (int step = 5; step < 8; step++) {
+      writer.write(bodies, step, step * 0.1);
+      expected.push_back(bodies);
+      update_positions(bodies, n, 0.37);
+    }
+    compressedEnd = writer.header().headerBytes + writer.frame_bytes_written();
+    EXPECT_LT(writer.frame_bytes_written(), 8 * trajectory_frame_bytes(writer.header()));
+  }
+
+  // Bez indeksu klatki odnajdywane są po rozmiarach z nagłówków; odczyt w dowolnej kolejności
+  for (bool truncated : {false, true}) {
+    if (truncated) std::filesystem::resize_file(filename, compressedEnd);
+    TrajectoryReader reader(filename);
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.compression().codec, TRAJ_CODEC_XOR);
+    ASSERT_EQ(reader.frame_count(), 8u);
+    for (size_t k : {7u, 2u, 3u, 4u, 0u, 6u, 5u, 1u}) {
+      TrajectoryFrame frame = reader.frame(k);
+      EXPECT_EQ(frame.header->step, (int64_t)k);
+      for (int i = 0; i < n; i++) {
+        EXPECT_EQ(frame.value(TRAJ_X, i), expected[k].x[i]);
+        EXPECT_EQ(frame.value(TRAJ_Z, i), expected[k].z[i]);
+        EXPECT_EQ(frame.value(TRAJ_VZ, i), expected[k].vz[i]);
+        EXPECT_EQ(frame.value(TRAJ_MASS, i), expected[k].mass[i]);
+      }
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(TrajectoryTest, QuantizedCodecRespectsToleranceAndKeepsMasses) {
+  const int n = 200;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_trajectory_quantized.nbt";
+  TrajectoryCompression compression;
+  compression.codec = TRAJ_CODEC_QUANTIZE;
+  compression.tolerance = 1e-5;
+  compression.keyframeInterval = 4;
+
+  std::vector<Body> expected;
+  uint64_t compressedBytes, rawBytes;
+  {
+    TrajectoryWriter writer(filename, n, 0.1, TRAJ_ALL_FIELDS, false, false, TRAJECTORY_DEFAULT_UNITS, compression);
+    for (int step = 0; step < 10; step++) {
+      writer.write(bodies, step, step * 0.1);
+      expected.push_back(bodies);
+      update_positions(bodies, n, 0.01);
+    }
+    compressedBytes = writer.frame_bytes_written();
+    rawBytes = 10 * trajectory_frame_bytes(writer.header());
+  }
+  EXPECT_LT(compressedBytes * 3, rawBytes);
+
+  TrajectoryReader reader(filename);
+  ASSERT_TRUE(reader.is_open());
+  EXPECT_EQ(reader.compression().codec, TRAJ_CODEC_QUANTIZE);
+  EXPECT_DOUBLE_EQ(reader.compression().tolerance, 1e-5);
+  ASSERT_EQ(reader.frame_count(), 10u);
+  // Błąd ograniczony przez tolerancję razy największy bok prostopadłościanu otaczającego grupę pól
+  const int groups[3] = {TRAJ_X, TRAJ_VX, TRAJ_AX};
+  for (size_t k = 0; k < 10; k++) {
+    TrajectoryFrame frame = reader.frame(k);
+    for (int g : groups) {
+      double extent = 0.0;
+      for (int c = g; c < g + 3; c++) {
+        const double* values = column_of(expected[k], c);
+        auto range = std::minmax_element(values, values + n);
+        extent = std::max(extent, *range.second - *range.first);
+      }
+      for (int c = g; c < g + 3; c++) {
+        for (int i = 0; i < n; i++) {
+          EXPECT_LE(std::fabs(frame.value(c, i) - column_of(expected[k], c)[i]), 1e-5 * extent * (1 + 1e-9))
+              << "klatka " << k << ", kolumna " << c << ", ciało " << i;
+        }
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      EXPECT_EQ(frame.value(TRAJ_MASS, i), expected[k].mass[i]);
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(TrajectoryTest, MismatchedAppendLeavesFileIntact) {
+  const int n = 12;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_trajectory_mismatch.nbt";
+  TrajectoryCompression xorCompression;
+  xorCompression.codec = TRAJ_CODEC_XOR;
+  {
+    TrajectoryWriter writer(filename, n, 0.1, TRAJ_ALL_FIELDS, false, false, TRAJECTORY_DEFAULT_UNITS,
+                            xorCompression);
+    for (int step = 0; step < 4; step++) {
+      writer.write(bodies, step, step * 0.1);
+    }
+  }
+  const uintmax_t size = std::filesystem::file_size(filename);
+
+  // Inny kodek albo liczba ciał: dopisywanie odmawia, a plik zostaje bez zmian
+  std::string reason;
+  EXPECT_TRUE(trajectory_can_append(filename, n, TRAJ_ALL_FIELDS, false, TRAJ_CODEC_XOR, reason));
+  EXPECT_FALSE(trajectory_can_append(filename, n, TRAJ_ALL_FIELDS, false, TRAJ_CODEC_NONE, reason));
+  EXPECT_FALSE(reason.empty());
+  EXPECT_FALSE(trajectory_can_append(filename, n + 1, TRAJ_ALL_FIELDS, false, TRAJ_CODEC_XOR, reason));
+  {
+    TrajectoryWriter writer(filename, n, 0.1, TRAJ_ALL_FIELDS, false, true);
+    EXPECT_FALSE(writer.is_open());
+    writer.write(bodies, 4, 0.4);
+  }
+  EXPECT_EQ(std::filesystem::file_size(filename), size);
+  TrajectoryReader reader(filename);
+  ASSERT_TRUE(reader.is_open());
+  EXPECT_EQ(reader.compression().codec, TRAJ_CODEC_XOR);
+  EXPECT_EQ(reader.frame_count(), 4u);
+  std::remove(filename.c_str());
+}
+
+TEST(CheckpointTest, RestartContinuesBitExactly) {
+  const int n = 300;
+  const double dt = 0.05;
+  std::string filename = "test_checkpoint.nbc";
+  for (Kernel kernel : {Kernel::Symmetric, Kernel::Simd, Kernel::Tiled}) {
+    Body initial;
+    initial.resize(n);
+    srand(11);
+    for (int i = 0; i < n; i++) {
+      initial.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+      initial.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+      initial.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+      initial.mass[i] = 1e9 * (1.0 + rand() / (double)RAND_MAX * 9.0);
+    }
+    CheckpointState state;
+    state.dt = dt;
+    state.kernel = kernel;
+    state.isa = detect_simd_isa();
+    state.tileSize = 64;
+    state.threads = omp_get_max_threads();
+    state.rng = "12345 67890";
+    state.compression.codec = TRAJ_CODEC_QUANTIZE;
+    state.compression.tolerance = 1e-4;
+
+    Body straight = initial;
+    for (int step = 1; step <= 6; step++) {
+      update_velocities(straight, n, dt, kernel, state.isa, state.tileSize);
+      update_positions(straight, n, dt);
+    }
+
+    Body interrupted = initial;
+    for (int step = 1; step <= 3; step++) {
+      update_velocities(interrupted, n, dt, kernel, state.isa, state.tileSize);
+      update_positions(interrupted, n, dt);
+    }
+    state.step = 3;
+    state.time = 3 * dt;
+    ASSERT_TRUE(write_checkpoint(filename, interrupted, n, state));
+    EXPECT_FALSE(std::filesystem::exists(filename + ".tmp"));
+
+    Body resumed;
+    int restoredCount = 0;
+    CheckpointState restored;
+    ASSERT_TRUE(read_checkpoint(filename, resumed, restoredCount, restored));
+    ASSERT_EQ(restoredCount, n);
+    EXPECT_EQ(restored.step, 3);
+    EXPECT_EQ(restored.kernel, kernel);
+    EXPECT_EQ(restored.tileSize, 64);
+    EXPECT_EQ(restored.rng, state.rng);
+    EXPECT_EQ(restored.compression.codec, TRAJ_CODEC_QUANTIZE);
+    EXPECT_EQ(restored.compression.tolerance, 1e-4);
+    for (int step = 4; step <= 6; step++) {
+      update_velocities(resumed, n, restored.dt, restored.kernel, restored.isa, restored.tileSize);
+      update_positions(resumed, n, restored.dt);
+    }
+    for (int i = 0; i < n; i++) {
+      EXPECT_EQ(resumed.x[i], straight.x[i]);
+      EXPECT_EQ(resumed.vy[i], straight.vy[i]);
+      EXPECT_EQ(resumed.vz[i], straight.vz[i]);
+      EXPECT_EQ(resumed.az[i], straight.az[i]);
+      EXPECT_EQ(resumed.mass[i], straight.mass[i]);
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(CheckpointTest, RestartCutsFramesWrittenAfterCheckpoint) {
+  const int n = 5;
+  const double dt = 0.1;
+  Body bodies = make_trajectory_bodies(n);
+  TrajectoryCompression xorCompression;
+  xorCompression.codec = TRAJ_CODEC_XOR;
+  xorCompression.keyframeInterval = 2;
+  const std::pair<std::string, TrajectoryCompression> outputs[] = {{"test_restart.nbt", TrajectoryCompression()},
+                                                                    {"test_restart_xor.nbt", xorCompression},
+                                                                    {"test_restart.json", TrajectoryCompression()},
+                                                                    {"test_restart.ndjson", TrajectoryCompression()}};
+
+  for (const auto &[filename, compression] : outputs) {
+    SnapshotFormat format = snapshot_format_for(filename);
+    // Przerwany przebieg: klatki co 5 kroków, punkt kontrolny w kroku 10, awaria po kroku 20
+    {
+      SnapshotWriter writer(filename, format, false, dt, compression);
+      for (int step = 0; step <= 20; step += 5) {
+        bodies.x[0] = step;
+        writer.write(bodies, n, step);
+      }
+    }
+    // Wznowienie od kroku 10 zapisuje kroki 15 i 20 ponownie
+    {
+      SnapshotWriter writer(filename, format, true, dt, compression, 10);
+      ASSERT_TRUE(writer.is_open()) << filename;
+      for (int step = 15; step <= 25; step += 5) {
+        bodies.x[0] = step;
+        writer.write(bodies, n, step);
+      }
+    }
+
+    std::vector<int64_t> steps;
+    std::vector<double> x;
+    if (format == SnapshotFormat::Binary) {
+      TrajectoryReader reader(filename);
+      ASSERT_TRUE(reader.is_open()) << filename;
+      for (size_t k = 0; k < reader.frame_count(); k++) {
+        TrajectoryFrame frame = reader.frame(k);
+        steps.push_back(frame.header->step);
+        x.push_back(frame.value(TRAJ_X, 0));
+      }
+    } else {
+      std::ifstream inFile(filename);
+      std::vector<nlohmann::json> frames;
+      if (format == SnapshotFormat::JsonArray) {
+        nlohmann::json array;
+        inFile >> array;
+        frames.assign(array.begin(), array.end());
+      } else {
+        for (std::string line; std::getline(inFile, line);) frames.push_back(nlohmann::json::parse(line));
+      }
+      for (const nlohmann::json &frame : frames) {
+        steps.push_back(frame["step"]);
+        x.push_back(frame["bodies"][0]["position"]["x"]);
+      }
+    }
+    EXPECT_EQ(steps, (std::vector<int64_t>{0, 5, 10, 15, 20, 25})) << filename;
+    EXPECT_EQ(x, (std::vector<double>{0, 5, 10, 15, 20, 25})) << filename;
+    std::remove(filename.c_str());
+  }
+}
+
+TEST(CheckpointTest, IncompleteCheckpointIsRejectedAndPreviousKept) {
+  const int n = 10;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_checkpoint_atomic.nbc";
+  CheckpointState state;
+  state.step = 7;
+  ASSERT_TRUE(write_checkpoint(filename, bodies, n, state));
+  const uintmax_t size = std::filesystem::file_size(filename);
+
+  // Nieudany zapis (brak katalogu) nie narusza istniejącego punktu kontrolnego
+  EXPECT_FALSE(write_checkpoint("brak_katalogu/checkpoint.nbc", bodies, n, state));
+  Body restored;
+  int count = 0;
+  CheckpointState restoredState;
+  ASSERT_TRUE(read_checkpoint(filename, restored, count, restoredState));
+  EXPECT_EQ(restoredState.step, 7);
+  EXPECT_EQ(restored.mass[9], bodies.mass[9]);
+
+  // Plik ucięty w trakcie kopiowania jest odrzucany
+  std::filesystem::resize_file(filename, size - 8);
+  EXPECT_FALSE(read_checkpoint(filename, restored, count, restoredState));
+  std::remove(filename.c_str());
+}
+
+// Nadpisuje pole nagłówka punktu kontrolnego - plik ma nadal poprawny rozmiar
+template <typename T>
+static void patch_checkpoint(const std::string &filename, size_t offset, T value) {
+  std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+TEST(CheckpointTest, OutOfRangeFieldsAreRejectedAndVersion1IsUncompressed) {
+  const int n = 4;
+  Body bodies = make_trajectory_bodies(n);
+  std::string filename = "test_checkpoint_fields.nbc";
+  CheckpointState state;
+  state.kernel = Kernel::Tiled;
+  state.compression.codec = TRAJ_CODEC_XOR;
+  state.compression.keyframeInterval = 8;
+
+  Body restored;
+  int count = 0;
+  CheckpointState restoredState;
+  const std::pair<size_t, uint32_t> corrupt[] = {{offsetof(CheckpointHeader, kernel), 3},
+                                                  {offsetof(CheckpointHeader, isa), 17},
+                                                  {offsetof(CheckpointHeader, codec), 3},
+                                                  {offsetof(CheckpointHeader, keyframeInterval), 0},
+                                                  {offsetof(CheckpointHeader, threads), 0}};
+  for (const auto &[offset, value] : corrupt) {
+    ASSERT_TRUE(write_checkpoint(filename, bodies, n, state));
+    patch_checkpoint(filename, offset, value);
+    EXPECT_FALSE(read_checkpoint(filename, restored, count, restoredState)) << offset;
+  }
+
+  // Wersja 1: pola kompresji były zarezerwowane i wyzerowane - wznowienie bez kompresji
+  ASSERT_TRUE(write_checkpoint(filename, bodies, n, state));
+  patch_checkpoint(filename, offsetof(CheckpointHeader, version), (uint32_t)1);
+  patch_checkpoint(filename, offsetof(CheckpointHeader, codec), (uint32_t)0);
+  patch_checkpoint(filename, offsetof(CheckpointHeader, keyframeInterval), (uint32_t)0);
+  patch_checkpoint(filename, offsetof(CheckpointHeader, tolerance), 0.0);
+  ASSERT_TRUE(read_checkpoint(filename, restored, count, restoredState));
+  EXPECT_EQ(restoredState.kernel, Kernel::Tiled);
+  EXPECT_EQ(restoredState.compression.codec, TRAJ_CODEC_NONE);
+  EXPECT_EQ(restoredState.compression.keyframeInterval, TrajectoryCompression().keyframeInterval);
+  EXPECT_EQ(restoredState.compression.tolerance, TrajectoryCompression().tolerance);
+  std::remove(filename.c_str());
+}
+
+// Wektory kontrolne Philox4x32-10 z biblioteki Random123 (kat_vectors)
+TEST(InitialConditionsTest, PhiloxMatchesKnownAnswers) {
+  uint32_t out[4];
+  const uint32_t zero[4] = {0, 0, 0, 0};
+  Philox4x32(0)(zero, out);
+  EXPECT_EQ(out[0], 0x6627e8d5u);
+  EXPECT_EQ(out[1], 0xe169c58du);
+  EXPECT_EQ(out[2], 0xbc57ac4cu);
+  EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+  const uint32_t pi[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+  Philox4x32(0x299f31d0a4093822ull)(pi, out);
+  EXPECT_EQ(out[0], 0xd16cfe09u);
+  EXPECT_EQ(out[1], 0x94fdccebu);
+  EXPECT_EQ(out[2], 0x5001e420u);
+  EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+TEST(InitialConditionsTest, SameSeedGivesSameBodiesForAnyThreadCount) {
+  const int n = 5000;
+  int defaultThreads = omp_get_max_threads();
+  for (InitialModel model : {InitialModel::Uniform, InitialModel::Plummer, InitialModel::Hernquist,
+                             InitialModel::ExponentialDisk, InitialModel::CollidingGalaxies}) {
+    InitialConditions ic;
+    ic.model = model;
+    ic.seed = 20240601;
+    Body serial, parallel;
+    omp_set_num_threads(1);
+    generate_initial_conditions(serial, n, ic);
+    omp_set_num_threads(4);
+    generate_initial_conditions(parallel, n, ic);
+
+    for (int c = 0; c < TRAJ_COLUMNS; c++) {
+      EXPECT_EQ(std::memcmp(column_of(serial, c), column_of(parallel, c), n * sizeof(double)), 0)
+          << initial_model_name(model) << ", kolumna " << c;
+    }
+    // Inne ziarno - inne ciała
+    ic.seed++;
+    generate_initial_conditions(parallel, n, ic);
+    EXPECT_NE(serial.x[0], parallel.x[0]) << initial_model_name(model);
+  }
+  omp_set_num_threads(defaultThreads);
+}
+
+TEST(InitialConditionsTest, PlummerSphereIsInVirialEquilibrium) {
+  const int n = 4000;
+  const double a = 10.0;
+  InitialConditions ic;
+  ic.model = InitialModel::Plummer;
+  ic.seed = 42;
+  ic.scale = a;
+  Body bodies;
+  generate_initial_conditions(bodies, n, ic);
+
+  // Środek masy i pęd całkowity w zerze
+  double mass = 0.0, cx = 0.0, px = 0.0;
+  for (int i = 0; i < n; i++) {
+    mass += bodies.mass[i];
+    cx += bodies.mass[i] * bodies.x[i];
+    px += bodies.mass[i] * bodies.vx[i];
+  }
+  EXPECT_NEAR(cx / mass, 0.0, 1e-9 * a);
+  EXPECT_NEAR(mass, 5.5 * n, 1e-9 * mass);
+
+  // Promień połowy masy: a / sqrt(2^(2/3) - 1) = 1.305 a
+  std::vector<double> radii(n);
+  for (int i = 0; i < n; i++) {
+    radii[i] = std::sqrt(bodies.x[i] * bodies.x[i] + bodies.y[i] * bodies.y[i] + bodies.z[i] * bodies.z[i]);
+  }
+  std::nth_element(radii.begin(), radii.begin() + n / 2, radii.end());
+  EXPECT_NEAR(radii[n / 2] / a, 1.305, 0.06);
+
+  // Równowaga wirialna 2T / |W| = 1 (z dokładnością do szumu próbkowania i obcięcia)
+  double kinetic = 0.0, potential = 0.0;
+  for (int i = 0; i < n; i++) {
+    kinetic += 0.5 * bodies.mass[i] *
+               (bodies.vx[i] * bodies.vx[i] + bodies.vy[i] * bodies.vy[i] + bodies.vz[i] * bodies.vz[i]);
+    for (int j = i + 1; j < n; j++) {
+      double dx = bodies.x[i] - bodies.x[j], dy = bodies.y[i] - bodies.y[j], dz = bodies.z[i] - bodies.z[j];
+      potential -= G * bodies.mass[i] * bodies.mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+  }
+  EXPECT_NEAR(2.0 * kinetic / -potential, 1.0, 0.08);
+  EXPECT_NEAR(px / mass, 0.0, 1e-9 * std::sqrt(2.0 * kinetic / mass));
+}
+
+TEST(InitialConditionsTest, ExponentialDiskHasExpectedProfileAndRotation) {
+  const int n = 20000;
+  const double Rd = 10.0;
+  InitialConditions ic;
+  ic.model = InitialModel::ExponentialDisk;
+  ic.seed = 7;
+  ic.scale = Rd;
+  Body bodies;
+  generate_initial_conditions(bodies, n, ic);
+
+  // Średni promień dysku wykładniczego to 2 Rd; wszystkie ciała krążą w tę samą stronę
+  double meanR = 0.0, meanZ = 0.0;
+  int prograde = 0;
+  for (int i = 0; i < n; i++) {
+    meanR += std::sqrt(bodies.x[i] * bodies.x[i] + bodies.y[i] * bodies.y[i]) / n;
+    meanZ += std::abs(bodies.z[i]) / n;
+    prograde += bodies.x[i] * bodies.vy[i] - bodies.y[i] * bodies.vx[i] > 0.0;
+  }
+  EXPECT_NEAR(meanR / Rd, 2.0, 0.05);
+  EXPECT_LT(meanZ, 2.0 * ic.diskThickness * Rd);
+  EXPECT_GT(prograde, 0.99 * n);
+}
+
+// Liczby zapisane z 17 cyframi wczytują się bit w bit przy każdym podziale pliku na fragmenty - także gdy granica
+// wypada w środku linii, w komentarzu albo w pustej linii
+TEST(ParticleLoaderTest, CsvIsIndependentOfChunkCount) {
+  const int n = 300;
+  InitialConditions ic;
+  ic.model = InitialModel::Plummer;
+  ic.seed = 11;
+  Body expected;
+  generate_initial_conditions(expected, n, ic);
+
+  std::string filename = "test_particles.csv";
+  {
+    std::ofstream out(filename);
+    out.precision(17);
+    out << "# warunki początkowe\r\nid; mass; x; y; z; vx; vy; vz\r\n";
+    for (int i = 0; i < n; i++) {
+      out << i << "; " << expected.mass[i] << "; " << expected.x[i] << ";" << expected.y[i] << "; +"
+          << expected.z[i] << "\t;" << expected.vx[i] << ";" << expected.vy[i] << ";" << expected.vz[i] << "\r\n";
+      if (i % 37 == 0) out << "\r\n# komentarz\r\n";
+    }
+  }
+  for (int chunks : {1, 3, 64, 5000}) {
+    Body bodies;
+    int loaded = 0;
+    ASSERT_TRUE(load_particles(filename, bodies, loaded, chunks)) << chunks;
+    ASSERT_EQ(loaded, n);
+    for (int c = 0; c < TRAJ_COLUMNS; c++) {
+      EXPECT_EQ(std::memcmp(column_of(bodies, c), column_of(expected, c), n * sizeof(double)), 0) << c;
+    }
+  }
+
+  // Bez nagłówka: 4 kolumny to x, y, z, mass; błędna liczba w dowolnym fragmencie odrzuca plik
+  Body bodies;
+  int loaded = 0;
+  { std::ofstream(filename) << "1 2 3 10\n4 5 6 20"; }
+  ASSERT_TRUE(load_particles(filename, bodies, loaded, 2));
+  ASSERT_EQ(loaded, 2);
+  EXPECT_EQ(bodies.z[1], 6.0);
+  EXPECT_EQ(bodies.vx[1], 0.0);
+  EXPECT_EQ(bodies.mass[1], 20.0);
+  { std::ofstream(filename) << "x,y,z,mass\n1,2,3,4\n1,2,oops,4\n"; }
+  EXPECT_FALSE(load_particles(filename, bodies, loaded, 2));
+  { std::ofstream(filename) << "1,2,3,4,5\n"; }
+  EXPECT_FALSE(load_particles(filename, bodies, loaded));
+  { std::ofstream(filename) << "# tylko komentarz\n"; }
+  EXPECT_FALSE(load_particles(filename, bodies, loaded));
+  EXPECT_FALSE(load_particles("brak_pliku.csv", bodies, loaded));
+  std::remove(filename.c_str());
+}
+
+// Przebieg może zacząć się od ostatniej klatki zapisu JSON, NDJSON albo .nbt (także skompresowanego)
+TEST(ParticleLoaderTest, StartsFromLastSavedFrame) {
+  const int n = 40;
+  TrajectoryCompression xorCodec;
+  xorCodec.codec = TRAJ_CODEC_XOR;
+  for (std::string filename : {"test_particles.json", "test_particles.ndjson", "test_particles.nbt"}) {
+    Body bodies = make_trajectory_bodies(n);
+    {
+      SnapshotWriter writer(filename, snapshot_format_for(filename), false, 0.01, xorCodec);
+      writer.write(bodies, n, 0);
+      update_positions(bodies, n, 1.0);
+      writer.write(bodies, n, 1);
+    }
+    Body loaded;
+    int count = 0;
+    for (int chunks : {1, 7}) {
+      ASSERT_TRUE(load_particles(filename, loaded, count, chunks)) << filename;
+      ASSERT_EQ(count, n);
+      for (int i = 0; i < n; i++) {
+        EXPECT_EQ(loaded.x[i], bodies.x[i]) << filename;
+        EXPECT_EQ(loaded.vz[i], bodies.vz[i]) << filename;
+        EXPECT_EQ(loaded.mass[i], bodies.mass[i]) << filename;
+        EXPECT_EQ(loaded.ax[i], 0.0) << filename;
+      }
+    }
+    std::remove(filename.c_str());
+  }
+
+  // Układ GPU_BH / GPU_2_pair (p, v, m, bez z w 2D); przerwany zapis i ciało bez masy są odrzucane
+  std::string filename = "test_particles_gpu.json";
+  { std::ofstream(filename) << "[{\"bodies\": [{\"id\": 0, \"m\": 1e+16, \"p\": {\"x\": 2.5, \"y\": -3.5}, "
+                               "\"v\": {\"x\": -8.0, \"y\": 2.0}}]}]"; }
+  Body loaded;
+  int count = 0;
+  ASSERT_TRUE(load_particles(filename, loaded, count));
+  ASSERT_EQ(count, 1);
+  EXPECT_EQ(loaded.mass[0], 1e16);
+  EXPECT_EQ(loaded.y[0], -3.5);
+  EXPECT_EQ(loaded.z[0], 0.0);
+  EXPECT_EQ(loaded.vx[0], -8.0);
+  { std::ofstream(filename) << "{\"bodies\":[{\"p\":{\"x\":1,\"y\":2},\"m\":3},{\"p\":{\"x\":1"; }
+  EXPECT_FALSE(load_particles(filename, loaded, count));
+  { std::ofstream(filename) << "{\"bodies\":[{\"p\":{\"x\":1,\"y\":2},\"m\":3},{\"p\":{\"x\":1,\"y\":2}}]}\n"; }
+  EXPECT_FALSE(load_particles(filename, loaded, count));
+  std::remove(filename.c_str());
+}
+
+// Surowe rekordy 7 x float64 (np. numpy tofile())
+TEST(ParticleLoaderTest, RawBinaryRecords) {
+  const int n = 50;
+  Body expected = make_trajectory_bodies(n);
+  std::vector<double> records;
+  for (int i = 0; i < n; i++) {
+    records.insert(records.end(), {expected.x[i], expected.y[i], expected.z[i], expected.vx[i], expected.vy[i],
+                                   expected.vz[i], expected.mass[i]});
+  }
+  std::string filename = "test_particles.bin";
+  {
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(double));
+  }
+  Body bodies;
+  int loaded = 0;
+  ASSERT_TRUE(load_particles(filename, bodies, loaded));
+  ASSERT_EQ(loaded, n);
+  EXPECT_EQ(bodies.x[7], expected.x[7]);
+  EXPECT_EQ(bodies.vz[49], expected.vz[49]);
+  EXPECT_EQ(bodies.mass[13], expected.mass[13]);
+  EXPECT_EQ(bodies.ax[7], 0.0);
+
+  std::filesystem::resize_file(filename, 6 * sizeof(double));
+  EXPECT_FALSE(load_particles(filename, bodies, loaded));
+  std::remove(filename.c_str());
 }
 
 TEST(BoundaryTest, NoBodiesTest) {
@@ -213,6 +1091,223 @@ TEST(GravityTest, LargeMassDifference) {
   EXPECT_GT(std::abs(bodies.vx[1]), std::abs(bodies.vx[0]));
 }
 
+// Bezpośrednia suma bez symetrii: każde ciało zbiera siły od wszystkich pozostałych
+static void direct_accelerations(const Body &bodies, int n, std::vector<double> &ax, std::vector<double> &ay,
+                                 std::vector<double> &az) {
+  ax.assign(n, 0.0);
+  ay.assign(n, 0.0);
+  az.assign(n, 0.0);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      if (i == j) continue;
+      double dx = bodies.x[j] - bodies.x[i];
+      double dy = bodies.y[j] - bodies.y[i];
+      double dz = bodies.z[j] - bodies.z[i];
+      double dist = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-9;
+      double F = G * bodies.mass[j] / (dist * dist);
+      ax[i] += F * dx / dist;
+      ay[i] += F * dy / dist;
+      az[i] += F * dz / dist;
+    }
+  }
+}
+
+TEST(GravityTest, SymmetricKernelMatchesDirectSum) {
+  const int n = 300;
+  Body bodies;
+  bodies.resize(n);
+
+  srand(42);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.vx[i] = bodies.vy[i] = bodies.vz[i] = 0.0;
+    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  }
+
+  std::vector<double> ax, ay, az;
+  direct_accelerations(bodies, n, ax, ay, az);
+
+  compute_accelerations(bodies, n);
+
+  for (int i = 0; i < n; i++) {
+    double scale = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+    EXPECT_NEAR(bodies.ax[i], ax[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.ay[i], ay[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.az[i], az[i], 1e-12 * scale);
+  }
+}
+
+TEST(GravityTest, AccelerationsIndependentOfThreadCount) {
+  const int n = 500;
+  Body bodies;
+  bodies.resize(n);
+
+  srand(7);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  }
+
+  int defaultThreads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  compute_accelerations(bodies, n);
+  Column ax = bodies.ax, ay = bodies.ay, az = bodies.az;
+
+  // Wątki liczą różne wiersze i sumują bufory w innej kolejności - wyniki różnią się tylko zaokrągleniami
+  omp_set_num_threads(4);
+  compute_accelerations(bodies, n);
+  omp_set_num_threads(defaultThreads);
+
+  for (int i = 0; i < n; i++) {
+    double scale = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+    EXPECT_NEAR(bodies.ax[i], ax[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.ay[i], ay[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.az[i], az[i], 1e-12 * scale);
+  }
+}
+
+TEST(GravityTest, SmallerTeamSumsOnlyItsOwnBuffers) {
+  const int n = 400;
+  Body bodies;
+  bodies.resize(n);
+
+  srand(19);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  }
+  std::vector<double> ax, ay, az;
+  direct_accelerations(bodies, n, ax, ay, az);
+
+  // Pełny zespół zostawia w buforach wszystkich wątków niezerowe wkłady
+  int defaultThreads = omp_get_max_threads();
+  int defaultLevels = omp_get_max_active_levels();
+  omp_set_num_threads(4);
+  compute_accelerations(bodies, n);
+
+  // Wywołanie z regionu równoległego bez zagnieżdżania: zespół ma 1 wątek, choć omp_get_max_threads() zwraca 4
+  omp_set_max_active_levels(1);
+#pragma omp parallel num_threads(2)
+  {
+#pragma omp single
+    compute_accelerations(bodies, n);
+  }
+  omp_set_max_active_levels(defaultLevels);
+  omp_set_num_threads(defaultThreads);
+
+  for (int i = 0; i < n; i++) {
+    double scale = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+    EXPECT_NEAR(bodies.ax[i], ax[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.ay[i], ay[i], 1e-12 * scale);
+    EXPECT_NEAR(bodies.az[i], az[i], 1e-12 * scale);
+  }
+}
+
+TEST(SimdTest, EveryAvailableIsaMatchesSoftenedDirectSum) {
+  const int n = 203;  // nie jest wielokrotnością szerokości wektora - sprawdza też końcówkę pętli
+  Body bodies;
+  bodies.resize(n);
+
+  srand(11);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  }
+  // Dwa ciała prawie w tym samym miejscu - wygładzenie utrzymuje siłę skończoną
+  bodies.x[1] = bodies.x[0] + 1e-12;
+  bodies.y[1] = bodies.y[0];
+  bodies.z[1] = bodies.z[0];
+
+  std::vector<double> ax(n, 0.0), ay(n, 0.0), az(n, 0.0);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      double dx = bodies.x[j] - bodies.x[i];
+      double dy = bodies.y[j] - bodies.y[i];
+      double dz = bodies.z[j] - bodies.z[i];
+      double r2 = dx * dx + dy * dy + dz * dz + 0.01;
+      double F = G * bodies.mass[j] / (r2 * std::sqrt(r2));
+      ax[i] += F * dx;
+      ay[i] += F * dy;
+      az[i] += F * dz;
+    }
+  }
+
+  for (int isa = (int)SimdIsa::Scalar; isa <= (int)detect_simd_isa(); isa++) {
+    SCOPED_TRACE(simd_isa_name((SimdIsa)isa));
+    compute_accelerations_simd(bodies, n, (SimdIsa)isa);
+
+    for (int i = 0; i < n; i++) {
+      double scale = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+      EXPECT_NEAR(bodies.ax[i], ax[i], 1e-10 * scale);
+      EXPECT_NEAR(bodies.ay[i], ay[i], 1e-10 * scale);
+      EXPECT_NEAR(bodies.az[i], az[i], 1e-10 * scale);
+    }
+  }
+}
+
+TEST(SimdTest, SimdKernelConservesMomentum) {
+  Body bodies;
+  bodies.resize(3);
+
+  bodies.x = {0.0, 1.0, 0.5};
+  bodies.y = {0.0, 0.0, std::sqrt(3.0) / 2.0};
+  bodies.z = {0.0, 0.0, 0.0};
+  bodies.vx = {0.0, 0.0, 0.0};
+  bodies.vy = {0.0, 0.0, 0.0};
+  bodies.vz = {0.0, 0.0, 0.0};
+  bodies.mass = {1.0, 2.0, 3.0};
+
+  update_velocities(bodies, 3, 1.0, Kernel::Simd);
+
+  double px = 0.0, py = 0.0;
+  for (int i = 0; i < 3; i++) {
+    px += bodies.mass[i] * bodies.vx[i];
+    py += bodies.mass[i] * bodies.vy[i];
+  }
+  EXPECT_NEAR(px, 0.0, 1e-20);
+  EXPECT_NEAR(py, 0.0, 1e-20);
+  EXPECT_GT(bodies.vx[0], 0.0);
+}
+
+TEST(SimdTest, TiledKernelMatchesUntiled) {
+  const int n = 333;  // kilka niepełnych bloków celów i kafli źródeł
+  Body bodies;
+  bodies.resize(n);
+
+  srand(5);
+  for (int i = 0; i < n; i++) {
+    bodies.x[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.y[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.z[i] = rand() / (double)RAND_MAX * 100.0 - 50.0;
+    bodies.mass[i] = 1.0 + rand() / (double)RAND_MAX * 9.0;
+  }
+
+  for (int isa = (int)SimdIsa::Scalar; isa <= (int)detect_simd_isa(); isa++) {
+    SCOPED_TRACE(simd_isa_name((SimdIsa)isa));
+    compute_accelerations_simd(bodies, n, (SimdIsa)isa);
+    Column ax = bodies.ax, ay = bodies.ay, az = bodies.az;
+
+    for (int tile : {50, 128, 0}) {
+      compute_accelerations_tiled(bodies, n, tile, (SimdIsa)isa);
+      for (int i = 0; i < n; i++) {
+        double scale = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+        EXPECT_NEAR(bodies.ax[i], ax[i], 1e-12 * scale);
+        EXPECT_NEAR(bodies.ay[i], ay[i], 1e-12 * scale);
+        EXPECT_NEAR(bodies.az[i], az[i], 1e-12 * scale);
+      }
+    }
+  }
+  EXPECT_GE(default_tile_size(), 256);
+}
+
 TEST(IntegrationTest, PositionUpdateLargeSystem) {
   Body bodies;
   bodies.resize(100);
@@ -251,7 +1346,7 @@ TEST(SaveStateTest, SaveMultipleSteps) {
   bodies.vz = {0.0, 0.0};
   bodies.mass = {1.0, 1.0};
 
-  std::string filename = "test_output.json";
+  std::string filename = temp_path("test_output.json");
 
   save_state(bodies, 2, filename, 0, false);
   update_positions(bodies, 2, 1.0);
@@ -268,6 +1363,7 @@ TEST(SaveStateTest, SaveMultipleSteps) {
   ASSERT_EQ(jsonData.size(), 2);
   EXPECT_EQ(jsonData[0]["step"], 0);
   EXPECT_EQ(jsonData[1]["step"], 1);
+  std::remove(filename.c_str());
 }
 
 int main(int argc, char** argv) {